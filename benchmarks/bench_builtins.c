@@ -0,0 +1,108 @@
+/* Command resolution benchmark
+ *
+ * Resolves a mix of builtin and external command names, as found in
+ * interactive use and scripts, and reports the time per lookup:
+ * - builtin lookup through the perfect hash table (find_builtin)
+ * - the same lookup done with a linear strcmp scan of the builtin names
+ * - full resolution with get_command_info (builtins, then PATH search)
+ *
+ * Usage: bench_builtins [lookups] [rounds]
+ */
+
+#include <stdbool.h> /* bool, true, false */
+#include <stdio.h>   /* printf, fprintf, stderr */
+#include <stdlib.h>  /* free, atoi */
+#include <string.h>  /* strcmp */
+#include <time.h>    /* clock_gettime, CLOCK_MONOTONIC */
+
+#include "builtin.h" /* find_builtin, builtins */
+#include "execute.h" /* CommandInfo, get_command_info */
+#include "session.h" /* Session, init_session, free_session */
+
+/* Command names resolved by the benchmark */
+static const char *names[] = {
+    "cd",   "ls",     "echo",   "export", "grep", "[",       "cat",
+    "test", "source", "git",    "pwd",    "make", "history", "sed",
+    ".",    "jobs",   "printf", "type",   "awk",  "exit",    "nonexistent",
+};
+
+#define NAME_COUNT (sizeof(names) / sizeof(names[0]))
+
+/* Look a name up the way builtins were found before the hash table */
+static bool linear_lookup(const char *name) {
+    for (int i = 0; builtins[i]; i++) {
+        if (strcmp(builtins[i], name) == 0) {
+            return true;
+        }
+    }
+    return strcmp(name, ".") == 0 || strcmp(name, "[") == 0;
+}
+
+/* Seconds elapsed since `start` */
+static double elapsed(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Time `lookups` lookups done by `kind` and return the best ns per lookup */
+static double run(int kind, size_t lookups, int rounds, Session *session,
+                  size_t *found) {
+    double best = 0;
+    for (int round = 0; round < rounds; round++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        *found = 0;
+        for (size_t i = 0; i < lookups; i++) {
+            const char *name = names[i % NAME_COUNT];
+            if (kind == 0) {
+                *found += find_builtin(name) != NULL;
+            } else if (kind == 1) {
+                *found += linear_lookup(name);
+            } else {
+                CommandInfo info = get_command_info(name, session);
+                *found += info.type != COMMAND_NOT_FOUND;
+                free(info.path);
+            }
+        }
+        double seconds = elapsed(&start);
+        if (round == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best * 1e9 / (double)lookups;
+}
+
+int main(int argc, char **argv) {
+    size_t lookups = argc > 1 ? (size_t)atoi(argv[1]) : 10000000;
+    int    rounds  = argc > 2 ? atoi(argv[2]) : 5;
+    if (lookups == 0 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [lookups] [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    Session *session = init_session(NULL, NULL);
+    if (!session) {
+        fprintf(stderr, "bench_builtins: cannot create a session\n");
+        return 1;
+    }
+
+    size_t found;
+    double hashed = run(0, lookups, rounds, session, &found);
+    printf("builtins: find_builtin %.1f ns/lookup (%zu/%zu builtins)\n",
+           hashed, found, lookups);
+    double linear = run(1, lookups, rounds, session, &found);
+    printf("builtins: linear scan  %.1f ns/lookup (%zu/%zu builtins)\n",
+           linear, found, lookups);
+
+    // PATH searches hit the filesystem, so fewer of them are made
+    size_t resolutions = lookups / 100 ? lookups / 100 : 1;
+    double resolved    = run(2, resolutions, rounds, session, &found);
+    printf("builtins: get_command_info %.1f ns/resolution (%zu/%zu found)\n",
+           resolved, found, resolutions);
+
+    free_session(session);
+    free(session);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* Lexer throughput benchmark
+ *
+ * Tokenizes a synthetic script of a few megabytes (a mix of commands,
+ * quoted strings, assignments, pipelines, redirections and comments, as
+ * found in generated scripts) and reports the throughput in MB/s.
+ *
+ * Usage: bench_lexer [megabytes] [rounds]
+ */
+
+#include <stdbool.h> /* bool, true, false */
+#include <stdio.h>   /* printf, fprintf, stderr */
+#include <stdlib.h>  /* malloc, free, atoi */
+#include <string.h>  /* strlen, memcpy */
+#include <time.h>    /* clock_gettime, CLOCK_MONOTONIC */
+
+#include "lexer.h" /* LexerInput, LexerToken, init_lexer_input, lexer_next_token */
+
+/* Lines the synthetic script is made of */
+static const char *script_lines[] = {
+    "echo \"building target $TARGET in $BUILD_DIR\" --verbose --jobs=8\n",
+    "CFLAGS=\"-O2 -Wall -Wextra -Iinclude -DPROJECT_NAME=tidesh\"\n",
+    "cat /var/log/application/output.log | grep -v debug_message | sort -u > "
+    "/tmp/filtered_output.txt 2>&1\n",
+    "if test -f /etc/configuration_file.conf; then echo 'configuration "
+    "found'; fi\n",
+    "# generated by the configuration tool, do not edit by hand\n",
+    "export LONG_VARIABLE_NAME=some_rather_long_value_without_spaces_at_all\n",
+    "cp -r source_directory/subdirectory/file_name.c "
+    "destination_directory/file_name.c && echo copied || echo failed\n",
+};
+
+/* Build a script of at least `size` bytes */
+static char *build_script(size_t size, size_t *length) {
+    char  *script = malloc(size + 512);
+    size_t used   = 0;
+    size_t lines  = sizeof(script_lines) / sizeof(script_lines[0]);
+    for (size_t i = 0; script && used < size; i++) {
+        const char *line = script_lines[i % lines];
+        size_t      len  = strlen(line);
+        memcpy(script + used, line, len);
+        used += len;
+    }
+    if (script) {
+        script[used] = '\0';
+    }
+    *length = used;
+    return script;
+}
+
+/* Seconds elapsed since `start` */
+static double elapsed(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 8;
+    int    rounds    = argc > 2 ? atoi(argv[2]) : 5;
+    if (megabytes == 0 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [megabytes] [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    size_t length;
+    char  *script = build_script(megabytes * 1024 * 1024, &length);
+    if (!script) {
+        fprintf(stderr, "bench_lexer: out of memory\n");
+        return 1;
+    }
+
+    double best   = 0;
+    size_t tokens = 0;
+    for (int round = 0; round < rounds; round++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        // No session: the lexer falls back to every feature being enabled
+        LexerInput input = {0};
+        init_lexer_input(&input, script, NULL, NULL);
+        tokens = 0;
+        while (true) {
+            LexerToken token = lexer_next_token(&input);
+            bool       done  = token.type == TOKEN_EOF;
+            free_lexer_token(&token);
+            if (done) {
+                break;
+            }
+            tokens++;
+        }
+        free_lexer_input(&input);
+
+        double seconds = elapsed(&start);
+        if (round == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    double mb = (double)length / (1024.0 * 1024.0);
+    printf("lexer: %.1f MB/s (%.1f MB, %zu tokens, best of %d rounds: %.3f "
+           "s)\n",
+           mb / best, mb, tokens, rounds, best);
+
+    free(script);
+    return 0;
+}
@@ -0,0 +1,575 @@
+/* Benchmark suite
+ *
+ * Runs a fixed set of benchmarks over the main parts of the shell and
+ * prints the results as JSON, so runs made on different commits can be
+ * compared with any JSON tool:
+ * - lexing and parsing throughput over a synthetic script
+ * - expansion throughput (variables, braces, tildes, globbing)
+ * - command spawn rate
+ * - Trie, Environ and Array operations
+ * - history load time
+ * - startup time (session creation, and the shell binary if given)
+ *
+ * Every benchmark runs a fixed number of operations per sample, on fixed
+ * inputs, after one untimed warm-up sample. The min, median and p99 of the
+ * time per operation over all the samples are reported.
+ *
+ * Usage: bench_suite [--samples n] [--filter prefix] [--shell path]
+ */
+
+#include <fcntl.h>    /* open, O_WRONLY */
+#include <spawn.h>    /* posix_spawn, posix_spawn_file_actions_* */
+#include <stdbool.h>  /* bool, true, false */
+#include <stdio.h>    /* fprintf, snprintf, FILE, fopen, fdopen, stderr */
+#include <stdlib.h>   /* malloc, free, atoi, qsort, mkdtemp */
+#include <string.h>   /* strlen, strcmp, strncmp, memcpy */
+#include <sys/wait.h> /* waitpid */
+#include <time.h>     /* clock_gettime, CLOCK_MONOTONIC */
+#include <unistd.h>   /* dup, dup2, close, unlink, rmdir */
+
+#include "ast.h"        /* ASTNode, parse, free_ast */
+#include "data/array.h" /* Array, init_array, array_add, array_sort */
+#include "data/trie.h"  /* Trie, init_trie, trie_set, trie_get */
+#include "environ.h"    /* Environ, environ_set, environ_get */
+#include "execute.h"    /* execute_string */
+#include "expand.h"     /* full_expansion */
+#include "history.h"    /* History, init_history, load_history */
+#include "lexer.h"      /* LexerInput, LexerToken, lexer_next_token */
+#include "session.h"    /* Session, init_session, free_session */
+
+extern char **environ;
+
+/* Number of samples taken by default */
+#define BENCH_DEFAULT_SAMPLES 30
+
+/* Size of the synthetic script used by the lexer and parser benchmarks */
+#define BENCH_SCRIPT_SIZE (64 * 1024)
+
+/* Number of files in the directory used by the glob benchmark */
+#define BENCH_GLOB_FILES 256
+
+/* Number of commands in the history file used by the history benchmark */
+#define BENCH_HISTORY_COMMANDS 10000
+
+/* State shared by the benchmarks */
+typedef struct BenchContext {
+    Session    *session;       // Session the benchmarks run in
+    char       *script;        // Synthetic script
+    size_t      script_length; // Length of the script
+    char        directory[64]; // Temporary directory with test files
+    char        glob[96];      // Pattern matching the glob files
+    char        history[96];   // Path of the history file
+    const char *shell;         // Path of the shell binary (or NULL)
+} BenchContext;
+
+/* A benchmark: `run` performs `operations` operations */
+typedef struct Benchmark {
+    const char *name;       // Name, as group/benchmark
+    size_t      operations; // Operations per sample
+    size_t      bytes;      // Bytes processed per operation (0 if none)
+    bool (*run)(BenchContext *context, size_t operations);
+} Benchmark;
+
+/* Lines the synthetic script is made of */
+static const char *script_lines[] = {
+    "echo \"building target $TARGET in $BUILD_DIR\" --verbose --jobs=8\n",
+    "CFLAGS=\"-O2 -Wall -Wextra -Iinclude -DPROJECT_NAME=tidesh\"\n",
+    "cat /var/log/application/output.log | grep -v debug | sort -u > "
+    "/tmp/filtered_output.txt 2>&1\n",
+    "test -f /etc/configuration.conf && echo 'configuration found' || echo "
+    "missing\n",
+    "# generated by the configuration tool, do not edit by hand\n",
+    "export LONG_VARIABLE_NAME=some_rather_long_value_without_spaces\n",
+    "cp -r source_directory/file_name.c destination/file_name.c; echo done\n",
+};
+
+/* Build a script of at least `size` bytes */
+static char *build_script(size_t size, size_t *length) {
+    size_t lines  = sizeof(script_lines) / sizeof(script_lines[0]);
+    char  *script = malloc(size + 512);
+    size_t used   = 0;
+    for (size_t i = 0; script && used < size; i++) {
+        const char *line = script_lines[i % lines];
+        size_t      len  = strlen(line);
+        memcpy(script + used, line, len);
+        used += len;
+    }
+    if (script) {
+        script[used] = '\0';
+    }
+    *length = used;
+    return script;
+}
+
+/* Nanoseconds elapsed since `start` */
+static double elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1e9 +
+           (double)(now.tv_nsec - start->tv_nsec);
+}
+
+/* Keep a value from being optimized away */
+static volatile size_t bench_sink;
+
+/* Tokenize the script */
+static bool bench_lexer(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        LexerInput input = {0};
+        init_lexer_input(&input, context->script, NULL, context->session);
+        while (true) {
+            LexerToken token = lexer_next_token(&input);
+            bool       done  = token.type == TOKEN_EOF;
+            free_lexer_token(&token);
+            if (done) {
+                break;
+            }
+            bench_sink++;
+        }
+        free_lexer_input(&input);
+    }
+    return true;
+}
+
+/* Parse the script into an AST */
+static bool bench_parser(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        LexerInput input = {0};
+        init_lexer_input(&input, context->script, NULL, context->session);
+        ASTNode *tree = parse(&input, context->session);
+        if (!tree) {
+            free_lexer_input(&input);
+            return false;
+        }
+        free_ast(tree);
+        free(tree);
+        free_lexer_input(&input);
+    }
+    return true;
+}
+
+/* Expand `word` `operations` times */
+static bool expand_word(BenchContext *context, const char *word,
+                        size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        Array *words = full_expansion((char *)word, context->session);
+        if (!words) {
+            return false;
+        }
+        bench_sink += words->count;
+        free_array(words);
+        free(words);
+    }
+    return true;
+}
+
+/* Expand a word with nothing to expand */
+static bool bench_expand_plain(BenchContext *context, size_t operations) {
+    return expand_word(context, "--output=build/release/tidesh", operations);
+}
+
+/* Expand a quoted word with variables */
+static bool bench_expand_variables(BenchContext *context, size_t operations) {
+    return expand_word(context, "\"$BENCH_PREFIX/${BENCH_NAME}_$BENCH_ID.log\"",
+                       operations);
+}
+
+/* Expand a word to 192 words with braces */
+static bool bench_expand_braces(BenchContext *context, size_t operations) {
+    return expand_word(context, "src/{lexer,parser,expand}/file{1..32}.{c,h}",
+                       operations);
+}
+
+/* Expand a tilde */
+static bool bench_expand_tilde(BenchContext *context, size_t operations) {
+    return expand_word(context, "~/.config/tidesh/tideshrc", operations);
+}
+
+/* Match the files of a directory against a pattern */
+static bool bench_expand_glob(BenchContext *context, size_t operations) {
+    return expand_word(context, context->glob, operations);
+}
+
+/* Run an external command */
+static bool bench_spawn(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        if (execute_string("/bin/true", context->session) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Run a builtin (builtins that are not special run in a child process) */
+static bool bench_builtin(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        if (execute_string("test -n value", context->session) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Run a special builtin, which runs in the shell process */
+static bool bench_special(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        if (execute_string("export BENCH_ID=42", context->session) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Number of keys used by the data structure benchmarks */
+#define BENCH_KEYS 1024
+
+/* Key number `i` */
+static void bench_key(char *buffer, size_t size, size_t i) {
+    snprintf(buffer, size, "BENCH_KEY_%zu_%zu", i % 7, i);
+}
+
+/* Fill a Trie and look every key up */
+static bool bench_trie(BenchContext *context, size_t operations) {
+    (void)context;
+    char buffer[64];
+    for (size_t i = 0; i < operations; i++) {
+        Trie *trie = init_trie(NULL);
+        if (!trie) {
+            return false;
+        }
+        for (size_t key = 0; key < BENCH_KEYS; key++) {
+            bench_key(buffer, sizeof(buffer), key);
+            trie_set(trie, buffer, "value");
+        }
+        for (size_t key = 0; key < BENCH_KEYS; key++) {
+            bench_key(buffer, sizeof(buffer), key);
+            bench_sink += trie_get(trie, buffer) != NULL;
+        }
+        free_trie(trie);
+    }
+    return true;
+}
+
+/* Fill an Environ and look every variable up */
+static bool bench_environ(BenchContext *context, size_t operations) {
+    (void)context;
+    char buffer[64];
+    for (size_t i = 0; i < operations; i++) {
+        Environ *env = init_environ(NULL);
+        if (!env) {
+            return false;
+        }
+        for (size_t key = 0; key < BENCH_KEYS; key++) {
+            bench_key(buffer, sizeof(buffer), key);
+            environ_set(env, buffer, "value");
+        }
+        for (size_t key = 0; key < BENCH_KEYS; key++) {
+            bench_key(buffer, sizeof(buffer), key);
+            bench_sink += environ_get(env, buffer) != NULL;
+        }
+        free_environ(env);
+        free(env);
+    }
+    return true;
+}
+
+/* Fill an Array and sort it */
+static bool bench_array(BenchContext *context, size_t operations) {
+    (void)context;
+    char buffer[64];
+    for (size_t i = 0; i < operations; i++) {
+        Array *array = init_array(NULL);
+        if (!array) {
+            return false;
+        }
+        for (size_t key = BENCH_KEYS; key > 0; key--) {
+            bench_key(buffer, sizeof(buffer), key);
+            array_add(array, buffer);
+        }
+        array_sort(array);
+        bench_sink += array->count;
+        free_array(array);
+        free(array);
+    }
+    return true;
+}
+
+/* Load a history file */
+static bool bench_history(BenchContext *context, size_t operations) {
+    for (size_t i = 0; i < operations; i++) {
+        History *history = init_history(NULL);
+        if (!history) {
+            return false;
+        }
+        history->strings = context->session->strings;
+        history          = load_history(history, context->history);
+        if (!history || history->size != BENCH_HISTORY_COMMANDS) {
+            return false;
+        }
+        free_history(history);
+        free(history);
+    }
+    return true;
+}
+
+/* Create and free a session */
+static bool bench_session(BenchContext *context, size_t operations) {
+    (void)context;
+    for (size_t i = 0; i < operations; i++) {
+        Session *session = init_session(NULL, NULL);
+        if (!session) {
+            return false;
+        }
+        free_session(session);
+        free(session);
+    }
+    return true;
+}
+
+/* Start the shell binary to run a single builtin */
+static bool bench_process(BenchContext *context, size_t operations) {
+    char *argv[] = {(char *)context->shell,
+                    "--rc",
+                    "/dev/null",
+                    "--history",
+                    "/dev/null",
+                    "-c",
+                    "pwd",
+                    NULL};
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < operations; i++) {
+        pid_t pid;
+        int   status;
+        ok = posix_spawn(&pid, context->shell, &actions, NULL, argv,
+                         environ) == 0 &&
+             waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+             WEXITSTATUS(status) == 0;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return ok;
+}
+
+/* The benchmarks, in the order they are run */
+static const Benchmark benchmarks[] = {
+    {"lexer/tokenize", 20, BENCH_SCRIPT_SIZE, bench_lexer},
+    {"parser/parse", 20, BENCH_SCRIPT_SIZE, bench_parser},
+    {"expand/plain", 20000, 0, bench_expand_plain},
+    {"expand/variables", 20000, 0, bench_expand_variables},
+    {"expand/braces", 1000, 0, bench_expand_braces},
+    {"expand/tilde", 20000, 0, bench_expand_tilde},
+    {"expand/glob", 200, 0, bench_expand_glob},
+    {"execute/spawn", 50, 0, bench_spawn},
+    {"execute/builtin", 200, 0, bench_builtin},
+    {"execute/special", 20000, 0, bench_special},
+    {"data/trie", 20, 0, bench_trie},
+    {"data/environ", 20, 0, bench_environ},
+    {"data/array", 20, 0, bench_array},
+    {"history/load", 5, 0, bench_history},
+    {"startup/session", 200, 0, bench_session},
+    {"startup/process", 10, 0, bench_process},
+};
+
+#define BENCHMARK_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/* Create the files used by the glob and history benchmarks */
+static bool setup_files(BenchContext *context) {
+    snprintf(context->directory, sizeof(context->directory),
+             "/tmp/tidesh-bench-XXXXXX");
+    if (!mkdtemp(context->directory)) {
+        return false;
+    }
+
+    char path[128];
+    for (int i = 0; i < BENCH_GLOB_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/file%03d.%s", context->directory, i,
+                 i % 2 ? "c" : "h");
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+    }
+    snprintf(context->glob, sizeof(context->glob), "%s/file*.c",
+             context->directory);
+
+    snprintf(context->history, sizeof(context->history), "%s/history",
+             context->directory);
+    FILE *file = fopen(context->history, "w");
+    if (!file) {
+        return false;
+    }
+    for (int i = 0; i < BENCH_HISTORY_COMMANDS; i++) {
+        // One command in four is a repeat, as in real histories
+        if (i % 4 == 0) {
+            fprintf(file, "%d,git status\n", 1700000000 + i);
+        } else {
+            fprintf(file, "%d,make test/core JOBS=%d\n", 1700000000 + i, i);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+/* Remove the files created by setup_files */
+static void cleanup_files(BenchContext *context) {
+    char path[128];
+    for (int i = 0; i < BENCH_GLOB_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/file%03d.%s", context->directory, i,
+                 i % 2 ? "c" : "h");
+        unlink(path);
+    }
+    unlink(context->history);
+    rmdir(context->directory);
+}
+
+/* Order doubles for qsort */
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Value below which `percent` percent of the sorted samples are */
+static double percentile(const double *samples, size_t count, double percent) {
+    size_t rank = (size_t)(percent / 100.0 * (double)count + 0.999999);
+    return samples[rank ? rank - 1 : 0];
+}
+
+/* Run a benchmark and print its JSON object, or return false if it failed */
+static bool run_benchmark(const Benchmark *benchmark, BenchContext *context,
+                          size_t sample_count, bool first, FILE *output) {
+    double *samples = malloc(sample_count * sizeof(double));
+    if (!samples) {
+        return false;
+    }
+
+    // The first sample warms caches up and is not reported
+    bool ok = benchmark->run(context, benchmark->operations);
+    for (size_t i = 0; ok && i < sample_count; i++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ok         = benchmark->run(context, benchmark->operations);
+        samples[i] = elapsed_ns(&start) / (double)benchmark->operations;
+    }
+    if (!ok) {
+        free(samples);
+        return false;
+    }
+
+    qsort(samples, sample_count, sizeof(double), compare_doubles);
+    size_t middle = sample_count / 2;
+    double median = sample_count % 2
+                        ? samples[middle]
+                        : (samples[middle - 1] + samples[middle]) / 2;
+    double p99    = percentile(samples, sample_count, 99);
+
+    fprintf(output,
+            "%s\n    {\"name\": \"%s\", \"unit\": \"ns/op\", "
+            "\"operations\": %zu, \"samples\": %zu, \"min\": %.1f, "
+            "\"median\": %.1f, \"p99\": %.1f",
+            first ? "" : ",", benchmark->name, benchmark->operations,
+            sample_count, samples[0], median, p99);
+    if (benchmark->bytes) {
+        fprintf(output, ", \"mb_per_s\": %.1f",
+                (double)benchmark->bytes / median * 1e9 / (1024.0 * 1024.0));
+    }
+    fprintf(output, "}");
+    fflush(output);
+    fprintf(stderr, "%-20s median %12.1f ns/op  (min %.1f, p99 %.1f)\n",
+            benchmark->name, median, samples[0], p99);
+
+    free(samples);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t      sample_count = BENCH_DEFAULT_SAMPLES;
+    const char *filter       = NULL;
+    const char *shell        = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            int value    = atoi(argv[++i]);
+            sample_count = value > 0 ? (size_t)value : 0;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--shell") == 0 && i + 1 < argc) {
+            shell = argv[++i];
+        } else {
+            sample_count = 0;
+            break;
+        }
+    }
+    if (sample_count == 0) {
+        fprintf(stderr,
+                "usage: %s [--samples n] [--filter prefix] [--shell path]\n",
+                argv[0]);
+        return 2;
+    }
+
+    BenchContext context = {0};
+    context.shell        = shell;
+    context.session      = init_session(NULL, NULL);
+    context.script = build_script(BENCH_SCRIPT_SIZE, &context.script_length);
+    if (!context.session || !context.script || !setup_files(&context)) {
+        fprintf(stderr, "bench_suite: cannot set the benchmarks up\n");
+        return 1;
+    }
+    context.session->features.history = false;
+    environ_set(context.session->environ, "BENCH_PREFIX", "/var/log/tidesh");
+    environ_set(context.session->environ, "BENCH_NAME", "benchmark");
+    environ_set(context.session->environ, "BENCH_ID", "42");
+
+    // Commands write to stdout (and their children restore the terminal on
+    // exit), so the results go to a copy of it and stdout to /dev/null
+    int   null_fd = open("/dev/null", O_WRONLY);
+    FILE *output  = fdopen(dup(STDOUT_FILENO), "w");
+    if (null_fd < 0 || !output) {
+        fprintf(stderr, "bench_suite: cannot redirect stdout\n");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    fprintf(output, "{\n  \"suite\": \"tidesh\",\n");
+#ifdef VERSION
+    fprintf(output, "  \"version\": \"%s\",\n", VERSION);
+#endif
+    fprintf(output, "  \"results\": [");
+    // Forked children would write what is still buffered again on exit
+    fflush(output);
+
+    bool first    = true;
+    int  failures = 0;
+    for (size_t i = 0; i < BENCHMARK_COUNT; i++) {
+        const Benchmark *benchmark = &benchmarks[i];
+        if (filter && strncmp(benchmark->name, filter, strlen(filter)) != 0) {
+            continue;
+        }
+        if (benchmark->run == bench_process && !context.shell) {
+            fprintf(stderr, "%-20s skipped (no --shell given)\n",
+                    benchmark->name);
+            continue;
+        }
+        if (run_benchmark(benchmark, &context, sample_count, first, output)) {
+            first = false;
+        } else {
+            fprintf(stderr, "bench_suite: %s failed\n", benchmark->name);
+            failures++;
+        }
+    }
+    fprintf(output, "\n  ]\n}\n");
+    fclose(output);
+
+    cleanup_files(&context);
+    free(context.script);
+    free_session(context.session);
+    free(context.session);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+"""
+Benchmark of sessions driven by many Python threads.
+
+Each thread owns a session and parses, tokenizes, expands and looks up a batch
+of commands. The C calls run without the GIL, so the throughput should grow
+with the number of threads (up to the number of cores).
+
+Usage: python benchmarks/threads.py [--threads N] [--rounds N]
+"""
+
+from __future__ import annotations
+
+import argparse
+import concurrent.futures
+import os
+import time
+
+import tidesh
+
+COMMANDS = [
+    "echo hello world | grep -v foo | wc -l",
+    "x=1 y=2 ls -la ~ > /dev/null 2>&1 &",
+    "if test -f /etc/passwd; then cat /etc/passwd; else echo missing; fi",
+    "make -j8 all && ./bin/tidesh --version || echo failed; true",
+    "cat < <(printf '%s\\n' a b c) | sort -r | head -n 2",
+] * 20
+WORDS = ["~", "a{b,c,d}{1,2}", "$HOME/src", "${PATH}", "plain"] * 20
+LOOKUPS = ["ls", "cat", "sh", "env", "nonexistent_tidesh_command"]
+
+
+def work(rounds: int) -> int:
+    """Run the workload in a new session, returning the number of operations."""
+    operations = 0
+    with tidesh.Session(run_hooks=False) as session:
+        for _ in range(rounds):
+            session.parse_many(COMMANDS)
+            session.tokenize_many(COMMANDS)
+            session.expand_many(WORDS)
+            for command in LOOKUPS:
+                session.find_in_path(command)
+            operations += 2 * len(COMMANDS) + len(WORDS) + len(LOOKUPS)
+    return operations
+
+
+def measure(threads: int, rounds: int) -> float:
+    """Run the workload on a number of threads, returning the operations per second."""
+    start = time.perf_counter()
+    with concurrent.futures.ThreadPoolExecutor(threads) as executor:
+        operations = sum(executor.map(work, [rounds] * threads))
+    return operations / (time.perf_counter() - start)
+
+
+def main() -> None:
+    """Compare the throughput of one thread with the one of many."""
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--threads", type=int, default=min(os.cpu_count() or 1, 8))
+    parser.add_argument("--rounds", type=int, default=200)
+    args = parser.parse_args()
+
+    work(1)  # Warm up
+    single = measure(1, args.rounds)
+    many = measure(args.threads, args.rounds)
+    print(f"1 thread:    {single:12.0f} ops/s")
+    print(f"{args.threads} threads: {many:12.0f} ops/s ({many / single:.2f}x)")
+
+
+if __name__ == "__main__":
+    main()
@@ -93,25 +93,36 @@ Or ensure sources are staged in bindings/python/src before building.
 sources = [
     "ast.c",
     "builtin.c",
+    "dircache.c",
     "dirstack.c",
     "environ.c",
     "execute.c",
     "expand.c",
     "features.c",
+    "flat.c",
     "history.c",
     "jobs.c",
     "lexer.c",
     "prompt.c",
     "hooks.c",
+    "profile.c",
+    "script.c",
+    "server.c",
     "session.c",
+    "startup.c",
+    "trace.c",
+    "zygote.c",
     "data/array.c",
     "data/dynamic.c",
     "data/trie.c",
     "data/utf8.c",
+    "data/scan.c",
+    "data/intern.c",
     "data/files.c",
     "expansions/aliases.c",
     "expansions/braces.c",
     "expansions/filenames.c",
+    "expansions/substitutions.c",
     "expansions/tildes.c",
     "expansions/variables.c",
     "prompt/ansi.c",
@@ -132,6 +143,7 @@ sources = [
     "builtins/history.c",
     "builtins/info.c",
     "builtins/jobs.c",
+    "builtins/parallel.c",
     "builtins/popd.c",
     "builtins/printenv.c",
     "builtins/pushd.c",
@@ -144,6 +156,8 @@ sources = [
     "builtins/test.c",
     "builtins/hooks.c",
     "builtins/features.c",
+    "builtins/wait.c",
+    "builtins/time.c",
 ]
 
 # Convert to relative paths for setup
@@ -170,7 +184,8 @@ ffibuilder.set_source(
         ("PLATFORM", f'"{PLATFORM}"'),
         ("BRIEF", f'"{BRIEF}"'),
     ],
-    extra_compile_args=["-O3"],
+    extra_compile_args=["-O3", "-pthread"],
+    extra_link_args=["-pthread"],
 )
 
 # Build the extension module
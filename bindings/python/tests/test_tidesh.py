@@ -1,3 +1,7 @@
+import concurrent.futures
+
+import pytest
+
 import tidesh
 
 
@@ -33,3 +37,70 @@ def test_capture() -> None:
     output = tidesh.capture("echo 'hello world'")
     assert output is not None
     assert output.strip() == "hello world"
+
+
+def test_server() -> None:
+    with tidesh.Server(run_hooks=False) as server:
+        # Requests are all sent before any reply is read
+        requests = [server.submit(f"echo {i}") for i in range(10)]
+        assert [request.stdout for request in requests] == [f"{i}\n".encode() for i in range(10)]
+        assert all(request.status == 0 for request in requests)
+
+        # The session keeps its state between requests
+        assert server.submit("cd /").wait() == 0
+        assert server.capture("pwd") == "/\n"
+
+        chunks = list(server.stream("ls /nonexistent_tidesh_12345"))
+        assert chunks
+        assert all(stream is tidesh.OutputStream.STDERR for stream, _ in chunks)
+
+
+def test_server_exit() -> None:
+    server = tidesh.Server(run_hooks=False)
+    request = server.submit("exit 3")
+    assert request.wait() == 3
+    with pytest.raises(tidesh.ServerError):
+        server.submit("true").wait()
+    server.close()
+
+
+def test_parse_many() -> None:
+    flat = tidesh.parse_many(["echo a | wc -l", "", "x=1 ls > out &"])
+    assert flat.roots == [0, None, 3]
+
+    pipe = flat[0]
+    assert pipe.type is tidesh.NodeType.PIPE
+    assert pipe.left is not None
+    assert flat[pipe.left].argv == ["echo", "a"]
+
+    command = flat[3]
+    assert command.background
+    assert command.argv == ["ls"]
+    assert command.assignments == ["x=1"]
+    assert [redirect.target for redirect in command.redirects] == ["out"]
+
+
+def test_tokenize_many() -> None:
+    commands = ["echo hi", "a > b"]
+    assert [list(map(repr, tokens)) for tokens in tidesh.tokenize_many(commands)] == [
+        list(map(repr, tidesh.tokenize(command))) for command in commands
+    ]
+
+
+def test_threads() -> None:
+    commands = ["echo a | wc -l", "x=1 ls > out &"]
+    expected = [list(tidesh.parse_many(commands))] * 8
+
+    def work(_: int) -> list[tidesh.FlatNode]:
+        with tidesh.Session(run_hooks=False) as session:
+            assert session.find_in_path("ls") is not None
+            assert session.expand_many(["a{b,c}"]) == [["ab", "ac"]]
+            return list(session.parse_many(commands))
+
+    with concurrent.futures.ThreadPoolExecutor(4) as executor:
+        assert list(executor.map(work, range(8))) == expected
+
+
+def test_expand_many() -> None:
+    with tidesh.Session() as session:
+        assert session.expand_many(["a{b,c}", "plain"]) == [["ab", "ac"], ["plain"]]
@@ -20,6 +20,9 @@ Hello
 Classes
 -------
 - Session: Represents a shell session with state and capabilities.
+- Server: A session owned by a worker process, for running many commands
+  without forking the Python process.
+- ServerRequest: A command sent to a server, with its streamed output.
 - History: Manages command history for a session.
 - Environ: A dict-like interface for environment variables.
 - Aliases: A dict-like interface for shell aliases.
@@ -35,6 +38,7 @@ Classes
 - ExtraValuedToken: Token with both value and extra attributes.
 - WordToken, IONumberToken, CommentToken, etc.: Specific token types.
 - ASTNode: Represents a node in the abstract syntax tree of a command.
+- FlatAST: The flattened ASTs of many commands, in a single buffer.
 
 Functions
 ---------
@@ -42,6 +46,8 @@ Functions
 - capture(command: str) -> str | None: Run a command and capture its standard output.
 - tokenize(command: str) -> Iterable[Token]: Tokenize a command string.
 - parse(command: str) -> ASTNode: Parse a command string into an abstract syntax tree.
+- tokenize_many(commands: Iterable[str]) -> list[list[Token]]: Tokenize many command strings at once.
+- parse_many(commands: Iterable[str]) -> FlatAST: Parse many command strings at once.
 """
 # pyright: reportUnknownMemberType=false, reportUnknownVariableType=false, reportUnknownArgumentType=false, reportPrivateUsage=false
 
@@ -67,7 +73,7 @@ from .__info__ import (
     __year__,
 )
 from ._tidesh import ffi, lib
-from .ast import ASTNode, NodeType
+from .ast import ASTNode, FlatAST, FlatNode, FlatRedirect, NodeType
 from .constants import Hook
 from .exceptions import (
     AliasError,
@@ -77,10 +83,13 @@ from .exceptions import (
     ExecutionError,
     LexerError,
     ParseError,
+    ServerError,
     SessionError,
     TideshError,
 )
+from .flat import FlatBuffer
 from .lexer import Lexer
+from .server import OutputStream, Server, ServerRequest
 from .session import (
     AliasCommandInfo,
     BuiltinCommandInfo,
@@ -150,6 +159,10 @@ __all__ = [
     "ExtraValuedToken",
     "FDDuplicationToken",
     "Features",
+    "FlatAST",
+    "FlatBuffer",
+    "FlatNode",
+    "FlatRedirect",
     "HeredocToken",
     "HereStringToken",
     "History",
@@ -162,6 +175,7 @@ __all__ = [
     "Lexer",
     "NodeType",
     "OrToken",
+    "OutputStream",
     "ParseError",
     "PipeToken",
     "ProcessSubstitutionInToken",
@@ -173,6 +187,9 @@ __all__ = [
     "RedirectOutToken",
     "SemicolonToken",
     "SequenceToken",
+    "Server",
+    "ServerError",
+    "ServerRequest",
     "Session",
     "SessionError",
     "Terminal",
@@ -182,8 +199,10 @@ __all__ = [
     "WordToken",
     "capture",
     "parse",
+    "parse_many",
     "run",
     "tokenize",
+    "tokenize_many",
     "__author__",
     "__brief__",
     "__build_date__",
@@ -278,3 +297,39 @@ def parse(command: str) -> ASTNode:
             msg = "Failed to parse command"
             raise ParseError(msg, command=command)
         return ASTNode(c_node)
+
+
+def tokenize_many(commands: typing.Iterable[str]) -> list[list[Token]]:
+    """
+    Tokenize many command strings at once in a new session.
+
+    Parameters
+    ----------
+    commands : Iterable[str]
+        The commands to tokenize.
+
+    Returns
+    -------
+    list[list[Token]]
+        The tokens of each command, including its EOF token.
+    """
+    with Session() as s:
+        return s.tokenize_many(commands)
+
+
+def parse_many(commands: typing.Iterable[str]) -> FlatAST:
+    """
+    Parse many command strings at once in a new session, into a single flat buffer.
+
+    Parameters
+    ----------
+    commands : Iterable[str]
+        The commands to parse.
+
+    Returns
+    -------
+    FlatAST
+        The flattened trees of the commands.
+    """
+    with Session() as s:
+        return s.parse_many(commands)
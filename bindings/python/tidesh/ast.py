@@ -1,10 +1,13 @@
 """Abstract Syntax Tree (AST) representation for tidesh."""
 # pyright: reportUnknownMemberType=false, reportUnknownVariableType=false, reportUnknownArgumentType=false, reportPrivateUsage=false
+from __future__ import annotations
 
+import functools
 import typing
 from enum import IntEnum
 
 from ._tidesh import ffi, lib
+from .flat import FlatBuffer
 
 
 class NodeType(IntEnum):
@@ -16,6 +19,7 @@ class NodeType(IntEnum):
     OR = lib.NODE_OR
     SEQUENCE = lib.NODE_SEQUENCE
     SUBSHELL = lib.NODE_SUBSHELL
+    CONDITIONAL = lib.NODE_CONDITIONAL
 
 
 class ASTNode:
@@ -81,3 +85,139 @@ class ASTNode:
             The right child node, or None if not present.
         """
         return ASTNode(self._node.right) if self._node.right != ffi.NULL else None
+
+    def flatten(self) -> "FlatAST":
+        """
+        Flatten the tree below this node into a single buffer.
+
+        Returns
+        -------
+        FlatAST
+            The flattened tree, whose only root is this node.
+        """
+        return FlatAST(lib.flatten_ast(self._node))
+
+
+class FlatRedirect(typing.NamedTuple):
+    """A redirection of a flattened AST node."""
+
+    fd: int
+    """The descriptor being redirected."""
+    type: int
+    """The token type of the redirection (see `TokenType`)."""
+    target: str | None
+    """The target (the command of a process substitution)."""
+    process_substitution: bool
+    """Whether the target is a process substitution."""
+
+
+class FlatNode(typing.NamedTuple):
+    """A node of a flattened AST, with its children as indices."""
+
+    type: NodeType
+    """The type of the node."""
+    background: bool
+    """Whether the command should run in the background."""
+    left: int | None
+    """The index of the left child."""
+    right: int | None
+    """The index of the right child."""
+    argv: list[str]
+    """The command arguments."""
+    assignments: list[str]
+    """The variable assignments (NAME=value)."""
+    redirects: list[FlatRedirect]
+    """The I/O redirections."""
+    branches: list[tuple[int | None, int | None]]
+    """The branches of a conditional: condition (None for else) and body indices."""
+
+
+class FlatAST(FlatBuffer):
+    """
+    The flattened ASTs of one or more commands, in a single buffer.
+
+    Nodes are rows of the `nodes` memoryview (12 integers: type, flags, left,
+    right, then the first index and count of the arguments, assignments,
+    redirections and branches), children and strings being referred to by
+    index. Indexing the object decodes a node into a `FlatNode`.
+    """
+
+    @property
+    def roots(self) -> list[int | None]:
+        """The root node of each command, None for the ones without any or which failed to parse."""
+        return [None if root < 0 else root for root in self.inputs.tolist()]
+
+    @functools.cached_property
+    def nodes(self) -> memoryview:
+        """The nodes, as a (count, 12) memoryview of 32 bits integers."""
+        return self.records(12)
+
+    @functools.cached_property
+    def redirects(self) -> memoryview:
+        """The redirections, as a (count, 4) memoryview: fd, type, target string and flags."""
+        return self._section(self._header.redirects, self._header.redirect_count, 4)
+
+    @functools.cached_property
+    def branches(self) -> memoryview:
+        """The branches of conditionals, as a (count, 2) memoryview: condition and body nodes."""
+        return self._section(self._header.branches, self._header.branch_count, 2)
+
+    def __getitem__(self, index: int) -> FlatNode:
+        """
+        Decode a node.
+
+        Parameters
+        ----------
+        index : int
+            The index of the node.
+
+        Returns
+        -------
+        FlatNode
+            The node.
+        """
+        if not 0 <= index < len(self):
+            raise IndexError(index)
+        (
+            node_type,
+            flags,
+            left,
+            right,
+            argv,
+            argc,
+            assignments,
+            assignment_count,
+            redirects,
+            redirect_count,
+            branches,
+            branch_count,
+        ) = self.nodes[index : index + 1].tolist()[0]
+        strings = self.strings
+        # Rows are sliced, as sub-views of a single row are not supported
+        redirect_rows = self.redirects[redirects : redirects + redirect_count].tolist()
+        branch_rows = self.branches[branches : branches + branch_count].tolist()
+        return FlatNode(
+            type=NodeType(node_type),
+            background=bool(flags & lib.FLAT_NODE_BACKGROUND),
+            left=None if left < 0 else left,
+            right=None if right < 0 else right,
+            argv=strings[argv : argv + argc],
+            assignments=strings[assignments : assignments + assignment_count],
+            redirects=[
+                FlatRedirect(
+                    fd=fd,
+                    type=redirect_type,
+                    target=None if target < 0 else strings[target],
+                    process_substitution=bool(redirect_flags & lib.FLAT_REDIRECT_PROCESS_SUBSTITUTION),
+                )
+                for fd, redirect_type, target, redirect_flags in redirect_rows
+            ],
+            branches=[
+                (None if condition < 0 else condition, None if body < 0 else body) for condition, body in branch_rows
+            ],
+        )
+
+    def __iter__(self) -> typing.Iterator[FlatNode]:
+        """Iterate over the decoded nodes."""
+        for index in range(len(self)):
+            yield self[index]
@@ -44,6 +44,15 @@ class SessionError(TideshError):
     """
 
 
+class ServerError(TideshError):
+    """
+    Raised when a server worker cannot be reached.
+
+    This occurs when the worker process could not be started, or exited
+    (for example after running `exit`) while requests were still pending.
+    """
+
+
 class ParseError(TideshError):
     """
     Raised when command parsing fails.
@@ -0,0 +1,127 @@
+"""
+Flat buffers for tidesh.
+
+The batch APIs (`Session.parse_many`, `Session.tokenize_many`,
+`Session.expand_many`) process all their inputs in a single C call, which
+returns a flat buffer: one block of memory holding a header, an entry per
+input, fixed size records (AST nodes or tokens) referring to each other and to
+their strings by index, and a table of NUL terminated strings.
+
+The sections are exposed as memoryviews of the C memory, without copies, and
+the string table is decoded at once when it is first needed.
+"""
+
+# pyright: reportUnknownMemberType=false, reportUnknownVariableType=false, reportUnknownArgumentType=false, reportPrivateUsage=false
+from __future__ import annotations
+
+import functools
+import typing
+
+from ._tidesh import ffi, lib
+
+
+def pack_inputs(inputs: typing.Iterable[str]) -> tuple[bytes, int]:
+    """
+    Pack strings the way the batch functions take them: NUL terminated, one after the other.
+
+    Parameters
+    ----------
+    inputs : Iterable[str]
+        The strings.
+
+    Returns
+    -------
+    tuple[bytes, int]
+        The packed strings and their number.
+
+    Raises
+    ------
+    ValueError
+        If a string contains a NUL character.
+    """
+    encoded = [text.encode() for text in inputs]
+    if any(b"\0" in text for text in encoded):
+        msg = "Inputs cannot contain NUL characters"
+        raise ValueError(msg)
+    return b"\0".join(encoded) + b"\0", len(encoded)
+
+
+class FlatBuffer:
+    """
+    A flat buffer returned by a batch function.
+
+    Attributes
+    ----------
+    buffer : memoryview
+        The whole buffer, header included.
+    """
+
+    def __init__(self, c_buffer: typing.Any) -> None:
+        """
+        Take ownership of a flat buffer.
+
+        Parameters
+        ----------
+        c_buffer : typing.Any
+            The C flat buffer, freed along with this object.
+
+        Raises
+        ------
+        MemoryError
+            If the buffer could not be built (NULL).
+        """
+        super().__init__()
+        if c_buffer == ffi.NULL:
+            msg = "Failed to build a flat buffer"
+            raise MemoryError(msg)
+        self._header = ffi.gc(c_buffer, lib.free)
+        self.buffer = memoryview(ffi.buffer(self._header, self._header.size))
+        """The whole buffer, header included."""
+
+    def _section(self, offset: int, count: int, fields: int) -> memoryview:
+        """(internal) A section of 32 bits integers, with a row per item."""
+        view = self.buffer[offset : offset + count * fields * 4]
+        if count == 0:
+            return view.cast("i")
+        return view.cast("i", shape=[count, fields])
+
+    @property
+    def inputs(self) -> memoryview:
+        """The entry of each input (32 bits integers)."""
+        start = self._header.inputs
+        return self.buffer[start : start + self._header.input_count * 4].cast("i")
+
+    def records(self, fields: int) -> memoryview:
+        """
+        Get the records.
+
+        Parameters
+        ----------
+        fields : int
+            The number of 32 bits fields of a record (12 for nodes, 3 for tokens).
+
+        Returns
+        -------
+        memoryview
+            The records, as a (count, fields) memoryview of 32 bits integers.
+        """
+        return self._section(self._header.records, self._header.record_count, fields)
+
+    @functools.cached_property
+    def strings(self) -> list[str]:
+        """The strings, decoded."""
+        size = self._header.strings_size
+        if size == 0:
+            return []
+        start = self._header.strings
+        # Every string is NUL terminated, so the last separator is dropped
+        return bytes(self.buffer[start : start + size - 1]).decode(errors="replace").split("\0")
+
+    def __len__(self) -> int:
+        """The number of records."""
+        return int(self._header.record_count)
+
+    @property
+    def nbytes(self) -> int:
+        """The size of the buffer."""
+        return int(self._header.size)
@@ -55,6 +55,8 @@ class Lexer:
             The next token in the command string.
         """
         c_token = lib.lexer_next_token(self._lexer)
+        # Plain words are only views of the input until they are copied
+        lib.lexer_token_value(ffi.addressof(c_token))
         token = create_token(c_token)
         lib.free_lexer_token(ffi.addressof(c_token))
         return token
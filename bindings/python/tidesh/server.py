@@ -0,0 +1,485 @@
+"""
+Persistent server mode for tidesh.
+
+A `Server` starts a worker process which owns a tidesh session and runs the
+commands it is sent over a Unix socket. Running a command then never forks
+the Python process (which may be large), only the small worker, and the
+session keeps its state (working directory, variables, aliases) between
+commands.
+
+Requests are pipelined: `Server.submit` sends a command without waiting for
+the previous ones to finish, and the output of each command is streamed back
+as it is written.
+
+Examples
+--------
+>>> from tidesh import Server
+>>> with Server() as server:
+...     requests = [server.submit(f"echo {i}") for i in range(3)]
+...     [request.stdout for request in requests]
+[b'0\\n', b'1\\n', b'2\\n']
+"""
+
+# pyright: reportUnknownMemberType=false, reportUnknownVariableType=false, reportUnknownArgumentType=false, reportPrivateUsage=false
+from __future__ import annotations
+
+import codecs
+import collections
+import enum
+import itertools
+import pathlib
+import select
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import typing
+
+import typing_extensions
+
+from ._tidesh import lib
+from .exceptions import ServerError
+from .session import Session
+
+if typing.TYPE_CHECKING:
+    import types
+
+_HEADER = struct.Struct("=IBI")
+"""(internal) Header of a frame: request id, frame type and payload length."""
+
+_STATUS = struct.Struct("=i")
+"""(internal) Payload of a status frame."""
+
+_RECEIVE_SIZE = 65536
+"""(internal) Number of bytes read from the worker at once."""
+
+_WORKER = "import sys; sys.path.insert(0, sys.argv.pop(1)); from tidesh.server import main; main()"
+"""(internal) Program run by a worker interpreter, given the package location first."""
+
+
+class OutputStream(enum.IntEnum):
+    """The stream a chunk of output was written to."""
+
+    STDOUT = lib.SERVER_STDOUT
+    """Standard output."""
+
+    STDERR = lib.SERVER_STDERR
+    """Standard error."""
+
+
+class ServerRequest:
+    """
+    A command sent to a server.
+
+    Its output and exit status arrive while the worker runs it, and are
+    received whenever they are waited for.
+
+    Attributes
+    ----------
+    command : str
+        The command.
+    status : int | None
+        The exit status of the command, or None while it runs.
+    """
+
+    def __init__(self, server: Server, command: str) -> None:
+        """
+        Initialize a request (see `Server.submit`).
+
+        Parameters
+        ----------
+        server : Server
+            The server the request was sent to.
+        command : str
+            The command.
+        """
+        super().__init__()
+        self.command = command
+        """The command."""
+        self.status: int | None = None
+        """The exit status of the command, or None while it runs."""
+        self._server = server
+        self._chunks: collections.deque[tuple[OutputStream, bytes]] = collections.deque()
+        self._error: ServerError | None = None
+
+    @property
+    def done(self) -> bool:
+        """Whether the command is done (without waiting for it)."""
+        return self.status is not None or self._error is not None
+
+    def _receive(self) -> None:
+        """(internal) Receive replies until one for this request arrives, or fail."""
+        if self._error is not None:
+            raise self._error
+        self._server._receive()
+
+    def chunks(self) -> typing.Iterator[tuple[OutputStream, bytes]]:
+        """
+        Iterate over the output of the command as it is written.
+
+        Chunks are not kept once they have been yielded.
+
+        Yields
+        ------
+        tuple[OutputStream, bytes]
+            The stream a chunk was written to, and the chunk.
+        """
+        while True:
+            while self._chunks:
+                yield self._chunks.popleft()
+            if self.status is not None:
+                return
+            self._receive()
+
+    def wait(self) -> int:
+        """
+        Wait for the command to finish.
+
+        Returns
+        -------
+        int
+            The exit status of the command.
+
+        Raises
+        ------
+        ServerError
+            If the worker exited before the command finished.
+        """
+        while self.status is None:
+            self._receive()
+        return self.status
+
+    def _output(self, stream: OutputStream) -> bytes:
+        """(internal) Wait for the command and join what it wrote to a stream."""
+        self.wait()
+        return b"".join(data for kind, data in self._chunks if kind is stream)
+
+    @property
+    def stdout(self) -> bytes:
+        """The standard output of the command (waits for it to finish)."""
+        return self._output(OutputStream.STDOUT)
+
+    @property
+    def stderr(self) -> bytes:
+        """The standard error of the command (waits for it to finish)."""
+        return self._output(OutputStream.STDERR)
+
+    def __repr__(self) -> str:
+        """Return a representation of the request."""
+        return f"ServerRequest({self.command!r}, status={self.status!r})"
+
+
+class Server:
+    """
+    A tidesh session owned by a worker process.
+
+    The worker is a fresh Python interpreter running `tidesh.server.main`, with
+    its own session, which forks and executes commands on behalf of this
+    process. It exits once the server is closed, or when a command runs `exit`.
+
+    Attributes
+    ----------
+    pid : int
+        The process id of the worker.
+    """
+
+    def __init__(
+        self,
+        history_path: str | None = None,
+        *,
+        run_hooks: bool = True,
+        cwd: str | None = None,
+        env: typing.Mapping[str, str] | None = None,
+    ) -> None:
+        """
+        Start a server.
+
+        Parameters
+        ----------
+        history_path : str | None, optional
+            The path to the history file of the session. If None, history will not be saved to disk.
+        run_hooks : bool, default=True
+            Whether to enable hook execution for the session.
+        cwd : str | None, optional
+            The initial working directory of the session, the current one by default.
+        env : Mapping[str, str] | None, optional
+            The initial environment of the session, `os.environ` by default.
+
+        Raises
+        ------
+        ServerError
+            If the worker could not be started.
+        """
+        super().__init__()
+        self._socket: socket.socket | None = None
+        self._buffer = bytearray()
+        self._pending: dict[int, ServerRequest] = {}
+        self._ids = itertools.count(1)
+
+        # The worker imports this very package, wherever it is
+        connection, worker_end = socket.socketpair(socket.AF_UNIX, socket.SOCK_STREAM)
+        arguments = [
+            sys.executable,
+            "-c",
+            _WORKER,
+            str(pathlib.Path(__file__).resolve().parent.parent),
+            str(worker_end.fileno()),
+        ]
+        if history_path:
+            arguments += ["--history", history_path]
+        if not run_hooks:
+            arguments.append("--no-hooks")
+
+        try:
+            self._process = subprocess.Popen(  # noqa: S603
+                arguments,
+                pass_fds=(worker_end.fileno(),),
+                stdin=subprocess.DEVNULL,
+                cwd=cwd,
+                env=env,
+                start_new_session=True,
+            )
+        except OSError as e:
+            connection.close()
+            msg = "Failed to start the server worker"
+            raise ServerError(msg, cause=e) from e
+        finally:
+            worker_end.close()
+
+        connection.setblocking(False)
+        self._socket = connection
+
+    @property
+    def pid(self) -> int:
+        """The process id of the worker."""
+        return self._process.pid
+
+    def submit(self, command: str) -> ServerRequest:
+        """
+        Send a command to the worker without waiting for it to run.
+
+        Parameters
+        ----------
+        command : str
+            The command to execute.
+
+        Returns
+        -------
+        ServerRequest
+            The request, to wait for or stream the output of.
+
+        Raises
+        ------
+        ServerError
+            If the worker is gone.
+        """
+        request_id = next(self._ids) & 0xFFFFFFFF
+        payload = command.encode()
+        request = ServerRequest(self, command)
+        self._pending[request_id] = request
+        self._send(_HEADER.pack(request_id, lib.SERVER_EXECUTE, len(payload)) + payload)
+        return request
+
+    def stream(self, command: str) -> typing.Iterator[tuple[OutputStream, bytes]]:
+        """
+        Execute a command and iterate over its output as it is written.
+
+        Parameters
+        ----------
+        command : str
+            The command to execute.
+
+        Yields
+        ------
+        tuple[OutputStream, bytes]
+            The stream a chunk was written to, and the chunk.
+        """
+        yield from self.submit(command).chunks()
+
+    def execute(self, command: str) -> int:
+        """
+        Execute a command, writing its output to `sys.stdout` and `sys.stderr`.
+
+        Parameters
+        ----------
+        command : str
+            The command to execute.
+
+        Returns
+        -------
+        int
+            The exit status of the command.
+        """
+        request = self.submit(command)
+        decoders = {
+            OutputStream.STDOUT: (codecs.getincrementaldecoder("utf-8")("replace"), sys.stdout),
+            OutputStream.STDERR: (codecs.getincrementaldecoder("utf-8")("replace"), sys.stderr),
+        }
+        for stream, data in request.chunks():
+            decoder, output = decoders[stream]
+            output.write(decoder.decode(data))
+        for decoder, output in decoders.values():
+            output.write(decoder.decode(b"", final=True))
+            output.flush()
+        return request.wait()
+
+    def capture(self, command: str) -> str:
+        """
+        Execute a command and capture its standard output.
+
+        Its standard error is written to `sys.stderr`.
+
+        Parameters
+        ----------
+        command : str
+            The command to execute.
+
+        Returns
+        -------
+        str
+            The captured output.
+        """
+        request = self.submit(command)
+        request.wait()
+        error = request.stderr
+        if error:
+            sys.stderr.write(error.decode(errors="replace"))
+        return request.stdout.decode(errors="replace")
+
+    def _send(self, data: bytes) -> None:
+        """(internal) Send bytes to the worker, receiving its replies meanwhile so neither side blocks."""
+        view = memoryview(data)
+        while view:
+            if self._socket is None:
+                msg = "The server worker is not running"
+                raise ServerError(msg)
+            readable, writable, _ = select.select([self._socket], [self._socket], [])
+            if readable:
+                self._fill()
+            if writable and self._socket is not None:
+                try:
+                    sent = self._socket.send(view)
+                except BlockingIOError:
+                    continue
+                except OSError as e:
+                    self._disconnect(exited=True)
+                    msg = "The server worker exited"
+                    raise ServerError(msg, cause=e) from e
+                view = view[sent:]
+
+    def _fill(self) -> None:
+        """(internal) Buffer what the worker sent."""
+        if self._socket is None:
+            return
+        try:
+            data = self._socket.recv(_RECEIVE_SIZE)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b""
+        if data:
+            self._buffer += data
+        else:
+            self._disconnect(exited=True)
+
+    def _frame_size(self) -> int | None:
+        """(internal) The size of the first buffered frame, or None if it is not complete yet."""
+        if len(self._buffer) < _HEADER.size:
+            return None
+        _, _, length = _HEADER.unpack_from(self._buffer)
+        size = _HEADER.size + length
+        return size if len(self._buffer) >= size else None
+
+    def _receive(self) -> None:
+        """(internal) Receive a frame and hand it to its request."""
+        size = self._frame_size()
+        while size is None:
+            if self._socket is None:
+                return  # Pending requests were settled on disconnection
+            select.select([self._socket], [], [])
+            self._fill()
+            size = self._frame_size()
+
+        request_id, kind, _ = _HEADER.unpack_from(self._buffer)
+        payload = bytes(self._buffer[_HEADER.size : size])
+        del self._buffer[:size]
+        request = self._pending.get(request_id)
+        if request is None:
+            return
+        if kind == lib.SERVER_STATUS:
+            (request.status,) = _STATUS.unpack(payload)
+            del self._pending[request_id]
+        else:
+            request._chunks.append((OutputStream(kind), payload))
+
+    def _disconnect(self, *, exited: bool) -> None:
+        """(internal) Close the connection and settle the pending requests."""
+        if self._socket is not None:
+            self._socket.close()
+            self._socket = None
+        returncode = self._process.wait()
+
+        # Frames already received still belong to their requests
+        while self._pending and self._frame_size() is not None:
+            self._receive()
+
+        # A worker exits on its own when a command runs `exit`, the first pending one
+        pending = [self._pending.pop(request_id) for request_id in sorted(self._pending)]
+        for index, request in enumerate(pending):
+            if index == 0 and exited and returncode >= 0:
+                request.status = returncode
+            else:
+                msg = "The server worker exited before running the command"
+                request._error = ServerError(msg)
+
+    def close(self) -> None:
+        """
+        Stop the worker.
+
+        It finishes the command it is running first. Pending requests fail.
+        """
+        if getattr(self, "_socket", None) is not None:
+            self._disconnect(exited=False)
+
+    def __del__(self) -> None:
+        """Stop the worker when the server is garbage collected."""
+        self.close()
+
+    def __enter__(self) -> typing_extensions.Self:
+        """Enter the context manager."""
+        return self
+
+    def __exit__(
+        self,
+        exc_type: type[BaseException] | None,
+        exc_val: BaseException | None,
+        exc_tb: types.TracebackType | None,
+    ) -> None:
+        """Exit the context manager and stop the worker."""
+        self.close()
+
+
+def main(arguments: list[str] | None = None) -> None:
+    """
+    Run a server worker (started by `Server`).
+
+    Parameters
+    ----------
+    arguments : list[str] | None, optional
+        The connection descriptor, then `--history PATH` and `--no-hooks`
+        options. Defaults to `sys.argv[1:]`.
+    """
+    arguments = sys.argv[1:] if arguments is None else arguments
+    fd = int(arguments[0])
+    history_path = None
+    if "--history" in arguments:
+        history_path = arguments[arguments.index("--history") + 1]
+
+    # Commands get the signal dispositions of a shell, not those of Python
+    signal.signal(signal.SIGPIPE, signal.SIG_DFL)
+    signal.signal(signal.SIGINT, signal.SIG_IGN)
+
+    with Session(history_path, run_hooks="--no-hooks" not in arguments) as session:
+        result = lib.serve(session._session, fd)
+    sys.exit(0 if result == 0 else 1)
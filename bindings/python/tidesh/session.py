@@ -9,10 +9,12 @@ import typing
 import typing_extensions
 
 from ._tidesh import ffi, lib
-from .ast import ASTNode
+from .ast import ASTNode, FlatAST
 from .exceptions import CommandNotFoundError, ParseError, SessionError
+from .flat import FlatBuffer, pack_inputs
 from .lexer import Lexer
 from .state import Aliases, DirectoryStack, Environ, Features, History, Jobs, Terminal
+from .tokens import create_token_from_values
 
 if typing.TYPE_CHECKING:
     import types
@@ -60,6 +62,12 @@ class Session:
     aliases, directory stack, and terminal properties. It can execute commands,
     capture output, and perform shell expansions.
 
+    The GIL is released while the C code runs, and parsing, tokenizing,
+    expanding and looking up commands only use the state of the session, so
+    threads can each drive their own session in parallel. A session itself
+    must not be used by several threads at once, and executing commands
+    changes process wide state (working directory, file descriptors).
+
     Attributes
     ----------
     history : History
@@ -153,12 +161,59 @@ class Session:
         ASTNode
             The root node of the parsed abstract syntax tree.
         """
-        ast_ptr = lib.parse_command(command.encode(), self._session)
+        lexer = Lexer(command, self)
+        ast_ptr = lib.parse(lexer._lexer, self._session)
         if ast_ptr == ffi.NULL:
             msg = "Failed to parse command"
             raise ParseError(msg, command=command)
         return ASTNode(ast_ptr)
 
+    def parse_many(self, commands: typing.Iterable[str]) -> FlatAST:
+        """
+        Parse many command strings at once, into a single flat buffer.
+
+        Parameters
+        ----------
+        commands : Iterable[str]
+            The command strings to parse.
+
+        Returns
+        -------
+        FlatAST
+            The flattened trees, whose `roots` are the root node of each
+            command (None for the ones which failed to parse).
+        """
+        packed, count = pack_inputs(commands)
+        return FlatAST(lib.parse_many(packed, count, self._session))
+
+    def tokenize_many(self, commands: typing.Iterable[str]) -> list[list[Token]]:
+        """
+        Tokenize many command strings at once.
+
+        Parameters
+        ----------
+        commands : Iterable[str]
+            The command strings to tokenize.
+
+        Returns
+        -------
+        list[list[Token]]
+            The tokens of each command, including its EOF token.
+        """
+        packed, count = pack_inputs(commands)
+        flat = FlatBuffer(lib.tokenize_many(packed, count, self._session))
+        strings = flat.strings
+        tokens = [
+            create_token_from_values(
+                token_type,
+                None if value < 0 else strings[value],
+                None if extra < 0 else strings[extra],
+            )
+            for token_type, value, extra in flat.records(3).tolist()
+        ]
+        bounds = [*flat.inputs.tolist(), len(tokens)]
+        return [tokens[bounds[i] : bounds[i + 1]] for i in range(count)]
+
     def execute(self, command: str | ASTNode) -> int:
         """
         Execute a shell command.
@@ -421,6 +476,26 @@ class Session:
             lib.free_array(arr_ptr)
             lib.free(arr_ptr)
 
+    def expand_many(self, texts: typing.Iterable[str]) -> list[list[str]]:
+        """
+        Perform full shell expansion on many texts at once.
+
+        Parameters
+        ----------
+        texts : Iterable[str]
+            The texts to expand.
+
+        Returns
+        -------
+        list[list[str]]
+            The expanded strings of each text.
+        """
+        packed, count = pack_inputs(texts)
+        flat = FlatBuffer(lib.expand_many(packed, count, self._session))
+        strings = flat.strings
+        bounds = [*flat.inputs.tolist(), len(strings)]
+        return [strings[bounds[i] : bounds[i + 1]] for i in range(count)]
+
     def find_in_path(self, command: str) -> str | None:
         """
         Find a command in the PATH.
@@ -21,11 +21,13 @@
 #include "execute.h"
 #include "expand.h"
 #include "feature-flags.h"
+#include "flat.h"
 #include "history.h"
 #include "hooks.h"
 #include "jobs.h"
 #include "lexer.h"
 #include "prompt/terminal.h"
+#include "server.h"
 #include "session.h"
 
 const char *tidesh_compiler = __VERSION__;
@@ -35,6 +35,11 @@ class TokenType(IntEnum):
     SEMICOLON = lib.TOKEN_SEMICOLON
     LPAREN = lib.TOKEN_LPAREN
     RPAREN = lib.TOKEN_RPAREN
+    IF = lib.TOKEN_IF
+    THEN = lib.TOKEN_THEN
+    ELSE = lib.TOKEN_ELSE
+    ELIF = lib.TOKEN_ELIF
+    FI = lib.TOKEN_FI
     EOL = lib.TOKEN_EOL
     EOF = lib.TOKEN_EOF
 
@@ -298,3 +303,32 @@ def create_token(c_token: typing.Any) -> Token:
     token_type = TokenType(c_token.type)
     token_class = _TOKEN_CLASS_MAP.get(token_type, Token)
     return token_class(c_token)
+
+
+def create_token_from_values(token_type: int, value: str | None, extra: str | None) -> Token:
+    """
+    Create a token instance of the appropriate class from already decoded values.
+
+    Parameters
+    ----------
+    token_type : int
+        The type of the token.
+    value : str | None
+        The value of the token, if any.
+    extra : str | None
+        The extra data of the token, if any.
+
+    Returns
+    -------
+    Token
+        A token instance of the appropriate type.
+    """
+    kind = TokenType(token_type)
+    token_class = _TOKEN_CLASS_MAP.get(kind, Token)
+    token = token_class.__new__(token_class)
+    token.type = kind
+    if isinstance(token, ValuedToken):
+        token._value = value or ""  # noqa: SLF001
+    if isinstance(token, ExtraValuedToken):
+        token._extra = extra or ""  # noqa: SLF001
+    return token
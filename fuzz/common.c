@@ -0,0 +1,57 @@
+#include <stdarg.h> /* va_list, va_start, va_end */
+#include <stdio.h>  /* fprintf, vfprintf, stderr */
+#include <stdlib.h> /* abort, atexit, free, malloc */
+#include <string.h> /* memchr, memcpy */
+
+#include "fuzz.h"
+
+static Session *shared_session = NULL;
+
+void fuzz_fail(const char *file, int line, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s:%d: check failed: ", file, line);
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    abort();
+}
+
+char *fuzz_string(const uint8_t *data, size_t size) {
+    if (size > FUZZ_MAX_INPUT) {
+        size = FUZZ_MAX_INPUT;
+    }
+    const uint8_t *nul = memchr(data, '\0', size);
+    if (nul) {
+        size = (size_t)(nul - data);
+    }
+
+    char *string = malloc(size + 1);
+    if (!string) {
+        abort();
+    }
+    if (size > 0) {
+        memcpy(string, data, size);
+    }
+    string[size] = '\0';
+    return string;
+}
+
+/* Free the shared session, so that leak checks only report real leaks */
+static void free_shared_session(void) {
+    free_session(shared_session);
+    free(shared_session);
+    shared_session = NULL;
+}
+
+Session *fuzz_session(void) {
+    if (!shared_session) {
+        shared_session = init_session(NULL, NULL);
+        if (!shared_session) {
+            abort();
+        }
+        shared_session->hooks_disabled = true;
+        atexit(free_shared_session);
+    }
+    return shared_session;
+}
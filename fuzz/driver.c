@@ -0,0 +1,277 @@
+/* Standalone fuzzing driver
+ *
+ * Runs a harness without libFuzzer (with gcc, or where libFuzzer is missing):
+ * every file given (or found in a given directory) is run once, then random
+ * mutations of them are run until a number of runs or a time limit is
+ * reached. The mutations are blind, without coverage feedback, so this finds
+ * less than libFuzzer does, but it replays corpora and crash files the same
+ * way, and its options are a subset of the libFuzzer ones:
+ *
+ * Usage: fuzz_<harness> [-runs=N] [-max_total_time=S] [-seed=N]
+ *                        [-artifact_prefix=P] [paths...]
+ *
+ * Without -runs nor -max_total_time, the files are only replayed. -runs=-1
+ * mutates until the time is up, or forever.
+ *
+ * Other -options are ignored. The input of a failed run is written to
+ * <P>crash-<run> (in the current directory by default).
+ */
+
+#include <dirent.h>   /* DIR, opendir, readdir, closedir */
+#include <fcntl.h>    /* open, O_WRONLY, O_CREAT, O_TRUNC */
+#include <signal.h>   /* signal, raise, SIGABRT, SIGSEGV, SIG_DFL */
+#include <stdbool.h>  /* bool, true, false */
+#include <stdio.h>    /* fprintf, snprintf, stderr, FILE, fopen, fread */
+#include <stdlib.h>   /* malloc, realloc, free, strtoul, strtol */
+#include <string.h>   /* memcpy, memmove, strlen, strncmp, strcmp */
+#include <sys/stat.h> /* stat, S_ISDIR */
+#include <time.h>     /* time */
+#include <unistd.h>   /* write, close */
+
+#include "fuzz.h"
+
+/* Maximum size of a mutated input */
+#define DRIVER_MAX_SIZE FUZZ_MAX_INPUT
+
+/* Pieces of shell syntax inserted by the mutations */
+static const char *dictionary[] = {
+    // Braces
+    "{", "}", ",", "..", "1..10", "a..z",
+    // Variables
+    "$", "${", "${#", ":-", ":=", ":+", ":?", "$=", "~",
+    // Operators
+    "|", "||", "&&", "&", ";", "(", ")", "<", ">", ">>", "2>&1", "<<", "<(",
+    ">(", "$(", "`",
+    // Quotes and others
+    "'", "\"", "\\", "#", "=", "*", "?", " ", "\t", "\n",
+    // Keywords
+    "if ", " then ", " elif ", " else ", " fi",
+};
+
+/* An input of the corpus */
+typedef struct Input {
+    uint8_t *data;
+    size_t   size;
+} Input;
+
+static Input             *corpus          = NULL;
+static size_t             corpus_count    = 0;
+static uint8_t            current[DRIVER_MAX_SIZE]; // Input being run
+static size_t             current_size    = 0;
+static size_t             run_count       = 0;
+static const char        *artifact_prefix = "";
+static unsigned long long random_state    = 0x9e3779b97f4a7c15ULL;
+
+/* Make sanitizer errors abort, so that the failed input is saved */
+const char *__asan_default_options(void) { return "abort_on_error=1"; }
+const char *__ubsan_default_options(void) {
+    return "abort_on_error=1:halt_on_error=1:print_stacktrace=1";
+}
+
+/* Save the input being run when a run fails */
+static void save_crash(int sig) {
+    char name[4096];
+    int  length = snprintf(name, sizeof(name), "%scrash-%zu", artifact_prefix,
+                           run_count);
+    int  fd     = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        (void)!write(fd, current, current_size);
+        close(fd);
+        (void)!write(STDERR_FILENO, "Input written to ", 17);
+        (void)!write(STDERR_FILENO, name, (size_t)length);
+        (void)!write(STDERR_FILENO, "\n", 1);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* Next pseudo random number (xorshift64*) */
+static unsigned long long next_random(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ULL;
+}
+
+static size_t random_below(size_t bound) {
+    return bound ? (size_t)(next_random() % bound) : 0;
+}
+
+/* Add a file to the corpus */
+static void add_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return;
+    }
+    uint8_t buffer[DRIVER_MAX_SIZE];
+    size_t  size  = fread(buffer, 1, sizeof(buffer), file);
+    Input  *grown = realloc(corpus, (corpus_count + 1) * sizeof(Input));
+    uint8_t *data = malloc(size ? size : 1);
+    fclose(file);
+    if (!grown || !data) {
+        free(data);
+        return;
+    }
+    memcpy(data, buffer, size);
+    corpus                 = grown;
+    corpus[corpus_count++] = (Input){data, size};
+}
+
+/* Add a file or the files of a directory to the corpus */
+static void add_path(const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        add_file(path);
+        return;
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char child[4096];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (stat(child, &info) == 0 && !S_ISDIR(info.st_mode)) {
+            add_file(child);
+        }
+    }
+    closedir(dir);
+}
+
+/* Insert bytes into the current input */
+static void insert(size_t position, const void *bytes, size_t size) {
+    if (current_size + size > DRIVER_MAX_SIZE) {
+        return;
+    }
+    memmove(current + position + size, current + position,
+            current_size - position);
+    memcpy(current + position, bytes, size);
+    current_size += size;
+}
+
+/* Mutate the current input a few times */
+static void mutate(void) {
+    size_t count = 1 + random_below(4);
+    for (size_t i = 0; i < count; i++) {
+        size_t position = random_below(current_size + 1);
+        switch (random_below(6)) {
+            case 0: // Flip a bit
+                if (current_size > 0) {
+                    current[random_below(current_size)] ^=
+                        (uint8_t)(1u << random_below(8));
+                }
+                break;
+            case 1: { // Insert a byte
+                uint8_t byte = (uint8_t)next_random();
+                insert(position, &byte, 1);
+                break;
+            }
+            case 2: // Remove some bytes
+                if (position < current_size) {
+                    size_t size = 1 + random_below(current_size - position);
+                    memmove(current + position, current + position + size,
+                            current_size - position - size);
+                    current_size -= size;
+                }
+                break;
+            case 3: { // Insert a piece of syntax
+                const char *word =
+                    dictionary[random_below(sizeof(dictionary) /
+                                            sizeof(*dictionary))];
+                insert(position, word, strlen(word));
+                break;
+            }
+            case 4: // Duplicate a part of the input
+                if (current_size > 0) {
+                    size_t  start = random_below(current_size);
+                    size_t  size  = 1 + random_below(current_size - start);
+                    uint8_t copy[DRIVER_MAX_SIZE];
+                    memcpy(copy, current + start, size);
+                    insert(position, copy, size);
+                }
+                break;
+            default: // Insert a part of another input
+                if (corpus_count > 0) {
+                    Input *other = &corpus[random_below(corpus_count)];
+                    if (other->size > 0) {
+                        size_t start = random_below(other->size);
+                        size_t size  = 1 + random_below(other->size - start);
+                        insert(position, other->data + start, size);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+/* Run the harness on the current input */
+static void run_current(void) {
+    run_count++;
+    LLVMFuzzerTestOneInput(current, current_size);
+}
+
+int main(int argc, char **argv) {
+    long          runs       = 0; // Mutated runs (-1: no limit)
+    long          max_time   = 0; // Seconds of mutated runs (0: no limit)
+    unsigned long seed       = (unsigned long)time(NULL);
+    bool          seed_given = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = strtol(argv[i] + 6, NULL, 10);
+        } else if (strncmp(argv[i], "-max_total_time=", 16) == 0) {
+            max_time = strtol(argv[i] + 16, NULL, 10);
+        } else if (strncmp(argv[i], "-seed=", 6) == 0) {
+            seed       = strtoul(argv[i] + 6, NULL, 10);
+            seed_given = true;
+        } else if (strncmp(argv[i], "-artifact_prefix=", 17) == 0) {
+            artifact_prefix = argv[i] + 17;
+        } else if (argv[i][0] != '-') {
+            add_path(argv[i]);
+        }
+    }
+    random_state ^= seed;
+    signal(SIGABRT, save_crash);
+    signal(SIGSEGV, save_crash);
+
+    // Replay the corpus
+    for (size_t i = 0; i < corpus_count; i++) {
+        current_size = corpus[i].size;
+        memcpy(current, corpus[i].data, current_size);
+        run_current();
+    }
+    fprintf(stderr, "Replayed %zu inputs\n", corpus_count);
+
+    // Then mutate it
+    if (runs == 0 && max_time > 0) {
+        runs = -1; // No limit but the time
+    }
+    if (runs != 0) {
+        time_t end = max_time > 0 ? time(NULL) + max_time : 0;
+        for (long i = 0; runs < 0 || i < runs; i++) {
+            if (end && time(NULL) >= end) {
+                break;
+            }
+            Input *base  = corpus_count ? &corpus[random_below(corpus_count)]
+                                        : NULL;
+            current_size = base ? base->size : 0;
+            if (base) {
+                memcpy(current, base->data, current_size);
+            }
+            mutate();
+            run_current();
+        }
+        fprintf(stderr, "Done %zu runs (seed %lu%s)\n", run_count, seed,
+                seed_given ? "" : ", from the time");
+    }
+
+    for (size_t i = 0; i < corpus_count; i++) {
+        free(corpus[i].data);
+    }
+    free(corpus);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Extract the seed corpus of the fuzzing harnesses from the tests
+
+Every string literal of the given test files, but the included headers and
+the descriptions of `describe` and `it`, becomes an input of the harnesses
+it concerns, in <output>/<harness>/<hash>.
+
+Usage: extract_corpus.py <output> <test files...>
+"""
+
+import hashlib
+import pathlib
+import re
+import sys
+
+# A C string literal
+LITERAL = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+
+# Lines whose literals are not shell inputs
+SKIPPED = re.compile(r"^\s*(#\s*include|describe\(|it\()")
+
+# Simple escapes of C strings
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\",
+           '"': '"', "'": "'", "?": "?", "a": "\a", "b": "\b", "e": "\x1b"}
+
+# Which inputs each harness gets
+HARNESSES = {
+    "lexer": lambda text: True,
+    "parser": lambda text: True,
+    "braces": lambda text: "{" in text,
+    "variables": lambda text: "$" in text,
+}
+
+
+def unescape(literal: str) -> str:
+    """Decode the escapes of a C string literal"""
+    def replace(match: re.Match) -> str:
+        escape = match.group(1)
+        if escape[0] == "x":
+            return chr(int(escape[1:], 16))
+        if escape[0] in "01234567" and len(escape) > 1:
+            return chr(int(escape, 8))
+        return ESCAPES.get(escape, escape)
+    return re.sub(r"\\(x[0-9a-fA-F]+|[0-7]{1,3}|.)", replace, literal)
+
+
+def extract(paths: list) -> set:
+    """The string literals of the test files"""
+    inputs = set()
+    for path in paths:
+        for line in pathlib.Path(path).read_text(errors="replace").splitlines():
+            if SKIPPED.match(line):
+                continue
+            for literal in LITERAL.findall(line):
+                text = unescape(literal)
+                # The harnesses stop at the first NUL byte
+                if text and "\0" not in text:
+                    inputs.add(text)
+    return inputs
+
+
+def main() -> int:
+    if len(sys.argv) < 3:
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+
+    output = pathlib.Path(sys.argv[1])
+    inputs = extract(sys.argv[2:])
+    for harness, wanted in HARNESSES.items():
+        directory = output / harness
+        directory.mkdir(parents=True, exist_ok=True)
+        count = 0
+        for text in sorted(inputs):
+            if not wanted(text):
+                continue
+            data = text.encode()
+            name = hashlib.sha1(data).hexdigest()[:16]
+            (directory / name).write_bytes(data)
+            count += 1
+        print(f"{harness}: {count} inputs in {directory}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,72 @@
+/** fuzz.h
+ *
+ * Helpers shared by the fuzzing harnesses.
+ *
+ * Every harness defines LLVMFuzzerTestOneInput, the entry point of libFuzzer,
+ * and checks properties of the code it exercises: besides not crashing (the
+ * sanitizers take care of memory errors), the optimized paths must agree with
+ * the reference ones (SIMD scans with byte loops, token views with copies,
+ * flat buffers with pointer trees, generated brace words with a naive
+ * expansion...). A failed check aborts with a description of the mismatch, so
+ * the fuzzer saves the input that triggered it.
+ *
+ * Harnesses are built with libFuzzer (clang), or with the standalone driver in
+ * driver.c, which replays a corpus and mutates it with any compiler.
+ */
+
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t */
+
+#include "session.h" /* Session */
+
+/* Largest input the harnesses look at, bigger ones are truncated */
+#define FUZZ_MAX_INPUT 4096
+
+/**
+ * Check a property, aborting with a message if it does not hold
+ *
+ * @param condition The property
+ * @param format printf-like description of the failure, then its arguments
+ */
+#define fuzz_check(condition, ...)                                             \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            fuzz_fail(__FILE__, __LINE__, __VA_ARGS__);                        \
+        }                                                                      \
+    } while (0)
+
+/**
+ * Report a failed check and abort
+ *
+ * @param file The file of the check
+ * @param line The line of the check
+ * @param format printf-like description of the failure, then its arguments
+ */
+void fuzz_fail(const char *file, int line, const char *format, ...)
+    __attribute__((noreturn, format(printf, 3, 4)));
+
+/**
+ * Copy an input into a NUL terminated string, stopping at its first NUL
+ * byte and at FUZZ_MAX_INPUT bytes
+ *
+ * @param data The input
+ * @param size The size of the input
+ * @return The string (to free)
+ */
+char *fuzz_string(const uint8_t *data, size_t size);
+
+/**
+ * Get the session shared by the inputs of a harness, created on first use
+ * with hooks disabled. Harnesses must not change it.
+ *
+ * @return The session
+ */
+Session *fuzz_session(void);
+
+/* The entry point of the harnesses */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#endif /* FUZZ_H */
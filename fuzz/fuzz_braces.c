@@ -0,0 +1,217 @@
+/* Brace expansion fuzzing harness
+ *
+ * Checks that the words of the brace generator (parsed once into a template,
+ * each word built from its index) are the ones of a naive expansion, which
+ * expands the first brace pair and recurses on what follows it, and that
+ * brace_expansion returns them too.
+ */
+
+#include <ctype.h>   /* isalpha, isspace */
+#include <stdbool.h> /* bool, true, false */
+#include <stdint.h>  /* SIZE_MAX */
+#include <stdio.h>   /* snprintf */
+#include <stdlib.h>  /* malloc, realloc, free, strtol */
+#include <string.h>  /* memcpy, strcmp, strlen, strndup */
+
+#include "data/array.h"        /* Array, free_array */
+#include "expansions/braces.h" /* BraceGenerator, init_brace_generator, brace_generator_next, brace_expansion */
+#include "fuzz.h"
+
+/* Most words compared for an input, bigger expansions are only counted */
+#define FUZZ_MAX_WORDS 4096
+
+/* Words of the naive expansion */
+typedef struct Words {
+    char **items;
+    size_t count;
+    bool   overflow; // Whether there were more than FUZZ_MAX_WORDS
+} Words;
+
+/* Add a word made of three parts */
+static void add_word(Words *words, const char *a, size_t a_length,
+                     const char *b, const char *c) {
+    if (words->count >= FUZZ_MAX_WORDS) {
+        words->overflow = true;
+        return;
+    }
+    size_t b_length = strlen(b);
+    size_t c_length = strlen(c);
+    char  *word     = malloc(a_length + b_length + c_length + 1);
+    char **items = realloc(words->items, (words->count + 1) * sizeof(char *));
+    fuzz_check(word && items, "out of memory");
+    memcpy(word, a, a_length);
+    memcpy(word + a_length, b, b_length);
+    memcpy(word + a_length + b_length, c, c_length + 1);
+    words->items                 = items;
+    words->items[words->count++] = word;
+}
+
+static void free_words(Words *words) {
+    for (size_t i = 0; i < words->count; i++) {
+        free(words->items[i]);
+    }
+    free(words->items);
+}
+
+/* Expand the range between `start` and `end` ("x..y") into words */
+static void expand_range(const char *str, int start, int end, Words *words) {
+    const char *dots = strstr(str + start, "..");
+    if (!dots || dots + 2 > str + end) {
+        return;
+    }
+
+    char *first_copy = strndup(str + start, dots - (str + start));
+    char *last_copy  = strndup(dots + 2, str + end - (dots + 2));
+    fuzz_check(first_copy && last_copy, "out of memory");
+    char *first = first_copy;
+    char *last  = last_copy;
+    while (*first && isspace(*first))
+        first++;
+    while (*last && isspace(*last))
+        last++;
+
+    char *first_end, *last_end;
+    long  from = strtol(first, &first_end, 10);
+    long  to   = strtol(last, &last_end, 10);
+    if (!*first_end && !*last_end) {
+        int width = (int)(strlen(first) > strlen(last) ? strlen(first)
+                                                       : strlen(last));
+        for (long value = from; !words->overflow; value += from <= to ? 1 : -1) {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%0*ld", width, value);
+            add_word(words, buffer, strlen(buffer), "", "");
+            if (value == to)
+                break;
+        }
+    } else if (strlen(first) == 1 && strlen(last) == 1 && isalpha(*first) &&
+               isalpha(*last)) {
+        for (char c = *first;; c += *first <= *last ? 1 : -1) {
+            char buffer[2] = {c, '\0'};
+            add_word(words, buffer, 1, "", "");
+            if (c == *last)
+                break;
+        }
+    }
+    free(first_copy);
+    free(last_copy);
+}
+
+static void expand(const char *str, int start, int end, Words *words);
+
+/* Expand the alternatives between `start` and `end` ("a,b,c") into words */
+static void expand_list(const char *str, int start, int end, Words *words) {
+    int depth = 0, part = start;
+    for (int i = start; i <= end && !words->overflow; i++) {
+        if (i < end && str[i] == '{') {
+            depth++;
+        } else if (i < end && str[i] == '}') {
+            depth--;
+        } else if (i == end || (str[i] == ',' && depth == 0)) {
+            expand(str, part, i, words);
+            part = i + 1;
+        }
+    }
+}
+
+/* Expand the text between `start` and `end` into words */
+static void expand(const char *str, int start, int end, Words *words) {
+    // Find the first brace pair which is a list or a range
+    int open = start, close = -1;
+    bool list = false, range = false;
+    for (; open < end; open++) {
+        if (str[open] != '{')
+            continue;
+        int depth = 0;
+        close     = -1;
+        for (int i = open; i < end && close < 0; i++) {
+            depth += str[i] == '{' ? 1 : str[i] == '}' ? -1 : 0;
+            if (depth == 0)
+                close = i;
+        }
+        if (close < 0)
+            break; // Nothing after an unclosed brace is expanded
+
+        depth = 0;
+        for (int i = open + 1; i < close && !list; i++) {
+            depth += str[i] == '{' ? 1 : str[i] == '}' ? -1 : 0;
+            list = str[i] == ',' && depth == 0;
+        }
+        for (int i = open + 1; !list && close - open - 1 >= 4 && i < close - 1;
+             i++) {
+            range = range || (str[i] == '.' && str[i + 1] == '.');
+        }
+        if (list || range)
+            break;
+        open = close;
+    }
+
+    if (!list && !range) {
+        add_word(words, str + start, end - start, "", "");
+        return;
+    }
+
+    // Every alternative, followed by every expansion of the rest
+    Words alternatives = {0}, rest = {0};
+    if (list) {
+        expand_list(str, open + 1, close, &alternatives);
+    } else {
+        expand_range(str, open + 1, close, &alternatives);
+    }
+    expand(str, close + 1, end, &rest);
+    for (size_t a = 0; a < alternatives.count; a++) {
+        for (size_t r = 0; r < rest.count; r++) {
+            add_word(words, str + start, open - start, alternatives.items[a],
+                     rest.items[r]);
+        }
+    }
+    // Nothing times too many words is still nothing
+    words->overflow |= (alternatives.overflow && rest.count > 0) ||
+                       (rest.overflow && alternatives.count > 0);
+    free_words(&alternatives);
+    free_words(&rest);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *input = fuzz_string(data, size);
+
+    BraceGenerator generator;
+    fuzz_check(init_brace_generator(&generator, input) != NULL,
+               "init_brace_generator failed");
+
+    if (generator.count > BRACE_EXPANSION_LIMIT) {
+        // Refused before anything is built
+        fuzz_check(brace_expansion(input, NULL) == NULL,
+                   "%zu words were not refused", generator.count);
+    } else if (generator.count <= FUZZ_MAX_WORDS) {
+        Words expected = {0};
+        expand(input, 0, strlen(input), &expected);
+        fuzz_check(!expected.overflow && generator.count == expected.count,
+                   "%zu generated words, not %zu", generator.count,
+                   expected.count);
+
+        for (size_t i = 0; i < expected.count; i++) {
+            char *word = brace_generator_next(&generator);
+            fuzz_check(word && strcmp(word, expected.items[i]) == 0,
+                       "word %zu is \"%s\", not \"%s\"", i,
+                       word ? word : "(none)", expected.items[i]);
+            free(word);
+        }
+        fuzz_check(brace_generator_next(&generator) == NULL,
+                   "more words than counted");
+
+        Array *words = brace_expansion(input, NULL);
+        fuzz_check(words && words->count == expected.count,
+                   "brace_expansion returned a different number of words");
+        for (size_t i = 0; i < expected.count; i++) {
+            fuzz_check(strcmp(words->items[i], expected.items[i]) == 0,
+                       "brace_expansion word %zu differs", i);
+        }
+        free_array(words);
+        free(words);
+        free_words(&expected);
+    }
+
+    free_brace_generator(&generator);
+    free(input);
+    return 0;
+}
@@ -0,0 +1,217 @@
+/* Lexer fuzzing harness
+ *
+ * Checks that:
+ *  - scan_until and scan_ascii (SIMD) agree with byte loops, at every
+ *    alignment of the input;
+ *  - the lexer produces the same tokens after leading blanks, which move the
+ *    words of the input across the boundaries of the vector loads;
+ *  - words returned as views of the input hold the same text as their copies;
+ *  - tokenize_many (flat buffers) produces the same tokens as the lexer.
+ */
+
+#include <stdbool.h> /* bool, true, false */
+#include <stdlib.h>  /* malloc, free */
+#include <string.h>  /* memchr, memcmp, memcpy, memset, strcmp, strdup, strlen */
+
+#include "data/scan.h" /* ScanSet, SCANSET, scan_until, scan_ascii */
+#include "flat.h"      /* FlatBuffer, FlatToken, tokenize_many */
+#include "fuzz.h"
+#include "lexer.h" /* LexerInput, LexerToken, init_lexer_input, lexer_next_token, lexer_token_copy, free_lexer_token */
+
+/* Numbers of blanks put before the input, to change its alignment */
+static const size_t shifts[] = {1, 7, 13, 31};
+
+/* A token, with its strings copied */
+typedef struct FuzzToken {
+    int   type;  // TokenType
+    char *value; // Value (copy), or NULL
+    char *extra; // Extra value (copy), or NULL
+} FuzzToken;
+
+/* The sets of bytes the lexer scans for */
+static const ScanSet lexer_sets[] = {
+    SCANSET(" \t\n\r\\$"),
+    SCANSET("'\\$"),
+    SCANSET("\"\\$"),
+    SCANSET(" \t\n\r|&;()#\\$=<>"),
+};
+
+/* Check if two strings are equal, NULL being only equal to NULL */
+static bool same_string(const char *a, const char *b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+/* Find the first byte of a set, one byte at a time */
+static size_t reference_scan_until(const char *data, size_t length,
+                                   const ScanSet *set) {
+    for (size_t i = 0; i < length; i++) {
+        if (memchr(set->chars, data[i], set->count)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+/* Find the first byte that is not ASCII or is `stop`, one byte at a time */
+static size_t reference_scan_ascii(const char *data, size_t length,
+                                   char stop) {
+    for (size_t i = 0; i < length; i++) {
+        if ((unsigned char)data[i] >= 0x80 || data[i] == stop) {
+            return i;
+        }
+    }
+    return length;
+}
+
+/* Compare the scans with the byte loops at every alignment */
+static void check_scans(const char *input, size_t length) {
+    // A set made of the first bytes of the input, to reach every byte value
+    char    chars[4];
+    ScanSet own = {chars, 0};
+    for (size_t i = 0; i < length && own.count < sizeof(chars); i++) {
+        chars[own.count++] = input[i];
+    }
+
+    for (size_t offset = 0; offset < length && offset < 64; offset++) {
+        const char *data = input + offset;
+        size_t      size = length - offset;
+        for (size_t k = 0; k < sizeof(lexer_sets) / sizeof(*lexer_sets); k++) {
+            size_t found    = scan_until(data, size, &lexer_sets[k]);
+            size_t expected = reference_scan_until(data, size, &lexer_sets[k]);
+            fuzz_check(found == expected,
+                       "scan_until with set %zu at offset %zu: %zu, not %zu",
+                       k, offset, found, expected);
+        }
+        if (own.count > 0) {
+            size_t found    = scan_until(data, size, &own);
+            size_t expected = reference_scan_until(data, size, &own);
+            fuzz_check(found == expected,
+                       "scan_until with the input bytes at offset %zu: %zu, "
+                       "not %zu",
+                       offset, found, expected);
+        }
+        size_t found    = scan_ascii(data, size, input[0]);
+        size_t expected = reference_scan_ascii(data, size, input[0]);
+        fuzz_check(found == expected,
+                   "scan_ascii at offset %zu: %zu, not %zu", offset, found,
+                   expected);
+    }
+}
+
+/* Tokenize an input, checking its views against their copies */
+static FuzzToken *tokenize(char *input, size_t *count) {
+    size_t length = strlen(input);
+    // Tokens are bounded by the input, unless the lexer stops advancing
+    size_t     capacity = 2 * length + 2;
+    FuzzToken *tokens   = malloc(capacity * sizeof(FuzzToken));
+    fuzz_check(tokens != NULL, "out of memory");
+    *count = 0;
+
+    LexerInput lexer = {0};
+    init_lexer_input(&lexer, input, NULL, fuzz_session());
+    int type;
+    do {
+        fuzz_check(*count < capacity, "the lexer does not advance");
+        LexerToken token = lexer_next_token(&lexer);
+        char      *copy  = lexer_token_copy(&token);
+        if (!token.value && token.start) {
+            fuzz_check(token.start >= lexer.data &&
+                           token.start + token.length <= lexer.data + length,
+                       "a view points out of the input");
+            fuzz_check(copy && strlen(copy) == token.length &&
+                           memcmp(copy, token.start, token.length) == 0,
+                       "the copy of a view differs from its text");
+        }
+        fuzz_check(same_string(copy, lexer_token_value(&token)),
+                   "the value of a token differs from its copy");
+
+        tokens[*count] = (FuzzToken){
+            .type  = token.type,
+            .value = copy,
+            .extra = token.extra ? strdup(token.extra) : NULL};
+        (*count)++;
+        type = token.type;
+        free_lexer_token(&token);
+    } while (type != TOKEN_EOF);
+    free_lexer_input(&lexer);
+    return tokens;
+}
+
+static void free_tokens(FuzzToken *tokens, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(tokens[i].value);
+        free(tokens[i].extra);
+    }
+    free(tokens);
+}
+
+/* Compare the tokens of a flat buffer with the ones of the lexer */
+static void check_flat(const char *input, const FuzzToken *tokens,
+                       size_t count) {
+    FlatBuffer *flat = tokenize_many(input, 1, fuzz_session());
+    fuzz_check(flat != NULL, "tokenize_many failed");
+    fuzz_check(flat->record_count == count, "%u flat tokens, not %zu",
+               flat->record_count, count);
+
+    // Strings are found by walking the table, they are indexed in order
+    const char  *base    = (const char *)flat;
+    const char **strings = malloc((flat->string_count + 1) * sizeof(char *));
+    fuzz_check(strings != NULL, "out of memory");
+    const char *string = base + flat->strings;
+    for (uint32_t i = 0; i < flat->string_count; i++) {
+        strings[i] = string;
+        string += strlen(string) + 1;
+    }
+
+    const FlatToken *records = (const FlatToken *)(base + flat->records);
+    for (size_t i = 0; i < count; i++) {
+        const char *value = records[i].value < 0 ? NULL
+                                                 : strings[records[i].value];
+        const char *extra = records[i].extra < 0 ? NULL
+                                                 : strings[records[i].extra];
+        fuzz_check(records[i].type == tokens[i].type,
+                   "flat token %zu has type %d, not %d", i, records[i].type,
+                   tokens[i].type);
+        fuzz_check(same_string(value, tokens[i].value) &&
+                       same_string(extra, tokens[i].extra),
+                   "flat token %zu has different strings", i);
+    }
+    free(strings);
+    free(flat);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char  *input  = fuzz_string(data, size);
+    size_t length = strlen(input);
+    check_scans(input, length);
+
+    size_t     count;
+    FuzzToken *tokens = tokenize(input, &count);
+    check_flat(input, tokens, count);
+
+    // The same input after blanks, which are skipped
+    for (size_t s = 0; s < sizeof(shifts) / sizeof(*shifts); s++) {
+        char *shifted = malloc(shifts[s] + length + 1);
+        fuzz_check(shifted != NULL, "out of memory");
+        memset(shifted, ' ', shifts[s]);
+        memcpy(shifted + shifts[s], input, length + 1);
+
+        size_t     other_count;
+        FuzzToken *other = tokenize(shifted, &other_count);
+        fuzz_check(other_count == count,
+                   "%zu tokens after %zu blanks, not %zu", other_count,
+                   shifts[s], count);
+        for (size_t i = 0; i < count; i++) {
+            fuzz_check(other[i].type == tokens[i].type &&
+                           same_string(other[i].value, tokens[i].value) &&
+                           same_string(other[i].extra, tokens[i].extra),
+                       "token %zu differs after %zu blanks", i, shifts[s]);
+        }
+        free_tokens(other, other_count);
+        free(shifted);
+    }
+
+    free_tokens(tokens, count);
+    free(input);
+    return 0;
+}
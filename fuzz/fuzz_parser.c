@@ -0,0 +1,171 @@
+/* Parser fuzzing harness
+ *
+ * Checks that:
+ *  - the flat form of a tree (flatten_ast) holds the same nodes as the tree;
+ *  - parse_many gives every input of a batch the tree parse gives it alone,
+ *    whatever was parsed before it.
+ */
+
+#include <stdbool.h> /* bool, true, false */
+#include <stdlib.h>  /* malloc, free */
+#include <string.h>  /* memcpy, strcmp, strlen */
+
+#include "ast.h"  /* ASTNode, Redirection, parse, free_ast */
+#include "flat.h" /* FlatBuffer, FlatNode, FlatRedirect, FlatBranch, flatten_ast, parse_many */
+#include "fuzz.h"
+#include "lexer.h" /* LexerInput, init_lexer_input, free_lexer_input */
+
+/* Input parsed before the fuzzed one in a batch */
+#define FUZZ_PARSER_PRELUDE "a=1 b | c > d 2>&1 && (e; f) &"
+
+/* A flat buffer with its strings indexed */
+typedef struct FlatView {
+    const FlatBuffer   *buffer;
+    const FlatNode     *nodes;
+    const FlatRedirect *redirects;
+    const FlatBranch   *branches;
+    const char        **strings;
+} FlatView;
+
+static FlatView view_flat(const FlatBuffer *buffer) {
+    const char *base = (const char *)buffer;
+    FlatView    view = {
+           .buffer    = buffer,
+           .nodes     = (const FlatNode *)(base + buffer->records),
+           .redirects = (const FlatRedirect *)(base + buffer->redirects),
+           .branches  = (const FlatBranch *)(base + buffer->branches),
+           .strings = malloc((buffer->string_count + 1) * sizeof(char *))};
+    fuzz_check(view.strings != NULL, "out of memory");
+
+    const char *string = base + buffer->strings;
+    for (uint32_t i = 0; i < buffer->string_count; i++) {
+        view.strings[i] = string;
+        string += strlen(string) + 1;
+    }
+    return view;
+}
+
+/* Check that a flat node (-1 for none) is the same as a tree node */
+static void check_node(const FlatView *view, int32_t index,
+                       const ASTNode *node) {
+    if (!node) {
+        fuzz_check(index == -1, "flat node %d should be missing", index);
+        return;
+    }
+    fuzz_check(index >= 0 && (uint32_t)index < view->buffer->record_count,
+               "flat node %d is missing", index);
+
+    const FlatNode *flat = &view->nodes[index];
+    fuzz_check(flat->type == (int32_t)node->type, "node %d has type %d, not %d",
+               index, flat->type, node->type);
+    fuzz_check(((flat->flags & FLAT_NODE_BACKGROUND) != 0) == node->background,
+               "node %d has a different background flag", index);
+
+    fuzz_check(flat->argc == node->argc, "node %d has %d arguments, not %d",
+               index, flat->argc, node->argc);
+    for (int i = 0; i < node->argc; i++) {
+        fuzz_check(strcmp(view->strings[flat->argv + i], node->argv[i]) == 0,
+                   "argument %d of node %d differs", i, index);
+    }
+
+    size_t assignments = node->assignments ? node->assignments->count : 0;
+    fuzz_check((size_t)flat->assignment_count == assignments,
+               "node %d has %d assignments, not %zu", index,
+               flat->assignment_count, assignments);
+    for (size_t i = 0; i < assignments; i++) {
+        fuzz_check(strcmp(view->strings[flat->assignments + i],
+                          node->assignments->items[i]) == 0,
+                   "assignment %zu of node %d differs", i, index);
+    }
+
+    int32_t redirects = 0;
+    for (Redirection *r = node->redirects; r; r = r->next, redirects++) {
+        fuzz_check(redirects < flat->redirect_count,
+                   "node %d has too few redirections", index);
+        const FlatRedirect *flat_redirect =
+            &view->redirects[flat->redirects + redirects];
+        const char *target = flat_redirect->target < 0
+                                 ? NULL
+                                 : view->strings[flat_redirect->target];
+        fuzz_check(flat_redirect->fd == r->fd &&
+                       flat_redirect->type == (int32_t)r->type &&
+                       ((flat_redirect->flags &
+                         FLAT_REDIRECT_PROCESS_SUBSTITUTION) != 0) ==
+                           r->is_process_substitution,
+                   "redirection %d of node %d differs", redirects, index);
+        fuzz_check((!target && !r->target) ||
+                       (target && r->target && strcmp(target, r->target) == 0),
+                   "target of redirection %d of node %d differs", redirects,
+                   index);
+    }
+    fuzz_check(redirects == flat->redirect_count,
+               "node %d has too many redirections", index);
+
+#ifndef TIDESH_DISABLE_CONDITIONALS
+    int32_t branches = 0;
+    for (ConditionalBranch *b = node->branches; b; b = b->next, branches++) {
+        fuzz_check(branches < flat->branch_count,
+                   "node %d has too few branches", index);
+        const FlatBranch *flat_branch =
+            &view->branches[flat->branches + branches];
+        check_node(view, flat_branch->condition, b->condition);
+        check_node(view, flat_branch->body, b->body);
+    }
+    fuzz_check(branches == flat->branch_count,
+               "node %d has too many branches", index);
+#endif
+
+    check_node(view, flat->left, node->left);
+    check_node(view, flat->right, node->right);
+}
+
+/* Parse an input alone */
+static ASTNode *parse_input(char *input) {
+    LexerInput lexer = {0};
+    init_lexer_input(&lexer, input, NULL, fuzz_session());
+    ASTNode *tree = parse(&lexer, fuzz_session());
+    free_lexer_input(&lexer);
+    return tree;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char    *input = fuzz_string(data, size);
+    ASTNode *tree  = parse_input(input);
+
+    FlatBuffer *flat = flatten_ast(tree);
+    fuzz_check(flat != NULL, "flatten_ast failed");
+    FlatView view = view_flat(flat);
+    check_node(&view, ((const int32_t *)((const char *)flat + flat->inputs))[0],
+               tree);
+    free(view.strings);
+    free(flat);
+
+    // The input twice after another one: [prelude, input, input]
+    size_t prelude = sizeof(FUZZ_PARSER_PRELUDE);
+    size_t length  = strlen(input) + 1;
+    char  *batch   = malloc(prelude + 2 * length);
+    fuzz_check(batch != NULL, "out of memory");
+    memcpy(batch, FUZZ_PARSER_PRELUDE, prelude);
+    memcpy(batch + prelude, input, length);
+    memcpy(batch + prelude + length, input, length);
+
+    flat = parse_many(batch, 3, fuzz_session());
+    fuzz_check(flat != NULL, "parse_many failed");
+    fuzz_check(flat->input_count == 3, "parse_many has %u inputs, not 3",
+               flat->input_count);
+    view = view_flat(flat);
+    const int32_t *roots = (const int32_t *)((const char *)flat + flat->inputs);
+    fuzz_check(roots[0] >= 0, "the prelude did not parse");
+    check_node(&view, roots[1], tree);
+    check_node(&view, roots[2], tree);
+    free(view.strings);
+    free(flat);
+    free(batch);
+
+    if (tree) {
+        free_ast(tree);
+        free(tree);
+    }
+    free(input);
+    return 0;
+}
@@ -0,0 +1,234 @@
+/* Variable expansion fuzzing harness
+ *
+ * Checks that variable_expansion, which builds its words in Dynamic strings,
+ * returns the words of a naive expansion written from its documentation. Both
+ * run in a fresh environment holding a few variables, as ${VAR:=value} sets
+ * them.
+ */
+
+#include <ctype.h>   /* isalnum, isdigit, isspace */
+#include <stdbool.h> /* bool, true, false */
+#include <stdio.h>   /* snprintf */
+#include <stdlib.h>  /* malloc, realloc, free */
+#include <string.h>  /* memcpy, strchr, strcmp, strlen, strndup */
+
+#include "data/array.h"           /* Array, free_array */
+#include "environ.h"              /* Environ, init_environ, environ_get, environ_set, free_environ */
+#include "expansions/variables.h" /* variable_expansion */
+#include "fuzz.h"
+
+/* A string being built */
+typedef struct Text {
+    char  *data;
+    size_t length;
+} Text;
+
+/* Words of the naive expansion */
+typedef struct Words {
+    char **items;
+    size_t count;
+} Words;
+
+static void text_add(Text *text, const char *data, size_t length) {
+    char *grown = realloc(text->data, text->length + length + 1);
+    fuzz_check(grown != NULL, "out of memory");
+    memcpy(grown + text->length, data, length);
+    text->data                 = grown;
+    text->length              += length;
+    text->data[text->length]   = '\0';
+}
+
+static void add_word(Words *words, const char *data, size_t length) {
+    char **items = realloc(words->items, (words->count + 1) * sizeof(char *));
+    char  *word  = strndup(data, length);
+    fuzz_check(items && word, "out of memory");
+    words->items                 = items;
+    words->items[words->count++] = word;
+}
+
+static void free_words(Words *words) {
+    for (size_t i = 0; i < words->count; i++) {
+        free(words->items[i]);
+    }
+    free(words->items);
+}
+
+/* Create the environment both expansions run in */
+static Environ *fuzz_environ(void) {
+    Environ *env = init_environ(NULL);
+    fuzz_check(env != NULL, "init_environ failed");
+    environ_set(env, "A", "hello world");
+    environ_set(env, "EMPTY", "");
+    environ_set(env, "SPACED", "  one \t two  ");
+    environ_set(env, "N", "42");
+    return env;
+}
+
+/* Expand the expression of ${...}, NULL for a failed ${VAR:?message} */
+static char *reference_brace(const char *expr, Environ *env, bool *split) {
+    char value_buffer[32];
+    if (expr[0] == '#') {
+        char *value = environ_get(env, (char *)expr + 1);
+        snprintf(value_buffer, sizeof(value_buffer), "%zu",
+                 value ? strlen(value) : 0);
+        return strdup(value_buffer);
+    }
+    *split = expr[0] == '=';
+    expr += *split;
+
+    // The first ':' followed by an operator starts the modifier
+    const char *op = expr;
+    while ((op = strchr(op, ':')) && (!op[1] || !strchr("-=+?", op[1]))) {
+        op++;
+    }
+    char       *name  = op ? strndup(expr, op - expr) : strdup(expr);
+    const char *word  = op ? op + 2 : NULL;
+    char       *value = environ_get(env, name);
+    bool        set   = value && *value;
+    char       *result;
+    if (!op) {
+        result = strdup(value ? value : "");
+    } else if (op[1] == '-') {
+        result = strdup(set ? value : word);
+    } else if (op[1] == '+') {
+        result = strdup(set ? word : "");
+    } else if (op[1] == '=') {
+        if (!set) {
+            environ_set(env, name, (char *)word);
+        }
+        result = strdup(set ? value : word);
+    } else {
+        result = set ? strdup(value) : NULL;
+    }
+    free(name);
+    return result;
+}
+
+/* Expand the variables of an input, false for a failed ${VAR:?message} */
+static bool reference_expansion(const char *input, Environ *env,
+                                Words *words) {
+    Text   text  = {0};
+    bool   split = false;
+    size_t i     = 0;
+    text_add(&text, "", 0);
+
+    while (input[i]) {
+        if (input[i] == '\\' && input[i + 1] == '$') {
+            text_add(&text, "$", 1);
+            i += 2;
+            continue;
+        }
+        if (input[i] != '$' || !input[i + 1]) {
+            text_add(&text, &input[i++], 1);
+            continue;
+        }
+        i++;
+
+        char *value      = NULL;
+        bool  word_split = false;
+        if (input[i] == '{') {
+            // The closing brace matching this one
+            size_t close = i + 1;
+            for (int depth = 1; input[close]; close++) {
+                depth += input[close] == '{' ? 1 : input[close] == '}' ? -1 : 0;
+                if (depth == 0)
+                    break;
+            }
+            if (!input[close]) {
+                text_add(&text, "${", 2);
+                i++;
+                continue;
+            }
+            char *expr = strndup(input + i + 1, close - i - 1);
+            value      = reference_brace(expr, env, &word_split);
+            free(expr);
+            if (!value) {
+                free(text.data);
+                return false;
+            }
+            i = close + 1;
+        } else {
+            word_split = input[i] == '=';
+            i += word_split;
+
+            // Special variables and digits are a single character
+            size_t start = i;
+            if (strchr("?$!_", input[i]) && input[i]) {
+                i++;
+            } else if (isdigit(input[i])) {
+                i++;
+            } else {
+                while (isalnum(input[i]) || input[i] == '_')
+                    i++;
+            }
+            char *name = strndup(input + start, i - start);
+            value      = environ_get(env, name);
+            value      = strdup(value ? value : "");
+            free(name);
+        }
+
+        if (!word_split) {
+            text_add(&text, value, strlen(value));
+        } else {
+            // The text so far is a word, then every field of the value
+            if (text.length > 0) {
+                add_word(words, text.data, text.length);
+            }
+            text.length = 0;
+            for (char *field = value; *field;) {
+                if (isspace(*field)) {
+                    field++;
+                    continue;
+                }
+                char *end = field;
+                while (*end && !isspace(*end))
+                    end++;
+                add_word(words, field, end - field);
+                field = end;
+            }
+            split = true;
+        }
+        free(value);
+    }
+
+    // After a split, an empty rest is not a word
+    if (!split || text.length > 0) {
+        add_word(words, text.data, text.length);
+    }
+    free(text.data);
+    return true;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *input = fuzz_string(data, size);
+
+    Session session = {0};
+    session.environ = fuzz_environ();
+    Array *words    = variable_expansion(input, &session);
+
+    Environ *env      = fuzz_environ();
+    Words    expected = {0};
+    bool     expanded = reference_expansion(input, env, &expected);
+
+    fuzz_check((words != NULL) == expanded, "variable_expansion %s",
+               expanded ? "failed" : "should have failed");
+    if (words) {
+        fuzz_check(words->count == expected.count, "%zu words, not %zu",
+                   words->count, expected.count);
+        for (size_t i = 0; i < expected.count; i++) {
+            fuzz_check(strcmp(words->items[i], expected.items[i]) == 0,
+                       "word %zu is \"%s\", not \"%s\"", i, words->items[i],
+                       expected.items[i]);
+        }
+        free_array(words);
+        free(words);
+    }
+
+    free_words(&expected);
+    free_environ(env);
+    free(env);
+    free_environ(session.environ);
+    free(session.environ);
+    free(input);
+    return 0;
+}
@@ -20,6 +20,8 @@
 #include "builtins/hooks.h"
 #include "builtins/info.h"
 #include "builtins/jobs.h"
+#include "builtins/parallel.h"
+#include "builtins/wait.h"
 #include "builtins/popd.h"
 #include "builtins/printenv.h"
 #include "builtins/pushd.h"
@@ -31,6 +33,24 @@
 #include "builtins/unalias.h"
 #include "builtins/which.h"
 
+/* Builtin flags */
+#define BUILTIN_SPECIAL (1 << 0) // Runs in the shell process (see below)
+
+/* A builtin command */
+typedef struct Builtin {
+    const char *name; // Command name
+    int (*function)(int argc, char **argv, Session *session); // Handler
+    int flags; // BUILTIN_* flags
+} Builtin;
+
+/**
+ * Find a builtin command by name
+ *
+ * @param name The command name to look up
+ * @return The builtin with its handler and flags, or NULL if not found
+ */
+const Builtin *find_builtin(const char *name);
+
 /**
  * Get the function pointer for a builtin command by name
  *
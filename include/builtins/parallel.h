@@ -0,0 +1,32 @@
+/** parallel.h
+ *
+ * Declarations for the 'parallel' builtin command.
+ */
+
+#ifndef BUILTIN_PARALLEL_H
+#define BUILTIN_PARALLEL_H
+
+#include "session.h"
+
+/**
+ * The parallel builtin command.
+ *
+ * Runs a command once per work item, keeping at most N jobs in flight.
+ * Work items are read from the arguments following `:::`, or one per line
+ * from the standard input. Each item replaces `{}` in the command, or is
+ * appended to it when `{}` is absent.
+ *
+ * Usage: parallel [-j N] [-k] [-u] [-s] [command...] [::: item...]
+ *   -j, --jobs N       Maximum number of concurrent jobs (default: online CPUs)
+ *   -k, --keep-order   Print job outputs in input order
+ *   -u, --ungroup      Do not buffer job outputs (lines may interleave)
+ *   -s, --summary      Report per-job exit statuses and aggregate timing
+ *
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param session The current session
+ * @return The number of failed jobs (capped at 101), or 255 on error
+ */
+int builtin_parallel(int argc, char **argv, Session *session);
+
+#endif /* BUILTIN_PARALLEL_H */
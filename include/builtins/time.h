@@ -0,0 +1,34 @@
+/** time.h
+ *
+ * Declarations for the 'time' builtin command.
+ */
+
+#ifndef BUILTIN_TIME_H
+#define BUILTIN_TIME_H
+
+#include "session.h"
+
+/**
+ * The time builtin command.
+ *
+ * Runs a command and reports its real, user and system times on stderr.
+ * With -v, also reports the time the shell spent in each phase of running
+ * it (parsing, command substitutions, expansions, PATH lookup, hooks,
+ * process creation, waiting and builtins) and the resource usage of its
+ * child processes.
+ *
+ * A command line starting with `time` is handled by the executor before
+ * its words are expanded, so that expansions are measured too. This
+ * function only runs when `time` itself comes from an expansion, and then
+ * runs its arguments as a command line, like eval.
+ *
+ * Usage: time [-v] command [args...]
+ *
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param session The current session
+ * @return The exit status of the command
+ */
+int builtin_time(int argc, char **argv, Session *session);
+
+#endif /* BUILTIN_TIME_H */
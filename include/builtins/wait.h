@@ -0,0 +1,31 @@
+/** wait.h
+ *
+ * Declarations for the 'wait' builtin command.
+ */
+
+#ifndef BUILTIN_WAIT_H
+#define BUILTIN_WAIT_H
+
+#include "session.h"
+
+/**
+ * The wait builtin command.
+ *
+ * Waits for background jobs to terminate. Without operands, waits for every
+ * running job. Operands are job specifications (%N, %%, %+, %-) or process
+ * IDs. All waited processes are multiplexed in a single poll() over their
+ * pidfds, so waiting on many jobs costs one blocking call.
+ *
+ * Usage: wait [-n] [--timeout SECONDS] [id...]
+ *   -n                 Return as soon as any one of the jobs terminates
+ *   --timeout SECONDS  Give up after SECONDS (fractions allowed)
+ *
+ * @param argc The number of arguments
+ * @param argv The arguments
+ * @param session The current session
+ * @return The exit status of the last (or, with -n, first) job waited for,
+ *         0 when waiting for all jobs, 124 on timeout, 127 for unknown IDs
+ */
+int builtin_wait(int argc, char **argv, Session *session);
+
+#endif /* BUILTIN_WAIT_H */
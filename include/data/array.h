@@ -47,6 +47,31 @@ Array *init_array(Array *array);
  */
 bool array_add(Array *array, char *string);
 
+/**
+ * Add a string to the Array without copying it
+ *
+ * @param array The Array to add to
+ * @param string The string to add, now owned by the Array
+ */
+bool array_push(Array *array, char *string);
+
+/**
+ * Make room for at least `capacity` strings in one allocation
+ *
+ * @param array The Array to grow
+ * @param capacity The number of strings the Array should be able to hold
+ * @return true on success, false if the allocation failed
+ */
+bool array_reserve(Array *array, size_t capacity);
+
+/**
+ * Move the strings of another Array to the end of an Array
+ *
+ * @param array The Array to extend
+ * @param other The Array to take the strings from, left empty
+ */
+void array_take(Array *array, Array *other);
+
 /**
  * Extend a Array with another Array
  *
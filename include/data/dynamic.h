@@ -9,7 +9,13 @@ dynamically growing strings.
 
 #include <stddef.h> /* size_t */
 
-/* A structure to hold a dynamically growing string value */
+/* Number of bytes (including the NUL terminator) stored inside the Dynamic
+ * itself before the string moves to the heap */
+#define DYNAMIC_INLINE_CAPACITY 32
+
+/* A structure to hold a dynamically growing string value.
+ * Short strings live in `small`, which `value` points to, so a Dynamic must
+ * not be copied by value once initialized. */
 typedef struct Dynamic {
     char  *value;    // The actual string value
     size_t length;   // The current length of the string
@@ -17,6 +23,7 @@ typedef struct Dynamic {
     size_t (
         *growing_strategy)( // The function which determines the new capacity
         size_t current_capacity, size_t required_capacity);
+    char small[DYNAMIC_INLINE_CAPACITY]; // Inline storage for short strings
 } Dynamic;
 
 /**
@@ -25,8 +32,8 @@ typedef struct Dynamic {
  * @param value The Dynamic to initialize. If NULL, a new Dynamic will be
  * allocated
  * @param growing_strategy Function pointer to the growing strategy function
- *     The function needs to return the default capacity when given a required
- * capacity <= 0.
+ *     The function is given the current capacity and the capacity needed,
+ * and must return a capacity at least as large as the needed one.
  *     If NULL, a default doubling strategy is used
  */
 Dynamic *init_dynamic_with_strategy(Dynamic *value,
@@ -56,6 +63,15 @@ void dynamic_append(Dynamic *value, char character);
  */
 void dynamic_extend(Dynamic *value, char *string);
 
+/**
+ * Append the first bytes of a string to a Dynamic
+ *
+ * @param value The Dynamic to append to
+ * @param string The bytes to append (not necessarily NUL-terminated)
+ * @param length Number of bytes to append
+ */
+void dynamic_extend_length(Dynamic *value, const char *string, size_t length);
+
 /**
  * Prepend a character to a Dynamic
  *
@@ -0,0 +1,94 @@
+/** intern.h
+ *
+ * This file provides a table of interned strings.
+ * Interning a string returns a canonical, reference counted copy of it:
+ * equal strings share a single allocation and can be compared by pointer.
+ */
+
+#ifndef DATA_INTERN_H
+#define DATA_INTERN_H
+
+#include <stdbool.h> /* bool */
+#include <stddef.h>  /* size_t */
+
+/* An interned string, stored right before its characters */
+typedef struct InternEntry {
+    size_t hash;     // Hash of the string
+    size_t refs;     // Number of holders of the string
+    size_t length;   // Length of the string
+    char   string[]; // The NUL-terminated string
+} InternEntry;
+
+/* A set of interned strings (open addressing with linear probing) */
+typedef struct InternTable {
+    InternEntry **slots;    // Entries, NULL for empty slots
+    size_t        capacity; // Number of slots (a power of two)
+    size_t        count;    // Number of distinct strings
+    size_t        bytes;    // Bytes used by the strings themselves
+} InternTable;
+
+/**
+ * Initialize an InternTable structure
+ *
+ * @param table Pointer to existing InternTable or NULL to allocate new
+ * @return Pointer to initialized InternTable, or NULL on failure
+ */
+InternTable *init_intern_table(InternTable *table);
+
+/**
+ * Intern a string, taking a reference to the canonical copy
+ *
+ * @param table The intern table
+ * @param string The string to intern
+ * @return The canonical copy, to be released with intern_release, or NULL on
+ * failure
+ */
+const char *intern_string(InternTable *table, const char *string);
+
+/**
+ * Intern the first bytes of a string, taking a reference to the canonical
+ * copy
+ *
+ * @param table The intern table
+ * @param string The bytes to intern (not necessarily NUL-terminated)
+ * @param length Number of bytes to intern
+ * @return The canonical copy, to be released with intern_release, or NULL on
+ * failure
+ */
+const char *intern_string_length(InternTable *table, const char *string,
+                                 size_t length);
+
+/**
+ * Take another reference to an interned string
+ *
+ * @param string A string returned by intern_string
+ * @return The same string
+ */
+const char *intern_retain(const char *string);
+
+/**
+ * Release a reference to an interned string, freeing it with the last one
+ *
+ * @param table The intern table the string was interned in
+ * @param string A string returned by intern_string (NULL is ignored)
+ */
+void intern_release(InternTable *table, const char *string);
+
+/**
+ * Check whether a string is the canonical copy held by a table
+ *
+ * @param table The intern table
+ * @param string The string to check
+ * @return true if `string` was returned by intern_string and is still alive
+ */
+bool intern_contains(const InternTable *table, const char *string);
+
+/**
+ * Free all resources used by an InternTable structure.
+ * Strings still referenced are freed too.
+ *
+ * @param table The intern table
+ */
+void free_intern_table(InternTable *table);
+
+#endif /* DATA_INTERN_H */
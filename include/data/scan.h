@@ -0,0 +1,48 @@
+/* scan.h
+
+Fast searching for the first of a few bytes in a buffer.
+Uses SSE2/AVX2 on x86 and NEON on ARM when the compiler targets them,
+and a portable byte loop everywhere else.
+*/
+
+#ifndef DATA_SCAN_H
+#define DATA_SCAN_H
+
+#include <stddef.h> /* size_t */
+
+/* Maximum number of bytes in a ScanSet */
+#define SCANSET_MAX 16
+
+/* A set of bytes to stop at */
+typedef struct ScanSet {
+    const char *chars; // Bytes to stop at
+    size_t      count; // Number of bytes in chars (at most SCANSET_MAX)
+} ScanSet;
+
+/* Initializer of a ScanSet from a string literal */
+#define SCANSET(literal) {(literal), sizeof(literal) - 1}
+
+/**
+ * Find the first byte of a buffer that belongs to a set.
+ * Only the `length` bytes of the buffer are read, so it does not need to be
+ * NUL-terminated or padded.
+ *
+ * @param data The buffer to search
+ * @param length Number of bytes to search
+ * @param set The bytes to stop at
+ * @return The index of the first byte in the set, or length if there is none
+ */
+size_t scan_until(const char *data, size_t length, const ScanSet *set);
+
+/**
+ * Find the first byte of a buffer that is not ASCII or is equal to `stop`.
+ * Pure ASCII text can then be handled a whole span at a time.
+ *
+ * @param data The buffer to search
+ * @param length Number of bytes to search
+ * @param stop An ASCII byte to stop at as well
+ * @return The index of the first matching byte, or length if there is none
+ */
+size_t scan_ascii(const char *data, size_t length, char stop);
+
+#endif /* DATA_SCAN_H */
@@ -16,6 +16,13 @@ strings with efficient prefix-based operations.
 
 typedef struct Trie Trie;
 
+/* Size of a Trie */
+typedef struct TrieStats {
+    size_t nodes; // Number of nodes, including the root
+    size_t keys;  // Number of keys
+    size_t bytes; // Memory used by the nodes and their values
+} TrieStats;
+
 /** Initialize a Trie
  *
  * @param node The node to initialize. If NULL, a new node will be allocated
@@ -91,4 +98,11 @@ bool trie_delete_key(Trie *trie, char *key);
  */
 Trie *trie_copy(Trie *src, Trie *dest);
 
+/** Measure a Trie, by walking all of its nodes
+ *
+ * @param trie The trie to measure
+ * @return Its number of nodes and keys and the memory it uses
+ */
+TrieStats trie_stats(Trie *trie);
+
 #endif /* DATA_TRIE_H */
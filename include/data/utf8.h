@@ -8,6 +8,7 @@ Handling of Unicode characters and strings
 
 #include <stdbool.h> /* bool */
 #include <stddef.h>  /* size_t */
+#include <stdint.h>  /* uint32_t */
 
 /**
  * Get the length of a UTF-8 character from its first byte.
@@ -42,4 +43,35 @@ char *utf8_next_char(char *str);
  */
 char *utf8_prev_char(char *current, char *start);
 
+/**
+ * Decode the UTF-8 character at the start of a buffer.
+ * Invalid or truncated sequences decode to U+FFFD and span a single byte.
+ *
+ * @param str Pointer to the character.
+ * @param length Number of bytes available from `str`.
+ * @param char_length Set to the number of bytes of the character.
+ * @return The code point of the character.
+ */
+uint32_t utf8_decode(const char *str, size_t length,
+                     unsigned char *char_length);
+
+/**
+ * Get the number of terminal columns a code point takes.
+ * East Asian wide and fullwidth characters (and most emoji) take two
+ * columns, combining marks and other zero-width characters take none.
+ *
+ * @param codepoint The code point.
+ * @return 0, 1 or 2.
+ */
+int utf8_codepoint_width(uint32_t codepoint);
+
+/**
+ * Get the number of terminal columns a UTF-8 encoded buffer takes.
+ *
+ * @param str Pointer to the UTF-8 encoded buffer.
+ * @param length Number of bytes of the buffer.
+ * @return Number of columns.
+ */
+size_t utf8_width(const char *str, size_t length);
+
 #endif /* DATA_UTF8_H */
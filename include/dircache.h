@@ -0,0 +1,97 @@
+/** dircache.h
+ *
+ * This file provides a small cache of directory listings.
+ * Listings are keyed by the directory's device and inode numbers and are
+ * revalidated against the directory's modification time, so repeated
+ * globbing or completion in the same directories does not re-read them.
+ */
+
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stdbool.h>   /* bool */
+#include <stddef.h>    /* size_t */
+#include <sys/types.h> /* dev_t, ino_t */
+#include <time.h>      /* struct timespec */
+
+/* Maximum number of listings kept before the least recently used is evicted */
+#define DIRCACHE_MAX_LISTINGS 64
+
+/* The entries of one directory */
+typedef struct DirListing {
+    dev_t           dev;       // Device of the directory
+    ino_t           ino;       // Inode of the directory
+    struct timespec mtime;     // Modification time when the listing was read
+    bool            racy;      // mtime too recent to prove later changes
+    char          **names;     // Entry names (without `.` and `..`)
+    unsigned char  *types;     // Entry types (DT_* values)
+    size_t          count;     // Number of entries
+    char           *storage;   // Backing storage for the names
+    unsigned long   last_used; // Clock value of the last access
+    unsigned int    pins;      // Number of users currently reading it
+} DirListing;
+
+/* A set of cached directory listings */
+typedef struct DirCache {
+    DirListing   *listings; // DIRCACHE_MAX_LISTINGS slots
+    size_t        count;    // Number of slots in use
+    unsigned long clock;    // Access counter used for eviction
+    size_t        hits;     // Lookups answered from the cache
+    size_t        misses;   // Lookups that had to read the directory
+} DirCache;
+
+/**
+ * Initialize a DirCache structure
+ *
+ * @param cache Pointer to existing DirCache or NULL to allocate new
+ * @return Pointer to initialized DirCache, or NULL on failure
+ */
+DirCache *init_dircache(DirCache *cache);
+
+/**
+ * Get the listing of an open directory, reading it only if it is not cached
+ * or has changed since it was cached.
+ * The listing is pinned and stays valid until it is passed to
+ * dircache_release.
+ *
+ * @param cache The directory cache
+ * @param fd A file descriptor open on the directory
+ * @return The listing, or NULL if the directory cannot be read or every
+ * cache slot is pinned
+ */
+const DirListing *dircache_get_fd(DirCache *cache, int fd);
+
+/**
+ * Get the listing of a directory by path.
+ * The listing is pinned and stays valid until it is passed to
+ * dircache_release.
+ *
+ * @param cache The directory cache
+ * @param path Path of the directory
+ * @return The listing, or NULL if the directory cannot be read
+ */
+const DirListing *dircache_get(DirCache *cache, const char *path);
+
+/**
+ * Release a listing obtained from dircache_get or dircache_get_fd
+ *
+ * @param cache The directory cache
+ * @param listing The listing to release
+ */
+void dircache_release(DirCache *cache, const DirListing *listing);
+
+/**
+ * Drop every cached listing
+ *
+ * @param cache The directory cache
+ */
+void dircache_clear(DirCache *cache);
+
+/**
+ * Free all resources used by a DirCache structure
+ *
+ * @param cache The directory cache
+ */
+void free_dircache(DirCache *cache);
+
+#endif /* DIRCACHE_H */
@@ -9,6 +9,7 @@
 #define EXECUTE_H
 
 #include <stdbool.h> /* bool */
+#include <sys/types.h> /* pid_t */
 
 #include "ast.h"
 #include "lexer.h"
@@ -86,4 +87,26 @@ int execute_string(const char *cmd, Session *session);
  */
 char *execute_string_stdout(const char *cmd, Session *session);
 
+/**
+ * Start executing a command string with its standard output captured,
+ * without waiting for it.
+ *
+ * @param cmd The command string to execute
+ * @param session The session context
+ * @param fd Set to the file descriptor the output can be read from
+ * @return The process ID of the command, or -1 on failure
+ */
+pid_t execute_string_stdout_start(const char *cmd, Session *session, int *fd);
+
+/**
+ * Read the output of a command started by execute_string_stdout_start and
+ * wait for it to finish.
+ *
+ * @param pid The process ID returned by execute_string_stdout_start
+ * @param fd The file descriptor returned by execute_string_stdout_start
+ * @param session The session context the command was started in
+ * @return The captured standard output of the command
+ */
+char *execute_string_stdout_finish(pid_t pid, int fd, Session *session);
+
 #endif /* EXECUTE_H */
@@ -7,21 +7,112 @@
  *  - a{b,c,d}e -> abe ace ade
  *  - a{b,c,d}e -> abe ace ade
  *  - a{{,c}d,e} -> ad acd ae
+ *
+ * Words are generated one at a time from a parsed template, so the number
+ * of words is known before any of them is built and no intermediate
+ * combination is ever stored.
  */
 
 #ifndef EXPANSIONS_BRACES_H
 #define EXPANSIONS_BRACES_H
 
-#include "data/array.h" /* Array */
-#include "session.h"    /* Session */
+#include <stdbool.h> /* bool */
+#include <stddef.h>  /* size_t */
+
+#include "data/array.h"   /* Array */
+#include "data/dynamic.h" /* Dynamic */
+#include "session.h"      /* Session */
+
+/* Default maximum number of words a single word may expand to */
+#define BRACE_EXPANSION_LIMIT 4000000
+
+/* Kinds of parts a brace template is made of */
+typedef enum BraceSegmentType {
+    BRACE_TEXT,  // Literal text
+    BRACE_LIST,  // {a,b,c}: one of several templates
+    BRACE_RANGE, // {1..10} or {a..z}: one value of a range
+} BraceSegmentType;
+
+struct BraceTemplate;
+
+/* A part of a brace template */
+typedef struct BraceSegment {
+    BraceSegmentType type;
+    size_t           count;  // Number of strings the segment produces
+    size_t           stride; // Words produced by the segments after it
+    // BRACE_TEXT
+    const char *text;   // Start of the text (inside the generator input)
+    size_t      length; // Length of the text
+    // BRACE_LIST
+    struct BraceTemplate **alternatives; // The alternatives
+    size_t                *offsets; // Words produced before each alternative
+    size_t                 alternative_count; // Number of alternatives
+    // BRACE_RANGE
+    long first;   // First value of the range
+    long step;    // 1 or -1
+    int  width;   // Minimum number of digits (zero padded)
+    bool letters; // Whether the range is made of letters
+} BraceSegment;
+
+/* A word with braces, parsed into segments */
+typedef struct BraceTemplate {
+    BraceSegment *segments; // The segments, in order
+    size_t        length;   // Number of segments
+    size_t        count;    // Number of words (SIZE_MAX if too many to count)
+} BraceTemplate;
+
+/* Generates the words of a brace expansion one at a time */
+typedef struct BraceGenerator {
+    char          *input;    // Copy of the word being expanded
+    BraceTemplate *template; // The parsed word
+    size_t         count;    // Number of words (SIZE_MAX if too many)
+    size_t         next;     // Index of the next word
+    Dynamic        word;     // Buffer the words are built in
+} BraceGenerator;
+
+/**
+ * Initialize a BraceGenerator for a word
+ *
+ * @param generator Pointer to existing BraceGenerator or NULL to allocate new
+ * @param input The word to expand
+ * @return Pointer to initialized BraceGenerator, or NULL on failure
+ */
+BraceGenerator *init_brace_generator(BraceGenerator *generator,
+                                     const char *input);
+
+/**
+ * Generate the next word of a brace expansion
+ *
+ * @param generator The generator
+ * @return The next word (to be freed by the caller), or NULL once all the
+ * words were generated
+ */
+char *brace_generator_next(BraceGenerator *generator);
+
+/**
+ * Free all resources used by a BraceGenerator structure
+ *
+ * @param generator The generator
+ */
+void free_brace_generator(BraceGenerator *generator);
+
+/**
+ * Get the maximum number of words a single word may expand to.
+ * It is read from TIDESH_BRACE_LIMIT (0 means no limit) and defaults to
+ * BRACE_EXPANSION_LIMIT.
+ *
+ * @param session The current session
+ * @return The maximum number of words
+ */
+size_t brace_expansion_limit(Session *session);
 
 /**
  * Perform brace expansion on the given input string.
  *
  * @param input The input string containing braces to expand
- * @param session The current session (not used in this function but included
- * for consistency)
- * @return An Array of expanded strings
+ * @param session The current session (used for the expansion limit)
+ * @return An Array of expanded strings, or NULL if the expansion would
+ * produce more words than allowed
  */
 Array *brace_expansion(char *input, Session *session);
 
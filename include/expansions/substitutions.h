@@ -0,0 +1,93 @@
+/** substitutions.h
+ * This file provides command substitution functionality.
+ *
+ * The lexer keeps `$(...)` in the words as written, and the commands are
+ * only run when the word is expanded, right before the command using it.
+ *
+ * Command substitution examples:
+ *  - $(cmd) -> output of cmd, without trailing newlines
+ *  - a$(cmd)b -> output of cmd between a and b
+ *  - \$(cmd) -> left as is
+ *
+ * Independent substitutions of one command are started together before its
+ * words are expanded (see prefetch_substitutions), so a command line with
+ * several slow substitutions waits for the slowest one only.
+ */
+
+#ifndef EXPANSIONS_SUBSTITUTIONS_H
+#define EXPANSIONS_SUBSTITUTIONS_H
+
+#include <stddef.h> /* size_t */
+
+#include <stdbool.h> /* bool */
+
+#include "data/array.h" /* Array */
+#include "session.h"    /* Session */
+
+/* Default number of substitutions run at the same time (can be changed with
+ * the TIDESH_SUBSTITUTION_JOBS variable, 1 disabling concurrency) */
+#define SUBSTITUTION_MAX_JOBS 8
+
+/* Outputs of the substitutions of a command, computed before expansion */
+typedef struct SubstitutionBatch {
+    Array  *commands; // Commands, in the order they appear in the words
+    char  **outputs;  // Their outputs (NULL once handed out)
+    size_t  next;     // Next output to hand out
+} SubstitutionBatch;
+
+/**
+ * Find the next command substitution in a word
+ *
+ * @param input The word to search
+ * @param from Index to start searching at
+ * @param start Set to the index of the `$`
+ * @param end Set to the index right after the closing `)`
+ * @return The command to run (without escapes), or NULL if there is none
+ */
+char *find_command_substitution(const char *input, size_t from, size_t *start,
+                                size_t *end);
+
+/**
+ * Perform command substitution on the given input string
+ *
+ * @param input The input string containing substitutions to run
+ * @param session The current session (the commands run in a copy of it)
+ * @return An Array containing the substituted string, or NULL on failure
+ */
+Array *command_substitution_expansion(char *input, Session *session);
+
+/**
+ * Check if a substituted command could change the session or files that
+ * a later substitution of the same command might depend on (special
+ * builtins, output redirections), in which case it must run in order.
+ *
+ * @param command The substituted command
+ * @param session The current session
+ * @return true if the command must not run concurrently with others
+ */
+bool substitution_has_side_effects(const char *command, Session *session);
+
+/**
+ * Run the substitutions found in a list of words concurrently, before the
+ * words are expanded.
+ * The outputs are handed out in order by command_substitution_expansion
+ * while session->substitutions points to the batch.
+ * Nothing is run if there are fewer than two substitutions or if one of
+ * them has side effects: they are then run one by one during expansion.
+ *
+ * @param words The words to scan
+ * @param count Number of words
+ * @param session The current session
+ * @return The batch of outputs, or NULL if nothing was run
+ */
+SubstitutionBatch *prefetch_substitutions(char **words, size_t count,
+                                          Session *session);
+
+/**
+ * Free a SubstitutionBatch structure and its outputs
+ *
+ * @param batch The batch to free
+ */
+void free_substitution_batch(SubstitutionBatch *batch);
+
+#endif /* EXPANSIONS_SUBSTITUTIONS_H */
@@ -0,0 +1,126 @@
+/** flat.h
+ *
+ * Declarations for flat buffers, contiguous copies of the results of parsing,
+ * tokenizing or expanding many inputs at once.
+ * A flat buffer is a single allocation holding a header, an entry per input,
+ * fixed size records (AST nodes or tokens) which refer to each other and to
+ * their strings by index, and a string table. It is meant for bulk consumers
+ * (the Python bindings) which can read it as one block of memory instead of
+ * walking pointers, and free it with a single free().
+ *
+ * Inputs are passed the same way strings are stored: NUL terminated, one
+ * after the other.
+ */
+
+#ifndef FLAT_H
+#define FLAT_H
+
+#include <stdint.h> /* int32_t, uint32_t */
+
+#include "ast.h"     /* ASTNode */
+#include "session.h" /* Session */
+
+/* Flags of a FlatNode */
+#define FLAT_NODE_BACKGROUND 1 // Run in the background
+
+/* Flags of a FlatRedirect */
+#define FLAT_REDIRECT_PROCESS_SUBSTITUTION 1 // The target is a command
+
+/* Header of a flat buffer. Offsets are in bytes from the start of the
+ * buffer, and every section is 4 bytes aligned */
+typedef struct FlatBuffer {
+    uint32_t size;           // Size of the whole buffer
+    uint32_t input_count;    // Number of inputs
+    uint32_t inputs;         // Offset of an int32_t per input (see below)
+    uint32_t record_count;   // Number of records (FlatNode or FlatToken)
+    uint32_t records;        // Offset of the records
+    uint32_t redirect_count; // Number of FlatRedirect (ASTs only)
+    uint32_t redirects;      // Offset of the redirections
+    uint32_t branch_count;   // Number of FlatBranch (ASTs only)
+    uint32_t branches;       // Offset of the branches
+    uint32_t string_count;   // Number of strings
+    uint32_t strings;        // Offset of the strings, NUL terminated
+    uint32_t strings_size;   // Size of the strings
+} FlatBuffer;
+
+/* A node of a flattened AST. Lists (arguments, assignments, redirections,
+ * branches) are ranges: an index of the first item and a count */
+typedef struct FlatNode {
+    int32_t type;             // NodeType
+    int32_t flags;            // FLAT_NODE_* flags
+    int32_t left;             // Left child, or -1
+    int32_t right;            // Right child, or -1
+    int32_t argv;             // First argument (string)
+    int32_t argc;             // Number of arguments
+    int32_t assignments;      // First assignment (string, NAME=value)
+    int32_t assignment_count; // Number of assignments
+    int32_t redirects;        // First redirection
+    int32_t redirect_count;   // Number of redirections
+    int32_t branches;         // First branch (conditionals)
+    int32_t branch_count;     // Number of branches
+} FlatNode;
+
+/* A redirection of a flattened AST */
+typedef struct FlatRedirect {
+    int32_t fd;     // Descriptor being redirected
+    int32_t type;   // TokenType of the redirection
+    int32_t target; // Target (string)
+    int32_t flags;  // FLAT_REDIRECT_* flags
+} FlatRedirect;
+
+/* A branch of a flattened conditional */
+typedef struct FlatBranch {
+    int32_t condition; // Condition (node), or -1 for else
+    int32_t body;      // Commands run if it holds (node), or -1
+} FlatBranch;
+
+/* A token of a flattened token list */
+typedef struct FlatToken {
+    int32_t type;  // TokenType
+    int32_t value; // Value (string), or -1
+    int32_t extra; // Extra value (string), or -1
+} FlatToken;
+
+/**
+ * Flatten an AST. Its input entry is its root node (0), or -1 if it is NULL.
+ *
+ * @param tree The root of the AST, or NULL
+ * @return The flat buffer (to free), or NULL on failure
+ */
+FlatBuffer *flatten_ast(const ASTNode *tree);
+
+/**
+ * Parse many commands into a single flat buffer. The entry of each input is
+ * its root node, or -1 if it has no command or does not parse.
+ *
+ * @param inputs The commands, NUL terminated, one after the other
+ * @param count The number of commands
+ * @param session The session (for aliases and features)
+ * @return The flat buffer (to free), or NULL on failure
+ */
+FlatBuffer *parse_many(const char *inputs, size_t count, Session *session);
+
+/**
+ * Tokenize many commands into a single flat buffer. The entry of each input
+ * is its first token, its last one being TOKEN_EOF.
+ *
+ * @param inputs The commands, NUL terminated, one after the other
+ * @param count The number of commands
+ * @param session The session
+ * @return The flat buffer (to free), or NULL on failure
+ */
+FlatBuffer *tokenize_many(const char *inputs, size_t count, Session *session);
+
+/**
+ * Expand many words into a single flat buffer, without records. The entry of
+ * each input is its first string, its strings ending where the ones of the
+ * next input begin.
+ *
+ * @param inputs The words, NUL terminated, one after the other
+ * @param count The number of words
+ * @param session The session
+ * @return The flat buffer (to free), or NULL on failure
+ */
+FlatBuffer *expand_many(const char *inputs, size_t count, Session *session);
+
+#endif /* FLAT_H */
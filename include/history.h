@@ -10,12 +10,17 @@
 
 #ifndef TIDESH_DISABLE_HISTORY
 
+#include <pthread.h> /* pthread_t */
 #include <stdbool.h> /* bool */
 #include <stddef.h>  /* size_t */
+#include <unistd.h>  /* pid_t */
+
+#include "data/intern.h" /* InternTable */
 
 /* Holds a single command in the history list */
 typedef struct HistoryEntry {
-    char                *command;   // The command string
+    char                *command;   // The command string (interned when the
+                                    // history has a string table)
     long                 timestamp; // Unix timestamp
     struct HistoryEntry *next;      // Next entry (newer)
     struct HistoryEntry *prev;      // Previous entry (older)
@@ -23,14 +28,22 @@ typedef struct HistoryEntry {
 
 /* The history state container */
 typedef struct History {
-    HistoryEntry *head;          // Oldest entry
-    HistoryEntry *tail;          // Newest entry
-    HistoryEntry *current;       // Navigation pointer (NULL = at live prompt)
-    size_t        size;          // Current number of entries
-    size_t        limit;         // Max number of entries
-    bool          disabled;      // Whether history is disabled
-    char         *filepath;      // Filepath for persistence
-    bool          owns_filepath; // Whether filepath should be freed
+    HistoryEntry   *head;          // Oldest entry
+    HistoryEntry   *tail;          // Newest entry
+    HistoryEntry   *current;       // Navigation pointer (NULL = at live prompt)
+    size_t          size;          // Current number of entries
+    size_t          limit;         // Max number of entries
+    bool            disabled;      // Whether history is disabled
+    char           *filepath;      // Filepath for persistence
+    bool            owns_filepath; // Whether filepath should be freed
+    InternTable    *strings;       // Table commands are interned in, so
+                                   // repeated commands share their storage
+                                   // (NULL to copy each one)
+    bool            pending;       // Whether the file still has to be read
+    bool            loading;       // Whether it is read in the background
+    pthread_t       loader;        // Thread reading the file
+    pid_t           loader_owner;  // Process that started the thread
+    struct History *loaded;        // Entries read by the thread
 } History;
 
 /**
@@ -44,12 +57,42 @@ History *init_history(History *history);
 /**
  * Load history from disk
  *
- * @param history Pointer to History to load into, or NULL to create new
+ * @param history Pointer to an initialized History to load into (its string
+ * table is kept), or NULL to create new
  * @param filepath Path to history file
  * @return Pointer to loaded History
  */
 History *load_history(History *history, char *filepath);
 
+/**
+ * Set the file of a history without reading it yet. It is read the first
+ * time the history is used, or in the background once
+ * history_load_in_background is called.
+ *
+ * @param history Pointer to an initialized History
+ * @param filepath Path to history file
+ */
+void history_defer_load(History *history, char *filepath);
+
+/**
+ * Start reading the file of a history set with history_defer_load in a
+ * background thread. Its entries are added the first time the history is
+ * used, waiting for the thread if it is not done yet.
+ *
+ * @param history Pointer to History
+ * @return true if the thread was started
+ */
+bool history_load_in_background(History *history);
+
+/**
+ * Make sure the file of a history set with history_defer_load was read.
+ * Every history function does it, so this is only needed before accessing
+ * the entries directly.
+ *
+ * @param history Pointer to History
+ */
+void history_ensure_loaded(History *history);
+
 /**
  * Clear history entries from memory and truncate the history file on disk
  *
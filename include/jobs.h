@@ -40,6 +40,8 @@ typedef struct Jobs {
     pid_t         pgid;          // Process group ID for the shell
     JobsStateHook state_hook;    // Optional state change hook
     void         *state_context; // Hook context
+    struct Trace *trace;         // Trace state changes are recorded in
+                                 // (NULL if none)
 } Jobs;
 
 /**
@@ -103,6 +105,24 @@ Job *jobs_get_current(Jobs *jobs);
  */
 Job *jobs_get_previous(Jobs *jobs);
 
+/**
+ * Get the name of a job state, as given to hooks and traces
+ *
+ * @param state The state
+ * @return Its name ("running", "stopped", "done" or "killed")
+ */
+const char *job_state_name(JobState state);
+
+/**
+ * Apply a status returned by waitpid to a job, firing the state hook when
+ * the job finishes
+ *
+ * @param jobs Pointer to Jobs
+ * @param job Pointer to the Job the status belongs to
+ * @param status Status as returned by waitpid
+ */
+void jobs_apply_status(Jobs *jobs, Job *job, int status);
+
 /**
  * Update job states by checking their status
  *
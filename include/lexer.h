@@ -15,9 +15,13 @@
 typedef struct LexerInput {
     /* The input data */
     char *data;
+    /* The length of the input data */
+    size_t length;
     /* The current position in the input data */
     size_t pos;
-    /* A function used to execute commands and get their output */
+    /* A function used to execute commands and get their output.
+    The lexer itself no longer calls it: command substitutions are kept in
+    the words and run when they are expanded (see expansions/substitutions.h) */
     char *(*execute)(const char *cmd, Session *session);
     /* The current session */
     Session *session;
@@ -115,12 +119,19 @@ typedef enum TokenType {
 typedef struct LexerToken {
     /* The type of the token */
     TokenType type;
-    /* The value of the token (ex: for `TOKEN_WORD`, `TOKEN_IO_NUMBER`, etc.) */
+    /* The value of the token (ex: for `TOKEN_WORD`, `TOKEN_IO_NUMBER`, etc.).
+    NULL for words that need no unescaping, which are only a view of the
+    input (see `lexer_token_value`) */
     char *value;
     /* Extra information about the token
     (ex: `TOKEN_ASSIGNMENT` has the variable name as value,
     and the assigned value as extra) */
     char *extra;
+    /* The text of the token in the input, when `value` is NULL.
+    It is only valid as long as the input is */
+    const char *start;
+    /* The length of the token text in the input */
+    size_t length;
 } LexerToken;
 
 /**
@@ -131,6 +142,23 @@ typedef struct LexerToken {
  */
 LexerToken lexer_next_token(LexerInput *input);
 
+/**
+ * Get the value of a token, copying it out of the input the first time if the
+ * token is only a view of it. The value is owned by the token.
+ *
+ * @param token Pointer to LexerToken
+ * @return The value of the token, or NULL if it has none
+ */
+char *lexer_token_value(LexerToken *token);
+
+/**
+ * Get a copy of the value of a token
+ *
+ * @param token Pointer to LexerToken
+ * @return A newly allocated copy of the value, or NULL if it has none
+ */
+char *lexer_token_copy(const LexerToken *token);
+
 /**
  * Free the resources associated with a LexerToken
  *
@@ -0,0 +1,136 @@
+/** profile.h
+ *
+ * Declarations for per-phase command profiling.
+ * While a Profile is attached to the session, the time spent running
+ * commands is split into phases (parsing, expansions, PATH lookup, hooks,
+ * process creation, waiting for children...). Phases nest, and time is only
+ * charged to the innermost one, so the phases add up to the elapsed time.
+ * It backs the `time` prefix and the TIDESH_PROFILE setting.
+ * Phases are also recorded as spans in the trace of the session, if any.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>      /* bool */
+#include <stddef.h>       /* size_t */
+#include <stdint.h>       /* uint64_t */
+#include <stdio.h>        /* FILE */
+#include <sys/resource.h> /* struct rusage */
+
+#include "session.h" /* Session */
+
+/* What the shell can be doing while running a command */
+typedef enum ProfilePhase {
+    PROFILE_SHELL,        // Anything not covered by another phase
+    PROFILE_PARSE,        // Lexing and parsing
+    PROFILE_SUBSTITUTION, // Running command substitutions
+    PROFILE_EXPANSION,    // Other expansions (variables, braces, globs...)
+    PROFILE_LOOKUP,       // Searching commands in PATH
+    PROFILE_HOOKS,        // Looking for and running hooks
+    PROFILE_SPAWN,        // Creating child processes
+    PROFILE_WAIT,         // Waiting for child processes
+    PROFILE_BUILTIN,      // Running builtins in the shell process
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+/* Maximum number of nested phases tracked */
+#define PROFILE_MAX_DEPTH 32
+
+/* Timings of the commands run while profiling */
+typedef struct Profile {
+    uint64_t      start; // When profiling started (monotonic ns)
+    uint64_t      last;  // When time was last charged to a phase
+    uint64_t      elapsed[PROFILE_PHASE_COUNT]; // Time spent in each phase
+    size_t        calls[PROFILE_PHASE_COUNT];   // Times each phase was entered
+    ProfilePhase  stack[PROFILE_MAX_DEPTH];     // Phases being run
+    size_t        depth;    // Number of phases being run
+    struct rusage self;     // Resource usage of the shell at the start
+    struct rusage children; // Resource usage of its children at the start
+    struct rusage spawned;  // Resource usage of the children started by the
+                            // zygote, which are not the shell's
+} Profile;
+
+/**
+ * Current monotonic time, the clock profiles and traces are measured with
+ *
+ * @return Monotonic time in nanoseconds
+ */
+uint64_t profile_now(void);
+
+/**
+ * Initialize a Profile and start measuring
+ *
+ * @param profile Pointer to existing Profile or NULL to allocate new
+ * @return Pointer to initialized Profile, or NULL on failure
+ */
+Profile *init_profile(Profile *profile);
+
+/**
+ * Whether every command should be profiled, as asked with TIDESH_PROFILE
+ * (any value but empty or 0)
+ *
+ * @param session The current session
+ * @return true if every command should be profiled
+ */
+bool profile_requested(Session *session);
+
+/**
+ * Enter a phase. Does nothing if the session is neither being profiled nor
+ * traced.
+ *
+ * @param session The current session
+ * @param phase The phase being entered
+ */
+void profile_begin(Session *session, ProfilePhase phase);
+
+/**
+ * Enter a phase, giving its span in the trace of the session a name (such
+ * as the hook or builtin being run) and details
+ *
+ * @param session The current session
+ * @param phase The phase being entered
+ * @param name Name of the span (NULL for the name of the phase)
+ * @param detail More information about the span, or NULL
+ */
+void profile_begin_named(Session *session, ProfilePhase phase,
+                         const char *name, const char *detail);
+
+/**
+ * Leave the phase entered last. Does nothing if the session is neither
+ * being profiled nor traced.
+ *
+ * @param session The current session
+ */
+void profile_end(Session *session);
+
+/**
+ * Account for the resource usage of a command the shell did not wait for
+ * itself (started by the zygote). Does nothing if the session is not being
+ * profiled.
+ *
+ * @param session The current session
+ * @param usage Resource usage of the command
+ */
+void profile_add_child(Session *session, const struct rusage *usage);
+
+/**
+ * Add the timings of a profile to another one, which was suspended while
+ * the first one was running
+ *
+ * @param profile The profile to add to
+ * @param other The profile to add
+ */
+void profile_merge(Profile *profile, const Profile *other);
+
+/**
+ * Print the real, user and system times since a profile was started and,
+ * if verbose, the time spent in each phase
+ *
+ * @param profile The profile
+ * @param output Where to print the report
+ * @param verbose Whether to print the time spent in each phase
+ */
+void profile_report(Profile *profile, FILE *output, bool verbose);
+
+#endif /* PROFILE_H */
@@ -248,6 +248,15 @@ char *ansi_apply(char *text, char *context, ...);
  */
 size_t ansi_strlen(const char *s);
 
+/**
+ * Calculates the number of terminal columns a string takes, excluding ANSI
+ * escape codes and counting East Asian wide characters as two columns.
+ *
+ * @param s The string to measure.
+ * @return The number of columns.
+ */
+size_t ansi_width(const char *s);
+
 /**
  * Strips all ANSI escape codes from the given string.
  *
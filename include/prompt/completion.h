@@ -5,6 +5,15 @@
 #include "session.h"
 #include "prompt/cursor.h"
 
+/* Time a slow completion source (PATH, directories) may run per request */
+#define COMPLETION_SOURCE_BUDGET_MS 150
+
+/* Time the prompt waits for the slow sources before using what it has */
+#define COMPLETION_WAIT_BUDGET_MS 300
+
+/* Worker thread running the slow completion sources */
+typedef struct CompletionEngine CompletionEngine;
+
 /**
  * Perform tab completion at the current cursor position.
  *
@@ -13,6 +22,59 @@
  */
 void completion_apply(Cursor *cursor, Session *session);
 
+/**
+ * Start completing the word at the cursor.
+ * In-memory sources are matched immediately while PATH and directory
+ * lookups run on the completion worker; the completion is inserted by
+ * completion_receive once they finish.
+ * Falls back to completion_apply if the worker cannot be started.
+ *
+ * @param cursor The current cursor state
+ * @param session The shell session
+ */
+void completion_request(Cursor *cursor, Session *session);
+
+/**
+ * Drop the pending completion, if any (the line changed since it was
+ * requested). Sources still working on it stop early.
+ *
+ * @param session The shell session
+ */
+void completion_cancel(Session *session);
+
+/**
+ * Get the file descriptor that becomes readable when the worker has
+ * results for the pending completion.
+ *
+ * @param session The shell session
+ * @return The file descriptor, or -1 if no completion is pending
+ */
+int completion_fd(Session *session);
+
+/**
+ * Get how long the prompt should still wait for the pending completion.
+ *
+ * @param session The shell session
+ * @return Milliseconds left, or -1 if no completion is pending
+ */
+int completion_timeout(Session *session);
+
+/**
+ * Insert the pending completion if its results arrived, or with the
+ * matches found so far once the wait budget is exhausted.
+ *
+ * @param cursor The current cursor state
+ * @param session The shell session
+ */
+void completion_receive(Cursor *cursor, Session *session);
+
+/**
+ * Stop the completion worker and free its resources
+ *
+ * @param engine The completion engine
+ */
+void free_completion_engine(CompletionEngine *engine);
+
 /**
  * Check if a character is a shell delimiter.
  *
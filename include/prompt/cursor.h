@@ -7,9 +7,23 @@
 #define PROMPT_CURSOR_H
 
 #include "session.h"
+#include <stdbool.h> /* bool */
 #include <stddef.h> /* size_t */
 #include "data/dynamic.h" /* Dynamic */
 
+/* Layout of the input on the terminal, kept between key presses so that
+ * positions are found without rescanning the whole input */
+typedef struct CursorLayout {
+    const char *prompt;             // Prompt the width was measured for
+    const char *continuation;       // Continuation prompt measured
+    size_t      prompt_width;       // Columns taken by the prompt
+    size_t      continuation_width; // Columns taken by the continuation prompt
+    size_t      columns;            // Terminal width the line was placed with
+    size_t      line_start;         // Byte offset of a line of the input
+    size_t      line_row;           // Terminal row that line starts on
+    bool        valid;              // Whether line_start and line_row are set
+} CursorLayout;
+
 typedef struct Cursor {
     char *keep; // Pointer to the previous cursor state for history navigation
     char *suggestion; // Pointer to the current suggestion string
@@ -20,6 +34,7 @@ typedef struct Cursor {
     const char *prompt;           // Prompt string
     const char *continuation_prompt; // Continuation prompt string
     Session    *session;             // Associated session
+    CursorLayout layout;             // Cached layout of the input
 } Cursor;
 
 typedef struct CursorPosition {
@@ -32,10 +47,36 @@ typedef struct CursorPosition {
  * codes.
  *
  * @param str The input string.
- * @return The visible length of the string.
+ * @return The number of terminal columns the string takes.
  */
 size_t visible_length(const char *str);
 
+/**
+ * Gets the number of columns taken by the prompt, measured once per prompt.
+ *
+ * @param cursor Pointer to the Cursor structure.
+ * @return The width of the prompt.
+ */
+size_t cursor_prompt_width(Cursor *cursor);
+
+/**
+ * Gets the number of columns taken by the continuation prompt, measured once
+ * per prompt.
+ *
+ * @param cursor Pointer to the Cursor structure.
+ * @return The width of the continuation prompt.
+ */
+size_t cursor_continuation_width(Cursor *cursor);
+
+/**
+ * Tells the cursor that its data changed from a byte offset onward, so that
+ * the cached layout of what comes after it is dropped.
+ *
+ * @param cursor Pointer to the Cursor structure.
+ * @param offset Byte offset of the first changed byte.
+ */
+void cursor_layout_changed(Cursor *cursor, size_t offset);
+
 /**
  * Initializes a Cursor structure.
  *
@@ -112,6 +153,15 @@ void cursor_clear_screen(Cursor *cursor);
  */
 size_t cursor_eol_distance(Cursor *cursor);
 
+/**
+ * Calculates the number of characters between the start of the current line
+ * and the cursor.
+ *
+ * @param cursor Pointer to the Cursor structure.
+ * @return The distance to the start of the line.
+ */
+size_t cursor_bol_distance(Cursor *cursor);
+
 /**
  * Appends a character at the end of the current input.
  *
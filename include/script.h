@@ -0,0 +1,80 @@
+/** script.h
+ *
+ * This file provides a streaming reader for shell scripts.
+ * Scripts are read in fixed-size blocks and split into complete top-level
+ * commands as soon as they have been read, so each command can be executed
+ * before the rest of the script is read and memory stays bounded by the
+ * largest command instead of the size of the script.
+ */
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdbool.h> /* bool */
+#include <stddef.h>  /* size_t */
+
+#include "data/dynamic.h" /* Dynamic */
+#include "lexer.h"        /* TokenType */
+#include "session.h"      /* Session */
+
+/* Number of bytes read from the script at once */
+#define SCRIPT_BLOCK_SIZE 65536
+
+/* What is known about the command being read */
+typedef struct ScriptState {
+    int       conditionals; // Number of open `if` blocks
+    int       subshells;    // Number of open parentheses
+    TokenType last;         // Last token that is not a newline or comment
+    bool      has_command;  // Whether any such token was read
+} ScriptState;
+
+/* A script being read command by command */
+typedef struct ScriptReader {
+    int         fd;        // The file descriptor the script is read from
+    bool        eof;       // Whether the end of the file was reached
+    Dynamic     pending;   // Text read but not returned yet
+    size_t      start;     // Start of the current command in pending
+    size_t      scanned;   // End of the last complete line in pending
+    ScriptState state;     // State of the current command up to scanned
+    Session    *session;   // The current session
+} ScriptReader;
+
+/**
+ * Initialize a ScriptReader structure
+ *
+ * @param reader Pointer to existing ScriptReader or NULL to allocate new
+ * @param fd The file descriptor to read the script from (not closed)
+ * @param session The current session
+ * @return Pointer to initialized ScriptReader, or NULL on failure
+ */
+ScriptReader *init_script_reader(ScriptReader *reader, int fd,
+                                 Session *session);
+
+/**
+ * Read the next complete top-level command of the script.
+ * A command is complete once it ends with a newline outside of any quote,
+ * here-document, parenthesis or `if` block and is not continued by a pipe or
+ * `&&`/`||`. The last command of a script does not need a newline.
+ *
+ * @param reader The script reader
+ * @return The command, which must be freed, or NULL at the end of the script
+ */
+char *script_reader_next(ScriptReader *reader);
+
+/**
+ * Free all resources used by a ScriptReader structure
+ *
+ * @param reader The script reader
+ */
+void free_script_reader(ScriptReader *reader);
+
+/**
+ * Execute a script command by command while it is being read
+ *
+ * @param fd The file descriptor to read the script from (not closed)
+ * @param session The current session
+ * @return The exit status of the last command
+ */
+int execute_script(int fd, Session *session);
+
+#endif /* SCRIPT_H */
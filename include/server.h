@@ -0,0 +1,51 @@
+/** server.h
+ *
+ * Declarations for the server mode, where a long-lived process owns a
+ * session and runs the commands another process sends it over a socket.
+ * Embedders (the Python bindings) otherwise fork themselves, however large
+ * they are, for every command whose output they capture; a server keeps
+ * the session (and its state: working directory, variables, aliases) in a
+ * small process and only sends bytes back and forth.
+ *
+ * Every message is a frame: a 9 bytes header (a request id and a payload
+ * length as native 32 bits integers around a type byte) followed by the
+ * payload. Requests are handled in the order they arrive, so a client may
+ * send many before reading any reply (pipelining). The output of a command
+ * is streamed back as it is written, in STDOUT and STDERR frames carrying
+ * the id of its request, and a STATUS frame ends every request.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "session.h" /* Session */
+
+/* Size of the header of a frame: id, type, length */
+#define SERVER_HEADER_SIZE 9
+
+/* Size of the output sent in a single frame */
+#define SERVER_CHUNK_SIZE 65536
+
+/* Largest command a request may carry */
+#define SERVER_MAX_COMMAND (16 * 1024 * 1024)
+
+/* Types of frames */
+typedef enum ServerFrameType {
+    SERVER_EXECUTE = 1, // Request: execute the command in the payload
+    SERVER_STDOUT  = 2, // Reply: standard output of the command
+    SERVER_STDERR  = 3, // Reply: standard error of the command
+    SERVER_STATUS  = 4  // Reply: exit status (32 bits), ends the request
+} ServerFrameType;
+
+/**
+ * Serve requests on a connection until it is closed or a command exits the
+ * shell. Commands run with their standard input on /dev/null. Background
+ * jobs only have their output forwarded until their request is done.
+ *
+ * @param session The session the commands are executed in
+ * @param fd The connection (a stream socket)
+ * @return 0 once the client is gone or the shell exited, -1 on error
+ */
+int serve(Session *session, int fd);
+
+#endif /* SERVER_H */
@@ -11,10 +11,13 @@
 
 #include <stddef.h> /* size_t */
 
+#include "data/intern.h"     /* InternTable */
 #include "data/trie.h"       /* Trie */
+#include "dircache.h"        /* DirCache */
 #include "environ.h"         /* Environ */
 #include "feature-flags.h"   /* Features */
 #include "prompt/terminal.h" /* Terminal */
+#include "stats.h"           /* Stats */
 
 #ifndef TIDESH_DISABLE_HISTORY
 #include "history.h" /* History */
@@ -32,6 +35,7 @@ typedef struct Session {
     char    *current_working_dir;  // Current working directory
     char    *previous_working_dir; // Previous working directory
     Environ *environ;              // Environment variables
+    InternTable *strings; // Interned strings shared by the session
 #ifndef TIDESH_DISABLE_HISTORY
     History *history; // Command history
 #endif
@@ -45,12 +49,26 @@ typedef struct Session {
     Terminal *terminal; // Terminal information
 #ifndef TIDESH_DISABLE_JOB_CONTROL
     Jobs *jobs; // Background jobs
+#endif
+    DirCache *dircache; // Cached directory listings
+    struct CompletionEngine *completion; // Tab completion worker (lazy)
+    struct Profile          *profile;    // Timings of the running command
+                                         // (NULL unless it is profiled)
+    struct Trace            *trace;      // Events of the session
+                                         // (NULL unless TIDESH_TRACE is set)
+    struct Zygote           *zygote;     // Helper starting commands
+                                         // (NULL unless TIDESH_ZYGOTE is set)
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+    struct SubstitutionBatch *substitutions; // Outputs computed ahead of
+                                             // expansion (NULL if none)
 #endif
     Features features;       // Runtime feature flags
+    Stats    stats;          // Runtime statistics
     bool     exit_requested; // Flag to indicate if shell should exit
     bool     hooks_disabled; // Prevent hook recursion during hook execution
     bool     initial_parent_hooks_run; // Track if initial HOOK_ENTER has been
                                        // executed
+    bool     path_scanned; // Whether completion already filled path_commands
 } Session;
 
 /**
@@ -0,0 +1,45 @@
+/** startup.h
+ *
+ * Declarations for the startup trace.
+ * When enabled (--startup-trace), every step of the shell startup is
+ * timestamped, and the time each one took is printed once the shell is
+ * ready to run commands. The trace is process-wide, as there is a single
+ * startup per process.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdio.h> /* FILE */
+
+/* Maximum number of steps recorded */
+#define STARTUP_MAX_STEPS 64
+
+/**
+ * Start the clock of the startup trace. Steps are only recorded once the
+ * trace is enabled, but are timed from here.
+ */
+void startup_trace_begin(void);
+
+/**
+ * Enable the startup trace
+ */
+void startup_trace_enable(void);
+
+/**
+ * Record the end of a startup step, which started when the previous one
+ * ended. Does nothing if the trace is not enabled.
+ *
+ * @param step Name of the step (not copied, must outlive the trace)
+ */
+void startup_trace_step(const char *step);
+
+/**
+ * Print the time each recorded step took, in microseconds, and disable the
+ * trace. Does nothing if the trace is not enabled.
+ *
+ * @param output Where to print the report
+ */
+void startup_trace_report(FILE *output);
+
+#endif /* STARTUP_H */
@@ -0,0 +1,32 @@
+/** stats.h
+ *
+ * Declarations for the runtime statistics of a session.
+ * Stats are plain counters bumped where things happen (commands, forks,
+ * PATH lookups, expansions, hooks), always on as they cost an increment.
+ * Sizes (history, tries, memory) are not counted but measured when the
+ * statistics are reported, by `info stats`.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+/* Counters of a session */
+typedef struct Stats {
+    size_t   commands;      // Simple commands run
+    size_t   forks;         // Child processes created
+    size_t   zygote_spawns; // Of those, the ones the zygote created
+    size_t   builtins;      // Builtins run in the shell process
+    size_t   path_lookups;  // Commands searched in PATH
+    size_t   path_misses;   // Commands not found in PATH
+    size_t   words;         // Words produced by expansions
+    size_t   globs;         // Patterns expanded against the file system
+    size_t   glob_matches;  // Paths matched by those patterns
+    size_t   hook_lookups;  // Times the hooks of an event were looked for
+    size_t   hook_runs;     // Hook files run
+    uint64_t hook_time;     // Time spent looking for and running hooks (ns)
+} Stats;
+
+#endif /* STATS_H */
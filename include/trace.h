@@ -0,0 +1,166 @@
+/** trace.h
+ *
+ * Declarations for execution traces.
+ * A Trace records what the shell does (commands, parsing, expansion stages,
+ * builtins, forks and exits of children, hooks, job state changes) as a
+ * stream of timestamped events, in the Chrome trace event format (which
+ * Perfetto and chrome://tracing open) or as JSON lines.
+ * Events are copied into a lock-free ring buffer by the shell, and written
+ * to the trace file by a background writer process sharing the buffer, so
+ * the shell never waits for the file (a writer thread would make every
+ * fork of the shell slower). Events are dropped (and counted) if the buffer
+ * is full.
+ * Only the process that opened a trace records events in it: forked
+ * children only show up as the fork and exit events of their parent.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h> /* atomic_size_t, atomic_bool */
+#include <stdbool.h>   /* bool */
+#include <stddef.h>    /* size_t */
+#include <stdint.h>    /* uint64_t */
+#include <sys/types.h> /* pid_t */
+
+#include "session.h" /* Session */
+
+/* Number of events the ring buffer holds (a power of two) */
+#define TRACE_RING_SIZE 16384
+
+/* Maximum length of the names and details of events (longer ones are cut) */
+#define TRACE_NAME_SIZE 48
+#define TRACE_DETAIL_SIZE 128
+
+/* Maximum number of nested spans the writer names the ends of */
+#define TRACE_MAX_DEPTH 64
+
+/* Value of the status of events without one */
+#define TRACE_NO_STATUS -1
+
+/* How a trace is written */
+typedef enum TraceFormat {
+    TRACE_CHROME, // Chrome trace event format (JSON array of events)
+    TRACE_JSONL,  // One JSON object per line
+} TraceFormat;
+
+/* Kinds of events */
+typedef enum TraceEventType {
+    TRACE_BEGIN,   // A span starts
+    TRACE_END,     // The last span started ends
+    TRACE_INSTANT, // Something happened
+} TraceEventType;
+
+/* An event, as stored in the ring buffer */
+typedef struct TraceEvent {
+    uint64_t       timestamp;                 // Monotonic time (ns)
+    TraceEventType type;                      // Kind of event
+    const char    *category;                  // Static string (NULL for ends)
+    char           name[TRACE_NAME_SIZE];     // What happened
+    char           detail[TRACE_DETAIL_SIZE]; // Command, directory... or ""
+    pid_t          pid;                       // Process it is about (0 if none)
+    int            status; // Exit status (TRACE_NO_STATUS if none)
+    int            job;    // Job ID (0 if none)
+} TraceEvent;
+
+/* Memory shared by the shell and the writer. Each writes its own position
+ * in the buffer, kept on separate cache lines. */
+typedef struct TraceRing {
+    _Alignas(64) atomic_size_t head; // Events recorded by the shell
+    atomic_size_t dropped;           // Events dropped as the buffer was full
+    _Alignas(64) atomic_size_t tail; // Events written to the file
+    atomic_bool stop;                // Whether the writer should stop
+    _Alignas(64) TraceEvent events[TRACE_RING_SIZE]; // The ring buffer
+} TraceRing;
+
+/* An open trace */
+typedef struct Trace {
+    TraceRing  *ring;      // Buffer shared with the writer
+    TraceFormat format;    // How events are written
+    int         fd;        // The trace file (opened for appending)
+    pid_t       owner;     // Process recording events
+    pid_t       writer;    // Process writing events to the file
+    size_t      free_tail; // Where the writer was last seen by the shell
+} Trace;
+
+/**
+ * Open a trace file and start recording events. Events are appended to the
+ * file, so that shells started by a traced shell can share it.
+ *
+ * @param trace Pointer to existing Trace or NULL to allocate new
+ * @param path Path to the trace file
+ * @param format How events are written
+ * @return Pointer to the open Trace, or NULL on failure
+ */
+Trace *open_trace(Trace *trace, const char *path, TraceFormat format);
+
+/**
+ * Open the trace asked for with TIDESH_TRACE (path of the trace file) and
+ * TIDESH_TRACE_FORMAT (chrome, the default, or jsonl)
+ *
+ * @param session The current session
+ * @return Pointer to a new open Trace, or NULL if no trace was asked for or
+ * it could not be opened
+ */
+Trace *open_requested_trace(Session *session);
+
+/**
+ * Start a span. Does nothing if trace is NULL.
+ *
+ * @param trace The trace
+ * @param category What kind of span it is (static string)
+ * @param name Name of the span
+ * @param detail More information (command, directory...), or NULL
+ */
+void trace_begin(Trace *trace, const char *category, const char *name,
+                 const char *detail);
+
+/**
+ * End the span started last. Does nothing if trace is NULL.
+ *
+ * @param trace The trace
+ */
+void trace_end(Trace *trace);
+
+/**
+ * Record an event without duration. Does nothing if trace is NULL.
+ *
+ * @param trace The trace
+ * @param category What kind of event it is (static string)
+ * @param name Name of the event
+ * @param detail More information (command, directory...), or NULL
+ */
+void trace_instant(Trace *trace, const char *category, const char *name,
+                   const char *detail);
+
+/**
+ * Record an event about a child process (fork, exit...). Does nothing if
+ * trace is NULL.
+ *
+ * @param trace The trace
+ * @param name Name of the event
+ * @param pid The child
+ * @param status Its exit status, or TRACE_NO_STATUS
+ * @param detail More information (command...), or NULL
+ */
+void trace_process(Trace *trace, const char *name, pid_t pid, int status,
+                   const char *detail);
+
+/**
+ * Record the new state of a job. Does nothing if trace is NULL.
+ *
+ * @param trace The trace
+ * @param job ID of the job
+ * @param pid Process of the job
+ * @param state Name of the new state
+ */
+void trace_job(Trace *trace, int job, pid_t pid, const char *state);
+
+/**
+ * Stop recording events, write the remaining ones and close the file
+ *
+ * @param trace The trace
+ */
+void close_trace(Trace *trace);
+
+#endif /* TRACE_H */
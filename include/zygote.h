@@ -0,0 +1,111 @@
+/** zygote.h
+ *
+ * Declarations for the zygote, a helper process that starts commands on
+ * behalf of the shell.
+ * Forking copies the page tables of the forking process, which grow with
+ * everything the shell loads (history, tries, caches...). The zygote is
+ * forked once at startup, while the shell is still small, and forks and
+ * executes commands when asked to over a Unix socket, so starting a command
+ * costs the same however large the shell has grown.
+ * The shell sends the path, arguments, environment and redirections of a
+ * command along with its working directory and standard streams (as file
+ * descriptors, with SCM_RIGHTS). The zygote replies with the pid of the
+ * command, then with its exit status and resource usage once it is done.
+ * Commands started by the zygote are its children, not the shell's, so it
+ * is only used for foreground commands, which the shell waits for right
+ * away.
+ */
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <stdbool.h>      /* bool */
+#include <stddef.h>       /* size_t */
+#include <sys/resource.h> /* struct rusage */
+#include <sys/types.h>    /* pid_t */
+
+#include "session.h" /* Session */
+
+/* Maximum number of redirections of a command started by the zygote */
+#define ZYGOTE_MAX_REDIRECTS 16
+
+/* A redirection, applied by the command before it is executed */
+typedef struct ZygoteRedirect {
+    int         fd;     // Descriptor being redirected
+    int         flags;  // Flags the target is opened with
+    bool        err;    // Whether standard error is redirected too
+    const char *target; // Path of the target (expanded)
+} ZygoteRedirect;
+
+/* A command to start */
+typedef struct ZygoteCommand {
+    const char           *path;      // Path of the executable
+    char *const          *argv;      // Arguments (NULL terminated)
+    char *const          *envp;      // Environment (NULL terminated)
+    const ZygoteRedirect *redirects; // Redirections, in order
+    size_t                redirect_count; // Number of redirections
+} ZygoteCommand;
+
+/* A running zygote */
+typedef struct Zygote {
+    int   socket; // Connection to the zygote (-1 once it is gone)
+    pid_t pid;    // The zygote
+    pid_t owner;  // Process that started it, the only one that may use it
+} Zygote;
+
+/**
+ * Start a zygote
+ *
+ * @param zygote Pointer to existing Zygote or NULL to allocate new
+ * @return Pointer to the started Zygote, or NULL on failure
+ */
+Zygote *start_zygote(Zygote *zygote);
+
+/**
+ * Start a zygote if asked for with TIDESH_ZYGOTE (any value but empty or 0)
+ *
+ * @param session The current session
+ * @return Pointer to a new started Zygote, or NULL if none was asked for or
+ * it could not be started
+ */
+Zygote *start_requested_zygote(Session *session);
+
+/**
+ * Whether commands can be started with a zygote by the current process
+ *
+ * @param zygote The zygote, or NULL
+ * @return true if the zygote is running and belongs to this process
+ */
+bool zygote_usable(Zygote *zygote);
+
+/**
+ * Start a command with the zygote. The command gets the working directory
+ * and standard streams of the calling process.
+ *
+ * @param zygote The zygote
+ * @param command The command to start
+ * @return The pid of the command, or -1 if the zygote could not start it
+ * (the zygote is then stopped, and the command should be forked)
+ */
+pid_t zygote_spawn(Zygote *zygote, const ZygoteCommand *command);
+
+/**
+ * Wait for a command started with the zygote to finish
+ *
+ * @param zygote The zygote
+ * @param pid The command
+ * @param status Where to store its status (as waitpid does)
+ * @param usage Where to store its resource usage, or NULL
+ * @return true on success, false if the zygote is gone
+ */
+bool zygote_wait(Zygote *zygote, pid_t pid, int *status,
+                 struct rusage *usage);
+
+/**
+ * Stop a zygote
+ *
+ * @param zygote The zygote
+ */
+void stop_zygote(Zygote *zygote);
+
+#endif /* ZYGOTE_H */
@@ -3,10 +3,8 @@
 #include <string.h> /* strlen, strdup, snprintf */
 
 #include "ast.h" /* ASTNode, NodeType, Redirection, free_ast, free_redirects, parse */
-#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_extend, dynamic_append, dynamic_to_string, free_dynamic */
-#include "expand.h"       /* full_expansion */
 #include "expansions/aliases.h" /* alias_expansion */
-#include "lexer.h" /* LexerInput, LexerToken, lexer_next_token, free_lexer_token, TOKEN_* */
+#include "lexer.h" /* LexerInput, LexerToken, lexer_next_token, lexer_token_value, lexer_token_copy, free_lexer_token, TOKEN_* */
 #include "session.h" /* Session */
 
 /* Create a new AST node of given type */
@@ -212,7 +210,14 @@ static ASTNode *parse_sequence(Parser *parser, Session *session) {
 #ifndef TIDESH_DISABLE_JOB_CONTROL
         if (token->type == TOKEN_BACKGROUND) {
             parser_skip(parser);
-            left->background = true;
+            // `&` applies to the last command of the sequence parsed so far
+            ASTNode *last = left;
+#ifndef TIDESH_DISABLE_SEQUENCES
+            while (last->type == NODE_SEQUENCE && last->right) {
+                last = last->right;
+            }
+#endif
+            last->background = true;
             token            = parser_peek(parser);
             if (token->type == TOKEN_EOF || token->type == TOKEN_EOL ||
 #ifndef TIDESH_DISABLE_SEQUENCES
@@ -375,8 +380,10 @@ static ASTNode *parse_conditional(Parser *parser, Session *session) {
         branch->next              = NULL;
 
         if (!first_branch) {
-            first_branch   = branch;
-            current_branch = branch;
+            // Attached now, so that an error in a later branch frees it
+            first_branch          = branch;
+            current_branch        = branch;
+            conditional->branches = branch;
         } else {
             current_branch->next = branch;
             current_branch       = branch;
@@ -537,18 +544,25 @@ static ASTNode *parse_pipeline(Parser *parser, Session *session) {
     return left;
 }
 
-/* Add an argument to a command node */
-static void add_argument(ASTNode *node, char *arg, int sub_type) {
+/* Add an argument to a command node, taking ownership of it */
+static void push_argument(ASTNode *node, char *arg, int sub_type) {
     if (!arg)
         return;
     node->argc++;
     node->argv       = realloc(node->argv, (node->argc + 1) * sizeof(char *));
     node->arg_is_sub = realloc(node->arg_is_sub, node->argc * sizeof(int));
-    node->argv[node->argc - 1]       = strdup(arg);
+    node->argv[node->argc - 1]       = arg;
     node->arg_is_sub[node->argc - 1] = sub_type;
     node->argv[node->argc]           = NULL;
 }
 
+/* Add a copy of an argument to a command node */
+static void add_argument(ASTNode *node, char *arg, int sub_type) {
+    if (!arg)
+        return;
+    push_argument(node, strdup(arg), sub_type);
+}
+
 /* Parse a single command (with possible redirections and assignments) */
 static ASTNode *parse_command(Parser *parser, Session *session) {
     LexerToken *peek = parser_peek(parser);
@@ -580,7 +594,7 @@ static ASTNode *parse_command(Parser *parser, Session *session) {
         int fd = -1;
         if (token->type == TOKEN_IO_NUMBER) {
             LexerToken io_token = parser_next(parser);
-            fd                  = atoi(io_token.value);
+            fd                  = atoi(lexer_token_value(&io_token));
             free_lexer_token(&io_token);
             token = parser_peek(parser);
         }
@@ -609,26 +623,8 @@ static ASTNode *parse_command(Parser *parser, Session *session) {
                 token->type == TOKEN_HERESTRING ||
                 token->type == TOKEN_PROCESS_SUBSTITUTION_IN ||
                 token->type == TOKEN_PROCESS_SUBSTITUTION_OUT) {
-                if (token->type == TOKEN_HERESTRING) {
-                    Array *expansion = full_expansion(token->value, session);
-                    if (expansion) {
-                        Dynamic joined = {0};
-                        init_dynamic(&joined);
-                        for (size_t i = 0; i < expansion->count; i++) {
-                            dynamic_extend(&joined, expansion->items[i]);
-                            if (i < expansion->count - 1)
-                                dynamic_append(&joined, ' ');
-                        }
-                        redirect->target = dynamic_to_string(&joined);
-                        free_dynamic(&joined);
-                        free_array(expansion);
-                        free(expansion);
-                    } else {
-                        redirect->target = strdup(token->value);
-                    }
-                } else {
-                    redirect->target = strdup(token->value);
-                }
+                // Targets are expanded when the redirection is applied
+                redirect->target = strdup(token->value);
 
                 if (token->type == TOKEN_PROCESS_SUBSTITUTION_IN ||
                     token->type == TOKEN_PROCESS_SUBSTITUTION_OUT) {
@@ -640,14 +636,7 @@ static ASTNode *parse_command(Parser *parser, Session *session) {
                 parser_skip(parser);
                 LexerToken target = parser_next(parser);
                 if (target.type == TOKEN_WORD) {
-                    Array *expansion = full_expansion(target.value, session);
-                    if (expansion && expansion->count > 0) {
-                        redirect->target = strdup(expansion->items[0]);
-                        free_array(expansion);
-                        free(expansion);
-                    } else {
-                        redirect->target = strdup(target.value);
-                    }
+                    redirect->target = lexer_token_copy(&target);
                 } else if (target.type == TOKEN_PROCESS_SUBSTITUTION_IN ||
                            target.type == TOKEN_PROCESS_SUBSTITUTION_OUT) {
                     redirect->target                  = strdup(target.value);
@@ -704,14 +693,16 @@ static ASTNode *parse_command(Parser *parser, Session *session) {
                 continue;
             } else if (first_word) {
 #ifndef TIDESH_DISABLE_ALIASES
-                parts = alias_expansion(word.value, session);
+                parts = alias_expansion(lexer_token_value(&word), session);
 #else
                 parts = init_array(NULL);
-                array_add(parts, word.value);
+                array_add(parts, lexer_token_value(&word));
 #endif
             } else {
-                parts = init_array(NULL);
-                array_add(parts, word.value);
+                // Plain words are copied straight out of the input
+                push_argument(cmd, lexer_token_copy(&word), 0);
+                free_lexer_token(&word);
+                continue;
             }
 
             for (size_t i = 0; i < parts->count; i++) {
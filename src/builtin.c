@@ -1,9 +1,9 @@
 #include <stdbool.h> /* bool, true, false */
 #include <stdio.h>   /* NULL */
 #include <stdlib.h>  /* NULL */
-#include <string.h>  /* strcmp */
+#include <string.h>  /* strcmp, strlen */
 
-#include "builtin.h" /* get_builtin, is_builtin, is_special_builtin, builtins */
+#include "builtin.h" /* Builtin, find_builtin, get_builtin, is_builtin, builtins */
 #ifndef TIDESH_DISABLE_ALIASES
 #include "builtins/alias.h"   /* builtin_alias */
 #include "builtins/unalias.h" /* builtin_unalias */
@@ -21,6 +21,7 @@
 #include "builtins/source.h"   /* builtin_source */
 #include "builtins/terminal.h" /* builtin_terminal */
 #include "builtins/test.h"     /* builtin_test */
+#include "builtins/time.h"     /* builtin_time */
 #include "builtins/type.h"     /* builtin_type */
 #include "builtins/which.h"    /* builtin_which */
 
@@ -37,13 +38,16 @@
 #ifndef TIDESH_DISABLE_JOB_CONTROL
 #include "builtins/bg.h"   /* builtin_bg */
 #include "builtins/fg.h"   /* builtin_fg */
-#include "builtins/jobs.h" /* builtin_jobs */
+#include "builtins/jobs.h"     /* builtin_jobs */
+#include "builtins/parallel.h" /* builtin_parallel */
+#include "builtins/wait.h"     /* builtin_wait */
 #endif
 #include "session.h" /* Session */
 
 const char *builtins[] = {"exit",    "pwd",     "clear", "help",     "printenv",
                           "which",   "export",  "eval",  "terminal", "info",
                           "source",  "type",    "test",  "hooks",    "features",
+                          "time",
 #ifndef TIDESH_DISABLE_ALIASES
                           "alias",   "unalias",
 #endif
@@ -54,105 +58,100 @@ const char *builtins[] = {"exit",    "pwd",     "clear", "help",     "printenv",
                           "cd",      "pushd",   "popd",
 #endif
 #ifndef TIDESH_DISABLE_JOB_CONTROL
-                          "jobs",    "fg",      "bg",
+                          "jobs",    "fg",      "bg",       "parallel", "wait",
 #endif
                           NULL};
 
-int (*get_builtin(const char *name))(int argc, char **argv, Session *session) {
-    if (strcmp(name, "exit") == 0)
-        return builtin_exit;
-    if (strcmp(name, "pwd") == 0)
-        return builtin_pwd;
-    if (strcmp(name, "clear") == 0)
-        return builtin_clear;
-#ifndef TIDESH_DISABLE_HISTORY
-    if (strcmp(name, "history") == 0)
-        return builtin_history;
-#endif
-    if (strcmp(name, "help") == 0)
-        return builtin_help;
-    if (strcmp(name, "features") == 0)
-        return builtin_features;
-    if (strcmp(name, "hooks") == 0)
-        return builtin_hooks;
-    if (strcmp(name, "printenv") == 0)
-        return builtin_printenv;
-    if (strcmp(name, "which") == 0)
-        return builtin_which;
-    if (strcmp(name, "export") == 0)
-        return builtin_export;
-#ifndef TIDESH_DISABLE_ALIASES
-    if (strcmp(name, "alias") == 0)
-        return builtin_alias;
-    if (strcmp(name, "unalias") == 0)
-        return builtin_unalias;
-#endif
-    if (strcmp(name, "eval") == 0)
-        return builtin_eval;
-    if (strcmp(name, "terminal") == 0)
-        return builtin_terminal;
-    if (strcmp(name, "info") == 0)
-        return builtin_info;
+/* Number of slots of the builtin table (a power of two) */
+#define BUILTIN_TABLE_SIZE 64
+
+/**
+ * Hash a command name into the builtin table.
+ * The coefficients were chosen so that every builtin name gets its own slot,
+ * which makes a lookup a single probe followed by one string comparison.
+ * Builtins removed by TIDESH_DISABLE_* flags simply leave their slot empty.
+ */
+static inline size_t builtin_hash(const char *name, size_t length) {
+    unsigned char first  = (unsigned char)name[0];
+    unsigned char second = length > 1 ? (unsigned char)name[1] : 0;
+    return (first * 8 + second * 5 + length * 42) & (BUILTIN_TABLE_SIZE - 1);
+}
+
+/* Builtins, stored at the slot of their name */
+static const Builtin builtin_table[BUILTIN_TABLE_SIZE] = {
+    [1] = {"test", builtin_test, 0},
+    [2] = {"[", builtin_test, 0},
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+    [5] = {"wait", builtin_wait, BUILTIN_SPECIAL},
+#endif
+    [6] = {"clear", builtin_clear, 0},
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+    [7] = {"fg", builtin_fg, BUILTIN_SPECIAL},
+#endif
+    [10] = {"printenv", builtin_printenv, 0},
+    [17] = {"pwd", builtin_pwd, 0},
+    [18] = {"which", builtin_which, 0},
 #ifndef TIDESH_DISABLE_DIRSTACK
-    if (strcmp(name, "cd") == 0)
-        return builtin_cd;
-    if (strcmp(name, "pushd") == 0)
-        return builtin_pushd;
-    if (strcmp(name, "popd") == 0)
-        return builtin_popd;
-#endif
-    if (strcmp(name, "source") == 0)
-        return builtin_source;
-    if (strcmp(name, ".") == 0)
-        return builtin_source;
-    if (strcmp(name, "type") == 0)
-        return builtin_type;
-    if (strcmp(name, "test") == 0)
-        return builtin_test;
-    if (strcmp(name, "[") == 0)
-        return builtin_test;
+    [19] = {"popd", builtin_popd, BUILTIN_SPECIAL},
+#endif
+    [21] = {"time", builtin_time, BUILTIN_SPECIAL},
+    [22] = {"info", builtin_info, BUILTIN_SPECIAL},
+    [26] = {".", builtin_source, BUILTIN_SPECIAL},
+#ifndef TIDESH_DISABLE_DIRSTACK
+    [27] = {"pushd", builtin_pushd, BUILTIN_SPECIAL},
+#endif
+    [30] = {"eval", builtin_eval, BUILTIN_SPECIAL},
+#ifndef TIDESH_DISABLE_DIRSTACK
+    [32] = {"cd", builtin_cd, BUILTIN_SPECIAL},
+#endif
+    [33] = {"help", builtin_help, 0},
 #ifndef TIDESH_DISABLE_JOB_CONTROL
-    if (strcmp(name, "jobs") == 0)
-        return builtin_jobs;
-    if (strcmp(name, "fg") == 0)
-        return builtin_fg;
-    if (strcmp(name, "bg") == 0)
-        return builtin_bg;
+    [35] = {"jobs", builtin_jobs, BUILTIN_SPECIAL},
 #endif
-    return NULL;
-}
-
-bool is_builtin(const char *name) { return get_builtin(name) != NULL; }
-
-bool is_special_builtin(const char *name) {
-    if (strcmp(name, "exit") == 0 || strcmp(name, "export") == 0 ||
-        strcmp(name, "info") == 0 || strcmp(name, "eval") == 0 ||
-        strcmp(name, "terminal") == 0 || strcmp(name, "source") == 0 ||
-        strcmp(name, ".") == 0 || strcmp(name, "type") == 0 ||
-        strcmp(name, "hooks") == 0 || strcmp(name, "features") == 0) {
-        return true;
-    }
-#ifndef TIDESH_DISABLE_ALIASES
-    if (strcmp(name, "alias") == 0 || strcmp(name, "unalias") == 0) {
-        return true;
-    }
+    [37] = {"type", builtin_type, BUILTIN_SPECIAL},
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+    [39] = {"bg", builtin_bg, BUILTIN_SPECIAL},
 #endif
+    [40] = {"exit", builtin_exit, BUILTIN_SPECIAL},
+    [41] = {"terminal", builtin_terminal, BUILTIN_SPECIAL},
 #ifndef TIDESH_DISABLE_HISTORY
-    if (strcmp(name, "history") == 0) {
-        return true;
-    }
+    [51] = {"history", builtin_history, BUILTIN_SPECIAL},
 #endif
-#ifndef TIDESH_DISABLE_DIRSTACK
-    if (strcmp(name, "cd") == 0 || strcmp(name, "pushd") == 0 ||
-        strcmp(name, "popd") == 0) {
-        return true;
-    }
+#ifndef TIDESH_DISABLE_ALIASES
+    [52] = {"unalias", builtin_unalias, BUILTIN_SPECIAL},
 #endif
 #ifndef TIDESH_DISABLE_JOB_CONTROL
-    if (strcmp(name, "jobs") == 0 || strcmp(name, "fg") == 0 ||
-        strcmp(name, "bg") == 0) {
-        return true;
-    }
+    [53] = {"parallel", builtin_parallel, BUILTIN_SPECIAL},
 #endif
-    return false;
+#ifndef TIDESH_DISABLE_ALIASES
+    [54] = {"alias", builtin_alias, BUILTIN_SPECIAL},
+#endif
+    [57] = {"features", builtin_features, BUILTIN_SPECIAL},
+    [60] = {"export", builtin_export, BUILTIN_SPECIAL},
+    [61] = {"hooks", builtin_hooks, BUILTIN_SPECIAL},
+    [63] = {"source", builtin_source, BUILTIN_SPECIAL},
+};
+
+const Builtin *find_builtin(const char *name) {
+    if (!name || !name[0]) {
+        return NULL;
+    }
+    size_t         length  = strlen(name);
+    const Builtin *builtin = &builtin_table[builtin_hash(name, length)];
+    if (builtin->name && strcmp(builtin->name, name) == 0) {
+        return builtin;
+    }
+    return NULL;
+}
+
+int (*get_builtin(const char *name))(int argc, char **argv, Session *session) {
+    const Builtin *builtin = find_builtin(name);
+    return builtin ? builtin->function : NULL;
+}
+
+bool is_builtin(const char *name) { return find_builtin(name) != NULL; }
+
+bool is_special_builtin(const char *name) {
+    const Builtin *builtin = find_builtin(name);
+    return builtin && (builtin->flags & BUILTIN_SPECIAL);
 }
@@ -1,12 +1,15 @@
 #include <stdlib.h> /* exit, atoi */
 
 #include "builtins/exit.h"
-#include "session.h" /* Session */
+#include "session.h" /* Session, free_session */
 
 int builtin_exit(int argc, char **argv, Session *session) {
     int exit_code = 0;
     if (argc > 1) {
         exit_code = atoi(argv[1]);
     }
+    // Nothing runs in the session anymore: release it, as the embedders
+    // (like a server) that own it never get back control
+    free_session(session);
     exit(exit_code);
-}
\ No newline at end of file
+}
@@ -29,9 +29,12 @@ int builtin_help(int argc, char **argv, Session *session) {
     bool source   = false;
     bool type     = false;
     bool test     = false;
+    bool time     = false;
     bool jobs     = false;
     bool fg       = false;
     bool bg       = false;
+    bool parallel = false;
+    bool wait     = false;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "cd") == 0)
@@ -80,6 +83,8 @@ int builtin_help(int argc, char **argv, Session *session) {
             type = true;
         else if (strcmp(argv[i], "test") == 0 || strcmp(argv[i], "[") == 0)
             test = true;
+        else if (strcmp(argv[i], "time") == 0)
+            time = true;
 #ifndef TIDESH_DISABLE_JOB_CONTROL
         else if (strcmp(argv[i], "jobs") == 0)
             jobs = true;
@@ -87,13 +92,17 @@ int builtin_help(int argc, char **argv, Session *session) {
             fg = true;
         else if (strcmp(argv[i], "bg") == 0)
             bg = true;
+        else if (strcmp(argv[i], "parallel") == 0)
+            parallel = true;
+        else if (strcmp(argv[i], "wait") == 0)
+            wait = true;
 #endif
     }
 
     bool all = !(cd || clear || exit || export || eval || alias || unalias ||
                  help || features || hooks || history || info || printenv ||
                  pwd || pushd || popd || terminal || which || source || type ||
-                 test || jobs || fg || bg);
+                 test || time || jobs || fg || bg || parallel || wait);
 
     bool use_colors = (session && session->terminal)
                           ? session->terminal->supports_colors
@@ -173,7 +182,12 @@ int builtin_help(int argc, char **argv, Session *session) {
 
     if (all || info)
         printf("  %s%-9s %s%-14s%s - Show shell and build information\n",
-               command_clr, "info", argument_clr, "", reset);
+               command_clr, "info", argument_clr, "[subcommand]", reset);
+
+    if (all || info)
+        printf("                             %sSubcommands: stats "
+               "%s[--json]%s\n",
+               subcommand_clr, argument_clr, reset);
 
     if (all || printenv)
         printf("  %s%-9s %s%-14s%s - Print environment variables\n",
@@ -227,6 +241,15 @@ int builtin_help(int argc, char **argv, Session *session) {
         printf("  %s%-9s %s%-14s%s - Evaluate conditional expressions\n",
                command_clr, "[", argument_clr, "expr ]", reset);
 
+    if (all || time)
+        printf("  %s%-9s %s%-14s%s - Report the time a command takes\n",
+               command_clr, "time", argument_clr, "[-v] cmd", reset);
+
+    if (all || time)
+        printf("                             %sOptions: -v (time of each "
+               "phase)%s\n",
+               subcommand_clr, reset);
+
 #ifndef TIDESH_DISABLE_JOB_CONTROL
     if (all || jobs)
         printf("  %s%-9s %s%-14s%s - List background jobs\n", command_clr,
@@ -239,6 +262,25 @@ int builtin_help(int argc, char **argv, Session *session) {
     if (all || bg)
         printf("  %s%-9s %s%-14s%s - Continue a stopped job in background\n",
                command_clr, "bg", argument_clr, "[job_id?]", reset);
+
+    if (all || parallel)
+        printf("  %s%-9s %s%-14s%s - Run a command for each item, N at a "
+               "time\n",
+               command_clr, "parallel", argument_clr, "[cmd] ::: items", reset);
+
+    if (all || parallel)
+        printf("                             %sOptions: -j N, -k (keep order), "
+               "-u (ungroup), -s (summary)%s\n",
+               subcommand_clr, reset);
+
+    if (all || wait)
+        printf("  %s%-9s %s%-14s%s - Wait for background jobs to finish\n",
+               command_clr, "wait", argument_clr, "[-n] [id...]", reset);
+
+    if (all || wait)
+        printf("                             %sOptions: -n (first to finish), "
+               "--timeout SECONDS%s\n",
+               subcommand_clr, reset);
 #endif
 
     return 0;
@@ -3,7 +3,7 @@
 #include <string.h> /* strcmp */
 
 #include "builtins/history.h"
-#include "history.h" /* History, HistoryEntry, history_clear, history_enforce_limit, history_save */
+#include "history.h" /* History, HistoryEntry, history_clear, history_enforce_limit, history_ensure_loaded, history_save */
 #include "session.h" /* Session */
 
 #ifndef TIDESH_DISABLE_HISTORY
@@ -13,6 +13,7 @@ int builtin_history(int argc, char **argv, Session *session) {
         fprintf(stderr, "tidesh: history not enabled\n");
         return 127;
     }
+    history_ensure_loaded(session->history);
     if (argc > 1) {
         if (strcmp(argv[1], "disable") == 0) {
             session->history->disabled = true;
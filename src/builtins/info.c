@@ -1,16 +1,133 @@
-#include <stdbool.h> /* bool */
-#include <stdio.h>   /* printf */
-#include <unistd.h>  /* getpid, getppid */
+#include <stdbool.h>      /* bool */
+#include <stdio.h>        /* printf, fprintf */
+#include <string.h>       /* strcmp, strlen */
+#include <sys/resource.h> /* getrusage, RUSAGE_SELF */
+#include <unistd.h>       /* getpid, getppid */
 
 #include "builtins/info.h"
+#include "data/trie.h"   /* TrieStats, trie_stats */
 #include "environ.h"     /* environ_get_default */
 #include "prompt/ansi.h" /* ANSI color constants */
 #include "session.h"     /* Session */
 
-int builtin_info(int argc, char **argv, Session *session) {
-    (void)argc;
-    (void)argv;
+#ifndef TIDESH_DISABLE_HISTORY
+#include "history.h" /* history_ensure_loaded */
+#endif
+
+/* Sizes measured when the statistics are reported */
+typedef struct Measures {
+    size_t    history_entries; // Entries in the history
+    size_t    history_bytes;   // Length of their commands
+    TrieStats aliases;         // Size of the aliases
+    TrieStats path_commands;   // Size of the commands found in PATH
+    size_t    dircache_hits;   // Directory listings found in the cache
+    size_t    dircache_misses; // Directory listings read
+    long      max_rss;         // Peak resident set size (KB)
+} Measures;
+
+static Measures measure(Session *session) {
+    Measures measures = {0};
+#ifndef TIDESH_DISABLE_HISTORY
+    if (session->history) {
+        history_ensure_loaded(session->history);
+        HistoryEntry *entry = session->history->head;
+        for (; entry; entry = entry->next) {
+            measures.history_entries++;
+            measures.history_bytes += strlen(entry->command) + 1;
+        }
+    }
+#endif
+#ifndef TIDESH_DISABLE_ALIASES
+    measures.aliases = trie_stats(session->aliases);
+#endif
+    measures.path_commands = trie_stats(session->path_commands);
+    if (session->dircache) {
+        measures.dircache_hits   = session->dircache->hits;
+        measures.dircache_misses = session->dircache->misses;
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        measures.max_rss = usage.ru_maxrss;
+    }
+    return measures;
+}
+
+/* Share of a total, in percent */
+static double percent(size_t part, size_t total) {
+    return total ? 100.0 * (double)part / (double)total : 0.0;
+}
 
+static void print_stats(Session *session, const char *l_clr,
+                        const char *reset) {
+    const Stats *stats    = &session->stats;
+    Measures     measures = measure(session);
+    size_t       lookups  = measures.dircache_hits + measures.dircache_misses;
+
+    printf("%sCommands:      %s %zu (%zu forks, %zu in-process builtins)\n",
+           l_clr, reset, stats->commands, stats->forks, stats->builtins);
+    if (stats->zygote_spawns > 0) {
+        printf("%sZygote:        %s %zu commands started\n", l_clr, reset,
+               stats->zygote_spawns);
+    }
+    printf("%sPATH Lookups:  %s %zu (%zu not found)\n", l_clr, reset,
+           stats->path_lookups, stats->path_misses);
+    printf("%sDir Cache:     %s %zu hits, %zu misses (%.1f%% hit rate)\n",
+           l_clr, reset, measures.dircache_hits, measures.dircache_misses,
+           percent(measures.dircache_hits, lookups));
+    printf("%sExpanded Words:%s %zu\n", l_clr, reset, stats->words);
+    printf("%sGlobs:         %s %zu (%zu matches)\n", l_clr, reset,
+           stats->globs, stats->glob_matches);
+#ifndef TIDESH_DISABLE_HISTORY
+    printf("%sHistory:       %s %zu entries, %zu bytes\n", l_clr, reset,
+           measures.history_entries, measures.history_bytes);
+#endif
+#ifndef TIDESH_DISABLE_ALIASES
+    printf("%sAliases:       %s %zu keys, %zu nodes, %zu bytes\n", l_clr,
+           reset, measures.aliases.keys, measures.aliases.nodes,
+           measures.aliases.bytes);
+#endif
+    printf("%sPATH Commands: %s %zu keys, %zu nodes, %zu bytes\n", l_clr,
+           reset, measures.path_commands.keys, measures.path_commands.nodes,
+           measures.path_commands.bytes);
+    printf("%sHooks:         %s %zu lookups, %zu run, %.3f ms\n", l_clr,
+           reset, stats->hook_lookups, stats->hook_runs,
+           (double)stats->hook_time / 1e6);
+    printf("%sPeak RSS:      %s %ld KB\n", l_clr, reset, measures.max_rss);
+}
+
+static void print_trie_json(const char *name, TrieStats stats) {
+    printf(",\"%s\":{\"keys\":%zu,\"nodes\":%zu,\"bytes\":%zu}", name,
+           stats.keys, stats.nodes, stats.bytes);
+}
+
+static void print_stats_json(Session *session) {
+    const Stats *stats    = &session->stats;
+    Measures     measures = measure(session);
+
+    printf("{\"commands\":%zu,\"forks\":%zu,\"zygote_spawns\":%zu",
+           stats->commands, stats->forks, stats->zygote_spawns);
+    printf(",\"builtins\":%zu", stats->builtins);
+    printf(",\"path_lookups\":%zu,\"path_misses\":%zu", stats->path_lookups,
+           stats->path_misses);
+    printf(",\"dircache_hits\":%zu,\"dircache_misses\":%zu",
+           measures.dircache_hits, measures.dircache_misses);
+    printf(",\"words\":%zu,\"globs\":%zu,\"glob_matches\":%zu",
+           stats->words, stats->globs, stats->glob_matches);
+#ifndef TIDESH_DISABLE_HISTORY
+    printf(",\"history_entries\":%zu,\"history_bytes\":%zu",
+           measures.history_entries, measures.history_bytes);
+#endif
+#ifndef TIDESH_DISABLE_ALIASES
+    print_trie_json("aliases", measures.aliases);
+#endif
+    print_trie_json("path_commands", measures.path_commands);
+    printf(",\"hook_lookups\":%zu,\"hook_runs\":%zu,\"hook_time_ns\":%llu",
+           stats->hook_lookups, stats->hook_runs,
+           (unsigned long long)stats->hook_time);
+    printf(",\"max_rss_kb\":%ld}\n", measures.max_rss);
+}
+
+int builtin_info(int argc, char **argv, Session *session) {
     bool use_colors = (session && session->terminal)
                           ? session->terminal->supports_colors
                           : false;
@@ -18,6 +135,20 @@ int builtin_info(int argc, char **argv, Session *session) {
     const char *l_clr = use_colors ? ANSI_BOLD : "";
     const char *reset = use_colors ? ANSI_COLOR_RESET : "";
 
+    if (argc > 1) {
+        if (strcmp(argv[1], "stats") != 0 ||
+            (argc > 2 && strcmp(argv[2], "--json") != 0) || argc > 3) {
+            fprintf(stderr, "Usage: info [stats [--json]]\n");
+            return 1;
+        }
+        if (argc > 2) {
+            print_stats_json(session);
+        } else {
+            print_stats(session, l_clr, reset);
+        }
+        return 0;
+    }
+
     /* Build Information */
 #ifdef PROJECT_NAME
     printf("%sName:        %s %s\n", l_clr, reset, PROJECT_NAME);
@@ -0,0 +1,550 @@
+#include <errno.h>    /* errno, EINTR, EAGAIN */
+#include <fcntl.h>    /* open, fcntl, O_RDONLY, F_SETFD, FD_CLOEXEC */
+#include <poll.h>     /* poll, struct pollfd, POLLIN */
+#include <signal.h>   /* signal, kill, SIGINT, SIGQUIT, SIGTERM, SIG_DFL */
+#include <stdbool.h>  /* bool, true, false */
+#include <stdio.h>    /* fprintf, fwrite, fflush, stderr, stdout, stdin */
+#include <stdlib.h>   /* malloc, calloc, free, strtol */
+#include <string.h>   /* strcmp, strncmp, strstr, strdup, strerror */
+#include <sys/wait.h> /* waitpid, WIFEXITED, WEXITSTATUS, WIFSIGNALED */
+#include <time.h>     /* clock_gettime, CLOCK_MONOTONIC, struct timespec */
+#include <unistd.h>   /* fork, pipe, read, close, dup2, sysconf, _exit */
+
+#include "builtins/parallel.h"
+#include "data/array.h"   /* Array, init_array, array_add, free_array */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, dynamic_extend_length, free_dynamic, dynamic_to_string */
+#include "data/files.h"   /* read_all */
+#include "execute.h"      /* execute_string */
+#include "jobs.h"         /* jobs_add, jobs_get, jobs_apply_status, jobs_remove */
+#include "session.h"      /* Session */
+
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+
+/* Exit statuses are capped so that they never collide with signal statuses */
+#define PARALLEL_MAX_FAILURES 101
+
+/* Status used when the builtin itself fails */
+#define PARALLEL_ERROR 255
+
+/* Options controlling how jobs are scheduled and how their output is shown */
+typedef struct ParallelOptions {
+    long max_jobs;   // Maximum number of jobs in flight
+    bool keep_order; // Print outputs in input order
+    bool ungroup;    // Let jobs write directly to the terminal
+    bool summary;    // Report statuses and timings at the end
+} ParallelOptions;
+
+/* A single unit of work scheduled by `parallel` */
+typedef struct ParallelTask {
+    char           *command;     // Command line to run
+    pid_t           pid;         // Process ID once started
+    int             job_id;      // Job ID in the session's jobs table
+    int             fds[2];      // stdout/stderr pipes, or a control pipe
+    Dynamic         output[2];   // Buffered stdout/stderr
+    struct timespec start;       // Start time
+    double          elapsed;     // Wall time in seconds
+    int             exit_status; // Exit status once done
+    bool            done;        // Whether the task finished
+} ParallelTask;
+
+/* Seconds elapsed since `start` */
+static double elapsed_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Quote a word so that it reaches the command as a single word.
+ * Double quotes are used, as the lexer expands variables even in single
+ * quotes and ends them at the first matching quote, escaped or not. */
+static char *quote_word(const char *item) {
+    Dynamic quoted = {0};
+    init_dynamic(&quoted);
+    dynamic_append(&quoted, '"');
+    for (const char *c = item; *c; c++) {
+        if (*c == '"' || *c == '\\' || *c == '$') {
+            dynamic_append(&quoted, '\\');
+        }
+        dynamic_append(&quoted, *c);
+    }
+    dynamic_append(&quoted, '"');
+    char *result = dynamic_to_string(&quoted);
+    free_dynamic(&quoted);
+    return result;
+}
+
+/* Build the command line for a work item from the command template.
+ * The template words were already expanded by the shell: each one is quoted
+ * (with the item in place of `{}`) so that it is read back as is. */
+static char *build_task_command(char **template, int template_count,
+                                const char *item) {
+    // Without a template, each item is a command line on its own
+    if (template_count == 0) {
+        return strdup(item);
+    }
+
+    bool    replaced = false;
+    Dynamic command  = {0};
+    init_dynamic(&command);
+
+    for (int i = 0; i < template_count; i++) {
+        if (i > 0) {
+            dynamic_append(&command, ' ');
+        }
+        Dynamic     word = {0};
+        const char *rest = template[i];
+        const char *mark;
+        init_dynamic(&word);
+        while ((mark = strstr(rest, "{}")) != NULL) {
+            dynamic_extend_length(&word, rest, (size_t)(mark - rest));
+            dynamic_extend(&word, (char *)item);
+            rest     = mark + 2;
+            replaced = true;
+        }
+        dynamic_extend(&word, (char *)rest);
+
+        char *value  = dynamic_to_string(&word);
+        char *quoted = quote_word(value);
+        dynamic_extend(&command, quoted);
+        free(quoted);
+        free(value);
+        free_dynamic(&word);
+    }
+
+    if (!replaced) {
+        char *quoted = quote_word(item);
+        dynamic_append(&command, ' ');
+        dynamic_extend(&command, quoted);
+        free(quoted);
+    }
+
+    char *result = dynamic_to_string(&command);
+    free_dynamic(&command);
+    return result;
+}
+
+/* Read work items from the standard input, one per non-empty line */
+static Array *read_items_from_stdin(void) {
+    Array *items = init_array(NULL);
+    if (!items) {
+        return NULL;
+    }
+
+    char *content = read_all(stdin);
+    if (!content) {
+        return items;
+    }
+
+    char *line = content;
+    while (*line) {
+        char *end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r') {
+            line[len - 1] = '\0';
+        }
+        if (*line) {
+            array_add(items, line);
+        }
+        if (!end) {
+            break;
+        }
+        line = end + 1;
+    }
+
+    free(content);
+    return items;
+}
+
+/* Write the buffered output of a task and release the buffers */
+static void flush_task(ParallelTask *task, const ParallelOptions *options) {
+    if (options->ungroup) {
+        return;
+    }
+    if (task->output[0].value && task->output[0].length > 0) {
+        fwrite(task->output[0].value, 1, task->output[0].length, stdout);
+        fflush(stdout);
+    }
+    if (task->output[1].value && task->output[1].length > 0) {
+        fwrite(task->output[1].value, 1, task->output[1].length, stderr);
+        fflush(stderr);
+    }
+    free_dynamic(&task->output[0]);
+    free_dynamic(&task->output[1]);
+}
+
+/* Fork a task. Returns false if it could not be started. */
+static bool spawn_task(ParallelTask *task, const ParallelOptions *options,
+                       Session *session) {
+    int out_fds[2] = {-1, -1};
+    int err_fds[2] = {-1, -1};
+
+    if (pipe(out_fds) < 0) {
+        return false;
+    }
+    if (!options->ungroup && pipe(err_fds) < 0) {
+        close(out_fds[0]);
+        close(out_fds[1]);
+        return false;
+    }
+
+    // Read ends must not leak into the commands started by other tasks
+    fcntl(out_fds[0], F_SETFD, FD_CLOEXEC);
+    if (err_fds[0] >= 0) {
+        fcntl(err_fds[0], F_SETFD, FD_CLOEXEC);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    clock_gettime(CLOCK_MONOTONIC, &task->start);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(out_fds[0]);
+        close(out_fds[1]);
+        if (err_fds[0] >= 0) {
+            close(err_fds[0]);
+            close(err_fds[1]);
+        }
+        return false;
+    }
+
+    if (pid == 0) {
+        /* Child Process */
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+
+        // Jobs must not consume the work items
+        int devnull = open("/dev/null", O_RDONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            close(devnull);
+        }
+
+        close(out_fds[0]);
+        if (options->ungroup) {
+            // The control pipe only signals completion: it is held by this
+            // process and dropped by anything it executes
+            fcntl(out_fds[1], F_SETFD, FD_CLOEXEC);
+        } else {
+            close(err_fds[0]);
+            dup2(out_fds[1], STDOUT_FILENO);
+            dup2(err_fds[1], STDERR_FILENO);
+            close(out_fds[1]);
+            close(err_fds[1]);
+        }
+
+#ifndef TIDESH_DISABLE_HISTORY
+        session->history->disabled = true;
+#endif
+        int status = execute_string(task->command, session);
+        fflush(stdout);
+        fflush(stderr);
+
+        // The shell state belongs to the parent: skip the exit handlers,
+        // which would also write the terminal cleanup sequences
+        _exit(status);
+    }
+
+    /* Parent Process */
+    close(out_fds[1]);
+    if (err_fds[1] >= 0) {
+        close(err_fds[1]);
+    }
+
+    session->stats.forks++;
+    task->pid    = pid;
+    task->fds[0] = out_fds[0];
+    task->fds[1] = err_fds[0];
+    init_dynamic(&task->output[0]);
+    init_dynamic(&task->output[1]);
+    task->job_id =
+        jobs_add(session->jobs, pid, task->command, JOB_RUNNING);
+    return true;
+}
+
+/* Reap a task whose pipes are all closed */
+static void finish_task(ParallelTask *task, Session *session) {
+    int status = 0;
+    while (waitpid(task->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    task->elapsed = elapsed_since(&task->start);
+    if (WIFSIGNALED(status)) {
+        task->exit_status = 128 + WTERMSIG(status);
+    } else {
+        task->exit_status = WEXITSTATUS(status);
+    }
+    task->done = true;
+
+    Job *job = jobs_get(session->jobs, task->job_id);
+    if (job) {
+        jobs_apply_status(session->jobs, job, status);
+        jobs_remove(session->jobs, task->job_id);
+    }
+}
+
+/* Stop the running tasks and fail the ones not started, when the outputs
+ * can no longer be waited for */
+static void abandon_tasks(ParallelTask *tasks, size_t count,
+                          const size_t *active, size_t active_count,
+                          size_t next, const ParallelOptions *options,
+                          Session *session) {
+    for (size_t i = 0; i < active_count; i++) {
+        ParallelTask *task = &tasks[active[i]];
+        for (int k = 0; k < 2; k++) {
+            if (task->fds[k] >= 0) {
+                close(task->fds[k]);
+                task->fds[k] = -1;
+            }
+        }
+        kill(task->pid, SIGTERM);
+        finish_task(task, session);
+        if (task->exit_status == 0) {
+            task->exit_status = PARALLEL_ERROR;
+        }
+    }
+    for (size_t i = next; i < count; i++) {
+        tasks[i].exit_status = PARALLEL_ERROR;
+        tasks[i].done        = true;
+    }
+    for (size_t i = 0; i < count; i++) {
+        flush_task(&tasks[i], options);
+    }
+}
+
+/* Run all tasks, keeping at most `options->max_jobs` in flight */
+static void run_tasks(ParallelTask *tasks, size_t count,
+                      const ParallelOptions *options, Session *session) {
+    size_t         max_jobs = (size_t)options->max_jobs;
+    size_t        *active   = malloc(max_jobs * sizeof(size_t));
+    struct pollfd *pfds     = malloc(max_jobs * 2 * sizeof(struct pollfd));
+    size_t        *owners   = malloc(max_jobs * 2 * sizeof(size_t));
+    if (!active || !pfds || !owners) {
+        free(active);
+        free(pfds);
+        free(owners);
+        return;
+    }
+
+    size_t active_count = 0;
+    size_t next         = 0;
+    size_t flush_next   = 0;
+    size_t finished     = 0;
+
+    while (finished < count) {
+        // Fill the free slots
+        while (active_count < max_jobs && next < count) {
+            ParallelTask *task = &tasks[next];
+            if (spawn_task(task, options, session)) {
+                active[active_count++] = next;
+            } else {
+                fprintf(stderr, "parallel: could not start job: %s\n",
+                        strerror(errno));
+                task->exit_status = 127;
+                task->done        = true;
+                finished++;
+            }
+            next++;
+        }
+
+        // Wait for output on any of the running tasks
+        nfds_t nfds = 0;
+        for (size_t i = 0; i < active_count; i++) {
+            ParallelTask *task = &tasks[active[i]];
+            for (int k = 0; k < 2; k++) {
+                if (task->fds[k] >= 0) {
+                    pfds[nfds].fd      = task->fds[k];
+                    pfds[nfds].events  = POLLIN;
+                    pfds[nfds].revents = 0;
+                    owners[nfds]       = i * 2 + k;
+                    nfds++;
+                }
+            }
+        }
+
+        if (nfds > 0 && poll(pfds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "parallel: %s\n", strerror(errno));
+            abandon_tasks(tasks, count, active, active_count, next, options,
+                          session);
+            break;
+        }
+
+        for (nfds_t p = 0; p < nfds; p++) {
+            if (!pfds[p].revents) {
+                continue;
+            }
+            ParallelTask *task = &tasks[active[owners[p] / 2]];
+            int           k    = (int)(owners[p] % 2);
+            char          buffer[4096];
+            ssize_t       n = read(task->fds[k], buffer, sizeof(buffer));
+            if (n > 0) {
+                dynamic_extend_length(&task->output[k], buffer, (size_t)n);
+            } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+                close(task->fds[k]);
+                task->fds[k] = -1;
+            }
+        }
+
+        // Reap the tasks that closed all their pipes
+        for (size_t i = 0; i < active_count;) {
+            ParallelTask *task = &tasks[active[i]];
+            if (task->fds[0] >= 0 || task->fds[1] >= 0) {
+                i++;
+                continue;
+            }
+            finish_task(task, session);
+            finished++;
+            active[i] = active[--active_count];
+            if (!options->keep_order) {
+                flush_task(task, options);
+            }
+        }
+
+        if (options->keep_order) {
+            while (flush_next < count && tasks[flush_next].done) {
+                flush_task(&tasks[flush_next++], options);
+            }
+        }
+    }
+
+    free(active);
+    free(pfds);
+    free(owners);
+}
+
+/* Parse the leading options. Returns the index of the first non-option. */
+static int parse_options(int argc, char **argv, ParallelOptions *options) {
+    int i = 1;
+    for (; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--") == 0) {
+            return i + 1;
+        } else if (strcmp(arg, "-k") == 0 ||
+                   strcmp(arg, "--keep-order") == 0) {
+            options->keep_order = true;
+        } else if (strcmp(arg, "-u") == 0 || strcmp(arg, "--ungroup") == 0) {
+            options->ungroup = true;
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--summary") == 0) {
+            options->summary = true;
+        } else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0 ||
+                   strncmp(arg, "-j", 2) == 0) {
+            const char *value = arg[1] == 'j' && arg[2] ? arg + 2 : NULL;
+            if (!value) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "parallel: %s: missing job count\n", arg);
+                    return -1;
+                }
+                value = argv[++i];
+            }
+            char *end;
+            long  max_jobs = strtol(value, &end, 10);
+            if (*end != '\0' || max_jobs < 1) {
+                fprintf(stderr, "parallel: invalid job count: %s\n", value);
+                return -1;
+            }
+            options->max_jobs = max_jobs;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+int builtin_parallel(int argc, char **argv, Session *session) {
+    if (!session->features.job_control) {
+        fprintf(stderr, "tidesh: job control not enabled\n");
+        return 127;
+    }
+    if (!session || !session->jobs) {
+        return PARALLEL_ERROR;
+    }
+
+    ParallelOptions options = {0};
+    options.max_jobs        = sysconf(_SC_NPROCESSORS_ONLN);
+    if (options.max_jobs < 1) {
+        options.max_jobs = 1;
+    }
+
+    int first = parse_options(argc, argv, &options);
+    if (first < 0) {
+        return PARALLEL_ERROR;
+    }
+
+    // Split the command template from the inline work items
+    int template_count = 0;
+    while (first + template_count < argc &&
+           strcmp(argv[first + template_count], ":::") != 0) {
+        template_count++;
+    }
+
+    Array *items = NULL;
+    if (first + template_count < argc) {
+        items = init_array(NULL);
+        for (int i = first + template_count + 1; i < argc; i++) {
+            array_add(items, argv[i]);
+        }
+    } else {
+        items = read_items_from_stdin();
+    }
+    if (!items) {
+        return PARALLEL_ERROR;
+    }
+
+    ParallelTask *tasks = calloc(items->count ? items->count : 1,
+                                 sizeof(ParallelTask));
+    if (!tasks) {
+        free_array(items);
+        free(items);
+        return PARALLEL_ERROR;
+    }
+
+    for (size_t i = 0; i < items->count; i++) {
+        tasks[i].command =
+            build_task_command(argv + first, template_count, items->items[i]);
+        tasks[i].fds[0] = -1;
+        tasks[i].fds[1] = -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_tasks(tasks, items->count, &options, session);
+    double wall = elapsed_since(&start);
+
+    size_t failed    = 0;
+    double busy_time = 0;
+    for (size_t i = 0; i < items->count; i++) {
+        if (tasks[i].exit_status != 0) {
+            failed++;
+        }
+        busy_time += tasks[i].elapsed;
+        if (options.summary) {
+            fprintf(stderr, "[%zu] exit %d\t%.3fs\t%s\n", i + 1,
+                    tasks[i].exit_status, tasks[i].elapsed, tasks[i].command);
+        }
+        free(tasks[i].command);
+        free_dynamic(&tasks[i].output[0]);
+        free_dynamic(&tasks[i].output[1]);
+    }
+
+    if (options.summary) {
+        fprintf(stderr,
+                "parallel: %zu jobs, %zu failed, %.3fs wall, %.3fs busy, "
+                "%ld max in flight\n",
+                items->count, failed, wall, busy_time, options.max_jobs);
+    }
+
+    free(tasks);
+    free_array(items);
+    free(items);
+    return failed > PARALLEL_MAX_FAILURES ? PARALLEL_MAX_FAILURES
+                                          : (int)failed;
+}
+
+#endif
@@ -1,11 +1,12 @@
-#include <stdio.h>  /* fprintf, fopen, fclose, FILE */
+#include <fcntl.h>  /* open, O_RDONLY, O_CLOEXEC */
+#include <stdio.h>  /* fprintf */
 #include <stdlib.h> /* free */
+#include <unistd.h> /* close */
 
 #include "builtins/source.h" /* builtin_source */
 #include "data/array.h"      /* Array, free_array, array_pop */
-#include "data/files.h"      /* read_all */
-#include "execute.h"         /* execute_string */
 #include "expand.h"          /* full_expansion */
+#include "script.h"          /* execute_script */
 #include "session.h"         /* Session */
 
 int builtin_source(int argc, char **argv, Session *session) {
@@ -31,38 +32,28 @@ int builtin_source(int argc, char **argv, Session *session) {
     free(expanded);
 
     // Open the file
-    FILE *f = fopen(expanded_filename, "r");
-    if (!f) {
+    int fd = open(expanded_filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         fprintf(stderr, "source: could not open file: %s\n", expanded_filename);
         free(expanded_filename);
         return 1;
     }
 
-    // Read the entire file content
-    char *content = read_all(f);
-    fclose(f);
-
-    if (!content) {
-        fprintf(stderr, "source: could not read file: %s\n", expanded_filename);
-        free(expanded_filename);
-        return 1;
-    }
-
     // Temporarily disable history for sourced commands
 #ifndef TIDESH_DISABLE_HISTORY
     bool was_disabled          = session->history->disabled;
     session->history->disabled = true;
 #endif
 
-    // Execute the content
-    int status = execute_string(content, session);
+    // Execute each command as soon as it has been read
+    int status = execute_script(fd, session);
 
     // Restore history setting
 #ifndef TIDESH_DISABLE_HISTORY
     session->history->disabled = was_disabled;
 #endif
 
-    free(content);
+    close(fd);
     free(expanded_filename);
     return status;
 }
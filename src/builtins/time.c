@@ -0,0 +1,32 @@
+#include <stdbool.h> /* bool */
+
+#include "builtins/time.h"
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, free_dynamic */
+#include "execute.h"      /* execute_string */
+#include "session.h"      /* Session */
+
+int builtin_time(int argc, char **argv, Session *session) {
+    // Like eval, run the arguments as a command line, and let the executor
+    // handle the `time` prefix
+    Dynamic command = {0};
+    init_dynamic(&command);
+    dynamic_extend(&command, "time");
+    for (int i = 1; i < argc; i++) {
+        dynamic_append(&command, ' ');
+        dynamic_extend(&command, argv[i]);
+    }
+
+    // Temporarily disable history to avoid double logging
+#ifndef TIDESH_DISABLE_HISTORY
+    bool was_disabled          = session->history->disabled;
+    session->history->disabled = true;
+#endif
+
+    int status = execute_string(command.value, session);
+
+#ifndef TIDESH_DISABLE_HISTORY
+    session->history->disabled = was_disabled;
+#endif
+    free_dynamic(&command);
+    return status;
+}
@@ -0,0 +1,367 @@
+#include <errno.h>       /* errno, EINTR, ECHILD */
+#include <poll.h>        /* poll, struct pollfd, POLLIN */
+#include <stdbool.h>     /* bool, true, false */
+#include <stdio.h>       /* fprintf, stderr */
+#include <stdlib.h>      /* calloc, free, strtol, strtod */
+#include <string.h>      /* strcmp, strncmp */
+#include <sys/syscall.h> /* SYS_pidfd_open */
+#include <sys/wait.h>    /* waitpid, WNOHANG */
+#include <time.h>        /* clock_gettime, CLOCK_MONOTONIC, struct timespec */
+#include <unistd.h>      /* syscall, close */
+
+#include "builtins/wait.h"
+#include "jobs.h"    /* Job, jobs_get, jobs_get_by_pid, jobs_get_current, jobs_get_previous, jobs_apply_status, jobs_remove */
+#include "session.h" /* Session */
+
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+
+/* Status returned when the timeout expires (same as timeout(1)) */
+#define WAIT_TIMEOUT_STATUS 124
+
+/* Polling interval used for processes that could not get a pidfd */
+#define WAIT_FALLBACK_INTERVAL_MS 10
+
+/* A process being waited for */
+typedef struct WaitTarget {
+    pid_t pid;    // Process ID
+    int   pidfd;  // pidfd for the process, or -1 if unavailable
+    bool  done;   // Whether the process has terminated
+    int   status; // Exit status once done
+} WaitTarget;
+
+/**
+ * Resolve a job specification (%N, %%, %+, %-) or a process ID to a PID.
+ *
+ * @param session The current session
+ * @param arg The operand to resolve
+ * @return The process ID, or -1 if it does not name a known job
+ */
+static pid_t resolve_operand(Session *session, const char *arg) {
+    if (arg[0] == '%') {
+        const char *spec = arg + 1;
+        Job        *job  = NULL;
+        if (*spec == '\0' || strcmp(spec, "%") == 0 ||
+            strcmp(spec, "+") == 0) {
+            job = jobs_get_current(session->jobs);
+        } else if (strcmp(spec, "-") == 0) {
+            job = jobs_get_previous(session->jobs);
+        } else {
+            char *end;
+            long  id = strtol(spec, &end, 10);
+            if (*end == '\0' && id > 0) {
+                job = jobs_get(session->jobs, (int)id);
+            }
+        }
+        return job ? job->pid : -1;
+    }
+
+    char *end;
+    long  pid = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || pid <= 0) {
+        return -1;
+    }
+    return (pid_t)pid;
+}
+
+/**
+ * Open a pidfd for a process, if the platform supports it.
+ *
+ * @param pid The process ID
+ * @return The pidfd, or -1 if unavailable
+ */
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+/**
+ * Reap a target without blocking, updating its job entry if it has one.
+ *
+ * @param session The current session
+ * @param target The target to reap
+ * @return false if the process is not a child of the shell
+ */
+static bool reap_target(Session *session, WaitTarget *target) {
+    Job *job = jobs_get_by_pid(session->jobs, target->pid);
+    if (job && (job->state == JOB_DONE || job->state == JOB_KILLED)) {
+        // Already reaped by jobs_update
+        target->done   = true;
+        target->status = job->exit_status;
+        return true;
+    }
+
+    int   status;
+    pid_t result;
+    do {
+        result = waitpid(target->pid, &status, WNOHANG);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        return false;
+    }
+    if (result == 0) {
+        return true;
+    }
+
+    if (WIFEXITED(status)) {
+        target->status = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        target->status = 128 + WTERMSIG(status);
+    } else {
+        return true;
+    }
+    target->done = true;
+    if (job) {
+        jobs_apply_status(session->jobs, job, status);
+    }
+    return true;
+}
+
+/**
+ * Milliseconds elapsed since a start time.
+ *
+ * @param start The start time
+ * @return Elapsed milliseconds
+ */
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/**
+ * Block until the targets terminate (all of them, or any one with any_mode).
+ *
+ * @param session The current session
+ * @param targets The targets to wait for
+ * @param count Number of targets
+ * @param any_mode Return as soon as one target terminates
+ * @param timeout_ms Timeout in milliseconds, negative for none
+ * @return false if the timeout expired
+ */
+static bool wait_targets(Session *session, WaitTarget *targets, int count,
+                         bool any_mode, double timeout_ms) {
+    struct pollfd  *fds    = calloc((size_t)count, sizeof(struct pollfd));
+    int            *owners = calloc((size_t)count, sizeof(int));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool satisfied = false;
+
+    for (int i = 0; i < count; i++) {
+        targets[i].pidfd = targets[i].done ? -1 : open_pidfd(targets[i].pid);
+    }
+
+    while (fds && owners) {
+        int  pending    = 0;
+        int  nfds       = 0;
+        bool unwatched  = false;
+        bool any_done   = false;
+        for (int i = 0; i < count; i++) {
+            if (targets[i].done) {
+                any_done = true;
+                continue;
+            }
+            pending++;
+            if (targets[i].pidfd >= 0) {
+                fds[nfds].fd      = targets[i].pidfd;
+                fds[nfds].events  = POLLIN;
+                fds[nfds].revents = 0;
+                owners[nfds]      = i;
+                nfds++;
+            } else {
+                unwatched = true;
+            }
+        }
+
+        if (pending == 0 || (any_mode && any_done)) {
+            satisfied = true;
+            break;
+        }
+
+        int poll_timeout = -1;
+        if (timeout_ms >= 0) {
+            double remaining = timeout_ms - elapsed_ms(&start);
+            if (remaining <= 0) {
+                break;
+            }
+            poll_timeout = (int)remaining + 1;
+        }
+        if (unwatched && (poll_timeout < 0 ||
+                          poll_timeout > WAIT_FALLBACK_INTERVAL_MS)) {
+            poll_timeout = WAIT_FALLBACK_INTERVAL_MS;
+        }
+
+        if (poll(fds, (nfds_t)nfds, poll_timeout) < 0 && errno != EINTR) {
+            break;
+        }
+
+        // A readable pidfd means its process exited: only those are reaped,
+        // with the ones without a pidfd, which have to be checked every time
+        for (int p = 0; p < nfds; p++) {
+            WaitTarget *target = &targets[owners[p]];
+            if (fds[p].revents && !reap_target(session, target)) {
+                // Reaped elsewhere: its status is lost
+                target->done   = true;
+                target->status = 127;
+            }
+        }
+        for (int i = 0; unwatched && i < count; i++) {
+            if (!targets[i].done && targets[i].pidfd < 0) {
+                reap_target(session, &targets[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (targets[i].pidfd >= 0) {
+            close(targets[i].pidfd);
+            targets[i].pidfd = -1;
+        }
+    }
+    free(fds);
+    free(owners);
+    return satisfied;
+}
+
+/**
+ * Parse a --timeout value in seconds.
+ *
+ * @param value The value to parse
+ * @param timeout_ms Output timeout in milliseconds
+ * @return true on success
+ */
+static bool parse_timeout(const char *value, double *timeout_ms) {
+    char  *end;
+    double seconds = strtod(value, &end);
+    if (*value == '\0' || *end != '\0' || seconds < 0) {
+        fprintf(stderr, "wait: invalid timeout: %s\n", value);
+        return false;
+    }
+    *timeout_ms = seconds * 1000.0;
+    return true;
+}
+
+int builtin_wait(int argc, char **argv, Session *session) {
+    if (!session->features.job_control) {
+        fprintf(stderr, "tidesh: job control not enabled\n");
+        return 127;
+    }
+    if (!session || !session->jobs) {
+        return 1;
+    }
+
+    bool   any_mode   = false;
+    double timeout_ms = -1;
+    int    i          = 1;
+    for (; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(arg, "-n") == 0) {
+            any_mode = true;
+        } else if (strcmp(arg, "--timeout") == 0 || strcmp(arg, "-t") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "wait: %s: option requires an argument\n",
+                        arg);
+                return 2;
+            }
+            if (!parse_timeout(argv[++i], &timeout_ms)) {
+                return 2;
+            }
+        } else if (strncmp(arg, "--timeout=", 10) == 0) {
+            if (!parse_timeout(arg + 10, &timeout_ms)) {
+                return 2;
+            }
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "wait: unknown option: %s\n", arg);
+            return 2;
+        } else {
+            break;
+        }
+    }
+
+    int         operands = argc - i;
+    int         capacity = operands > 0 ? operands : session->jobs->count;
+    WaitTarget *targets  = calloc(capacity > 0 ? (size_t)capacity : 1,
+                                  sizeof(WaitTarget));
+    if (!targets) {
+        return 1;
+    }
+
+    int count  = 0;
+    int result = 0;
+    if (operands > 0) {
+        for (; i < argc; i++) {
+            pid_t pid = resolve_operand(session, argv[i]);
+            if (pid < 0) {
+                fprintf(stderr, "wait: no such job: %s\n", argv[i]);
+                result = 127;
+                continue;
+            }
+            targets[count].pid   = pid;
+            targets[count].pidfd = -1;
+            if (!reap_target(session, &targets[count])) {
+                fprintf(stderr, "wait: pid %d is not a child of this shell\n",
+                        (int)pid);
+                result = 127;
+                continue;
+            }
+            count++;
+        }
+    } else {
+        // Stopped jobs never terminate on their own, so they are skipped
+        for (int j = 0; j < session->jobs->count; j++) {
+            Job *job = &session->jobs->jobs[j];
+            if (job->state == JOB_STOPPED) {
+                continue;
+            }
+            targets[count].pid   = job->pid;
+            targets[count].pidfd = -1;
+            reap_target(session, &targets[count]);
+            count++;
+        }
+    }
+
+    if (count > 0) {
+        bool satisfied =
+            wait_targets(session, targets, count, any_mode, timeout_ms);
+
+        if (!satisfied) {
+            result = WAIT_TIMEOUT_STATUS;
+        } else if (any_mode) {
+            // Report the first target (in operand order) that terminated
+            for (int j = 0; j < count; j++) {
+                if (targets[j].done) {
+                    result = targets[j].status;
+                    break;
+                }
+            }
+        } else if (operands > 0 && result == 0) {
+            result = targets[count - 1].status;
+        }
+
+        // Waited-for jobs are reported by their status, not by jobs_notify
+        bool removed_one = false;
+        for (int j = 0; j < count; j++) {
+            if (!targets[j].done || (any_mode && removed_one)) {
+                continue;
+            }
+            Job *job = jobs_get_by_pid(session->jobs, targets[j].pid);
+            if (job) {
+                jobs_remove(session->jobs, job->id);
+            }
+            removed_one = true;
+        }
+    }
+
+    free(targets);
+    return result;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdbool.h> /* bool */
+#include <stdint.h>  /* SIZE_MAX */
 #include <stdlib.h>  /* malloc, free, realloc, qsort */
-#include <string.h>  /* strdup, strcmp, memmove */
+#include <string.h>  /* strdup, strcmp, memcpy, memmove */
 
 #include "data/array.h"
 
@@ -69,6 +70,36 @@ bool array_add(Array *array, char *str) {
     return true;
 }
 
+bool array_push(Array *array, char *str) {
+    ensure_capacity(array, array->count + 1);
+    array->items[array->count++] = str;
+    return true;
+}
+
+bool array_reserve(Array *array, size_t capacity) {
+    if (array->capacity >= capacity)
+        return true;
+    if (capacity > SIZE_MAX / sizeof(char *))
+        return false;
+
+    char **items = realloc(array->items, capacity * sizeof(char *));
+    if (!items)
+        return false;
+    array->items    = items;
+    array->capacity = capacity;
+    return true;
+}
+
+void array_take(Array *array, Array *other) {
+    if (!array_reserve(array, array->count + other->count))
+        return;
+
+    memcpy(&array->items[array->count], other->items,
+           other->count * sizeof(char *));
+    array->count += other->count;
+    other->count = 0;
+}
+
 void array_extend(Array *array, Array *other) {
     for (size_t i = 0; i < other->count; i++) {
         array_add(array, other->items[i]);
@@ -128,10 +159,14 @@ void free_array(Array *array) {
     array->capacity = 0;
 }
 
+/* qsort comparator for an array of strings */
+static int compare_items(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
 void array_sort(Array *array) {
     if (array->count > 1) {
-        qsort(array->items, array->count, sizeof(char *),
-              (int (*)(const void *, const void *))strcmp);
+        qsort(array->items, array->count, sizeof(char *), compare_items);
     }
 }
 
@@ -1,31 +1,59 @@
 #include <stdbool.h> /* bool, true, false */
 #include <stdlib.h>  /* malloc, free, realloc */
-#include <string.h>  /* strdup, strlen, memmove */
+#include <string.h>  /* strdup, strlen, memcpy, memmove */
 
 #include "data/dynamic.h"
 
-/* The default growing strategy: double the capacity */
+/* The default growing strategy: double the capacity, or jump straight to
+ * the required one when doubling is not enough */
 static size_t default_growing_strategy(size_t current_capacity,
                                        size_t required_capacity) {
-    if (required_capacity < 1)
-        return 8;
-    size_t new_capacity = current_capacity;
-    while (new_capacity < required_capacity) {
-        new_capacity *= 2;
-    }
+    size_t new_capacity = current_capacity * 2;
+    if (new_capacity < required_capacity)
+        new_capacity = required_capacity;
+    if (new_capacity < DYNAMIC_INLINE_CAPACITY)
+        new_capacity = DYNAMIC_INLINE_CAPACITY;
     return new_capacity;
 }
 
+/* Make sure the Dynamic can hold `needed` bytes (including the NUL
+ * terminator), moving it out of its inline storage if necessary */
+static bool dynamic_reserve(Dynamic *value, size_t needed) {
+    if (needed <= value->capacity)
+        return true;
+
+    size_t (*strategy)(size_t, size_t) =
+        value->growing_strategy ? value->growing_strategy
+                                : default_growing_strategy;
+    size_t new_capacity = strategy(value->capacity, needed);
+    if (new_capacity < needed)
+        new_capacity = needed;
+
+    char *new_value;
+    if (value->value == value->small) {
+        new_value = malloc(new_capacity * sizeof(char));
+        if (!new_value)
+            return false;
+        memcpy(new_value, value->small, value->length + 1);
+    } else {
+        new_value = realloc(value->value, new_capacity * sizeof(char));
+        if (!new_value)
+            return false;
+        if (!value->value)
+            new_value[0] = '\0';
+    }
+    value->value    = new_value;
+    value->capacity = new_capacity;
+    return true;
+}
+
 Dynamic *init_dynamic_with_strategy(Dynamic *value,
                                     size_t (*growing_strategy)(size_t,
                                                                size_t)) {
-    bool allocated_struct = false;
-
     if (!value) {
         value = malloc(sizeof(Dynamic));
         if (!value)
             return NULL;
-        allocated_struct = true;
     } else {
         // Safety: ensure it doesn't hold old data if reused
         free_dynamic(value);
@@ -33,18 +61,10 @@ Dynamic *init_dynamic_with_strategy(Dynamic *value,
 
     value->growing_strategy =
         growing_strategy ? growing_strategy : default_growing_strategy;
-    value->capacity = value->growing_strategy(0, 0);
-
-    if (value->capacity < 1)
-        value->capacity = 8;
-
-    value->value = malloc(value->capacity * sizeof(char));
-    if (!value->value) {
-        if (allocated_struct)
-            free(value); // Only free if we allocated it
-        return NULL;
-    }
 
+    // Short strings never touch the heap
+    value->value    = value->small;
+    value->capacity = DYNAMIC_INLINE_CAPACITY;
     value->length   = 0;
     value->value[0] = '\0';
     return value;
@@ -55,51 +75,34 @@ Dynamic *init_dynamic(Dynamic *value) {
 }
 
 void dynamic_append(Dynamic *value, char character) {
-    size_t needed = value->length + 1 + 1;
-    if (needed >= value->capacity) {
-        size_t new_capacity = value->growing_strategy(value->capacity, needed);
-        char  *new_value = realloc(value->value, new_capacity * sizeof(char));
-        if (!new_value)
-            return; // allocation failed
-        value->value    = new_value;
-        value->capacity = new_capacity;
-    }
+    if (!dynamic_reserve(value, value->length + 2))
+        return; // allocation failed
 
-    value->value[value->length] = character;
-    value->length               = needed - 1;
-    value->value[value->length] = '\0';
+    value->value[value->length++] = character;
+    value->value[value->length]   = '\0';
 }
 
 void dynamic_extend(Dynamic *value, char *string) {
     if (string == NULL)
         return;
-    size_t length = strlen(string);
-    size_t needed = value->length + length + 1;
-    if (needed >= value->capacity) {
-        size_t new_capacity = value->growing_strategy(value->capacity, needed);
-        char  *new_value = realloc(value->value, new_capacity * sizeof(char));
-        if (!new_value)
-            return; // allocation failed
-        value->value    = new_value;
-        value->capacity = new_capacity;
-    }
+    dynamic_extend_length(value, string, strlen(string));
+}
+
+void dynamic_extend_length(Dynamic *value, const char *string, size_t length) {
+    if (string == NULL || length == 0)
+        return;
+    if (!dynamic_reserve(value, value->length + length + 1))
+        return; // allocation failed
+
     memcpy(value->value + value->length, string, length);
-    value->length               = needed - 1;
+    value->length += length;
     value->value[value->length] = '\0';
 }
 
 void dynamic_prepend(Dynamic *value, char character) {
     // length + new character + null terminator
-    size_t needed = value->length + 2;
-
-    if (needed >= value->capacity) {
-        size_t new_capacity = value->growing_strategy(value->capacity, needed);
-        char  *new_value = realloc(value->value, new_capacity * sizeof(char));
-        if (!new_value)
-            return;
-        value->value    = new_value;
-        value->capacity = new_capacity;
-    }
+    if (!dynamic_reserve(value, value->length + 2))
+        return;
 
     // Shift existing characters + null terminator
     memmove(value->value + 1, value->value, value->length + 1);
@@ -123,24 +126,16 @@ void dynamic_insert(Dynamic *value, size_t position, char *string) {
     if (position > value->length)
         position = value->length;
 
-    size_t needed = value->length + str_len + 1;
-    if (needed >= value->capacity) {
-        size_t new_capacity = value->growing_strategy(value->capacity, needed);
-        char  *new_value = realloc(value->value, new_capacity * sizeof(char));
-        if (!new_value)
-            return; // allocation failed
-        value->value    = new_value;
-        value->capacity = new_capacity;
-    }
+    if (!dynamic_reserve(value, value->length + str_len + 1))
+        return; // allocation failed
 
-    // Shift existing characters to make space
+    // Shift existing characters (and the null terminator) to make space
     memmove(value->value + position + str_len, value->value + position,
             value->length - position + 1);
 
     // Insert new string
     memcpy(value->value + position, string, str_len);
-    value->length               = needed - 1;
-    value->value[value->length] = '\0';
+    value->length += str_len;
 }
 
 void dynamic_remove(Dynamic *value, size_t position, size_t length) {
@@ -168,10 +163,10 @@ void free_dynamic(Dynamic *value) {
     if (!value)
         return;
 
-    if (value->value) {
+    if (value->value && value->value != value->small) {
         free(value->value);
-        value->value = NULL;
     }
+    value->value = NULL;
 
     value->capacity = 0;
     value->length   = 0;
@@ -181,7 +176,10 @@ char *dynamic_to_string(Dynamic *value) {
     if (value->length == 0 || !value->value) {
         return strdup("");
     }
-    return strdup(value->value);
+    char *string = malloc(value->length + 1);
+    if (string)
+        memcpy(string, value->value, value->length + 1);
+    return string;
 }
 
 Dynamic *dynamic_copy(Dynamic *src, Dynamic *dest) {
@@ -192,6 +190,6 @@ Dynamic *dynamic_copy(Dynamic *src, Dynamic *dest) {
     if (!dest)
         return NULL;
 
-    dynamic_extend(dest, src->value);
+    dynamic_extend_length(dest, src->value, src->length);
     return dest;
 }
@@ -0,0 +1,194 @@
+#include <stddef.h> /* offsetof */
+#include <stdint.h> /* uint64_t */
+#include <stdlib.h> /* malloc, calloc, free */
+#include <string.h> /* memcmp, memcpy, memset, strlen */
+
+#include "data/intern.h"
+
+/* Number of slots of a new table */
+#define INTERN_INITIAL_CAPACITY 64
+
+/* Hash bytes with 64-bit FNV-1a */
+static size_t intern_hash(const char *string, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)string[i];
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)hash;
+}
+
+/* Get the entry an interned string belongs to */
+static InternEntry *intern_entry(const char *string) {
+    return (InternEntry *)(string - offsetof(InternEntry, string));
+}
+
+InternTable *init_intern_table(InternTable *table) {
+    bool allocated = false;
+    if (!table) {
+        table = malloc(sizeof(InternTable));
+        if (!table) {
+            return NULL;
+        }
+        allocated = true;
+    }
+    memset(table, 0, sizeof(InternTable));
+    table->slots = calloc(INTERN_INITIAL_CAPACITY, sizeof(InternEntry *));
+    if (!table->slots) {
+        if (allocated) {
+            free(table);
+        }
+        return NULL;
+    }
+    table->capacity = INTERN_INITIAL_CAPACITY;
+    return table;
+}
+
+/* Double the number of slots, keeping the load factor under 3/4 */
+static bool intern_grow(InternTable *table) {
+    size_t        capacity = table->capacity * 2;
+    InternEntry **slots    = calloc(capacity, sizeof(InternEntry *));
+    if (!slots) {
+        return false;
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        InternEntry *entry = table->slots[i];
+        if (!entry) {
+            continue;
+        }
+        size_t slot = entry->hash & (capacity - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = entry;
+    }
+    free(table->slots);
+    table->slots    = slots;
+    table->capacity = capacity;
+    return true;
+}
+
+const char *intern_string_length(InternTable *table, const char *string,
+                                 size_t length) {
+    if (!table || !string) {
+        return NULL;
+    }
+    if ((table->count + 1) * 4 > table->capacity * 3 && !intern_grow(table)) {
+        return NULL;
+    }
+
+    size_t hash = intern_hash(string, length);
+    size_t slot = hash & (table->capacity - 1);
+    while (table->slots[slot]) {
+        InternEntry *entry = table->slots[slot];
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->string, string, length) == 0) {
+            entry->refs++;
+            return entry->string;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    InternEntry *entry = malloc(sizeof(InternEntry) + length + 1);
+    if (!entry) {
+        return NULL;
+    }
+    entry->hash   = hash;
+    entry->refs   = 1;
+    entry->length = length;
+    memcpy(entry->string, string, length);
+    entry->string[length] = '\0';
+
+    table->slots[slot] = entry;
+    table->count++;
+    table->bytes += length + 1;
+    return entry->string;
+}
+
+const char *intern_string(InternTable *table, const char *string) {
+    if (!string) {
+        return NULL;
+    }
+    return intern_string_length(table, string, strlen(string));
+}
+
+const char *intern_retain(const char *string) {
+    if (string) {
+        intern_entry(string)->refs++;
+    }
+    return string;
+}
+
+/* Find the slot holding an entry, or return the table capacity */
+static size_t intern_find_slot(const InternTable *table,
+                               const InternEntry *entry) {
+    size_t slot = entry->hash & (table->capacity - 1);
+    while (table->slots[slot]) {
+        if (table->slots[slot] == entry) {
+            return slot;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return table->capacity;
+}
+
+void intern_release(InternTable *table, const char *string) {
+    if (!table || !string) {
+        return;
+    }
+    InternEntry *entry = intern_entry(string);
+    if (--entry->refs > 0) {
+        return;
+    }
+
+    size_t slot = intern_find_slot(table, entry);
+    if (slot == table->capacity) {
+        return;
+    }
+    table->slots[slot] = NULL;
+    table->count--;
+    table->bytes -= entry->length + 1;
+    free(entry);
+
+    // Move the following entries back so lookups never stop early
+    size_t mask = table->capacity - 1;
+    size_t next = (slot + 1) & mask;
+    while (table->slots[next]) {
+        InternEntry *moved = table->slots[next];
+        size_t       home  = moved->hash & mask;
+        // Only entries whose home is not between the hole and them can move
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            table->slots[slot] = moved;
+            table->slots[next] = NULL;
+            slot               = next;
+        }
+        next = (next + 1) & mask;
+    }
+}
+
+bool intern_contains(const InternTable *table, const char *string) {
+    if (!table || !string) {
+        return false;
+    }
+    size_t length = strlen(string);
+    size_t hash   = intern_hash(string, length);
+    size_t slot   = hash & (table->capacity - 1);
+    while (table->slots[slot]) {
+        if (table->slots[slot]->string == string) {
+            return true;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return false;
+}
+
+void free_intern_table(InternTable *table) {
+    if (!table) {
+        return;
+    }
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->slots[i]);
+    }
+    free(table->slots);
+    memset(table, 0, sizeof(InternTable));
+}
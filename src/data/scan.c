@@ -0,0 +1,135 @@
+#include <stdbool.h> /* bool */
+#include <stddef.h>  /* size_t */
+
+#if defined(__AVX2__)
+#include <immintrin.h> /* __m256i, _mm256_* */
+#elif defined(__SSE2__)
+#include <emmintrin.h> /* __m128i, _mm_* */
+#elif defined(__ARM_NEON)
+#include <arm_neon.h> /* uint8x16_t, vld1q_u8, vceqq_u8, vcgeq_u8, vmaxvq_u8 */
+#endif
+
+#include "data/scan.h"
+
+/* Check if a byte belongs to a set */
+static inline bool in_set(char c, const ScanSet *set) {
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->chars[i] == c) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Scan byte by byte, used for the tail of the buffer and without SIMD */
+static size_t scan_bytes(const char *data, size_t start, size_t length,
+                         const ScanSet *set) {
+    size_t i = start;
+    while (i < length && !in_set(data[i], set)) {
+        i++;
+    }
+    return i;
+}
+
+size_t scan_until(const char *data, size_t length, const ScanSet *set) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i needles[SCANSET_MAX];
+    for (size_t k = 0; k < set->count; k++) {
+        needles[k] = _mm256_set1_epi8(set->chars[k]);
+    }
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk   = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i matches = _mm256_setzero_si256();
+        for (size_t k = 0; k < set->count; k++) {
+            matches =
+                _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, needles[k]));
+        }
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(matches);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    __m128i needles[SCANSET_MAX];
+    for (size_t k = 0; k < set->count; k++) {
+        needles[k] = _mm_set1_epi8(set->chars[k]);
+    }
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk   = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i matches = _mm_setzero_si128();
+        for (size_t k = 0; k < set->count; k++) {
+            matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, needles[k]));
+        }
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(matches);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t needles[SCANSET_MAX];
+    for (size_t k = 0; k < set->count; k++) {
+        needles[k] = vdupq_n_u8((uint8_t)set->chars[k]);
+    }
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t chunk   = vld1q_u8((const uint8_t *)(data + i));
+        uint8x16_t matches = vdupq_n_u8(0);
+        for (size_t k = 0; k < set->count; k++) {
+            matches = vorrq_u8(matches, vceqq_u8(chunk, needles[k]));
+        }
+        if (vmaxvq_u8(matches)) {
+            // NEON has no movemask, the match is within these 16 bytes
+            return scan_bytes(data, i, i + 16, set);
+        }
+    }
+#endif
+
+    return scan_bytes(data, i, length, set);
+}
+
+size_t scan_ascii(const char *data, size_t length, char stop) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi8(stop);
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+        // The high bit of each byte is the non-ASCII mask already
+        unsigned int mask =
+            (unsigned int)_mm256_movemask_epi8(chunk) |
+            (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    __m128i needle = _mm_set1_epi8(stop);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+        // The high bit of each byte is the non-ASCII mask already
+        unsigned int mask =
+            (unsigned int)_mm_movemask_epi8(chunk) |
+            (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t needle = vdupq_n_u8((uint8_t)stop);
+    uint8x16_t high   = vdupq_n_u8(0x80);
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t chunk   = vld1q_u8((const uint8_t *)(data + i));
+        uint8x16_t matches = vorrq_u8(vcgeq_u8(chunk, high),
+                                      vceqq_u8(chunk, needle));
+        if (vmaxvq_u8(matches)) {
+            break; // The match is within these 16 bytes
+        }
+    }
+#endif
+
+    while (i < length && (unsigned char)data[i] < 0x80 && data[i] != stop) {
+        i++;
+    }
+    return i;
+}
@@ -1,5 +1,5 @@
 #include <stdlib.h> /* malloc, free, realloc */
-#include <string.h> /* strdup */
+#include <string.h> /* strdup, strlen */
 
 #include "data/array.h" /* Array, array_add, array_append, array_create, free_array */
 #include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_to_string, free_dynamic */
@@ -237,3 +237,24 @@ Trie *trie_copy(Trie *src, Trie *dest) {
 
     return dest;
 }
+
+static void measure(Trie *node, TrieStats *stats) {
+    stats->nodes++;
+    stats->bytes += sizeof(Trie);
+    if (node->value) {
+        stats->keys++;
+        stats->bytes += strlen(node->value) + 1;
+    }
+
+    for (int i = 0; i < ALPHABET_SIZE; i++) {
+        if (node->children[i])
+            measure(node->children[i], stats);
+    }
+}
+
+TrieStats trie_stats(Trie *trie) {
+    TrieStats stats = {0};
+    if (trie)
+        measure(trie, &stats);
+    return stats;
+}
@@ -2,6 +2,88 @@
 
 #include <stdbool.h> /* bool */
 #include <stddef.h>  /* size_t */
+#include <stdint.h>  /* uint32_t */
+#include <string.h>  /* strlen */
+
+#include "data/scan.h" /* scan_ascii */
+
+/* A range of code points */
+typedef struct CodepointRange {
+    uint32_t first; // First code point of the range
+    uint32_t last;  // Last code point of the range
+} CodepointRange;
+
+/* Code points that take no column: combining marks, joiners, selectors */
+static const CodepointRange zero_width[] = {
+    {0x0300, 0x036F},   {0x0483, 0x0489},   {0x0591, 0x05BD},
+    {0x05BF, 0x05BF},   {0x05C1, 0x05C2},   {0x05C4, 0x05C5},
+    {0x05C7, 0x05C7},   {0x0610, 0x061A},   {0x064B, 0x065F},
+    {0x0670, 0x0670},   {0x06D6, 0x06DC},   {0x06DF, 0x06E4},
+    {0x06E7, 0x06E8},   {0x06EA, 0x06ED},   {0x0900, 0x0902},
+    {0x093A, 0x093A},   {0x093C, 0x093C},   {0x0941, 0x0948},
+    {0x094D, 0x094D},   {0x0951, 0x0957},   {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A},   {0x0E47, 0x0E4E},   {0x1AB0, 0x1AFF},
+    {0x1DC0, 0x1DFF},   {0x200B, 0x200F},   {0x202A, 0x202E},
+    {0x2060, 0x2064},   {0x20D0, 0x20FF},   {0x302A, 0x302D},
+    {0x3099, 0x309A},   {0xFE00, 0xFE0F},   {0xFE20, 0xFE2F},
+    {0xFEFF, 0xFEFF},   {0x1F3FB, 0x1F3FF}, {0xE0001, 0xE0001},
+    {0xE0020, 0xE007F}, {0xE0100, 0xE01EF},
+};
+
+/* Code points that take two columns: East Asian wide/fullwidth, emoji */
+static const CodepointRange double_width[] = {
+    {0x1100, 0x115F},   {0x231A, 0x231B},   {0x2329, 0x232A},
+    {0x23E9, 0x23EC},   {0x23F0, 0x23F0},   {0x23F3, 0x23F3},
+    {0x25FD, 0x25FE},   {0x2614, 0x2615},   {0x2648, 0x2653},
+    {0x267F, 0x267F},   {0x2693, 0x2693},   {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB},   {0x26BD, 0x26BE},   {0x26C4, 0x26C5},
+    {0x26CE, 0x26CE},   {0x26D4, 0x26D4},   {0x26EA, 0x26EA},
+    {0x26F2, 0x26F3},   {0x26F5, 0x26F5},   {0x26FA, 0x26FA},
+    {0x26FD, 0x26FD},   {0x2705, 0x2705},   {0x270A, 0x270B},
+    {0x2728, 0x2728},   {0x274C, 0x274C},   {0x274E, 0x274E},
+    {0x2753, 0x2755},   {0x2757, 0x2757},   {0x2795, 0x2797},
+    {0x27B0, 0x27B0},   {0x27BF, 0x27BF},   {0x2B1B, 0x2B1C},
+    {0x2B50, 0x2B50},   {0x2B55, 0x2B55},   {0x2E80, 0x303E},
+    {0x3041, 0x3098},   {0x309B, 0x33FF},   {0x3400, 0x4DBF},
+    {0x4E00, 0x9FFF},   {0xA000, 0xA4CF},   {0xA960, 0xA97F},
+    {0xAC00, 0xD7A3},   {0xF900, 0xFAFF},   {0xFE10, 0xFE19},
+    {0xFE30, 0xFE6F},   {0xFF00, 0xFF60},   {0xFFE0, 0xFFE6},
+    {0x16FE0, 0x16FE4}, {0x17000, 0x18CFF}, {0x1B000, 0x1B2FF},
+    {0x1F004, 0x1F004}, {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E},
+    {0x1F191, 0x1F19A}, {0x1F200, 0x1F202}, {0x1F210, 0x1F23B},
+    {0x1F240, 0x1F248}, {0x1F250, 0x1F251}, {0x1F260, 0x1F265},
+    {0x1F300, 0x1F320}, {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C},
+    {0x1F37E, 0x1F393}, {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3},
+    {0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F3FA},
+    {0x1F400, 0x1F43E}, {0x1F440, 0x1F440}, {0x1F442, 0x1F4FC},
+    {0x1F4FF, 0x1F53D}, {0x1F54B, 0x1F54E}, {0x1F550, 0x1F567},
+    {0x1F57A, 0x1F57A}, {0x1F595, 0x1F596}, {0x1F5A4, 0x1F5A4},
+    {0x1F5FB, 0x1F64F}, {0x1F680, 0x1F6C5}, {0x1F6CC, 0x1F6CC},
+    {0x1F6D0, 0x1F6D2}, {0x1F6D5, 0x1F6D7}, {0x1F6DC, 0x1F6DF},
+    {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC}, {0x1F7E0, 0x1F7EB},
+    {0x1F7F0, 0x1F7F0}, {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945},
+    {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAFF}, {0x20000, 0x2FFFD},
+    {0x30000, 0x3FFFD},
+};
+
+/* Check whether a code point belongs to a sorted list of ranges */
+static bool in_ranges(uint32_t codepoint, const CodepointRange *ranges,
+                      size_t count) {
+    if (codepoint < ranges[0].first || codepoint > ranges[count - 1].last)
+        return false;
+
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (codepoint > ranges[middle].last)
+            low = middle + 1;
+        else if (codepoint < ranges[middle].first)
+            high = middle;
+        else
+            return true;
+    }
+    return false;
+}
 
 /* Get UTF-8 character length from first byte */
 unsigned char utf8_charlen(char c) {
@@ -20,11 +102,21 @@ size_t utf8_strlen(char *str) {
     if (!str)
         return 0;
 
-    size_t len = 0;
-    while (*str) {
-        unsigned char char_len = utf8_charlen((char)*str);
-        str += char_len;
-        len++;
+    size_t length = strlen(str);
+    size_t len    = 0;
+    size_t i      = 0;
+    while (i < length) {
+        // Pure ASCII spans count one character per byte
+        size_t span = scan_ascii(str + i, length - i, '\0');
+        len += span;
+        i += span;
+
+        // Every byte but continuation bytes (10xxxxxx) starts a character
+        while (i < length && ((unsigned char)str[i] & 0x80)) {
+            if (((unsigned char)str[i] & 0xC0) != 0x80)
+                len++;
+            i++;
+        }
     }
     return len;
 }
@@ -49,4 +141,56 @@ char *utf8_prev_char(char *current, char *start) {
     }
 
     return p;
-}
\ No newline at end of file
+}
+
+uint32_t utf8_decode(const char *str, size_t length,
+                     unsigned char *char_length) {
+    const unsigned char *s = (const unsigned char *)str;
+    unsigned char        n = utf8_charlen(str[0]);
+
+    *char_length = 1;
+    if (n == 1)
+        return s[0] < 0x80 ? s[0] : 0xFFFD;
+    if (n > length)
+        return 0xFFFD;
+
+    uint32_t codepoint = s[0] & (0x7F >> n);
+    for (unsigned char i = 1; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80)
+            return 0xFFFD;
+        codepoint = (codepoint << 6) | (s[i] & 0x3F);
+    }
+    *char_length = n;
+    return codepoint;
+}
+
+int utf8_codepoint_width(uint32_t codepoint) {
+    if (codepoint < 0x300)
+        return 1;
+    if (in_ranges(codepoint, zero_width,
+                  sizeof(zero_width) / sizeof(zero_width[0])))
+        return 0;
+    if (in_ranges(codepoint, double_width,
+                  sizeof(double_width) / sizeof(double_width[0])))
+        return 2;
+    return 1;
+}
+
+size_t utf8_width(const char *str, size_t length) {
+    size_t width = 0;
+    size_t i     = 0;
+    while (i < length) {
+        // Pure ASCII spans take one column per byte
+        size_t span = scan_ascii(str + i, length - i, '\0');
+        width += span;
+        i += span;
+        if (i >= length)
+            break;
+
+        unsigned char char_length;
+        uint32_t codepoint = utf8_decode(str + i, length - i, &char_length);
+        width += utf8_codepoint_width(codepoint);
+        i += char_length;
+    }
+    return width;
+}
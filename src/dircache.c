@@ -0,0 +1,253 @@
+#include <dirent.h>   /* DIR, dirent, fdopendir, readdir, closedir */
+#include <fcntl.h>    /* open, openat, O_RDONLY, O_DIRECTORY, O_CLOEXEC */
+#include <stdbool.h>  /* bool, true, false */
+#include <stdlib.h>   /* malloc, calloc, realloc, free */
+#include <string.h>   /* memcpy, memset, strlen */
+#include <sys/stat.h> /* fstat, struct stat, S_ISDIR */
+#include <time.h>     /* clock_gettime, CLOCK_REALTIME */
+#include <unistd.h>   /* close */
+
+#include "dircache.h"
+
+#ifdef __APPLE__
+#define STAT_MTIME(st) ((st).st_mtimespec)
+#else
+#define STAT_MTIME(st) ((st).st_mtim)
+#endif
+
+/* Listings whose mtime is this close to the time they were read may miss
+ * changes made within the same timestamp tick, so they are never trusted */
+#define DIRCACHE_RACY_SECONDS 1
+
+DirCache *init_dircache(DirCache *cache) {
+    bool allocated = false;
+    if (!cache) {
+        cache = malloc(sizeof(DirCache));
+        if (!cache) {
+            return NULL;
+        }
+        allocated = true;
+    }
+    memset(cache, 0, sizeof(DirCache));
+    cache->listings = calloc(DIRCACHE_MAX_LISTINGS, sizeof(DirListing));
+    if (!cache->listings) {
+        if (allocated) {
+            free(cache);
+        }
+        return NULL;
+    }
+    return cache;
+}
+
+/* Free the entries of a listing, leaving the slot empty */
+static void free_listing(DirListing *listing) {
+    free(listing->names);
+    free(listing->types);
+    free(listing->storage);
+    memset(listing, 0, sizeof(DirListing));
+}
+
+/* Read all entries of the directory open on `fd` into `listing` */
+static bool read_listing(DirListing *listing, int fd) {
+    // A fresh descriptor keeps the caller's read offset untouched
+    int own = openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (own < 0) {
+        return false;
+    }
+    DIR *dir = fdopendir(own);
+    if (!dir) {
+        close(own);
+        return false;
+    }
+
+    size_t         storage_capacity = 4096;
+    size_t         storage_length   = 0;
+    size_t         capacity         = 64;
+    size_t         count            = 0;
+    char          *storage          = malloc(storage_capacity);
+    size_t        *offsets          = malloc(capacity * sizeof(size_t));
+    unsigned char *types            = malloc(capacity);
+    bool           ok = storage && offsets && types;
+
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' &&
+            (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        size_t length = strlen(name) + 1;
+        if (storage_length + length > storage_capacity) {
+            while (storage_length + length > storage_capacity) {
+                storage_capacity *= 2;
+            }
+            char *grown = realloc(storage, storage_capacity);
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            storage = grown;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            size_t        *grown_offsets = realloc(offsets, capacity * sizeof(size_t));
+            unsigned char *grown_types   = grown_offsets ? realloc(types, capacity) : NULL;
+            if (grown_offsets) {
+                offsets = grown_offsets;
+            }
+            if (grown_types) {
+                types = grown_types;
+            }
+            if (!grown_offsets || !grown_types) {
+                ok = false;
+                break;
+            }
+        }
+
+        memcpy(storage + storage_length, name, length);
+        offsets[count] = storage_length;
+        types[count]   = entry->d_type;
+        storage_length += length;
+        count++;
+    }
+    closedir(dir);
+
+    char **names = ok ? malloc((count ? count : 1) * sizeof(char *)) : NULL;
+    if (!names) {
+        free(storage);
+        free(offsets);
+        free(types);
+        return false;
+    }
+    // Names are only materialized once storage has stopped moving
+    for (size_t i = 0; i < count; i++) {
+        names[i] = storage + offsets[i];
+    }
+    free(offsets);
+
+    listing->names   = names;
+    listing->types   = types;
+    listing->count   = count;
+    listing->storage = storage;
+    return true;
+}
+
+/* Check whether a cached listing still describes the directory */
+static bool listing_is_current(const DirListing *listing,
+                               const struct stat *st) {
+    return !listing->racy && listing->dev == st->st_dev &&
+           listing->ino == st->st_ino &&
+           listing->mtime.tv_sec == STAT_MTIME(*st).tv_sec &&
+           listing->mtime.tv_nsec == STAT_MTIME(*st).tv_nsec;
+}
+
+/* Pick the slot a new listing should be stored in, or NULL if all are pinned */
+static DirListing *find_free_slot(DirCache *cache, const struct stat *st) {
+    if (cache->count < DIRCACHE_MAX_LISTINGS) {
+        return &cache->listings[cache->count++];
+    }
+
+    DirListing *victim = NULL;
+    for (size_t i = 0; i < cache->count; i++) {
+        DirListing *listing = &cache->listings[i];
+        if (listing->pins > 0) {
+            continue;
+        }
+        // An outdated listing of the same directory is always replaced
+        if (listing->dev == st->st_dev && listing->ino == st->st_ino) {
+            return listing;
+        }
+        if (!victim || listing->last_used < victim->last_used) {
+            victim = listing;
+        }
+    }
+    return victim;
+}
+
+const DirListing *dircache_get_fd(DirCache *cache, int fd) {
+    struct stat st;
+    if (!cache || fstat(fd, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < cache->count; i++) {
+        DirListing *listing = &cache->listings[i];
+        if (listing_is_current(listing, &st)) {
+            listing->last_used = ++cache->clock;
+            listing->pins++;
+            cache->hits++;
+            return listing;
+        }
+    }
+
+    cache->misses++;
+    DirListing *slot = find_free_slot(cache, &st);
+    if (!slot) {
+        return NULL;
+    }
+    if (slot->storage) {
+        free_listing(slot);
+    }
+
+    if (!read_listing(slot, fd)) {
+        // Keep the slot reusable (the empty listing never matches)
+        slot->racy = true;
+        return NULL;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    slot->dev       = st.st_dev;
+    slot->ino       = st.st_ino;
+    slot->mtime     = STAT_MTIME(st);
+    slot->racy      = now.tv_sec - slot->mtime.tv_sec <= DIRCACHE_RACY_SECONDS;
+    slot->last_used = ++cache->clock;
+    slot->pins      = 1;
+    return slot;
+}
+
+const DirListing *dircache_get(DirCache *cache, const char *path) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    const DirListing *listing = dircache_get_fd(cache, fd);
+    close(fd);
+    return listing;
+}
+
+void dircache_release(DirCache *cache, const DirListing *listing) {
+    if (!cache || !listing) {
+        return;
+    }
+    DirListing *slot = &cache->listings[listing - cache->listings];
+    if (slot->pins > 0) {
+        slot->pins--;
+    }
+}
+
+void dircache_clear(DirCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->listings[i].pins == 0) {
+            free_listing(&cache->listings[i]);
+            // Emptied slots never match and are reused by eviction
+            cache->listings[i].racy = true;
+        }
+    }
+}
+
+void free_dircache(DirCache *cache) {
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < cache->count; i++) {
+        free_listing(&cache->listings[i]);
+    }
+    free(cache->listings);
+    cache->listings = NULL;
+    cache->count    = 0;
+}
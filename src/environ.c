@@ -1,5 +1,5 @@
 #include <limits.h>  /* PATH_MAX */
-#include <pwd.h>     /* getpwuid, getpwnam, struct passwd */
+#include <pwd.h>     /* getpwuid_r, struct passwd */
 #include <stdbool.h> /* bool, true, false */
 #include <stdio.h>   /* snprintf, fprintf, stderr */
 #include <stdlib.h>  /* malloc, free, realloc, strtol */
@@ -17,15 +17,14 @@ typedef struct Environ {
                                    hooks */
 } Environ;
 
-static char *get_executable_path() {
-    static char path[PATH_MAX];
-
+/* Get the path of the running executable into a PATH_MAX buffer */
+static char *get_executable_path(char path[PATH_MAX]) {
 #if defined(__APPLE__)
-    uint32_t size = sizeof(path);
+    uint32_t size = PATH_MAX;
     if (_NSGetExecutablePath(path, &size) != 0)
         return NULL;
 #else // Linux/Unix
-    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    ssize_t len = readlink("/proc/self/exe", path, PATH_MAX - 1);
     if (len == -1)
         return NULL;
     path[len] = '\0';
@@ -34,8 +33,8 @@ static char *get_executable_path() {
     // Resolve the path to an absolute path
     char *resolved_path = realpath(path, NULL);
     if (resolved_path) {
-        strncpy(path, resolved_path, sizeof(path) - 1);
-        path[sizeof(path) - 1] = '\0';
+        strncpy(path, resolved_path, PATH_MAX - 1);
+        path[PATH_MAX - 1] = '\0';
         free(resolved_path);
     }
     return path;
@@ -214,7 +213,8 @@ Environ *init_environ(Environ *env) {
     }
 
     // Set SHELL
-    char *shell = get_executable_path();
+    char  path[PATH_MAX];
+    char *shell = get_executable_path(path);
     if (shell) {
         environ_set(env, "SHELL", shell);
     }
@@ -244,9 +244,10 @@ Environ *init_environ(Environ *env) {
 
     // Set HOME if not set
     if (!environ_contains(env, "HOME")) {
-        struct passwd *pw   = getpwuid(getuid());
-        char          *home = pw ? pw->pw_dir : "/";
-        environ_set(env, "HOME", home);
+        struct passwd entry, *pw = NULL;
+        char          buffer[1024];
+        getpwuid_r(getuid(), &entry, buffer, sizeof(buffer), &pw);
+        environ_set(env, "HOME", pw ? pw->pw_dir : "/");
     }
 
     // Set PWD if not set
@@ -1,25 +1,32 @@
 #include <ctype.h>    /* isspace */
-#include <errno.h>    /* errno */
+#include <errno.h>    /* errno, EINTR */
 #include <fcntl.h>    /* open, O_WRONLY, O_CREAT, O_APPEND, O_TRUNC, O_RDONLY */
 #include <limits.h>   /* PATH_MAX */
 #include <signal.h>   /* signal, SIGINT, SIGQUIT, SIG_DFL */
 #include <stdbool.h>  /* bool, true, false */
 #include <stdio.h>    /* fprintf, stderr, printf, perror, fflush, stdout */
 #include <stdlib.h>   /* malloc, free, realloc, strdup, calloc, exit */
-#include <string.h>   /* strcmp, strchr, strlen, strncpy, strtok, snprintf */
-#include <sys/wait.h> /* waitpid, WEXITSTATUS */
+#include <string.h>   /* strcmp, strchr, strlen, strncpy, strtok_r, snprintf */
+#include <sys/wait.h> /* waitpid, WEXITSTATUS, WIFSIGNALED, WTERMSIG */
 #include <unistd.h> /* fork, access, X_OK, dup2, close, write, execve, pipe, STDOUT_FILENO, STDIN_FILENO, STDERR_FILENO, read */
 
 #include "ast.h"        /* ASTNode, NODE_*, parse, free_ast */
-#include "builtin.h"    /* is_special_builtin, get_builtin, is_builtin */
+#include "builtin.h"    /* Builtin, find_builtin, BUILTIN_SPECIAL */
 #include "data/array.h" /* Array, free_array, init_array, array_add */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_extend, dynamic_append, dynamic_to_string, free_dynamic */
 #include "data/trie.h"  /* trie_get */
 #include "environ.h" /* environ_get, environ_set, environ_set_exit_status, environ_set_last_arg, environ_set_background_pid, environ_to_array */
 #include "execute.h" /* execute, execute_string, execute_string_stdout, find_in_path, get_command_info, CommandInfo, COMMAND_* */
 #include "expand.h"  /* full_expansion */
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+#include "expansions/substitutions.h" /* command_substitution_expansion, prefetch_substitutions */
+#endif
 #include "hooks.h"   /* HOOK_* */
 #include "jobs.h"    /* jobs_add, jobs_update */
-#include "session.h" /* Session */
+#include "profile.h" /* Profile, init_profile, profile_add_child, profile_begin, profile_begin_named, profile_end, profile_merge, profile_report, profile_requested, PROFILE_* */
+#include "trace.h" /* trace_begin, trace_end, trace_process, TRACE_NO_STATUS */
+#include "zygote.h" /* Zygote, ZygoteCommand, ZygoteRedirect, zygote_spawn, zygote_usable, zygote_wait */
+#include "session.h" /* Session, free_session */
 
 #define RW_R__R__ 0644
 
@@ -193,11 +200,12 @@ static bool parse_shebang(const char *path, int *interp_argc,
     char **args = NULL;
     int    argc = 0;
 
-    char *token = strtok(p, " \t");
+    char *saveptr = NULL;
+    char *token   = strtok_r(p, " \t", &saveptr);
     while (token) {
         args         = realloc(args, (argc + 1) * sizeof(char *));
         args[argc++] = strdup(token);
-        token        = strtok(NULL, " \t");
+        token        = strtok_r(NULL, " \t", &saveptr);
     }
 
     if (argc == 0) {
@@ -209,17 +217,16 @@ static bool parse_shebang(const char *path, int *interp_argc,
     return true;
 }
 
-char *find_in_path(const char *cmd, Session *session) {
-    // If command contains a slash, treat it as a path
-    if (strchr(cmd, '/'))
-        return strdup(cmd);
-
+/* Search a command in PATH, then in the usual directories. Only the session
+ * is used, so sessions can search from different threads */
+static char *search_path(const char *cmd, Session *session) {
     // Search in PATH environment variable
-    char       *path_env = environ_get(session->environ, "PATH");
-    static char buffer[PATH_MAX];
+    char *path_env = environ_get(session->environ, "PATH");
+    char  buffer[PATH_MAX];
     if (path_env) {
         char *path_dup = strdup(path_env);
-        char *dir      = strtok(path_dup, ":");
+        char *saveptr  = NULL;
+        char *dir      = path_dup ? strtok_r(path_dup, ":", &saveptr) : NULL;
         while (dir) {
             snprintf(buffer, sizeof(buffer), "%s/%s", dir, cmd);
             // Check if the file is executable
@@ -228,7 +235,7 @@ char *find_in_path(const char *cmd, Session *session) {
                 return strdup(buffer);
             }
             // Next directory
-            dir = strtok(NULL, ":");
+            dir = strtok_r(NULL, ":", &saveptr);
         }
         free(path_dup);
     }
@@ -243,6 +250,26 @@ char *find_in_path(const char *cmd, Session *session) {
     return NULL;
 }
 
+/* Exit status of a child as the shell reports it */
+static int exit_code(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+char *find_in_path(const char *cmd, Session *session) {
+    // If command contains a slash, treat it as a path
+    if (strchr(cmd, '/'))
+        return strdup(cmd);
+
+    profile_begin(session, PROFILE_LOOKUP);
+    char *path = search_path(cmd, session);
+    profile_end(session);
+    session->stats.path_lookups++;
+    if (!path) {
+        session->stats.path_misses++;
+    }
+    return path;
+}
+
 CommandInfo get_command_info(const char *cmd, Session *session) {
     CommandInfo info = {COMMAND_NOT_FOUND, NULL};
 
@@ -258,16 +285,12 @@ CommandInfo get_command_info(const char *cmd, Session *session) {
     }
 #endif
 
-    // 2. Special Builtin
-    if (is_special_builtin(cmd)) {
-        info.type = COMMAND_SPECIAL_BUILTIN;
-        info.path = NULL;
-        return info;
-    }
-
-    // 3. Regular Builtin
-    if (is_builtin(cmd)) {
-        info.type = COMMAND_BUILTIN;
+    // 2. Special or regular Builtin
+    const Builtin *builtin = find_builtin(cmd);
+    if (builtin) {
+        info.type = (builtin->flags & BUILTIN_SPECIAL)
+                        ? COMMAND_SPECIAL_BUILTIN
+                        : COMMAND_BUILTIN;
         info.path = NULL;
         return info;
     }
@@ -286,6 +309,130 @@ CommandInfo get_command_info(const char *cmd, Session *session) {
 /* Forward declaration */
 int execute(ASTNode *node, Session *session);
 
+/**
+ * Run a command prefixed with `time [-v]` under a profile, then report the
+ * real, user and system times (and with -v, the time spent in each phase).
+ * The prefix is handled before the command is expanded, so that its
+ * expansions are measured too.
+ */
+static int execute_timed(ASTNode *node, Session *session) {
+    bool verbose = false;
+    int  skip    = 1;
+    while (skip < node->argc &&
+           (!node->arg_is_sub || node->arg_is_sub[skip] == 0)) {
+        if (strcmp(node->argv[skip], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(node->argv[skip], "--") == 0) {
+            skip++;
+            break;
+        } else {
+            break;
+        }
+        skip++;
+    }
+
+    // The command without the prefix, sharing the words of the node
+    ASTNode timed = *node;
+    timed.argv += skip;
+    timed.argc -= skip;
+    if (timed.arg_is_sub) {
+        timed.arg_is_sub += skip;
+    }
+
+    Profile  profile;
+    Profile *outer   = session->profile;
+    session->profile = init_profile(&profile);
+    int status       = timed.argc > 0 || timed.assignments
+                           ? execute(&timed, session)
+                           : 0;
+    session->profile = outer;
+
+    profile_report(&profile, stderr, verbose);
+    if (outer) {
+        profile_merge(outer, &profile);
+    }
+    return status;
+}
+
+#ifndef TIDESH_DISABLE_ASSIGNMENTS
+/* Apply a VAR=VALUE assignment, running the command substitutions of VALUE */
+static void apply_assignment(const char *assignment, Session *session) {
+    char *copy = strdup(assignment);
+    char *eq   = strchr(copy, '=');
+    if (eq) {
+        *eq = '\0';
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+        Array *value = command_substitution_expansion(eq + 1, session);
+        if (value && value->count > 0) {
+            environ_set(session->environ, copy, value->items[0]);
+        } else {
+            environ_set(session->environ, copy, eq + 1);
+        }
+        if (value) {
+            free_array(value);
+            free(value);
+        }
+#else
+        environ_set(session->environ, copy, eq + 1);
+#endif
+    }
+    free(copy);
+}
+#endif
+
+#ifndef TIDESH_DISABLE_REDIRECTIONS
+/* Expand the target of a redirection, right before it is opened */
+static char *expand_redirect_target(Redirection *redirect, Session *session) {
+    if (redirect->type == TOKEN_HEREDOC || redirect->is_process_substitution) {
+        return strdup(redirect->target);
+    }
+
+    profile_begin(session, PROFILE_EXPANSION);
+    Array *expansion = full_expansion(redirect->target, session);
+    profile_end(session);
+    if (!expansion || expansion->count == 0) {
+        if (expansion) {
+            free_array(expansion);
+            free(expansion);
+        }
+        return strdup(redirect->target);
+    }
+
+    char *target = NULL;
+    if (redirect->type == TOKEN_HERESTRING) {
+        // Here-strings keep every word
+        Dynamic joined = {0};
+        init_dynamic(&joined);
+        for (size_t i = 0; i < expansion->count; i++) {
+            dynamic_extend(&joined, expansion->items[i]);
+            if (i < expansion->count - 1)
+                dynamic_append(&joined, ' ');
+        }
+        target = dynamic_to_string(&joined);
+        free_dynamic(&joined);
+    } else {
+        target = strdup(expansion->items[0]);
+    }
+    free_array(expansion);
+    free(expansion);
+    return target;
+}
+#endif
+
+#ifndef TIDESH_DISABLE_REDIRECTIONS
+/* Flags the target of a file redirection is opened with */
+static int redirect_flags(TokenType type) {
+    if (type == TOKEN_REDIRECT_IN)
+        return O_RDONLY;
+    int flags = O_WRONLY | O_CREAT;
+    if (type == TOKEN_REDIRECT_APPEND)
+        flags |= O_APPEND;
+    else if (type == TOKEN_REDIRECT_OUT || type == TOKEN_REDIRECT_OUT_ERR)
+        flags |= O_TRUNC;
+    return flags;
+}
+#endif
+
 /* Handle combined output redirection and process substitution */
 static int handle_redirections(ASTNode *node, Session *session) {
 #ifndef TIDESH_DISABLE_REDIRECTIONS
@@ -297,7 +444,8 @@ static int handle_redirections(ASTNode *node, Session *session) {
     }
     Redirection *redirect = node->redirects;
     while (redirect) {
-        int fd_file = -1;
+        int   fd_file = -1;
+        char *target  = expand_redirect_target(redirect, session);
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
         if (redirect->type == TOKEN_HEREDOC ||
             redirect->type == TOKEN_HERESTRING) {
@@ -307,8 +455,7 @@ static int handle_redirections(ASTNode *node, Session *session) {
                     signal(SIGINT, SIG_DFL);
                     signal(SIGQUIT, SIG_DFL);
                     close(pipe_fds[0]);
-                    write(pipe_fds[1], redirect->target,
-                          strlen(redirect->target));
+                    write(pipe_fds[1], target, strlen(target));
                     close(pipe_fds[1]);
                     exit(0);
                 }
@@ -319,7 +466,7 @@ static int handle_redirections(ASTNode *node, Session *session) {
             // Process substitution
             bool  is_in = (redirect->type == TOKEN_REDIRECT_IN ||
                           redirect->type == TOKEN_PROCESS_SUBSTITUTION_IN);
-            char *cmd   = redirect->target;
+            char *cmd   = target;
 
             int pipe_fds[2];
             if (pipe(pipe_fds) == 0) {
@@ -347,20 +494,12 @@ static int handle_redirections(ASTNode *node, Session *session) {
             }
         } else {
 #endif
-            int flags = O_WRONLY | O_CREAT;
-            if (redirect->type == TOKEN_REDIRECT_APPEND)
-                flags |= O_APPEND;
-            else if (redirect->type == TOKEN_REDIRECT_OUT ||
-                     redirect->type == TOKEN_REDIRECT_OUT_ERR)
-                flags |= O_TRUNC;
-            else if (redirect->type == TOKEN_REDIRECT_IN)
-                flags = O_RDONLY;
-
-            fd_file = open(redirect->target, flags, RW_R__R__);
+            fd_file = open(target, redirect_flags(redirect->type), RW_R__R__);
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
         }
 #endif
 
+        free(target);
         if (fd_file < 0) {
             fprintf(stderr, "Error opening redirection target: %s\n",
                     strerror(errno));
@@ -378,6 +517,111 @@ static int handle_redirections(ASTNode *node, Session *session) {
     return 0;
 }
 
+/**
+ * Start an external command with the zygote of the session rather than by
+ * forking the shell. Only commands that do not need the shell once started
+ * are handled: no process substitutions, here-documents or temporary
+ * assignments. Redirection targets are expanded here, and opened by the
+ * command.
+ *
+ * @return The pid of the command, or -1 if it has to be forked
+ */
+static pid_t spawn_with_zygote(ASTNode *node, Session *session,
+                               const char *path, int argc, char **argv,
+                               const int *arg_is_sub) {
+    if (!zygote_usable(session->zygote) || node->background ||
+        node->assignments) {
+        return -1;
+    }
+    for (int i = 0; i < argc; i++) {
+        if (arg_is_sub && arg_is_sub[i] != 0) {
+            return -1;
+        }
+    }
+
+    ZygoteRedirect redirects[ZYGOTE_MAX_REDIRECTS];
+    size_t         redirect_count = 0;
+#ifndef TIDESH_DISABLE_REDIRECTIONS
+    if (node->redirects && !session->features.redirections) {
+        return -1;
+    }
+    for (Redirection *redirect = node->redirects; redirect;
+         redirect              = redirect->next) {
+        if (redirect_count == ZYGOTE_MAX_REDIRECTS ||
+            redirect->type == TOKEN_HEREDOC ||
+            redirect->type == TOKEN_HERESTRING ||
+            redirect->is_process_substitution) {
+            return -1;
+        }
+        redirect_count++;
+    }
+    redirect_count = 0;
+    for (Redirection *redirect = node->redirects; redirect;
+         redirect              = redirect->next) {
+        ZygoteRedirect *spawned = &redirects[redirect_count++];
+        spawned->fd             = redirect->fd;
+        spawned->flags          = redirect_flags(redirect->type);
+        spawned->err            = redirect->type == TOKEN_REDIRECT_OUT_ERR;
+        spawned->target         = expand_redirect_target(redirect, session);
+    }
+#endif
+
+    // Scripts are run by the interpreter of their shebang, as when forking
+    int    interp_argc = 0;
+    char **interp_argv = NULL;
+    char **exec_argv   = argv;
+    if (parse_shebang(path, &interp_argc, &interp_argv)) {
+        exec_argv = malloc((interp_argc + argc + 1) * sizeof(char *));
+        int idx   = 0;
+        for (int i = 0; i < interp_argc; i++) {
+            exec_argv[idx++] = interp_argv[i];
+        }
+        exec_argv[idx++] = (char *)path;
+        for (int i = 1; i < argc; i++) {
+            exec_argv[idx++] = argv[i];
+        }
+        exec_argv[idx] = NULL;
+    }
+
+    Array *env_array = environ_to_array(session->environ);
+    char **envp      = malloc(((env_array ? env_array->count : 0) + 1) *
+                              sizeof(char *));
+    pid_t  pid       = -1;
+    if (envp) {
+        size_t count = 0;
+        for (; env_array && count < env_array->count; count++) {
+            envp[count] = env_array->items[count];
+        }
+        envp[count] = NULL;
+
+        ZygoteCommand command = {
+            .path           = interp_argv ? interp_argv[0] : path,
+            .argv           = exec_argv,
+            .envp           = envp,
+            .redirects      = redirects,
+            .redirect_count = redirect_count,
+        };
+        pid = zygote_spawn(session->zygote, &command);
+        free(envp);
+    }
+
+    if (env_array) {
+        free_array(env_array);
+        free(env_array);
+    }
+    if (interp_argv) {
+        for (int i = 0; i < interp_argc; i++) {
+            free(interp_argv[i]);
+        }
+        free(interp_argv);
+        free(exec_argv);
+    }
+    for (size_t i = 0; i < redirect_count; i++) {
+        free((char *)redirects[i].target);
+    }
+    return pid;
+}
+
 int execute(ASTNode *node, Session *session) {
     if (!node)
         return 0;
@@ -394,6 +638,7 @@ int execute(ASTNode *node, Session *session) {
         int fds[2];
         if (pipe(fds) < 0)
             return 1;
+        profile_begin(session, PROFILE_SPAWN);
         pid_t left = fork();
         if (left == 0) {
             signal(SIGINT, SIG_DFL);
@@ -412,11 +657,19 @@ int execute(ASTNode *node, Session *session) {
             close(fds[0]);
             exit(execute(node->right, session));
         }
+        profile_end(session);
+        session->stats.forks += 2;
+        trace_process(session->trace, "fork", left, TRACE_NO_STATUS, "pipe");
+        trace_process(session->trace, "fork", right, TRACE_NO_STATUS, "pipe");
         close(fds[0]);
         close(fds[1]);
-        int st;
-        waitpid(left, NULL, 0);
+        int lst, st;
+        profile_begin(session, PROFILE_WAIT);
+        waitpid(left, &lst, 0);
         waitpid(right, &st, 0);
+        profile_end(session);
+        trace_process(session->trace, "exit", left, exit_code(lst), "pipe");
+        trace_process(session->trace, "exit", right, exit_code(st), "pipe");
         int exit_status = WEXITSTATUS(st);
         environ_set_exit_status(session->environ, exit_status);
         return exit_status;
@@ -461,14 +714,22 @@ int execute(ASTNode *node, Session *session) {
             return 127;
         }
         run_cwd_hook(session, HOOK_ENTER_SUBSHELL);
+        profile_begin(session, PROFILE_SPAWN);
         pid_t pid = fork();
         if (pid == 0) {
             signal(SIGINT, SIG_DFL);
             signal(SIGQUIT, SIG_DFL);
             exit(execute(node->left, session));
         }
+        profile_end(session);
+        session->stats.forks++;
+        trace_process(session->trace, "fork", pid, TRACE_NO_STATUS,
+                      "subshell");
         int st;
+        profile_begin(session, PROFILE_WAIT);
         waitpid(pid, &st, 0);
+        profile_end(session);
+        trace_process(session->trace, "exit", pid, exit_code(st), "subshell");
         int exit_status = 0;
         if (WIFSIGNALED(st)) {
             exit_status = 128 + WTERMSIG(st);
@@ -525,10 +786,34 @@ int execute(ASTNode *node, Session *session) {
 #endif
 
     if (node->type == NODE_COMMAND) {
+        if (node->argc > 0 && (!node->arg_is_sub || node->arg_is_sub[0] == 0) &&
+            strcmp(node->argv[0], "time") == 0) {
+            return execute_timed(node, session);
+        }
+
         // Expand arguments
-        int    argc       = 0;
-        char **argv       = NULL;
-        int   *arg_is_sub = NULL;
+        int    argc             = 0;
+        char **argv             = NULL;
+        int   *arg_is_sub       = NULL;
+        bool   expansion_failed = false;
+
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+        // Start the independent substitutions of all words at once
+        char **words      = malloc((node->argc + 1) * sizeof(char *));
+        size_t word_count = 0;
+        for (int i = 0; words && i < node->argc; i++) {
+            if (!node->arg_is_sub || node->arg_is_sub[i] == 0) {
+                words[word_count++] = node->argv[i];
+            }
+        }
+        profile_begin(session, PROFILE_SUBSTITUTION);
+        SubstitutionBatch *batch =
+            words ? prefetch_substitutions(words, word_count, session) : NULL;
+        profile_end(session);
+        SubstitutionBatch *outer_batch = session->substitutions;
+        session->substitutions         = batch;
+        free(words);
+#endif
 
         for (int i = 0; i < node->argc; i++) {
             if (node->arg_is_sub && node->arg_is_sub[i] != 0) {
@@ -539,22 +824,47 @@ int execute(ASTNode *node, Session *session) {
                 arg_is_sub[argc - 1] = node->arg_is_sub[i];
                 argv[argc]           = NULL;
             } else {
+                profile_begin(session, PROFILE_EXPANSION);
                 Array *expansion = full_expansion(node->argv[i], session);
-                if (expansion) {
+                profile_end(session);
+                if (!expansion) {
+                    expansion_failed = true;
+                    break;
+                }
+                if (expansion->count > 0) {
+                    // Grow argv once and take the expanded strings over
+                    size_t count = argc + expansion->count;
+                    argv = realloc(argv, (count + 1) * sizeof(char *));
+                    arg_is_sub = realloc(arg_is_sub, count * sizeof(int));
                     for (size_t j = 0; j < expansion->count; j++) {
+                        argv[argc]       = expansion->items[j];
+                        arg_is_sub[argc] = 0;
                         argc++;
-                        argv       = realloc(argv, (argc + 1) * sizeof(char *));
-                        arg_is_sub = realloc(arg_is_sub, argc * sizeof(int));
-                        argv[argc - 1]       = strdup(expansion->items[j]);
-                        arg_is_sub[argc - 1] = 0;
-                        argv[argc]           = NULL;
                     }
-                    free_array(expansion);
-                    free(expansion);
+                    argv[argc]       = NULL;
+                    expansion->count = 0;
                 }
+                free_array(expansion);
+                free(expansion);
             }
         }
 
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+        session->substitutions = outer_batch;
+        free_substitution_batch(batch);
+        free(batch);
+#endif
+
+        // A word that could not be expanded cancels the command
+        if (expansion_failed) {
+            for (int i = 0; i < argc; i++)
+                free(argv[i]);
+            free(argv);
+            free(arg_is_sub);
+            environ_set_exit_status(session->environ, 1);
+            return 1;
+        }
+
         // Handle variable assignments without command
         if (argc == 0 && node->assignments) {
 #ifndef TIDESH_DISABLE_ASSIGNMENTS
@@ -567,13 +877,7 @@ int execute(ASTNode *node, Session *session) {
                 return 127;
             }
             for (size_t i = 0; i < node->assignments->count; i++) {
-                char *copy = strdup(node->assignments->items[i]);
-                char *eq   = strchr(copy, '=');
-                if (eq) {
-                    *eq = 0;
-                    environ_set(session->environ, copy, eq + 1);
-                }
-                free(copy);
+                apply_assignment(node->assignments->items[i], session);
             }
 #endif
             if (argv)
@@ -598,25 +902,26 @@ int execute(ASTNode *node, Session *session) {
         const char *cmd_name =
             cmd_name_trimmed ? cmd_name_trimmed : cmd_name_raw;
         environ_set_last_arg(session->environ, argv[argc - 1]);
+        session->stats.commands++;
 
         // Special builtins should be executed in the main process
-        if (is_special_builtin(cmd_name)) {
-            int (*builtin_func)(int, char **, Session *) =
-                get_builtin(cmd_name);
-            if (builtin_func) {
-                int st = builtin_func(argc, argv, session);
-                for (int i = 0; i < argc; i++)
-                    free(argv[i]);
-                free(argv);
-                free(arg_is_sub);
-                if (cmd_name_trimmed)
-                    free(cmd_name_trimmed);
-                environ_set_exit_status(session->environ, st);
-                return st;
-            }
+        const Builtin *builtin = find_builtin(cmd_name);
+        if (builtin && (builtin->flags & BUILTIN_SPECIAL)) {
+            session->stats.builtins++;
+            profile_begin_named(session, PROFILE_BUILTIN, cmd_name, NULL);
+            int st = builtin->function(argc, argv, session);
+            profile_end(session);
+            for (int i = 0; i < argc; i++)
+                free(argv[i]);
+            free(argv);
+            free(arg_is_sub);
+            if (cmd_name_trimmed)
+                free(cmd_name_trimmed);
+            environ_set_exit_status(session->environ, st);
+            return st;
         }
 
-        bool  is_external   = !is_builtin(cmd_name);
+        bool  is_external   = !builtin;
         char *resolved_path = NULL;
         if (is_external) {
             resolved_path = find_in_path(cmd_name, session);
@@ -643,7 +948,15 @@ int execute(ASTNode *node, Session *session) {
             run_cwd_hook_with_vars(session, HOOK_BEFORE_EXEC, exec_vars, 2);
         }
 
-        pid_t pid = fork();
+        profile_begin(session, PROFILE_SPAWN);
+        pid_t pid    = is_external ? spawn_with_zygote(node, session,
+                                                       resolved_path, argc,
+                                                       argv, arg_is_sub)
+                                   : -1;
+        bool  zygote = pid > 0;
+        if (!zygote) {
+            pid = fork();
+        }
 
         if (pid == 0) {
             /* Child Process */
@@ -704,13 +1017,7 @@ int execute(ASTNode *node, Session *session) {
                     exit(127);
                 }
                 for (size_t i = 0; i < node->assignments->count; i++) {
-                    char *assign = strdup(node->assignments->items[i]);
-                    char *eq     = strchr(assign, '=');
-                    if (eq) {
-                        *eq = '\0';
-                        environ_set(session->environ, assign, eq + 1);
-                    }
-                    free(assign);
+                    apply_assignment(node->assignments->items[i], session);
                 }
 #else
                 fprintf(stderr, "tidesh: assignments are disabled\n");
@@ -718,6 +1025,20 @@ int execute(ASTNode *node, Session *session) {
 #endif
             }
 
+            // Execute builtins in the child, which then releases its copy
+            // of the shell before exiting
+            if (builtin) {
+                int ret = builtin->function(argc, argv, session);
+                for (int i = 0; i < argc; i++)
+                    free(argv[i]);
+                free(argv);
+                free(arg_is_sub);
+                if (cmd_name_trimmed)
+                    free(cmd_name_trimmed);
+                free_session(session);
+                exit(ret);
+            }
+
             // Create environment array
             Array *env_array = environ_to_array(session->environ);
             char **envp      = NULL;
@@ -729,15 +1050,6 @@ int execute(ASTNode *node, Session *session) {
                 envp[env_array->count] = NULL;
             }
 
-            // Execute
-            int (*builtin_func)(int, char **, Session *) =
-                get_builtin(cmd_name);
-
-            if (builtin_func) {
-                int ret = builtin_func(argc, argv, session);
-                exit(ret);
-            }
-
             // Find the command path if not already resolved
             char *path =
                 resolved_path ? resolved_path : find_in_path(cmd_name, session);
@@ -817,7 +1129,19 @@ int execute(ASTNode *node, Session *session) {
         }
 
         /* Parent Process */
+        profile_end(session);
+        session->stats.forks++;
+        if (zygote) {
+            session->stats.zygote_spawns++;
+        }
+        trace_process(session->trace, "fork", pid, TRACE_NO_STATUS, cmd_name);
         char *argv0_copy = argv && argv[0] ? strdup(argv[0]) : NULL;
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+        // The job table keeps its own copy of the command line, which must
+        // be built before argv is released
+        char *cmd_str =
+            node->background ? build_command_string(argv, argc) : NULL;
+#endif
         for (int i = 0; i < argc; i++)
             free(argv[i]);
         if (argv)
@@ -838,7 +1162,6 @@ int execute(ASTNode *node, Session *session) {
             return 127;
 #else
             if (session->features.job_control) {
-                char *cmd_str = build_command_string(argv, argc);
                 int job_id = jobs_add(session->jobs, pid, cmd_str, JOB_RUNNING);
                 if (cmd_str) {
                     free(cmd_str);
@@ -868,6 +1191,7 @@ int execute(ASTNode *node, Session *session) {
                 return 0;
             } else {
                 fprintf(stderr, "tidesh: background jobs not enabled\n");
+                free(cmd_str);
                 kill(pid, SIGTERM);
                 waitpid(pid, NULL, 0);
                 free(argv0_copy);
@@ -876,8 +1200,20 @@ int execute(ASTNode *node, Session *session) {
             }
 #endif
         } else {
-            int status;
-            waitpid(pid, &status, 0);
+            int           status;
+            struct rusage usage;
+            profile_begin(session, PROFILE_WAIT);
+            if (!zygote) {
+                waitpid(pid, &status, 0);
+            } else if (zygote_wait(session->zygote, pid, &status, &usage)) {
+                profile_add_child(session, &usage);
+            } else {
+                // The zygote is gone, and the status of the command with it
+                status = W_EXITCODE(1, 0);
+            }
+            profile_end(session);
+            trace_process(session->trace, "exit", pid, exit_code(status),
+                          argv0_copy);
             int exit_status = 0;
             if (WIFSIGNALED(status)) {
                 exit_status = 128 + WTERMSIG(status);
@@ -905,6 +1241,16 @@ int execute(ASTNode *node, Session *session) {
 }
 
 int execute_string(const char *cmd, Session *session) {
+    // With TIDESH_PROFILE, every command prints where its time went (the
+    // commands run by hooks and by other commands count as their own time)
+    Profile profile;
+    bool    profiling = !session->profile && !session->hooks_disabled &&
+                        profile_requested(session);
+    if (profiling) {
+        session->profile = init_profile(&profile);
+    }
+
+    trace_begin(session->trace, "command", cmd, cmd);
     char      *cmd_word   = extract_first_word(cmd);
     HookEnvVar cmd_vars[] = {{"TIDE_CMDLINE", cmd},
                              {"TIDE_CMD", cmd_word ? cmd_word : ""}};
@@ -913,8 +1259,10 @@ int execute_string(const char *cmd, Session *session) {
     LexerInput lexer_in = {0};
     init_lexer_input(&lexer_in, (char *)cmd, execute_string_stdout, session);
 
-    ASTNode *tree   = parse(&lexer_in, session);
-    int      result = 0;
+    profile_begin(session, PROFILE_PARSE);
+    ASTNode *tree = parse(&lexer_in, session);
+    profile_end(session);
+    int result = 0;
     if (tree) {
         result = execute(tree, session);
         free_ast(tree);
@@ -942,6 +1290,11 @@ int execute_string(const char *cmd, Session *session) {
 
     free(cmd_word);
     free_lexer_input(&lexer_in);
+    trace_end(session->trace);
+    if (profiling) {
+        session->profile = NULL;
+        profile_report(&profile, stderr, true);
+    }
     return result;
 }
 
@@ -952,11 +1305,20 @@ char *execute_string_stdout(const char *cmd, Session *session) {
         return strdup("");
     }
 
+    int   fd;
+    pid_t pid = execute_string_stdout_start(cmd, session, &fd);
+    if (pid == -1) {
+        return NULL;
+    }
+    return execute_string_stdout_finish(pid, fd, session);
+}
+
+pid_t execute_string_stdout_start(const char *cmd, Session *session, int *fd) {
     // Create a pipe to capture stdout
     int pipe_fd[2];
     if (pipe(pipe_fd) == -1) {
         perror("pipe");
-        return NULL;
+        return -1;
     }
 
     fflush(stdout); // Flush existing buffers before forking
@@ -966,7 +1328,11 @@ char *execute_string_stdout(const char *cmd, Session *session) {
         perror("fork");
         close(pipe_fd[0]);
         close(pipe_fd[1]);
-        return NULL;
+        return -1;
+    }
+    if (pid > 0) {
+        session->stats.forks++;
+        trace_process(session->trace, "fork", pid, TRACE_NO_STATUS, cmd);
     }
 
     if (pid == 0) {
@@ -982,6 +1348,11 @@ char *execute_string_stdout(const char *cmd, Session *session) {
         }
         close(pipe_fd[1]); // Close original write end
 
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+        // Outputs prefetched for the parent's command are not ours
+        session->substitutions = NULL;
+#endif
+
         // Execute the command
         // Note: we are not using execute_string to avoid writing to history
         LexerInput lexer_in = {0};
@@ -1015,21 +1386,37 @@ char *execute_string_stdout(const char *cmd, Session *session) {
 
     /* Parent Process */
     close(pipe_fd[1]); // Close write end immediately so we detect EOF
+    *fd = pipe_fd[0];
+    return pid;
+}
+
+/* Wait for the process of a command substitution */
+static void reap_substitution(pid_t pid, Session *session) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return;
+        }
+    }
+    trace_process(session->trace, "exit", pid, exit_code(status),
+                  "substitution");
+}
 
+char *execute_string_stdout_finish(pid_t pid, int fd, Session *session) {
     // Read output from the pipe
     size_t buf_size = 128;
     size_t length   = 0;
     char  *buffer   = malloc(buf_size);
 
     if (!buffer) {
-        close(pipe_fd[0]);
-        waitpid(pid, NULL, 0);
+        close(fd);
+        reap_substitution(pid, session);
         return NULL;
     }
 
     ssize_t bytes_read;
     while ((bytes_read =
-                read(pipe_fd[0], buffer + length, buf_size - length - 1)) > 0) {
+                read(fd, buffer + length, buf_size - length - 1)) > 0) {
         length += bytes_read;
         // printf("Read %zd bytes, total %zu: '%s'\n", bytes_read, length,
         // buffer);
@@ -1040,8 +1427,8 @@ char *execute_string_stdout(const char *cmd, Session *session) {
             char *new_buf = realloc(buffer, buf_size);
             if (!new_buf) {
                 free(buffer);
-                close(pipe_fd[0]);
-                waitpid(pid, NULL, 0);
+                close(fd);
+                reap_substitution(pid, session);
                 return NULL;
             }
             buffer = new_buf;
@@ -1049,11 +1436,10 @@ char *execute_string_stdout(const char *cmd, Session *session) {
     }
 
     buffer[length] = '\0'; // Null-terminate the string
-    close(pipe_fd[0]);
+    close(fd);
 
     // Wait for the child process to finish
-    int status;
-    waitpid(pid, &status, 0);
+    reap_substitution(pid, session);
 
     // Strip trailing newlines (Standard shell behavior for command
 
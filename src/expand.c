@@ -2,18 +2,24 @@
 #include <stdlib.h> /* malloc, free */
 #include <string.h> /* strcmp, strlen */
 
-#include "data/array.h" /* init_array, array_extend, free_array, Array */
+#include "data/array.h" /* init_array, array_take, free_array, Array */
 #include "expand.h"     /* Array */
 #ifndef TIDESH_DISABLE_ALIASES
 #include "expansions/aliases.h" /* alias_expansion */
 #endif
 #include "expansions/braces.h"    /* brace_expansion */
 #include "expansions/filenames.h" /* filename_expansion */
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+#include "expansions/substitutions.h" /* command_substitution_expansion */
+#endif
 #include "expansions/tildes.h"    /* tilde_expansion */
 #include "expansions/variables.h" /* variable_expansion */
 #include "session.h"              /* Session */
+#include "trace.h"                /* trace_begin, trace_end */
 
-/* Helper to apply an expansion function to all items in an Array */
+/* Helper to apply an expansion function to all items in an Array.
+ * Each input is freed once expanded, so that only one copy of the words is
+ * alive at a time. */
 static Array *apply(Array *inputs, Array *(*expansion_func)(char *, Session *),
                     Session *session) {
     Array *results = init_array(NULL);
@@ -25,7 +31,9 @@ static Array *apply(Array *inputs, Array *(*expansion_func)(char *, Session *),
             free(results);
             return NULL;
         }
-        array_extend(results, expanded);
+        free(inputs->items[i]);
+        inputs->items[i] = NULL;
+        array_take(results, expanded);
         free_array(expanded);
         free(expanded);
     }
@@ -34,23 +42,41 @@ static Array *apply(Array *inputs, Array *(*expansion_func)(char *, Session *),
 }
 
 Array *full_expansion(char *input, Session *session) {
-    // Variable expansion (always first)
+    // Command substitution (always first, the lexer leaves $(...) in words)
+    Array *after_substitutions = NULL;
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+    trace_begin(session->trace, "expansion", "substitutions", input);
+    after_substitutions = command_substitution_expansion(input, session);
+    trace_end(session->trace);
+    if (after_substitutions == NULL) {
+        return NULL;
+    }
+#else
+    after_substitutions = init_array(NULL);
+    array_add(after_substitutions, input);
+#endif
+
+    // Variable expansion
     Array *after_variables = NULL;
     if (session->features.variable_expansion) {
-        after_variables = variable_expansion(input, session);
+        trace_begin(session->trace, "expansion", "variables", NULL);
+        after_variables = apply(after_substitutions, variable_expansion, session);
+        trace_end(session->trace);
+        free_array(after_substitutions);
+        free(after_substitutions);
         if (after_variables == NULL) {
             return NULL;
         }
     } else {
-        // Skip variable expansion, create single-item array
-        after_variables = init_array(NULL);
-        array_add(after_variables, input);
+        after_variables = after_substitutions;
     }
 
     // Tilde expansion
     Array *after_tildes = NULL;
     if (session->features.tilde_expansion) {
+        trace_begin(session->trace, "expansion", "tildes", NULL);
         after_tildes = apply(after_variables, tilde_expansion, session);
+        trace_end(session->trace);
         free_array(after_variables);
         free(after_variables);
         if (after_tildes == NULL) {
@@ -63,7 +89,9 @@ Array *full_expansion(char *input, Session *session) {
     // Brace expansion
     Array *after_braces = NULL;
     if (session->features.brace_expansion) {
+        trace_begin(session->trace, "expansion", "braces", NULL);
         after_braces = apply(after_tildes, brace_expansion, session);
+        trace_end(session->trace);
         free_array(after_tildes);
         free(after_tildes);
         if (after_braces == NULL) {
@@ -76,12 +104,17 @@ Array *full_expansion(char *input, Session *session) {
     // Filename expansion (globbing)
     Array *after_filenames = NULL;
     if (session->features.filename_expansion) {
+        trace_begin(session->trace, "expansion", "filenames", NULL);
         after_filenames = apply(after_braces, filename_expansion, session);
+        trace_end(session->trace);
         free_array(after_braces);
         free(after_braces);
     } else {
         after_filenames = after_braces;
     }
 
+    if (after_filenames) {
+        session->stats.words += after_filenames->count;
+    }
     return after_filenames;
 }
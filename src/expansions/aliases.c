@@ -3,7 +3,7 @@
 
 #include "data/array.h"         /* init_array, array_add, Array */
 #include "expansions/aliases.h" /* alias_expansion */
-#include "lexer.h" /* LexerInput, init_lexer_input, lexer_next_token, TOKEN_EOF */
+#include "lexer.h" /* LexerInput, init_lexer_input, lexer_next_token, lexer_token_value, TOKEN_EOF */
 #include "session.h" /* Session, aliases_get */
 
 #ifndef TIDESH_DISABLE_ALIASES
@@ -28,7 +28,7 @@ Array *alias_expansion(char *input, Session *session) {
     LexerToken token;
     while ((token = lexer_next_token(&lexer_in)).type != TOKEN_EOF) {
         if (token.type == TOKEN_WORD) {
-            array_add(results, token.value);
+            array_add(results, lexer_token_value(&token));
         } else if (token.type == TOKEN_ASSIGNMENT) {
             // Reconstruct assignment: VAR=VALUE
             size_t val_len   = strlen(token.value);
@@ -2,21 +2,35 @@
 
 #include <ctype.h>   /* isspace, isalpha */
 #include <stdbool.h> /* bool, true, false */
-#include <stdio.h>   /* snprintf */
-#include <stdlib.h>  /* malloc, free, strtol */
-#include <string.h>  /* strdup, strndup, strlen */
-
-#include "data/array.h"   /* Array, init_array, array_add, free_array */
-#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, free_dynamic, dynamic_to_string */
-#include "expansions/braces.h" /* brace_expansion */
+#include <stdint.h>  /* SIZE_MAX */
+#include <stdio.h>   /* fprintf, snprintf, stderr */
+#include <stdlib.h>  /* malloc, calloc, free, strtol */
+#include <string.h>  /* memchr, memset, strchr, strdup, strndup, strlen */
+
+#include "data/array.h"   /* Array, init_array, array_reserve, array_push */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_extend_length, dynamic_clear, dynamic_to_string, free_dynamic */
+#include "environ.h"           /* environ_get */
+#include "expansions/braces.h" /* BraceGenerator, brace_expansion */
 #include "session.h"           /* Session */
 
-/* Find the matching closing brace, handling nested braces */
-static int find_closing_brace(char *str, int start) {
+/* Multiply word counts, saturating at SIZE_MAX */
+static size_t count_multiply(size_t a, size_t b) {
+    if (a != 0 && b > SIZE_MAX / a)
+        return SIZE_MAX;
+    return a * b;
+}
+
+/* Add word counts, saturating at SIZE_MAX */
+static size_t count_add(size_t a, size_t b) {
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
+}
+
+/* Find the matching closing brace before `end`, handling nested braces */
+static int find_closing_brace(const char *str, int start, int end) {
     int depth = 1;
     int i     = start;
 
-    while (str[i] && depth > 0) {
+    while (i < end && depth > 0) {
         if (str[i] == '{')
             depth++;
         else if (str[i] == '}')
@@ -28,7 +42,7 @@ static int find_closing_brace(char *str, int start) {
 }
 
 /* Check if string is a valid range {a..b} */
-static bool is_range(char *str, int start, int end) {
+static bool is_range(const char *str, int start, int end) {
     if (end - start < 4)
         return false; // Need at least "x..y"
 
@@ -41,7 +55,7 @@ static bool is_range(char *str, int start, int end) {
 }
 
 /* Check if string contains a top-level comma */
-static bool has_comma(char *str, int start, int end) {
+static bool has_comma(const char *str, int start, int end) {
     int depth = 0;
     for (int i = start; i < end; i++) {
         if (str[i] == '{')
@@ -54,9 +68,45 @@ static bool has_comma(char *str, int start, int end) {
     return false;
 }
 
-/* Parse and expand a range {start..end} */
-static Array *expand_range(char *str, int start, int end) {
-    Array *result = init_array(NULL);
+static BraceTemplate *parse_template(const char *str, int start, int end);
+
+/* Free a template and everything it contains */
+static void free_template(BraceTemplate *template) {
+    if (!template)
+        return;
+
+    for (size_t i = 0; i < template->length; i++) {
+        BraceSegment *segment = &template->segments[i];
+        for (size_t j = 0; j < segment->alternative_count; j++) {
+            free_template(segment->alternatives[j]);
+        }
+        free(segment->alternatives);
+        free(segment->offsets);
+    }
+    free(template->segments);
+    free(template);
+}
+
+/* Append a new, zeroed segment to a template */
+static BraceSegment *add_segment(BraceTemplate *template,
+                                 BraceSegmentType type) {
+    BraceSegment *segments = realloc(
+        template->segments, (template->length + 1) * sizeof(BraceSegment));
+    if (!segments)
+        return NULL;
+    template->segments = segments;
+
+    BraceSegment *segment = &segments[template->length++];
+    memset(segment, 0, sizeof(BraceSegment));
+    segment->type  = type;
+    segment->count = 1;
+    return segment;
+}
+
+/* Parse a range {start..end} into a segment */
+static void parse_range(BraceSegment *segment, const char *str, int start,
+                        int end) {
+    segment->count = 0;
 
     // Find the ".."
     int dots = -1;
@@ -68,11 +118,13 @@ static Array *expand_range(char *str, int start, int end) {
     }
 
     if (dots == -1)
-        return result;
+        return;
 
     // Extract start and end values
-    char *start_str = strndup(str + start, dots - start);
-    char *end_str   = strndup(str + dots + 2, end - (dots + 2));
+    char *start_copy = strndup(str + start, dots - start);
+    char *end_copy   = strndup(str + dots + 2, end - (dots + 2));
+    char *start_str  = start_copy;
+    char *end_str    = end_copy;
 
     // Trim whitespace
     while (*start_str && isspace(*start_str))
@@ -94,166 +146,297 @@ static Array *expand_range(char *str, int start, int end) {
     if (is_numeric) {
         int len_of_start = strlen(start_str);
         int len_of_end   = strlen(end_str);
-        int len_of_result =
-            len_of_start < len_of_end ? len_of_end : len_of_start;
 
         // Numeric range
-        int step = (start_num <= end_num) ? 1 : -1;
-        for (long i = start_num; step > 0 ? i <= end_num : i >= end_num;
-             i += step) {
-            char buf[32];
-            snprintf(buf, sizeof(buf), "%0*ld", len_of_result, i);
-            array_add(result, buf);
-        }
+        segment->first = start_num;
+        segment->step  = (start_num <= end_num) ? 1 : -1;
+        segment->width = len_of_start < len_of_end ? len_of_end : len_of_start;
+        unsigned long distance =
+            segment->step > 0
+                ? (unsigned long)end_num - (unsigned long)start_num
+                : (unsigned long)start_num - (unsigned long)end_num;
+        segment->count = count_add(distance, 1);
     } else if (strlen(start_str) == 1 && strlen(end_str) == 1 &&
                isalpha(start_str[0]) && isalpha(end_str[0])) {
         // Character range
-        char start_char = start_str[0];
-        char end_char   = end_str[0];
-        int  step       = (start_char <= end_char) ? 1 : -1;
-
-        for (char c = start_char; step > 0 ? c <= end_char : c >= end_char;
-             c += step) {
-            char buf[2] = {c, '\0'};
-            array_add(result, buf);
-        }
+        segment->first   = start_str[0];
+        segment->step    = (start_str[0] <= end_str[0]) ? 1 : -1;
+        segment->letters = true;
+        segment->count =
+            (size_t)((end_str[0] - start_str[0]) * segment->step) + 1;
     }
 
-    free(start_str);
-    free(end_str);
-    return result;
+    free(start_copy);
+    free(end_copy);
 }
 
-/* Split brace content by commas at the current depth level */
-static Array *split_by_comma(char *str, int start, int end) {
-    Array *parts = init_array(NULL);
+/* Parse the alternatives of {a,b,c} into a segment */
+static bool parse_list(BraceSegment *segment, const char *str, int start,
+                       int end) {
+    // Count the alternatives split by top-level commas
+    size_t count = 1;
+    int    depth = 0;
+    for (int i = start; i < end; i++) {
+        if (str[i] == '{')
+            depth++;
+        else if (str[i] == '}')
+            depth--;
+        else if (str[i] == ',' && depth == 0)
+            count++;
+    }
 
-    Dynamic buffer = {0};
-    init_dynamic(&buffer);
-    int depth = 0;
+    segment->alternatives = calloc(count, sizeof(BraceTemplate *));
+    segment->offsets      = malloc((count + 1) * sizeof(size_t));
+    if (!segment->alternatives || !segment->offsets)
+        return false;
 
+    segment->offsets[0] = 0;
+    int part_start      = start;
+    depth               = 0;
     for (int i = start; i <= end; i++) {
-        if (str[i] == '{') {
+        if (i < end && str[i] == '{') {
             depth++;
-            dynamic_append(&buffer, str[i]);
-        } else if (str[i] == '}') {
+        } else if (i < end && str[i] == '}') {
             depth--;
-            dynamic_append(&buffer, str[i]);
-        } else if (str[i] == ',' && depth == 0) {
-            char *part = dynamic_to_string(&buffer);
-            array_add(parts, part);
-            free(part);
-            init_dynamic(&buffer);
-        } else {
-            dynamic_append(&buffer, str[i]);
+        } else if (i == end || (str[i] == ',' && depth == 0)) {
+            BraceTemplate *alternative = parse_template(str, part_start, i);
+            if (!alternative)
+                return false;
+            size_t index                 = segment->alternative_count++;
+            segment->alternatives[index] = alternative;
+            segment->offsets[index + 1] =
+                count_add(segment->offsets[index], alternative->count);
+            part_start = i + 1;
         }
     }
-
-    char *part = dynamic_to_string(&buffer);
-    array_add(parts, part);
-    free(part);
-    free_dynamic(&buffer);
-
-    return parts;
+    segment->count = segment->offsets[segment->alternative_count];
+    return true;
 }
 
-/* Concatenate three strings */
-static char *concat_strings(char *prefix, char *middle, char *suffix) {
-    Dynamic result = {0};
-    init_dynamic(&result);
-
-    dynamic_extend(&result, (char *)prefix);
-    dynamic_extend(&result, (char *)middle);
-    dynamic_extend(&result, (char *)suffix);
-
-    char *str = dynamic_to_string(&result);
-    free_dynamic(&result);
-    return str;
+/* Add the literal text between `start` and `end` to a template */
+static bool add_text(BraceTemplate *template, const char *str, int start,
+                     int end) {
+    if (end <= start)
+        return true;
+
+    BraceSegment *segment = add_segment(template, BRACE_TEXT);
+    if (!segment)
+        return false;
+    segment->text   = str + start;
+    segment->length = end - start;
+    return true;
 }
 
-/* Recursive brace expansion */
-static Array *expand_braces_recursive(char *str) {
-    Array *results = init_array(NULL);
+/* Parse the text between `start` and `end` into a template */
+static BraceTemplate *parse_template(const char *str, int start, int end) {
+    BraceTemplate *template = calloc(1, sizeof(BraceTemplate));
+    if (!template)
+        return NULL;
 
-    int brace_start = -1;
-    int brace_end   = -1;
-    int search_pos  = 0;
+    int  text_start = start;
+    int  search_pos = start;
+    bool ok         = true;
 
-    // Search for the first *expandable* brace pair
-    while (str[search_pos]) {
+    // Expand every *expandable* brace pair, other braces are kept as is
+    while (ok && search_pos < end) {
         // Find next '{'
-        char *open_ptr = strchr(str + search_pos, '{');
+        const char *open_ptr = memchr(str + search_pos, '{', end - search_pos);
         if (!open_ptr)
             break;
         int current_start = open_ptr - str;
 
         // Find matching '}'
-        int current_end = find_closing_brace(str, current_start + 1);
+        int current_end = find_closing_brace(str, current_start + 1, end);
         if (current_end == -1)
             break; // No closing brace
 
-        // Check if expandable
-        if (is_range(str, current_start + 1, current_end) ||
-            has_comma(str, current_start + 1, current_end)) {
-            // Found one!
-            brace_start = current_start;
-            brace_end   = current_end;
-            break;
+        // Top-level commas make a list even if an alternative has a range
+        bool list  = has_comma(str, current_start + 1, current_end);
+        bool range = !list && is_range(str, current_start + 1, current_end);
+        if (!list && !range) {
+            // Not expandable, continue search after this block
+            search_pos = current_end + 1;
+            continue;
         }
 
-        // Not expandable, continue search after this block
-        if (current_end > search_pos) {
-            search_pos = current_end + 1;
+        ok = add_text(template, str, text_start, current_start);
+        BraceSegment *segment =
+            ok ? add_segment(template, range ? BRACE_RANGE : BRACE_LIST)
+               : NULL;
+        if (!segment) {
+            ok = false;
+        } else if (range) {
+            parse_range(segment, str, current_start + 1, current_end);
         } else {
-            // Should not happen if find_closing_brace is correct and advances
-            search_pos++;
+            ok = parse_list(segment, str, current_start + 1, current_end);
         }
+        text_start = search_pos = current_end + 1;
     }
 
-    if (brace_start == -1) {
-        array_add(results, str);
-        return results;
+    if (!ok || !add_text(template, str, text_start, end)) {
+        free_template(template);
+        return NULL;
     }
 
-    // Extract prefix and suffix
-    char *prefix = strndup(str, brace_start);
-    char *suffix = strdup(str + brace_end + 1);
+    // The last segment changes the fastest, like in a counter
+    template->count = 1;
+    for (size_t i = template->length; i > 0; i--) {
+        BraceSegment *segment = &template->segments[i - 1];
+        segment->stride       = template->count;
+        template->count = count_multiply(template->count, segment->count);
+    }
+    return template;
+}
 
-    Array *alternatives;
+/* Write the word with the given index of a template */
+static void write_word(BraceTemplate *template, size_t index, Dynamic *word) {
+    for (size_t i = 0; i < template->length; i++) {
+        BraceSegment *segment = &template->segments[i];
+        size_t        digit   = (index / segment->stride) % segment->count;
+
+        switch (segment->type) {
+            case BRACE_TEXT:
+                dynamic_extend_length(word, segment->text, segment->length);
+                break;
+            case BRACE_LIST: {
+                // Binary search for the alternative producing this word
+                size_t low = 0, high = segment->alternative_count - 1;
+                while (low < high) {
+                    size_t middle = (low + high + 1) / 2;
+                    if (segment->offsets[middle] <= digit)
+                        low = middle;
+                    else
+                        high = middle - 1;
+                }
+                write_word(segment->alternatives[low],
+                           digit - segment->offsets[low], word);
+                break;
+            }
+            case BRACE_RANGE: {
+                char buf[32];
+                int  length;
+                long value = (long)((unsigned long)segment->first +
+                                    (unsigned long)segment->step * digit);
+                if (segment->letters) {
+                    buf[0] = (char)value;
+                    length = 1;
+                } else {
+                    length = snprintf(buf, sizeof(buf), "%0*ld",
+                                      segment->width, value);
+                }
+                dynamic_extend_length(word, buf, (size_t)length);
+                break;
+            }
+        }
+    }
+}
 
-    // Check if it's a range
-    if (is_range(str, brace_start + 1, brace_end)) {
-        alternatives = expand_range(str, brace_start + 1, brace_end);
-    } else {
-        // Split brace content by commas
-        alternatives = split_by_comma(str, brace_start + 1, brace_end - 1);
+BraceGenerator *init_brace_generator(BraceGenerator *generator,
+                                     const char *input) {
+    bool allocated = false;
+    if (!generator) {
+        generator = malloc(sizeof(BraceGenerator));
+        if (!generator)
+            return NULL;
+        allocated = true;
     }
+    memset(generator, 0, sizeof(BraceGenerator));
 
-    // For each alternative, recursively expand
-    for (size_t i = 0; i < alternatives->count; i++) {
-        char *combined = concat_strings(prefix, alternatives->items[i], suffix);
+    generator->input = strdup(input);
+    if (generator->input) {
+        generator->template =
+            parse_template(generator->input, 0, strlen(generator->input));
+    }
+    if (!generator->template || !init_dynamic(&generator->word)) {
+        free_template(generator->template);
+        free(generator->input);
+        if (allocated)
+            free(generator);
+        return NULL;
+    }
 
-        // Recursively expand the combined string
-        Array *sub_results = expand_braces_recursive(combined);
+    generator->count = generator->template->count;
+    return generator;
+}
 
-        for (size_t j = 0; j < sub_results->count; j++) {
-            array_add(results, sub_results->items[j]);
-        }
+char *brace_generator_next(BraceGenerator *generator) {
+    // Words past SIZE_MAX cannot be indexed
+    if (generator->next >= generator->count || generator->count == SIZE_MAX)
+        return NULL;
 
-        free_array(sub_results);
-        free(sub_results);
-        free(combined);
-    }
+    dynamic_clear(&generator->word);
+    write_word(generator->template, generator->next++, &generator->word);
+    return dynamic_to_string(&generator->word);
+}
 
-    free_array(alternatives);
-    free(alternatives);
-    free(prefix);
-    free(suffix);
+void free_brace_generator(BraceGenerator *generator) {
+    if (!generator)
+        return;
 
-    return results;
+    free_template(generator->template);
+    free(generator->input);
+    free_dynamic(&generator->word);
+    generator->template = NULL;
+    generator->input    = NULL;
+}
+
+size_t brace_expansion_limit(Session *session) {
+    char *setting =
+        session ? environ_get(session->environ, "TIDESH_BRACE_LIMIT") : NULL;
+    if (setting && *setting) {
+        long limit = strtol(setting, NULL, 10);
+        if (limit >= 0)
+            return limit == 0 ? SIZE_MAX : (size_t)limit;
+    }
+    return BRACE_EXPANSION_LIMIT;
 }
 
 /* Main brace expansion function */
 Array *brace_expansion(char *input, Session *session) {
-    return expand_braces_recursive(input);
+    Array *results = init_array(NULL);
+    if (!results)
+        return NULL;
+
+    // Words without braces are kept as they are
+    if (!strchr(input, '{')) {
+        array_add(results, input);
+        return results;
+    }
+
+    BraceGenerator generator;
+    if (!init_brace_generator(&generator, input)) {
+        free_array(results);
+        free(results);
+        return NULL;
+    }
+
+    // Every word is known to come, so the array is grown only once
+    size_t limit = brace_expansion_limit(session);
+    if (generator.count > limit || generator.count == SIZE_MAX ||
+        !array_reserve(results, generator.count)) {
+#ifdef PROJECT_NAME
+        fprintf(stderr, "%s: ", PROJECT_NAME);
+#else
+        fprintf(stderr, "tidesh: ");
+#endif
+        if (generator.count <= limit)
+            fprintf(stderr, "brace expansion produces too many words\n");
+        else
+            fprintf(stderr,
+                    "brace expansion produces %zu words, more than the "
+                    "limit of %zu (TIDESH_BRACE_LIMIT)\n",
+                    generator.count, limit);
+        free_brace_generator(&generator);
+        free_array(results);
+        free(results);
+        return NULL;
+    }
+
+    char *word;
+    while ((word = brace_generator_next(&generator)) != NULL) {
+        array_push(results, word);
+    }
+
+    free_brace_generator(&generator);
+    return results;
 }
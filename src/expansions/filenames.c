@@ -1,24 +1,98 @@
 /* Filename (glob) expansion implementation
  *
  * This module handles shell-style glob pattern expansion (wildcards like *, ?,
- * []) for filenames. It processes user input strings, identifies glob patterns,
- * and expands them to matching filenames in the filesystem.
+ * [] and the recursive **) for filenames. It processes user input strings,
+ * identifies glob patterns, and expands them to matching filenames in the
+ * filesystem.
+ *
+ * Patterns are split on '/' and each segment is compiled once. Directories are
+ * then walked relative to their parent's file descriptor, using the entry
+ * types reported by the kernel so that most matches never need a stat call.
  */
 
-#include <ctype.h>    /* isspace */
-#include <dirent.h>   /* DIR, dirent, opendir, readdir, closedir */
-#include <glob.h>     /* glob, globfree, glob_t, GLOB_* */
+#include <dirent.h>   /* DIR, dirent, fdopendir, readdir, closedir, DT_* */
+#include <errno.h>    /* errno, EACCES */
+#include <fcntl.h>    /* openat, O_RDONLY, O_DIRECTORY, O_CLOEXEC, O_PATH */
+#include <fnmatch.h>  /* fnmatch, FNM_PERIOD */
+#include <limits.h>   /* PATH_MAX */
 #include <stdbool.h>  /* bool, true, false */
-#include <stdio.h>    /* fprintf, stderr */
-#include <stdlib.h>   /* malloc, free */
-#include <sys/stat.h> /* stat, struct stat */
+#include <stdint.h>   /* uint64_t, int64_t */
+#include <stdlib.h>   /* malloc, calloc, free */
+#include <string.h>   /* strlen, strcmp, strncmp, memcpy */
+#include <sys/stat.h> /* fstatat, struct stat, S_ISDIR */
+#include <unistd.h>   /* close, dup */
+#ifdef __linux__
+#include <sys/syscall.h> /* SYS_getdents64 */
+#endif
 
 #include "data/array.h" /* Array, init_array, array_add, array_extend, free_array, array_sort */
-#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, free_dynamic, dynamic_to_string */
-#include "environ.h"      /* Environ, environ_get */
+#include "dircache.h" /* DirCache, DirListing, dircache_get_fd, dircache_release */
 #include "expansions/filenames.h" /* filename_expansion */
 #include "session.h"              /* Session */
 
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/* Size of the buffer handed to getdents64 */
+#define GLOB_DIRENT_BUFFER_SIZE 32768
+
+/* Kinds of compiled pattern segments */
+typedef enum GlobSegmentKind {
+    GLOB_SEGMENT_LITERAL,  // No wildcards: looked up directly
+    GLOB_SEGMENT_PATTERN,  // Wildcards: matched against directory entries
+    GLOB_SEGMENT_RECURSIVE // `**`: any number of nested directories
+} GlobSegmentKind;
+
+/* A single '/'-separated component of a compiled glob pattern */
+typedef struct GlobSegment {
+    GlobSegmentKind kind;
+    char           *text;       // Unescaped literal, or the fnmatch pattern
+    bool            match_dots; // Pattern explicitly starts with '.'
+    bool            simple;     // Pattern is `prefix*suffix` (no fnmatch)
+    char           *prefix;     // Literal prefix of a simple pattern
+    size_t          prefix_len; // Length of prefix
+    char           *suffix;     // Literal suffix of a simple pattern
+    size_t          suffix_len; // Length of suffix
+} GlobSegment;
+
+/* State shared by a whole glob walk */
+typedef struct GlobWalk {
+    GlobSegment *segments;       // Compiled segments
+    size_t       count;          // Number of segments
+    bool         directory_only; // Pattern ends with '/'
+    char         path[PATH_MAX]; // Path of the directory being walked
+    size_t       length;         // Length of path
+    Array       *results;        // Matches found so far
+    DirCache    *cache;          // Listing cache, or NULL to always read
+} GlobWalk;
+
+/* An open directory being read entry by entry */
+typedef struct GlobDirectory {
+    DirCache         *cache;   // Cache the listing came from
+    const DirListing *listing; // Cached listing, or NULL when streaming
+    size_t            index;   // Next entry of the cached listing
+#ifdef __linux__
+    int   fd;     // Directory file descriptor (not owned)
+    char *buffer; // getdents64 buffer
+    long  size;   // Bytes currently in buffer
+    long  offset; // Offset of the next entry in buffer
+#else
+    DIR *dir; // Stream over a duplicate of the descriptor
+#endif
+} GlobDirectory;
+
+#ifdef __linux__
+/* Entry layout returned by the getdents64 system call */
+struct glob_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+#endif
+
 /* Check if string contains glob characters */
 static bool has_glob_chars(char *str) {
     for (size_t i = 0; str[i]; i++) {
@@ -29,28 +103,477 @@ static bool has_glob_chars(char *str) {
     return false;
 }
 
+/* Check if a pattern segment contains unescaped glob characters */
+static bool segment_has_glob_chars(const char *segment, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (segment[i] == '\\' && i + 1 < length) {
+            i++;
+        } else if (segment[i] == '*' || segment[i] == '?' ||
+                   segment[i] == '[') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Copy a segment, removing backslash escapes */
+static char *unescape_segment(const char *segment, size_t length) {
+    char  *result = malloc(length + 1);
+    size_t j      = 0;
+    if (!result) {
+        return NULL;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (segment[i] == '\\' && i + 1 < length) {
+            i++;
+        }
+        result[j++] = segment[i];
+    }
+    result[j] = '\0';
+    return result;
+}
+
+/* Copy the first `length` bytes of a string */
+static char *copy_span(const char *start, size_t length) {
+    char *result = malloc(length + 1);
+    if (result) {
+        memcpy(result, start, length);
+        result[length] = '\0';
+    }
+    return result;
+}
+
+/* Compile one segment of a pattern */
+static bool compile_segment(GlobSegment *segment, const char *start,
+                            size_t length) {
+    if (length == 2 && start[0] == '*' && start[1] == '*') {
+        segment->kind = GLOB_SEGMENT_RECURSIVE;
+        return true;
+    }
+
+    if (!segment_has_glob_chars(start, length)) {
+        segment->kind = GLOB_SEGMENT_LITERAL;
+        segment->text = unescape_segment(start, length);
+        return segment->text != NULL;
+    }
+
+    segment->kind       = GLOB_SEGMENT_PATTERN;
+    segment->text       = copy_span(start, length);
+    segment->match_dots = start[0] == '.';
+    if (!segment->text) {
+        return false;
+    }
+
+    // Recognize `prefix*suffix` with plain literals around a single star,
+    // which covers the common `*.c` and `name*` forms without fnmatch
+    const char *star = NULL;
+    bool        plain = true;
+    for (size_t i = 0; i < length; i++) {
+        if (start[i] == '*' && !star) {
+            star = start + i;
+        } else if (start[i] == '*' || start[i] == '?' || start[i] == '[' ||
+                   start[i] == '\\') {
+            plain = false;
+            break;
+        }
+    }
+    if (plain && star) {
+        segment->simple     = true;
+        segment->prefix_len = (size_t)(star - start);
+        segment->prefix     = copy_span(start, segment->prefix_len);
+        segment->suffix_len = length - segment->prefix_len - 1;
+        segment->suffix     = copy_span(star + 1, segment->suffix_len);
+        return segment->prefix && segment->suffix;
+    }
+    return true;
+}
+
+/* Free the compiled segments */
+static void free_segments(GlobSegment *segments, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(segments[i].text);
+        free(segments[i].prefix);
+        free(segments[i].suffix);
+    }
+    free(segments);
+}
+
+/* Split a pattern on '/' and compile every segment */
+static GlobSegment *compile_pattern(const char *pattern, size_t *count) {
+    size_t capacity = 1;
+    for (const char *c = pattern; *c; c++) {
+        if (*c == '/') {
+            capacity++;
+        }
+    }
+
+    GlobSegment *segments = calloc(capacity, sizeof(GlobSegment));
+    if (!segments) {
+        return NULL;
+    }
+
+    *count            = 0;
+    const char *start = pattern;
+    while (*start) {
+        const char *end = start;
+        while (*end && *end != '/') {
+            end++;
+        }
+        // Empty segments come from repeated slashes and are skipped
+        if (end > start) {
+            if (!compile_segment(&segments[*count], start,
+                                 (size_t)(end - start))) {
+                free_segments(segments, *count + 1);
+                return NULL;
+            }
+            (*count)++;
+        }
+        start = *end ? end + 1 : end;
+    }
+    return segments;
+}
+
+/* Match a directory entry name against a pattern segment */
+static bool segment_matches(const GlobSegment *segment, const char *name) {
+    // Hidden entries must be matched explicitly, and `.`/`..` never are
+    if (name[0] == '.') {
+        if (!segment->match_dots || name[1] == '\0' ||
+            (name[1] == '.' && name[2] == '\0')) {
+            return false;
+        }
+    }
+
+    if (segment->simple) {
+        size_t length = strlen(name);
+        return length >= segment->prefix_len + segment->suffix_len &&
+               strncmp(name, segment->prefix, segment->prefix_len) == 0 &&
+               memcmp(name + length - segment->suffix_len, segment->suffix,
+                      segment->suffix_len) == 0;
+    }
+    return fnmatch(segment->text, name, FNM_PERIOD) == 0;
+}
+
+/* Start reading the entries of a directory */
+static bool glob_directory_open(GlobDirectory *directory, int fd,
+                                DirCache *cache) {
+    // Every field is set whichever way the entries are read
+    directory->cache   = cache;
+    directory->listing = cache ? dircache_get_fd(cache, fd) : NULL;
+    directory->index   = 0;
+#ifdef __linux__
+    directory->fd     = fd;
+    directory->buffer = NULL;
+    directory->size   = 0;
+    directory->offset = 0;
+#else
+    directory->dir = NULL;
+#endif
+    if (directory->listing) {
+        return true;
+    }
+
+#ifdef __linux__
+    directory->buffer = malloc(GLOB_DIRENT_BUFFER_SIZE);
+    return directory->buffer != NULL;
+#else
+    int copy = dup(fd);
+    if (copy < 0) {
+        return false;
+    }
+    directory->dir = fdopendir(copy);
+    if (!directory->dir) {
+        close(copy);
+        return false;
+    }
+    return true;
+#endif
+}
+
+/* Read the next entry of a directory, returning false at the end */
+static bool glob_directory_next(GlobDirectory *directory, const char **name,
+                                unsigned char *type) {
+    if (directory->listing) {
+        if (directory->index >= directory->listing->count) {
+            return false;
+        }
+        *name = directory->listing->names[directory->index];
+        *type = directory->listing->types[directory->index];
+        directory->index++;
+        return true;
+    }
+
+#ifdef __linux__
+    if (directory->offset >= directory->size) {
+        directory->size   = syscall(SYS_getdents64, directory->fd,
+                                    directory->buffer, GLOB_DIRENT_BUFFER_SIZE);
+        directory->offset = 0;
+        if (directory->size <= 0) {
+            return false;
+        }
+    }
+    struct glob_dirent64 *entry =
+        (struct glob_dirent64 *)(directory->buffer + directory->offset);
+    directory->offset += entry->d_reclen;
+    *name = entry->d_name;
+    *type = entry->d_type;
+    return true;
+#else
+    struct dirent *entry = readdir(directory->dir);
+    if (!entry) {
+        return false;
+    }
+    *name = entry->d_name;
+    *type = entry->d_type;
+    return true;
+#endif
+}
+
+/* Stop reading a directory */
+static void glob_directory_close(GlobDirectory *directory) {
+    if (directory->listing) {
+        dircache_release(directory->cache, directory->listing);
+        return;
+    }
+
+#ifdef __linux__
+    free(directory->buffer);
+#else
+    closedir(directory->dir);
+#endif
+}
+
+/* Append a component to the walk path, returning the previous length */
+static bool path_push(GlobWalk *walk, const char *name, size_t *saved) {
+    size_t length = strlen(name);
+    if (walk->length + length + 2 > sizeof(walk->path)) {
+        return false;
+    }
+    *saved = walk->length;
+    memcpy(walk->path + walk->length, name, length + 1);
+    walk->length += length;
+    return true;
+}
+
+/* Restore the walk path to a previous length */
+static void path_pop(GlobWalk *walk, size_t saved) {
+    walk->length           = saved;
+    walk->path[walk->length] = '\0';
+}
+
+/* Check if an entry is a directory, following symlinks when asked */
+static bool entry_is_directory(int dir_fd, const char *name,
+                               unsigned char type, bool follow) {
+    if (type == DT_DIR) {
+        return true;
+    }
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow)) {
+        return false;
+    }
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    return S_ISDIR(st.st_mode);
+}
+
+/* Open a subdirectory relative to its parent */
+static int open_subdirectory(int dir_fd, const char *name) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#ifdef O_PATH
+    // Directories that cannot be listed can still be traversed
+    if (fd < 0 && errno == EACCES) {
+        fd = openat(dir_fd, name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+#endif
+    return fd;
+}
+
+/* Record the current path as a match, marking directories with '/' */
+static void add_match(GlobWalk *walk, bool is_directory) {
+    if (walk->directory_only && !is_directory) {
+        return;
+    }
+    if (is_directory) {
+        walk->path[walk->length]     = '/';
+        walk->path[walk->length + 1] = '\0';
+        array_add(walk->results, walk->path);
+        walk->path[walk->length] = '\0';
+    } else {
+        array_add(walk->results, walk->path);
+    }
+}
+
+static void glob_walk(GlobWalk *walk, int dir_fd, size_t index);
+
+/* Descend into a subdirectory of the current directory */
+static void glob_descend(GlobWalk *walk, int dir_fd, const char *name,
+                         size_t index) {
+    int fd = open_subdirectory(dir_fd, name);
+    if (fd < 0) {
+        return;
+    }
+    walk->path[walk->length++] = '/';
+    walk->path[walk->length]   = '\0';
+    glob_walk(walk, fd, index);
+    close(fd);
+}
+
+/* Handle an entry already known to match segment `index` */
+static void glob_accept(GlobWalk *walk, int dir_fd, size_t index,
+                        const char *name, unsigned char type) {
+    size_t saved;
+    if (!path_push(walk, name, &saved)) {
+        return;
+    }
+    if (index + 1 == walk->count) {
+        add_match(walk, entry_is_directory(dir_fd, name, type, true));
+    } else if (type == DT_DIR || type == DT_LNK || type == DT_UNKNOWN) {
+        glob_descend(walk, dir_fd, name, index + 1);
+    }
+    path_pop(walk, saved);
+}
+
+/* Match the entries of `dir_fd` against segments starting at `index` */
+static void glob_walk(GlobWalk *walk, int dir_fd, size_t index) {
+    if (index == walk->count) {
+        // Only reachable through a trailing `**` matching zero directories
+        return;
+    }
+
+    GlobSegment *segment = &walk->segments[index];
+
+    if (segment->kind == GLOB_SEGMENT_LITERAL) {
+        size_t saved;
+        if (!path_push(walk, segment->text, &saved)) {
+            return;
+        }
+        if (index + 1 == walk->count) {
+            struct stat st;
+            if (fstatat(dir_fd, segment->text, &st, 0) == 0) {
+                add_match(walk, S_ISDIR(st.st_mode));
+            }
+        } else {
+            glob_descend(walk, dir_fd, segment->text, index + 1);
+        }
+        path_pop(walk, saved);
+        return;
+    }
+
+    GlobDirectory directory;
+    if (!glob_directory_open(&directory, dir_fd, walk->cache)) {
+        return;
+    }
+
+    const char   *name;
+    unsigned char type;
+
+    if (segment->kind == GLOB_SEGMENT_PATTERN) {
+        while (glob_directory_next(&directory, &name, &type)) {
+            if (segment_matches(segment, name)) {
+                glob_accept(walk, dir_fd, index, name, type);
+            }
+        }
+        glob_directory_close(&directory);
+        return;
+    }
+
+    // `**` matches zero directories here; when the next segment is a
+    // pattern, it is matched against the entries of this same listing
+    bool         last = index + 1 == walk->count;
+    GlobSegment *next = last ? NULL : &walk->segments[index + 1];
+    bool fused = next && next->kind == GLOB_SEGMENT_PATTERN;
+    if (next && !fused) {
+        glob_walk(walk, dir_fd, index + 1);
+    }
+
+    while (glob_directory_next(&directory, &name, &type)) {
+        if (name[0] == '.') {
+            if (fused && segment_matches(next, name)) {
+                glob_accept(walk, dir_fd, index + 1, name, type);
+            }
+            continue;
+        }
+
+        // Symlinks are not followed to avoid walking cycles
+        bool is_directory = entry_is_directory(dir_fd, name, type, false);
+        size_t saved;
+        if (last || (fused && segment_matches(next, name))) {
+            if (last) {
+                if (path_push(walk, name, &saved)) {
+                    add_match(walk,
+                              is_directory ||
+                                  entry_is_directory(dir_fd, name, type, true));
+                    path_pop(walk, saved);
+                }
+            } else {
+                glob_accept(walk, dir_fd, index + 1, name, type);
+            }
+        }
+        if (is_directory && path_push(walk, name, &saved)) {
+            glob_descend(walk, dir_fd, name, index);
+            path_pop(walk, saved);
+        }
+    }
+    glob_directory_close(&directory);
+}
+
 /* Expand a glob pattern to matching filenames */
-static Array *expand_glob(char *pattern) {
+static Array *expand_glob(char *pattern, Session *session) {
     Array *results = init_array(NULL);
 
-    glob_t globbuf;
-    int    flags = GLOB_NOSORT | GLOB_MARK;
+    GlobWalk *walk = calloc(1, sizeof(GlobWalk));
+    if (!walk) {
+        array_add(results, pattern);
+        return results;
+    }
+
+    walk->results        = results;
+    walk->directory_only = pattern[0] && pattern[strlen(pattern) - 1] == '/';
+    walk->segments       = compile_pattern(pattern, &walk->count);
 
-    // Use glob() for expansion
-    int ret = glob(pattern, flags, NULL, &globbuf);
+    // Recursive walks visit far more directories than the cache holds, so
+    // they stream listings instead of evicting everything else
+    bool recursive = false;
+    for (size_t i = 0; walk->segments && i < walk->count; i++) {
+        recursive |= walk->segments[i].kind == GLOB_SEGMENT_RECURSIVE;
+    }
+    walk->cache = session && !recursive ? session->dircache : NULL;
 
-    if (ret == 0) {
-        // Success - add all matches
-        for (size_t i = 0; i < globbuf.gl_pathc; i++) {
-            array_add(results, globbuf.gl_pathv[i]);
+    if (walk->segments && walk->count > 0) {
+        bool absolute = pattern[0] == '/';
+        int  root     = absolute ? open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+                                 : open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (root >= 0) {
+            if (absolute) {
+                walk->path[0] = '/';
+                walk->length  = 1;
+            }
+            glob_walk(walk, root, 0);
+            close(root);
         }
+    }
+
+    if (session) {
+        session->stats.globs++;
+        session->stats.glob_matches += results->count;
+    }
+    if (results->count > 0) {
         array_sort(results);
+        // Consecutive `**` segments can reach the same path more than once
+        for (size_t i = results->count - 1; i > 0; i--) {
+            if (strcmp(results->items[i], results->items[i - 1]) == 0) {
+                array_remove(results, i);
+            }
+        }
     } else {
         // No matches or error - return pattern as-is
         array_add(results, pattern);
     }
 
-    globfree(&globbuf);
+    if (walk->segments) {
+        free_segments(walk->segments, walk->count);
+    }
+    free(walk);
     return results;
 }
 
@@ -62,7 +585,7 @@ Array *filename_expansion(char *input, Session *session) {
 
     if (has_glob_chars(input)) {
         // Expand glob pattern
-        Array *expanded = expand_glob(input);
+        Array *expanded = expand_glob(input, session);
         array_extend(results, expanded);
         free_array(expanded);
         free(expanded);
@@ -72,4 +595,4 @@ Array *filename_expansion(char *input, Session *session) {
     }
 
     return results;
-}
\ No newline at end of file
+}
@@ -0,0 +1,294 @@
+/* Command substitution implementation */
+
+#include <stdbool.h>   /* bool, true, false */
+#include <stdlib.h>    /* malloc, calloc, free, strtol */
+#include <string.h>    /* strlen, strcmp */
+#include <sys/types.h> /* pid_t */
+
+#include "builtin.h"    /* is_special_builtin */
+#include "data/array.h" /* Array, init_array, array_add, free_array */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, dynamic_extend_length, free_dynamic, dynamic_to_string */
+#include "environ.h" /* environ_get */
+#include "execute.h" /* execute_string_stdout, execute_string_stdout_start, execute_string_stdout_finish */
+#include "expansions/substitutions.h" /* command_substitution_expansion */
+#include "lexer.h" /* LexerInput, LexerToken, lexer_next_token, lexer_token_value, TOKEN_* */
+#include "profile.h" /* profile_begin, profile_end, PROFILE_SUBSTITUTION */
+#include "session.h" /* Session */
+
+char *find_command_substitution(const char *input, size_t from, size_t *start,
+                                size_t *end) {
+    size_t i = from;
+    while (input[i]) {
+        if (input[i] == '\\' && input[i + 1] == '$') {
+            // Escaped, left for variable expansion to unescape
+            i += 2;
+            continue;
+        }
+        if (input[i] == '$' && input[i + 1] == '(') {
+            break;
+        }
+        i++;
+    }
+    if (!input[i]) {
+        return NULL;
+    }
+
+    // Same rules as the lexer used to find the closing parenthesis
+    *start = i;
+    i += 2;
+    size_t  depth   = 1;
+    bool    escaped = false;
+    Dynamic command = {0};
+    init_dynamic(&command);
+    while (depth > 0 && input[i]) {
+        char c = input[i++];
+        if (c == '\\' && !escaped) {
+            escaped = true;
+            continue;
+        }
+        if (!escaped && c == '(') {
+            depth++;
+        } else if (!escaped && c == ')' && --depth == 0) {
+            break;
+        }
+        escaped = false;
+        dynamic_append(&command, c);
+    }
+    *end = i;
+
+    char *result = dynamic_to_string(&command);
+    free_dynamic(&command);
+    return result;
+}
+
+/* Take the prefetched output of a command if it is the next one expected */
+static bool take_prefetched(Session *session, const char *command,
+                            char **output) {
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+    SubstitutionBatch *batch = session ? session->substitutions : NULL;
+    if (!batch || batch->next >= batch->commands->count ||
+        strcmp(batch->commands->items[batch->next], command) != 0) {
+        return false;
+    }
+    *output                     = batch->outputs[batch->next];
+    batch->outputs[batch->next] = NULL;
+    batch->next++;
+    return true;
+#else
+    (void)session;
+    (void)command;
+    (void)output;
+    return false;
+#endif
+}
+
+Array *command_substitution_expansion(char *input, Session *session) {
+    Array *results = init_array(NULL);
+
+    if (!input)
+        return results;
+
+    Dynamic buffer = {0};
+    init_dynamic(&buffer);
+
+    size_t i = 0, start, end;
+    char  *command;
+    while ((command = find_command_substitution(input, i, &start, &end))) {
+        dynamic_extend_length(&buffer, input + i, start - i);
+        i = start;
+        char *output = NULL;
+        if (!take_prefetched(session, command, &output)) {
+            profile_begin(session, PROFILE_SUBSTITUTION);
+            output = execute_string_stdout(command, session);
+            profile_end(session);
+        }
+        free(command);
+        if (output) {
+            dynamic_extend(&buffer, output);
+            free(output);
+        }
+        i = end;
+    }
+    dynamic_extend(&buffer, input + i);
+
+    char *result = dynamic_to_string(&buffer);
+    array_add(results, result);
+    free(result);
+    free_dynamic(&buffer);
+    return results;
+}
+
+/* Check if a token ends a simple command, so the next word is a command */
+static bool starts_command(TokenType type) {
+    switch (type) {
+#ifndef TIDESH_DISABLE_PIPES
+        case TOKEN_PIPE:
+        case TOKEN_OR:
+#endif
+#ifndef TIDESH_DISABLE_JOB_CONTROL
+        case TOKEN_BACKGROUND:
+#endif
+#ifndef TIDESH_DISABLE_SEQUENCES
+        case TOKEN_SEQUENCE:
+        case TOKEN_SEMICOLON:
+#endif
+#ifndef TIDESH_DISABLE_SUBSHELLS
+        case TOKEN_LPAREN:
+#endif
+#ifndef TIDESH_DISABLE_CONDITIONALS
+        case TOKEN_IF:
+        case TOKEN_THEN:
+        case TOKEN_ELSE:
+        case TOKEN_ELIF:
+#endif
+        case TOKEN_EOL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Check if a token writes to a file or another process */
+static bool writes_output(TokenType type) {
+    switch (type) {
+#ifndef TIDESH_DISABLE_REDIRECTIONS
+        case TOKEN_REDIRECT_OUT:
+        case TOKEN_REDIRECT_APPEND:
+        case TOKEN_REDIRECT_OUT_ERR:
+#endif
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+        case TOKEN_PROCESS_SUBSTITUTION_OUT:
+#endif
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool substitution_has_side_effects(const char *command, Session *session) {
+    LexerInput input = {0};
+    init_lexer_input(&input, (char *)command, NULL, session);
+
+    bool       side_effects = false;
+    bool       at_command   = true;
+    LexerToken token        = lexer_next_token(&input);
+    while (token.type != TOKEN_EOF && !side_effects) {
+        if (writes_output(token.type)) {
+            side_effects = true;
+        } else if (token.type == TOKEN_WORD) {
+            char *word = lexer_token_value(&token);
+            // Special builtins are the ones that change the session
+            if (at_command && is_special_builtin(word)) {
+                side_effects = true;
+            }
+
+            // Nested substitutions run in the same process as this one
+            size_t from = 0, start, end;
+            char  *nested;
+            while (!side_effects &&
+                   (nested = find_command_substitution(word, from, &start,
+                                                       &end))) {
+                side_effects = substitution_has_side_effects(nested, session);
+                free(nested);
+                from = end;
+            }
+            at_command = false;
+        } else if (starts_command(token.type)) {
+            at_command = true;
+        }
+        free_lexer_token(&token);
+        token = lexer_next_token(&input);
+    }
+    free_lexer_token(&token);
+    free_lexer_input(&input);
+    return side_effects;
+}
+
+SubstitutionBatch *prefetch_substitutions(char **words, size_t count,
+                                          Session *session) {
+    if (!session || !session->features.command_substitution) {
+        return NULL;
+    }
+
+    long  max_jobs = SUBSTITUTION_MAX_JOBS;
+    char *setting  = environ_get(session->environ, "TIDESH_SUBSTITUTION_JOBS");
+    if (setting && *setting) {
+        max_jobs = strtol(setting, NULL, 10);
+    }
+    if (max_jobs < 2) {
+        return NULL;
+    }
+
+    // Collect the substitutions in the order expansion will reach them
+    Array *commands = init_array(NULL);
+    for (size_t i = 0; i < count; i++) {
+        size_t from = 0, start, end;
+        char  *command;
+        while ((command = find_command_substitution(words[i], from, &start,
+                                                    &end))) {
+            array_add(commands, command);
+            free(command);
+            from = end;
+        }
+    }
+
+    bool independent = commands->count >= 2;
+    for (size_t i = 0; independent && i < commands->count; i++) {
+        independent =
+            !substitution_has_side_effects(commands->items[i], session);
+    }
+    if (!independent) {
+        free_array(commands);
+        free(commands);
+        return NULL;
+    }
+
+    SubstitutionBatch *batch = calloc(1, sizeof(SubstitutionBatch));
+    pid_t             *pids  = malloc(commands->count * sizeof(pid_t));
+    int               *fds   = malloc(commands->count * sizeof(int));
+    if (batch) {
+        batch->outputs = calloc(commands->count, sizeof(char *));
+    }
+    if (!batch || !batch->outputs || !pids || !fds) {
+        if (batch) {
+            free(batch->outputs);
+        }
+        free(batch);
+        free(pids);
+        free(fds);
+        free_array(commands);
+        free(commands);
+        return NULL;
+    }
+    batch->commands = commands;
+
+    // Keep up to max_jobs commands running, collecting outputs in order
+    size_t started = 0;
+    for (size_t i = 0; i < commands->count; i++) {
+        while (started < commands->count && started - i < (size_t)max_jobs) {
+            pids[started] = execute_string_stdout_start(
+                commands->items[started], session, &fds[started]);
+            started++;
+        }
+        if (pids[i] != -1) {
+            batch->outputs[i] =
+                execute_string_stdout_finish(pids[i], fds[i], session);
+        }
+    }
+
+    free(pids);
+    free(fds);
+    return batch;
+}
+
+void free_substitution_batch(SubstitutionBatch *batch) {
+    if (!batch) {
+        return;
+    }
+    for (size_t i = 0; i < batch->commands->count; i++) {
+        free(batch->outputs[i]);
+    }
+    free(batch->outputs);
+    free_array(batch->commands);
+    free(batch->commands);
+}
@@ -1,7 +1,7 @@
 /* Tilde expansion implementation */
 
 #include <ctype.h>   /* isspace, isdigit */
-#include <pwd.h>     /* getpwnam, struct passwd */
+#include <pwd.h>     /* getpwnam_r, struct passwd */
 #include <stdbool.h> /* bool, true, false */
 #include <stdio.h>   /* fprintf, stderr */
 #include <stdlib.h>  /* malloc, free, strtol */
@@ -64,7 +64,9 @@ static char *expand_tilde_prefix(char *prefix, Session *session) {
     }
 
     // ~user -> /home/user
-    struct passwd *pw = getpwnam(prefix);
+    struct passwd entry, *pw = NULL;
+    char          buffer[1024];
+    getpwnam_r(prefix, &entry, buffer, sizeof(buffer), &pw);
     if (pw) {
         return strdup(pw->pw_dir);
     }
@@ -221,6 +221,8 @@ Array *variable_expansion(char *input, Session *session) {
                 if (expanded == NULL) {
                     free(expr);
                     free_dynamic(&buffer);
+                    free_array(results);
+                    free(results);
                     return NULL;
                 }
                 free(expr);
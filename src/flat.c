@@ -0,0 +1,294 @@
+#include <stdbool.h> /* bool */
+#include <stdint.h>  /* int32_t, uint32_t, INT32_MAX, UINT32_MAX */
+#include <stdlib.h>  /* malloc, free */
+#include <string.h>  /* memcpy, strlen */
+
+#include "ast.h"          /* ASTNode, Redirection, free_ast, parse */
+#include "data/array.h"   /* Array, free_array */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend_length, free_dynamic */
+#include "expand.h"       /* full_expansion */
+#include "flat.h"
+#include "lexer.h" /* LexerInput, LexerToken, init_lexer_input, lexer_next_token, free_lexer_token, free_lexer_input */
+
+/* A flat buffer being built, one section at a time */
+typedef struct FlatBuilder {
+    Dynamic  inputs;       // An int32_t per input
+    Dynamic  records;      // FlatNode or FlatToken
+    Dynamic  redirects;    // FlatRedirect
+    Dynamic  branches;     // FlatBranch
+    Dynamic  strings;      // NUL terminated strings
+    uint32_t string_count; // Number of strings
+    bool     failed;       // Whether an allocation failed
+} FlatBuilder;
+
+static void init_builder(FlatBuilder *builder) {
+    *builder = (FlatBuilder){0}; // init_dynamic frees what it is given
+    init_dynamic(&builder->inputs);
+    init_dynamic(&builder->records);
+    init_dynamic(&builder->redirects);
+    init_dynamic(&builder->branches);
+    init_dynamic(&builder->strings);
+}
+
+static void free_builder(FlatBuilder *builder) {
+    free_dynamic(&builder->inputs);
+    free_dynamic(&builder->records);
+    free_dynamic(&builder->redirects);
+    free_dynamic(&builder->branches);
+    free_dynamic(&builder->strings);
+}
+
+/* Append an item to a section, returning its index (-1 on failure) */
+static int32_t append_item(FlatBuilder *builder, Dynamic *section,
+                           const void *item, size_t size) {
+    size_t length = section->length;
+    dynamic_extend_length(section, item, size);
+    if (section->length != length + size || length / size >= INT32_MAX) {
+        builder->failed = true;
+        return -1;
+    }
+    return (int32_t)(length / size);
+}
+
+/* Replace an item of a section */
+static void set_item(Dynamic *section, int32_t index, const void *item,
+                     size_t size) {
+    memcpy(section->value + (size_t)index * size, item, size);
+}
+
+/* Add a string to the table, returning its index (-1 on failure) */
+static int32_t add_string(FlatBuilder *builder, const char *string,
+                          size_t length) {
+    size_t before = builder->strings.length;
+    dynamic_extend_length(&builder->strings, string, length);
+    dynamic_append(&builder->strings, '\0');
+    if (builder->strings.length != before + length + 1 ||
+        builder->string_count >= INT32_MAX) {
+        builder->failed = true;
+        return -1;
+    }
+    return (int32_t)builder->string_count++;
+}
+
+/* Flatten a node and its children, returning its index (-1 for NULL) */
+static int32_t flatten_node(FlatBuilder *builder, const ASTNode *node) {
+    if (!node || builder->failed) {
+        return -1;
+    }
+
+    // The strings and redirections of the node come first so that its ranges
+    // are contiguous, its children add theirs after
+    FlatNode flat = {.type  = node->type,
+                     .flags = node->background ? FLAT_NODE_BACKGROUND : 0,
+                     .left  = -1,
+                     .right = -1,
+                     .argv  = (int32_t)builder->string_count,
+                     .argc  = node->argc};
+    for (int i = 0; i < node->argc; i++) {
+        add_string(builder, node->argv[i], strlen(node->argv[i]));
+    }
+
+    flat.assignments = (int32_t)builder->string_count;
+    if (node->assignments) {
+        for (size_t i = 0; i < node->assignments->count; i++) {
+            const char *assignment = node->assignments->items[i];
+            add_string(builder, assignment, strlen(assignment));
+        }
+        flat.assignment_count = (int32_t)node->assignments->count;
+    }
+
+    flat.redirects =
+        (int32_t)(builder->redirects.length / sizeof(FlatRedirect));
+    for (Redirection *r = node->redirects; r; r = r->next) {
+        FlatRedirect redirect = {
+            .fd     = r->fd,
+            .type   = r->type,
+            .target = r->target
+                          ? add_string(builder, r->target, strlen(r->target))
+                          : -1,
+            .flags =
+                r->is_process_substitution ? FLAT_REDIRECT_PROCESS_SUBSTITUTION
+                                           : 0};
+        append_item(builder, &builder->redirects, &redirect, sizeof(redirect));
+        flat.redirect_count++;
+    }
+
+    // Branches are reserved before their conditions and bodies add theirs
+    flat.branches = (int32_t)(builder->branches.length / sizeof(FlatBranch));
+#ifndef TIDESH_DISABLE_CONDITIONALS
+    for (ConditionalBranch *b = node->branches; b; b = b->next) {
+        FlatBranch branch = {.condition = -1, .body = -1};
+        append_item(builder, &builder->branches, &branch, sizeof(branch));
+        flat.branch_count++;
+    }
+#endif
+
+    int32_t index = append_item(builder, &builder->records, &flat, sizeof(flat));
+    if (index < 0) {
+        return -1;
+    }
+
+    flat.left  = flatten_node(builder, node->left);
+    flat.right = flatten_node(builder, node->right);
+#ifndef TIDESH_DISABLE_CONDITIONALS
+    int32_t position = flat.branches;
+    for (ConditionalBranch *b = node->branches; b; b = b->next) {
+        FlatBranch branch = {.condition = flatten_node(builder, b->condition),
+                             .body      = flatten_node(builder, b->body)};
+        if (!builder->failed) {
+            set_item(&builder->branches, position++, &branch, sizeof(branch));
+        }
+    }
+#endif
+    if (!builder->failed) {
+        set_item(&builder->records, index, &flat, sizeof(flat));
+    }
+    return index;
+}
+
+/* Place a section after the previous ones */
+static uint32_t place(size_t *offset, const Dynamic *section) {
+    uint32_t start = (uint32_t)*offset;
+    *offset += section->length;
+    return start;
+}
+
+/* Copy the sections of a builder into a single buffer, and free it */
+static FlatBuffer *finish_builder(FlatBuilder *builder, size_t input_count,
+                                  size_t record_size) {
+    if (builder->failed) {
+        free_builder(builder);
+        return NULL;
+    }
+
+    // Sections hold 4 bytes fields (but the strings, which come last), so
+    // they stay aligned
+    size_t     offset = sizeof(FlatBuffer);
+    FlatBuffer header = {0};
+    header.input_count    = (uint32_t)input_count;
+    header.record_count   = (uint32_t)(record_size
+                                           ? builder->records.length / record_size
+                                           : 0);
+    header.redirect_count =
+        (uint32_t)(builder->redirects.length / sizeof(FlatRedirect));
+    header.branch_count =
+        (uint32_t)(builder->branches.length / sizeof(FlatBranch));
+    header.string_count = builder->string_count;
+    header.strings_size = (uint32_t)builder->strings.length;
+    header.inputs    = place(&offset, &builder->inputs);
+    header.records   = place(&offset, &builder->records);
+    header.redirects = place(&offset, &builder->redirects);
+    header.branches  = place(&offset, &builder->branches);
+    header.strings   = place(&offset, &builder->strings);
+    if (offset > UINT32_MAX) {
+        free_builder(builder);
+        return NULL;
+    }
+    header.size = (uint32_t)offset;
+
+    char *buffer = malloc(offset);
+    if (!buffer) {
+        free_builder(builder);
+        return NULL;
+    }
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + header.inputs, builder->inputs.value,
+           builder->inputs.length);
+    memcpy(buffer + header.records, builder->records.value,
+           builder->records.length);
+    memcpy(buffer + header.redirects, builder->redirects.value,
+           builder->redirects.length);
+    memcpy(buffer + header.branches, builder->branches.value,
+           builder->branches.length);
+    memcpy(buffer + header.strings, builder->strings.value,
+           builder->strings.length);
+    free_builder(builder);
+    return (FlatBuffer *)buffer;
+}
+
+FlatBuffer *flatten_ast(const ASTNode *tree) {
+    FlatBuilder builder;
+    init_builder(&builder);
+    int32_t root = flatten_node(&builder, tree);
+    append_item(&builder, &builder.inputs, &root, sizeof(root));
+    return finish_builder(&builder, 1, sizeof(FlatNode));
+}
+
+FlatBuffer *parse_many(const char *inputs, size_t count, Session *session) {
+    FlatBuilder builder;
+    init_builder(&builder);
+
+    const char *input = inputs;
+    for (size_t i = 0; i < count && !builder.failed; i++) {
+        LexerInput lexer = {0};
+        init_lexer_input(&lexer, (char *)input, NULL, session);
+        ASTNode *tree = parse(&lexer, session);
+        int32_t  root = flatten_node(&builder, tree);
+        append_item(&builder, &builder.inputs, &root, sizeof(root));
+        if (tree) {
+            free_ast(tree);
+            free(tree);
+        }
+        free_lexer_input(&lexer);
+        input += strlen(input) + 1;
+    }
+    return finish_builder(&builder, count, sizeof(FlatNode));
+}
+
+FlatBuffer *tokenize_many(const char *inputs, size_t count, Session *session) {
+    FlatBuilder builder;
+    init_builder(&builder);
+
+    const char *input = inputs;
+    for (size_t i = 0; i < count && !builder.failed; i++) {
+        int32_t first = (int32_t)(builder.records.length / sizeof(FlatToken));
+        append_item(&builder, &builder.inputs, &first, sizeof(first));
+
+        LexerInput lexer = {0};
+        init_lexer_input(&lexer, (char *)input, NULL, session);
+        TokenType type;
+        do {
+            // Plain words are copied from their view of the input
+            LexerToken token = lexer_next_token(&lexer);
+            FlatToken  flat  = {.type = token.type, .value = -1, .extra = -1};
+            if (token.value) {
+                flat.value =
+                    add_string(&builder, token.value, strlen(token.value));
+            } else if (token.start) {
+                flat.value = add_string(&builder, token.start, token.length);
+            }
+            if (token.extra) {
+                flat.extra =
+                    add_string(&builder, token.extra, strlen(token.extra));
+            }
+            append_item(&builder, &builder.records, &flat, sizeof(flat));
+            type = token.type;
+            free_lexer_token(&token);
+        } while (type != TOKEN_EOF && !builder.failed);
+        free_lexer_input(&lexer);
+        input += strlen(input) + 1;
+    }
+    return finish_builder(&builder, count, sizeof(FlatToken));
+}
+
+FlatBuffer *expand_many(const char *inputs, size_t count, Session *session) {
+    FlatBuilder builder;
+    init_builder(&builder);
+
+    const char *input = inputs;
+    for (size_t i = 0; i < count && !builder.failed; i++) {
+        int32_t first = (int32_t)builder.string_count;
+        append_item(&builder, &builder.inputs, &first, sizeof(first));
+
+        Array *words = full_expansion((char *)input, session);
+        if (words) {
+            for (size_t j = 0; j < words->count; j++) {
+                add_string(&builder, words->items[j], strlen(words->items[j]));
+            }
+            free_array(words);
+            free(words);
+        }
+        input += strlen(input) + 1;
+    }
+    return finish_builder(&builder, count, 0);
+}
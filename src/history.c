@@ -1,8 +1,10 @@
+#include <pthread.h> /* pthread_create, pthread_join */
 #include <stdbool.h> /* bool */
 #include <stdio.h>   /* FILE, fopen, fclose, fprintf, getline */
 #include <stdlib.h>  /* malloc, free, realloc, strtol */
 #include <string.h>  /* strdup, strlen, strcat, strchr, strncmp */
 #include <time.h>    /* time */
+#include <unistd.h>  /* getpid */
 
 #include "history.h"       /* History, HistoryEntry */
 #include "prompt/cursor.h" /* visible_length */
@@ -18,11 +20,23 @@ void history_reset_state(History *history) {
     }
 }
 
+/* Store a command for an entry, interning it if the history has a table */
+static char *history_store_command(History *history, const char *command) {
+    if (history->strings) {
+        return (char *)intern_string(history->strings, command);
+    }
+    return strdup(command);
+}
+
 /* Frees a single history entry and its contents */
-static void free_history_entry(HistoryEntry *entry) {
+static void free_history_entry(History *history, HistoryEntry *entry) {
     if (entry) {
         if (entry->command) {
-            free(entry->command);
+            if (history->strings) {
+                intern_release(history->strings, entry->command);
+            } else {
+                free(entry->command);
+            }
             entry->command = NULL;
         }
     }
@@ -59,7 +73,7 @@ static char *escape_newlines(const char *command) {
 }
 
 /* Reads a single entry from file handling multi-line escapes */
-static HistoryEntry *read_entry(FILE *file) {
+static HistoryEntry *read_entry(History *history, FILE *file) {
     char   *full_line = NULL;
     char   *line      = NULL;
     size_t  len       = 0;
@@ -106,8 +120,8 @@ static HistoryEntry *read_entry(FILE *file) {
     long  timestamp   = strtol(full_line, NULL, 10);
     char *escaped_cmd = comma + 1;
 
-    // Unescape command
-    char *command = strdup(escaped_cmd);
+    // Unescape command (in place, as it only gets shorter)
+    char *command = escaped_cmd;
     char *src     = command;
     char *dst     = command;
     while (*src) {
@@ -120,14 +134,13 @@ static HistoryEntry *read_entry(FILE *file) {
     }
     *dst = '\0';
 
-    free(full_line);
-
     HistoryEntry *entry = malloc(sizeof(HistoryEntry));
-    entry->command      = command;
+    entry->command      = history_store_command(history, command);
     entry->timestamp    = timestamp;
     entry->next         = NULL;
     entry->prev         = NULL;
 
+    free(full_line);
     return entry;
 }
 
@@ -145,25 +158,22 @@ History *init_history(History *history) {
     history->disabled      = false;
     history->filepath      = NULL;
     history->owns_filepath = false;
+    history->strings       = NULL;
+    history->pending       = false;
+    history->loading       = false;
+    history->loader_owner  = 0;
+    history->loaded        = NULL;
     return history;
 }
 
-History *load_history(History *history, char *filepath) {
-    history = init_history(history);
-    if (!history)
-        return NULL;
-
-    if (filepath) {
-        history->filepath      = strdup(filepath);
-        history->owns_filepath = history->filepath != NULL;
-    }
-
-    FILE *file = fopen(filepath, "r");
+/* Append the entries of a history file to a history */
+static void read_entries(History *history, const char *filepath) {
+    FILE *file = filepath ? fopen(filepath, "r") : NULL;
     if (!file)
-        return history;
+        return;
 
     HistoryEntry *entry;
-    while ((entry = read_entry(file)) != NULL) {
+    while ((entry = read_entry(history, file)) != NULL) {
         if (history->tail) {
             history->tail->next = entry;
             entry->prev         = history->tail;
@@ -176,13 +186,119 @@ History *load_history(History *history, char *filepath) {
     }
 
     fclose(file);
+}
+
+History *load_history(History *history, char *filepath) {
+    InternTable *strings = history ? history->strings : NULL;
+    history              = init_history(history);
+    if (!history)
+        return NULL;
+    history->strings = strings;
+
+    if (filepath) {
+        history->filepath      = strdup(filepath);
+        history->owns_filepath = history->filepath != NULL;
+    }
+
+    read_entries(history, filepath);
     history_reset_state(history);
     return history;
 }
 
+void history_defer_load(History *history, char *filepath) {
+    if (!history)
+        return;
+
+    if (history->filepath && history->owns_filepath)
+        free(history->filepath);
+    history->filepath      = filepath ? strdup(filepath) : NULL;
+    history->owns_filepath = history->filepath != NULL;
+    history->pending       = history->filepath != NULL;
+}
+
+/* Read the file of a history into a separate one, with copied commands.
+ * The string table is not thread safe, so commands are only interned once
+ * the thread is done. */
+static void *history_loader(void *arg) {
+    History *history = arg;
+    History *loaded  = init_history(NULL);
+    if (loaded)
+        read_entries(loaded, history->filepath);
+    history->loaded = loaded;
+    return NULL;
+}
+
+bool history_load_in_background(History *history) {
+    if (!history || !history->pending || history->loading)
+        return false;
+
+    history->loaded = NULL;
+    if (pthread_create(&history->loader, NULL, history_loader, history) != 0)
+        return false;
+    history->pending      = false;
+    history->loading      = true;
+    history->loader_owner = getpid();
+    return true;
+}
+
+/* Put the entries read by the loader thread before the ones of a history */
+static void history_adopt(History *history, History *loaded) {
+    for (HistoryEntry *entry = loaded->head; entry; entry = entry->next) {
+        if (history->strings) {
+            char *command =
+                (char *)intern_string(history->strings, entry->command);
+            free(entry->command);
+            entry->command = command;
+        }
+    }
+
+    if (loaded->tail) {
+        loaded->tail->next = history->head;
+        if (history->head)
+            history->head->prev = loaded->tail;
+        else
+            history->tail = loaded->tail;
+        history->head = loaded->head;
+        history->size += loaded->size;
+    }
+
+    loaded->head = NULL;
+    loaded->tail = NULL;
+    loaded->size = 0;
+    free_history(loaded);
+    free(loaded);
+}
+
+void history_ensure_loaded(History *history) {
+    if (!history)
+        return;
+
+    if (history->loading) {
+        history->loading = false;
+        if (history->loader_owner == getpid()) {
+            pthread_join(history->loader, NULL);
+            if (history->loaded)
+                history_adopt(history, history->loaded);
+            history->loaded = NULL;
+            history_reset_state(history);
+            return;
+        }
+        // Forked while the thread was running: it does not exist here
+        history->loaded  = NULL;
+        history->pending = true;
+    }
+
+    if (history->pending) {
+        history->pending = false;
+        read_entries(history, history->filepath);
+        history_reset_state(history);
+    }
+}
+
 void history_save(History *history) {
     if (!history || !history->filepath)
         return;
+    history_ensure_loaded(history);
 
     FILE *file = fopen(history->filepath, "w");
     if (!file)
@@ -204,10 +320,21 @@ void free_history(History *history) {
     if (!history)
         return;
 
+    if (history->loading && history->loader_owner == getpid()) {
+        pthread_join(history->loader, NULL);
+        if (history->loaded) {
+            free_history(history->loaded);
+            free(history->loaded);
+        }
+    }
+    history->loading = false;
+    history->pending = false;
+    history->loaded  = NULL;
+
     HistoryEntry *curr = history->head;
     while (curr) {
         HistoryEntry *next = curr->next;
-        free_history_entry(curr);
+        free_history_entry(history, curr);
         free(curr);
         curr = next;
     }
@@ -255,6 +382,7 @@ void history_clear(History *history) {
 bool history_remove(History *history, const char *command, bool all) {
     if (!history || !command || history->disabled)
         return false;
+    history_ensure_loaded(history);
 
     HistoryEntry *curr        = history->head;
     bool          removed_any = false;
@@ -272,7 +400,7 @@ bool history_remove(History *history, const char *command, bool all) {
 
             HistoryEntry *to_free = curr;
             curr                  = curr->next;
-            free_history_entry(to_free);
+            free_history_entry(history, to_free);
             free(to_free);
             history->size--;
             if (!all)
@@ -288,6 +416,7 @@ bool history_remove(History *history, const char *command, bool all) {
 size_t history_enforce_limit(History *history) {
     if (!history)
         return 0;
+    history_ensure_loaded(history);
 
     size_t removed = 0;
     while (history->size > history->limit && history->head) {
@@ -298,7 +427,7 @@ size_t history_enforce_limit(History *history) {
         else
             history->tail = NULL;
 
-        free_history_entry(old);
+        free_history_entry(history, old);
         free(old);
         history->size--;
         removed++;
@@ -310,10 +439,11 @@ void history_append(History *history, const char *command) {
     if (!history || history->disabled || !command ||
         visible_length(command) == 0)
         return;
+    history_ensure_loaded(history);
 
     // Append new
     HistoryEntry *entry = malloc(sizeof(HistoryEntry));
-    entry->command      = strdup(command);
+    entry->command      = history_store_command(history, command);
     entry->timestamp    = (long)time(NULL);
     entry->next         = NULL;
     entry->prev         = history->tail;
@@ -352,6 +482,7 @@ void history_append(History *history, const char *command) {
 }
 
 char *history_get_previous(History *history) {
+    history_ensure_loaded(history);
     if (!history || !history->tail)
         return NULL;
 
@@ -387,6 +518,7 @@ char *history_get_next(History *history) {
 }
 
 char *history_nth_last_command(History *history, size_t n) {
+    history_ensure_loaded(history);
     if (!history || n == 0 || n > history->size) {
         return NULL;
     }
@@ -403,6 +535,7 @@ char *history_nth_last_command(History *history, size_t n) {
 }
 
 char *history_nth_command(History *history, size_t n) {
+    history_ensure_loaded(history);
     if (!history || n == 0 || n > history->size) {
         return NULL;
     }
@@ -419,6 +552,7 @@ char *history_nth_command(History *history, size_t n) {
 }
 
 char *history_last_command(History *history) {
+    history_ensure_loaded(history);
     if (!history || !history->tail) {
         return NULL;
     }
@@ -429,6 +563,7 @@ char *history_last_command_starting_with(History *history, char *prefix) {
     if (!history || !prefix) {
         return NULL;
     }
+    history_ensure_loaded(history);
 
     HistoryEntry *current    = history->tail;
     size_t        prefix_len = strlen(prefix);
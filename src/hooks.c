@@ -5,23 +5,23 @@
 #include <stdlib.h>   /* malloc, free, realloc */
 #include <string.h>   /* strdup, strcmp, strncmp, strlen, strrchr */
 #include <sys/stat.h> /* stat, S_ISREG */
-#include <time.h>     /* time */
+#include <time.h>     /* time, clock_gettime, CLOCK_MONOTONIC */
 
 #include "data/files.h" /* read_all */
 #include "environ.h"    /* environ_get, environ_set, environ_remove */
 #include "execute.h"    /* execute_string */
 #include "hooks.h"      /* HookEnvVar, HOOK_* */
+#include "profile.h"    /* profile_begin_named, profile_end, PROFILE_HOOKS */
 #include "session.h"    /* Session */
 
 #ifndef TIDESH_DISABLE_JOB_CONTROL
-#include "jobs.h" /* jobs_set_state_hook */
+#include "jobs.h" /* jobs_set_state_hook, job_state_name */
 #endif
 
 static void session_env_change_hook(void *context, const char *key,
                                     EnvironChangeType type);
 #ifndef TIDESH_DISABLE_JOB_CONTROL
-static void        session_job_state_hook(void *context, const Job *job);
-static const char *job_state_name(JobState state);
+static void session_job_state_hook(void *context, const Job *job);
 #endif
 
 typedef struct HookEnvBackup {
@@ -166,14 +166,10 @@ static void hook_env_restore(Session *session, HookEnvBackup *backups,
     free(backups);
 }
 
-void run_dir_hook_with_vars(Session *session, const char *dir,
-                            const char *hook_name, const HookEnvVar *vars,
-                            size_t var_count) {
-    if (!session || !dir || !hook_name)
-        return;
-    if (session->hooks_disabled)
-        return;
-
+/* Run the wildcard and named hooks of a directory */
+static void run_dir_hooks(Session *session, const char *dir,
+                          const char *hook_name, const HookEnvVar *vars,
+                          size_t var_count) {
     // Generate TIDE_TIMESTAMP
     char   timestamp_str[32];
     time_t now = time(NULL);
@@ -194,6 +190,7 @@ void run_dir_hook_with_vars(Session *session, const char *dir,
     char wildcard_hook_path[PATH_MAX];
     if (find_hook_file(dir, HOOK_ALL, wildcard_hook_path,
                        sizeof(wildcard_hook_path))) {
+        session->stats.hook_runs++;
         bool hooks_were_disabled = session->hooks_disabled;
         session->hooks_disabled  = true;
 
@@ -252,6 +249,7 @@ void run_dir_hook_with_vars(Session *session, const char *dir,
     char hook_path[PATH_MAX];
     if (!find_hook_file(dir, hook_name, hook_path, sizeof(hook_path)))
         return;
+    session->stats.hook_runs++;
 
     bool hooks_were_disabled = session->hooks_disabled;
     session->hooks_disabled  = true;
@@ -321,6 +319,26 @@ void run_dir_hook_with_vars(Session *session, const char *dir,
 #endif
 }
 
+void run_dir_hook_with_vars(Session *session, const char *dir,
+                            const char *hook_name, const HookEnvVar *vars,
+                            size_t var_count) {
+    if (!session || !dir || !hook_name)
+        return;
+    if (session->hooks_disabled)
+        return;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    profile_begin_named(session, PROFILE_HOOKS, hook_name, dir);
+    run_dir_hooks(session, dir, hook_name, vars, var_count);
+    profile_end(session);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    session->stats.hook_lookups++;
+    session->stats.hook_time +=
+        (uint64_t)((end.tv_sec - start.tv_sec) * 1000000000L +
+                   (end.tv_nsec - start.tv_nsec));
+}
+
 void run_cwd_hook(Session *session, const char *hook_name) {
     if (!session || !session->current_working_dir)
         return;
@@ -396,18 +414,4 @@ static void session_job_state_hook(void *context, const Job *job) {
                              {"TIDE_JOB_STATE", state}};
     run_cwd_hook_with_vars(session, HOOK_AFTER_JOB, job_vars, 3);
 }
-
-static const char *job_state_name(JobState state) {
-    switch (state) {
-        case JOB_RUNNING:
-            return "running";
-        case JOB_STOPPED:
-            return "stopped";
-        case JOB_DONE:
-            return "done";
-        case JOB_KILLED:
-            return "killed";
-    }
-    return "";
-}
 #endif
@@ -8,6 +8,7 @@
 #ifndef TIDESH_DISABLE_JOB_CONTROL
 
 #include "jobs.h"
+#include "trace.h" /* trace_job */
 
 Jobs *init_jobs(void) {
     Jobs *jobs = malloc(sizeof(Jobs));
@@ -21,6 +22,7 @@ Jobs *init_jobs(void) {
     jobs->pgid          = getpgrp(); // Shell's process group
     jobs->state_hook    = NULL;
     jobs->state_context = NULL;
+    jobs->trace         = NULL;
 
     return jobs;
 }
@@ -157,6 +159,50 @@ Job *jobs_get_previous(Jobs *jobs) {
     return previous;
 }
 
+const char *job_state_name(JobState state) {
+    switch (state) {
+        case JOB_RUNNING:
+            return "running";
+        case JOB_STOPPED:
+            return "stopped";
+        case JOB_DONE:
+            return "done";
+        case JOB_KILLED:
+            return "killed";
+    }
+    return "";
+}
+
+void jobs_apply_status(Jobs *jobs, Job *job, int status) {
+    if (!jobs || !job) {
+        return;
+    }
+
+    JobState old_state = job->state;
+
+    if (WIFEXITED(status)) {
+        job->state       = JOB_DONE;
+        job->exit_status = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        job->state       = JOB_KILLED;
+        job->exit_status = 128 + WTERMSIG(status);
+    } else if (WIFSTOPPED(status)) {
+        job->state = JOB_STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        job->state = JOB_RUNNING;
+    }
+
+    // Mark as not notified if state changed
+    if (old_state != job->state) {
+        job->notified = false;
+        trace_job(jobs->trace, job->id, job->pid, job_state_name(job->state));
+        if ((job->state == JOB_DONE || job->state == JOB_KILLED) &&
+            jobs->state_hook) {
+            jobs->state_hook(jobs->state_context, job);
+        }
+    }
+}
+
 void jobs_update(Jobs *jobs) {
     if (!jobs) {
         return;
@@ -169,28 +215,7 @@ void jobs_update(Jobs *jobs) {
             waitpid(job->pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
 
         if (result > 0) {
-            JobState old_state = job->state;
-
-            if (WIFEXITED(status)) {
-                job->state       = JOB_DONE;
-                job->exit_status = WEXITSTATUS(status);
-            } else if (WIFSIGNALED(status)) {
-                job->state       = JOB_KILLED;
-                job->exit_status = 128 + WTERMSIG(status);
-            } else if (WIFSTOPPED(status)) {
-                job->state = JOB_STOPPED;
-            } else if (WIFCONTINUED(status)) {
-                job->state = JOB_RUNNING;
-            }
-
-            // Mark as not notified if state changed
-            if (old_state != job->state) {
-                job->notified = false;
-                if ((job->state == JOB_DONE || job->state == JOB_KILLED) &&
-                    jobs->state_hook) {
-                    jobs->state_hook(jobs->state_context, job);
-                }
-            }
+            jobs_apply_status(jobs, job, status);
         }
     }
 }
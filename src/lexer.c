@@ -1,9 +1,10 @@
 #include <stdbool.h> /* bool, true, false */
 #include <stddef.h>  /* size_t, NULL */
 #include <stdlib.h>  /* malloc, free */
-#include <string.h>  /* strlen, strncmp, strcmp */
+#include <string.h>  /* strlen, strncmp, strdup, strndup, memcmp, memchr */
 
-#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, dynamic_prepend, free_dynamic, dynamic_to_string */
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_append, dynamic_extend, dynamic_extend_length, dynamic_prepend, free_dynamic, dynamic_to_string */
+#include "data/scan.h" /* ScanSet, SCANSET, scan_until */
 #include "environ.h"      /* Environ, environ_get */
 #include "lexer.h"
 #include "session.h" /* Session */
@@ -40,6 +41,7 @@ LexerInput *init_lexer_input(LexerInput *input, char *data,
         }
     }
     input->data    = strdup(data);
+    input->length  = input->data ? strlen(input->data) : 0;
     input->pos     = 0;
     input->execute = execute;
     input->session = session;
@@ -52,6 +54,20 @@ void free_lexer_input(LexerInput *input) {
     }
 }
 
+char *lexer_token_value(LexerToken *token) {
+    if (!token->value && token->start) {
+        token->value = strndup(token->start, token->length);
+    }
+    return token->value;
+}
+
+char *lexer_token_copy(const LexerToken *token) {
+    if (token->value) {
+        return strdup(token->value);
+    }
+    return token->start ? strndup(token->start, token->length) : NULL;
+}
+
 void free_lexer_token(LexerToken *token) {
     if (token->value) {
         free(token->value);
@@ -63,8 +79,57 @@ void free_lexer_token(LexerToken *token) {
     }
 }
 
+/* Bytes that need more than copying, for each kind of word */
+static const ScanSet single_word_stops   = SCANSET(" \t\n\r\\$");
+static const ScanSet single_quoted_stops = SCANSET("'\\$");
+static const ScanSet double_quoted_stops = SCANSET("\"\\$");
+static const ScanSet word_stops          = SCANSET(" \t\n\r|&;()#\\$=<>");
+
+/* Copy the bytes up to the next one in `stops` into a word at once,
+ * returning false if there were none */
+static bool copy_plain_run(LexerInput *input, Dynamic *word,
+                           const ScanSet *stops) {
+    size_t run = scan_until(input->data + input->pos,
+                            input->length - input->pos, stops);
+    dynamic_extend_length(word, input->data + input->pos, run);
+    input->pos += run;
+    return run > 0;
+}
+
+/* Read a word that needs no unescaping as a view of the input,
+ * returning false (without consuming anything) for any other word */
+static bool read_plain_word(LexerInput *input, LexerToken *token) {
+    const char *start = input->data + input->pos;
+    size_t      run   = scan_until(start, input->length - input->pos,
+                                   &word_stops);
+    if (run == 0) {
+        return false;
+    }
+    switch (start[run]) {
+        // Bytes which end a word without changing how it is read
+        case '\0':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+        case '|':
+        case '&':
+        case ';':
+        case '(':
+        case ')':
+        case '#':
+            break;
+        default:
+            return false;
+    }
+    token->start = start;
+    token->length = run;
+    input->pos += run;
+    return true;
+}
+
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
-/* Handle command substitution $(...) or <(...) or >(...) */
+/* Read the command of a process substitution <(...) or >(...) */
 static char *command_substitution(LexerInput *input) {
     char    c       = advance(input); // Consume `(`
     size_t  depth   = 1;
@@ -107,35 +172,53 @@ static char *command_substitution(LexerInput *input) {
     free_dynamic(&command);
     return result_command;
 }
+
+/* Copy a command substitution $(...) into a word as written.
+ * It is only run when the word is expanded (see expansions/substitutions.h),
+ * so commands in branches that are never executed never run. */
+static void copy_command_substitution(LexerInput *input, Dynamic *word) {
+    dynamic_append(word, advance(input)); // Copy `$`
+    dynamic_append(word, advance(input)); // Copy `(`
+    size_t depth   = 1;
+    bool   escaped = false;
+    while (depth > 0 && !is_at_end(input)) {
+        char c = advance(input);
+        if (!escaped && c == '(') {
+            depth++;
+        } else if (!escaped && c == ')') {
+            depth--;
+        }
+        escaped = !escaped && c == '\\';
+        dynamic_append(word, c);
+    }
+}
 #endif /* TIDESH_DISABLE_COMMAND_SUBSTITUTION */
 
 /* Read a single unquoted word from the input */
-static Dynamic read_single_word(LexerInput *input) {
-    Dynamic word_value = {0};
-    init_dynamic(&word_value);
+static void read_single_word(LexerInput *input, Dynamic *word) {
+    init_dynamic(word);
     char c = peek(input);
 
     bool escaped = false;
     while (!is_at_end(input) && c != ' ' && c != '\t' && c != '\n' &&
            c != '\r') {
+        if (!escaped && copy_plain_run(input, word, &single_word_stops)) {
+            c = peek(input);
+            continue;
+        }
         if (!escaped && c == '\\' && peek_next(input) == '$') {
             advance(input); // consume '\\'
-            dynamic_append(&word_value, '\\');
+            dynamic_append(word, '\\');
             advance(input); // consume '$'
-            dynamic_append(&word_value, '$');
+            dynamic_append(word, '$');
             c = peek(input);
             continue;
         }
         if (!escaped && c == '$' && peek_next(input) == '(') {
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
-            advance(input); // consume '$'
-            char *command      = command_substitution(input);
-            char *substitution = input->execute(command, input->session);
-            free(command);
-            dynamic_extend(&word_value, substitution);
-            free(substitution);
+            copy_command_substitution(input, word);
 #else
-            dynamic_append(&word_value, c);
+            dynamic_append(word, c);
             advance(input);
 #endif
             c = peek(input);
@@ -148,42 +231,40 @@ static Dynamic read_single_word(LexerInput *input) {
             continue;
         }
         escaped = false;
-        dynamic_append(&word_value, c);
+        dynamic_append(word, c);
         advance(input);
         c = peek(input);
     }
-
-    return word_value;
 }
 
 /* Read a quoted word from the input */
-static Dynamic read_quoted_word(LexerInput *input) {
-    Dynamic word_value = {0};
-    init_dynamic(&word_value);
+static void read_quoted_word(LexerInput *input, Dynamic *word) {
+    init_dynamic(word);
 
     bool escaped    = false;
     char quote_char = advance(input);
     char c          = peek(input);
 
-    while (!is_at_end(input) && c != quote_char) {
+    const ScanSet *stops =
+        quote_char == '\'' ? &single_quoted_stops : &double_quoted_stops;
+    while (!is_at_end(input) && (escaped || c != quote_char)) {
+        if (!escaped && copy_plain_run(input, word, stops)) {
+            c = peek(input);
+            continue;
+        }
         if (!escaped && c == '\\' && peek_next(input) == '$') {
             advance(input); // consume '\\'
-            dynamic_append(&word_value, '\\');
+            dynamic_append(word, '\\');
             advance(input); // consume '$'
-            dynamic_append(&word_value, '$');
+            dynamic_append(word, '$');
             c = peek(input);
             continue;
         }
         if (!escaped && c == '$' && peek_next(input) == '(') {
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
-            advance(input); // consume '$'
-            char *command      = command_substitution(input);
-            char *substitution = input->execute(command, input->session);
-            free(command);
-            dynamic_extend(&word_value, substitution);
-            free(substitution);
+            copy_command_substitution(input, word);
 #else
-            dynamic_append(&word_value, c);
+            dynamic_append(word, c);
             advance(input);
 #endif
             c = peek(input);
@@ -196,7 +277,7 @@ static Dynamic read_quoted_word(LexerInput *input) {
             continue;
         }
         escaped = false;
-        dynamic_append(&word_value, c);
+        dynamic_append(word, c);
         advance(input);
         c = peek(input);
     }
@@ -204,10 +285,8 @@ static Dynamic read_quoted_word(LexerInput *input) {
     if (c == quote_char) {
         advance(input); // consume closing quote
     } else {
-        dynamic_prepend(&word_value, quote_char);
+        dynamic_prepend(word, quote_char);
     }
-
-    return word_value;
 }
 
 /* Skip whitespace characters in the input */
@@ -221,18 +300,21 @@ static void skip_whitespaces(LexerInput *input) {
 
 #ifndef TIDESH_DISABLE_CONDITIONALS
 /* Check if a word is a conditional keyword */
-static TokenType check_conditional_keyword(const char *word) {
-    if (strcmp(word, "if") == 0) {
+static TokenType check_conditional_keyword(const char *word, size_t length) {
+#define IS_KEYWORD(keyword)                                                    \
+    (length == sizeof(keyword) - 1 && memcmp(word, keyword, length) == 0)
+    if (IS_KEYWORD("if")) {
         return TOKEN_IF;
-    } else if (strcmp(word, "then") == 0) {
+    } else if (IS_KEYWORD("then")) {
         return TOKEN_THEN;
-    } else if (strcmp(word, "else") == 0) {
+    } else if (IS_KEYWORD("else")) {
         return TOKEN_ELSE;
-    } else if (strcmp(word, "elif") == 0) {
+    } else if (IS_KEYWORD("elif")) {
         return TOKEN_ELIF;
-    } else if (strcmp(word, "fi") == 0) {
+    } else if (IS_KEYWORD("fi")) {
         return TOKEN_FI;
     }
+#undef IS_KEYWORD
     return TOKEN_WORD;
 }
 #endif
@@ -243,8 +325,10 @@ LexerToken lexer_next_token(LexerInput *input) {
     char c = peek(input);
 
     LexerToken token;
-    token.value = NULL;
-    token.extra = NULL;
+    token.value  = NULL;
+    token.extra  = NULL;
+    token.start  = NULL;
+    token.length = 0;
 
     if (is_at_end(input)) {
         token.type = TOKEN_EOF;
@@ -258,12 +342,13 @@ LexerToken lexer_next_token(LexerInput *input) {
     }
 
     if (c == '\\') {
-        // Handle escaped characters
+        // Handle escaped characters (read_single_word consumes the
+        // backslash, keeping it only in front of `$`)
         token.type = TOKEN_WORD;
-        advance(input); // consume backslash
 
-        Dynamic word_value = read_single_word(input);
-        token.value        = dynamic_to_string(&word_value);
+        Dynamic word_value = {0};
+        read_single_word(input, &word_value);
+        token.value = dynamic_to_string(&word_value);
         free_dynamic(&word_value);
 
         return token;
@@ -283,9 +368,10 @@ LexerToken lexer_next_token(LexerInput *input) {
                 }
             } else {
                 // Pipes disabled, treat | as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
             break;
@@ -354,16 +440,18 @@ LexerToken lexer_next_token(LexerInput *input) {
                 token.type = TOKEN_SEMICOLON;
             } else {
                 // Sequences disabled, treat ; as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
 #else
             // Sequences disabled, treat ; as a normal word
-            Dynamic word_value = read_single_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_single_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
 #endif
             break;
@@ -385,9 +473,9 @@ LexerToken lexer_next_token(LexerInput *input) {
                         Dynamic word_value = {0};
                         char    next       = peek(input);
                         if (next == '"' || next == '\'') {
-                            word_value = read_quoted_word(input);
+                            read_quoted_word(input, &word_value);
                         } else {
-                            word_value = read_single_word(input);
+                            read_single_word(input, &word_value);
                         }
                         token.value = dynamic_to_string(&word_value);
                         free_dynamic(&word_value);
@@ -406,9 +494,9 @@ LexerToken lexer_next_token(LexerInput *input) {
                         Dynamic word_value = {0};
                         char    next       = peek(input);
                         if (next == '"' || next == '\'') {
-                            word_value = read_quoted_word(input);
+                            read_quoted_word(input, &word_value);
                         } else {
-                            word_value = read_single_word(input);
+                            read_single_word(input, &word_value);
                         }
                         char  *end_marker     = dynamic_to_string(&word_value);
                         size_t end_marker_len = word_value.length;
@@ -462,9 +550,10 @@ LexerToken lexer_next_token(LexerInput *input) {
                     if (input->session &&
                         !input->session->features.command_substitution) {
                         // Command substitution disabled, treat <( as word
-                        Dynamic word_value = read_single_word(input);
-                        token.type         = TOKEN_WORD;
-                        token.value        = dynamic_to_string(&word_value);
+                        Dynamic word_value = {0};
+                        read_single_word(input, &word_value);
+                        token.type  = TOKEN_WORD;
+                        token.value = dynamic_to_string(&word_value);
                         free_dynamic(&word_value);
                     } else {
                         token.type  = TOKEN_PROCESS_SUBSTITUTION_IN;
@@ -472,9 +561,10 @@ LexerToken lexer_next_token(LexerInput *input) {
                     }
 #else
                     // Command substitution disabled, treat <( as word
-                    Dynamic word_value = read_single_word(input);
-                    token.type         = TOKEN_WORD;
-                    token.value        = dynamic_to_string(&word_value);
+                    Dynamic word_value = {0};
+                    read_single_word(input, &word_value);
+                    token.type  = TOKEN_WORD;
+                    token.value = dynamic_to_string(&word_value);
                     free_dynamic(&word_value);
 #endif
                 } else {
@@ -482,16 +572,18 @@ LexerToken lexer_next_token(LexerInput *input) {
                 }
             } else {
                 // Redirections disabled, treat < as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
 #else
             // Redirections disabled, treat < as a normal word
-            Dynamic word_value = read_single_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_single_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
 #endif
             break;
@@ -513,9 +605,10 @@ LexerToken lexer_next_token(LexerInput *input) {
                     if (input->session &&
                         !input->session->features.command_substitution) {
                         // Command substitution disabled, treat >( as word
-                        Dynamic word_value = read_single_word(input);
-                        token.type         = TOKEN_WORD;
-                        token.value        = dynamic_to_string(&word_value);
+                        Dynamic word_value = {0};
+                        read_single_word(input, &word_value);
+                        token.type  = TOKEN_WORD;
+                        token.value = dynamic_to_string(&word_value);
                         free_dynamic(&word_value);
                     } else {
                         token.type  = TOKEN_PROCESS_SUBSTITUTION_OUT;
@@ -523,9 +616,10 @@ LexerToken lexer_next_token(LexerInput *input) {
                     }
 #else
                     // Command substitution disabled, treat >( as word
-                    Dynamic word_value = read_single_word(input);
-                    token.type         = TOKEN_WORD;
-                    token.value        = dynamic_to_string(&word_value);
+                    Dynamic word_value = {0};
+                    read_single_word(input, &word_value);
+                    token.type  = TOKEN_WORD;
+                    token.value = dynamic_to_string(&word_value);
                     free_dynamic(&word_value);
 #endif
                 } else {
@@ -533,16 +627,18 @@ LexerToken lexer_next_token(LexerInput *input) {
                 }
             } else {
                 // Redirections disabled, treat > as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
 #else
             // Redirections disabled, treat > as a normal word
-            Dynamic word_value = read_single_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_single_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
 #endif
             break;
@@ -555,16 +651,18 @@ LexerToken lexer_next_token(LexerInput *input) {
                 token.type = TOKEN_LPAREN;
             } else {
                 // Subshells disabled, treat ( as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
 #else
             // Subshells disabled, treat ( as a normal word
-            Dynamic word_value = read_single_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_single_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
 #endif
             break;
@@ -576,47 +674,52 @@ LexerToken lexer_next_token(LexerInput *input) {
                 token.type = TOKEN_RPAREN;
             } else {
                 // Subshells disabled, treat ) as a normal word
-                Dynamic word_value = read_single_word(input);
-                token.type         = TOKEN_WORD;
-                token.value        = dynamic_to_string(&word_value);
+                Dynamic word_value = {0};
+                read_single_word(input, &word_value);
+                token.type  = TOKEN_WORD;
+                token.value = dynamic_to_string(&word_value);
                 free_dynamic(&word_value);
             }
 #else
             // Subshells disabled, treat ) as a normal word
-            Dynamic word_value = read_single_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_single_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
 #endif
             break;
         case '"':
         case '\'': {
-            Dynamic word_value = read_quoted_word(input);
-            token.type         = TOKEN_WORD;
-            token.value        = dynamic_to_string(&word_value);
+            Dynamic word_value = {0};
+            read_quoted_word(input, &word_value);
+            token.type  = TOKEN_WORD;
+            token.value = dynamic_to_string(&word_value);
             free_dynamic(&word_value);
         } break;
         case '#': {
             // Comment: consume until end of line
             advance(input); // consume '#'
-            Dynamic word_value = {0};
-            init_dynamic(&word_value);
-
-            char c = peek(input);
-            while (!is_at_end(input) && c != '\n') {
-                dynamic_append(&word_value, c);
-                advance(input);
-                c = peek(input);
-            }
+            const char *comment = input->data + input->pos;
+            const char *eol =
+                memchr(comment, '\n', input->length - input->pos);
+            size_t length = eol ? (size_t)(eol - comment) : strlen(comment);
+            input->pos += length;
 
             token.type  = TOKEN_COMMENT;
-            token.value = dynamic_to_string(&word_value);
-            free_dynamic(&word_value);
+            token.value = strndup(comment, length);
         } break;
 
         default:
             // Handle words, IO numbers and assignments
-            token.type           = TOKEN_WORD;
+            token.type = TOKEN_WORD;
+            if (read_plain_word(input, &token)) {
+#ifndef TIDESH_DISABLE_CONDITIONALS
+                token.type = check_conditional_keyword(token.start, token.length);
+#endif
+                break;
+            }
+
             bool    is_io_number = true;
             bool    escaped      = false;
             Dynamic word_value   = {0};
@@ -625,6 +728,12 @@ LexerToken lexer_next_token(LexerInput *input) {
             while (!is_at_end(input) && c != ' ' && c != '\t' && c != '\n' &&
                    c != '\r' && c != '|' && c != '&' && c != ';' && c != '(' &&
                    c != ')' && c != '#') {
+                if (!escaped && !is_io_number &&
+                    copy_plain_run(input, &word_value, &word_stops)) {
+                    c = peek(input);
+                    continue;
+                }
+
 #ifndef TIDESH_DISABLE_REDIRECTIONS
                 if (is_io_number && (c < '0' || c > '9')) {
                     if (c == '>' || c == '<') {
@@ -641,13 +750,7 @@ LexerToken lexer_next_token(LexerInput *input) {
 
                 if (!escaped && c == '$' && peek_next(input) == '(') {
 #ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
-                    advance(input); // consume '$'
-                    char *command = command_substitution(input);
-                    char *substitution =
-                        input->execute(command, input->session);
-                    free(command);
-                    dynamic_extend(&word_value, substitution);
-                    free(substitution);
+                    copy_command_substitution(input, &word_value);
 #else
                     dynamic_append(&word_value, c);
                     advance(input);
@@ -663,6 +766,11 @@ LexerToken lexer_next_token(LexerInput *input) {
                     continue;
                 }
 
+                if (escaped && c == '$') {
+                    // Keep the escape so expansions leave the `$` alone
+                    dynamic_append(&word_value, '\\');
+                }
+
                 if (!escaped && !is_io_number && c == '=' &&
                     word_value.length > 0) {
 #ifndef TIDESH_DISABLE_ASSIGNMENTS
@@ -671,11 +779,13 @@ LexerToken lexer_next_token(LexerInput *input) {
                     c          = peek(input);
                     token.type = TOKEN_ASSIGNMENT;
                     if (c == '"' || c == '\'') {
-                        Dynamic quoted_value = read_quoted_word(input);
+                        Dynamic quoted_value = {0};
+                        read_quoted_word(input, &quoted_value);
                         token.extra          = dynamic_to_string(&quoted_value);
                         free_dynamic(&quoted_value);
                     } else {
-                        Dynamic unquoted_value = read_single_word(input);
+                        Dynamic unquoted_value = {0};
+                        read_single_word(input, &unquoted_value);
                         token.extra = dynamic_to_string(&unquoted_value);
                         free_dynamic(&unquoted_value);
                     }
@@ -699,7 +809,8 @@ LexerToken lexer_next_token(LexerInput *input) {
 #ifndef TIDESH_DISABLE_CONDITIONALS
             // Check if the word is a conditional keyword
             if (token.type == TOKEN_WORD) {
-                token.type = check_conditional_keyword(token.value);
+                token.type = check_conditional_keyword(token.value,
+                                                       strlen(token.value));
             }
 #endif
             break;
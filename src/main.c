@@ -1,23 +1,28 @@
+#include <fcntl.h>  /* open, O_RDONLY, O_CLOEXEC */
 #include <limits.h> /* PATH_MAX */
 #include <pwd.h>    /* getpwuid, struct passwd */
 #include <signal.h> /* signal, SIGINT, SIGQUIT, SIG_IGN */
 #include <stdio.h>  /* printf */
 #include <stdlib.h> /* free */
 #include <string.h> /* strcmp, strdup */
-#include <unistd.h> /* getuid */
+#include <unistd.h> /* getuid, close, STDIN_FILENO */
 
 #include "ast.h"        /* parse */
 #include "data/array.h" /* array_pop, free_array */
-#include "data/files.h" /* read_all */
 #include "data/trie.h"
 #include "environ.h" /* environ_get */
 #include "execute.h" /* execute */
 #include "expand.h"  /* full_expansion */
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+#include "expansions/substitutions.h" /* prefetch_substitutions, free_substitution_batch */
+#endif
 #include "hooks.h"   /* HOOK_* */
 #include "lexer.h"   /* free_lexer_token, LexerInput, LexerToken, TOKEN_* */
 #include "prompt.h"
 #include "prompt/ansi.h" /* ansi_apply */
+#include "script.h"      /* execute_script */
 #include "session.h"     /* init_session, Session */
+#include "startup.h" /* startup_trace_begin, startup_trace_step, startup_trace_report */
 
 #define PS1 "❱ "
 #define PS2 "╌ "
@@ -58,7 +63,18 @@ static char *expand_prompt(const char *prompt, Session *session) {
         return NULL;
     }
 
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+    // Prompts often hold several slow substitutions (git, date, ...)
+    SubstitutionBatch *batch       = prefetch_substitutions(&input, 1, session);
+    SubstitutionBatch *outer_batch = session->substitutions;
+    session->substitutions         = batch;
+#endif
     Array *expanded = full_expansion(input, session);
+#ifndef TIDESH_DISABLE_COMMAND_SUBSTITUTION
+    session->substitutions = outer_batch;
+    free_substitution_batch(batch);
+    free(batch);
+#endif
     free(input);
     if (!expanded) {
         return strdup(prompt);
@@ -134,10 +150,13 @@ static void print_usage(const char *prog_name, bool colors) {
            "Disable terminal colors");
     printf("  %s%-20s%s %s\n", option_clr, "--disable-history", reset,
            "Disable command history");
+    printf("  %s%-20s%s %s\n", option_clr, "--startup-trace", reset,
+           "Print the time each startup step takes");
 }
 
 #ifndef TESTING
 int main(int argc, char **argv) {
+    startup_trace_begin();
     signal(SIGINT, SIG_IGN);
     signal(SIGQUIT, SIG_IGN);
 
@@ -182,6 +201,8 @@ int main(int argc, char **argv) {
             disable_colors = true;
         } else if (strcmp(argv[i], "--disable-history") == 0) {
             disable_history = true;
+        } else if (strcmp(argv[i], "--startup-trace") == 0) {
+            startup_trace_enable();
         } else if (script_path == NULL) {
             script_path = argv[i];
         }
@@ -199,9 +220,12 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    startup_trace_step("arguments");
+
     // Get the user's home directory
     struct passwd *pw = getpwuid(getuid());
     Session       *session;
+    startup_trace_step("user lookup");
 
     // Set default history path
     char history_path[PATH_MAX] = {0};
@@ -214,6 +238,15 @@ int main(int argc, char **argv) {
     }
     session = init_session(NULL, history_path);
 
+#ifndef TIDESH_DISABLE_HISTORY
+    // Only interactive shells need the history file: read it while the rc
+    // file runs. Others read it if they use it.
+    if ((!eval_command && !script_path) || keep_alive) {
+        history_load_in_background(session->history);
+        startup_trace_step("history thread");
+    }
+#endif
+
     if (argc > 0)
         environ_set(session->environ, "0", argv[0]);
 
@@ -244,6 +277,8 @@ int main(int argc, char **argv) {
         }
     }
 
+    startup_trace_step("options");
+
     run_cwd_hook(session, HOOK_BEFORE_RC);
 
     // Read and execute .tideshrc if it exists in the home directory
@@ -255,32 +290,31 @@ int main(int argc, char **argv) {
     }
 
     if (rc_path[0] != '\0') {
-        FILE *rc_file = fopen(rc_path, "r");
-        if (rc_file) {
-            char *content = read_all(rc_file);
-            if (content) {
-                // Temporarily disable history for .tideshrc commands
+        int rc_fd = open(rc_path, O_RDONLY | O_CLOEXEC);
+        if (rc_fd >= 0) {
+            // Temporarily disable history for .tideshrc commands
 #ifndef TIDESH_DISABLE_HISTORY
-                bool was_disabled          = session->history->disabled;
-                session->history->disabled = true;
-                execute_string(content, session);
-                session->history->disabled = was_disabled;
+            bool was_disabled          = session->history->disabled;
+            session->history->disabled = true;
+            execute_script(rc_fd, session);
+            session->history->disabled = was_disabled;
 #else
-                execute_string(content, session);
+            execute_script(rc_fd, session);
 #endif
-
-                free(content);
-            }
-            fclose(rc_file);
+            close(rc_fd);
         } else if (custom_rc_path) {
             fprintf(stderr, "tidesh: could not open rc file: %s\n",
                     custom_rc_path);
         }
     }
 
+    startup_trace_step("rc file");
+
     // Run initial parent enter hooks after environment is set up from .tideshrc
     run_initial_parent_hooks(session);
     run_cwd_hook(session, HOOK_SESSION_START);
+    startup_trace_step("startup hooks");
+    startup_trace_report(stderr);
 
     // If an eval command is provided, execute it
     if (eval_command) {
@@ -303,37 +337,33 @@ int main(int argc, char **argv) {
 
     // If a script path is provided, read and execute the script
     if (script_path) {
-        FILE *f = NULL;
+        int fd = -1;
         if (strcmp(script_path, "-") == 0) {
-            f = stdin;
+            fd = STDIN_FILENO;
         } else {
-            f = fopen(script_path, "r");
+            fd = open(script_path, O_RDONLY | O_CLOEXEC);
         }
 
-        if (f) {
-            char *content = read_all(f);
-            if (content) {
-                // Temporarily disable history for script commands
+        if (fd >= 0) {
+            // Temporarily disable history for script commands
 #ifndef TIDESH_DISABLE_HISTORY
-                bool was_disabled          = session->history->disabled;
-                session->history->disabled = true;
-                int exit_status            = execute_string(content, session);
-                session->history->disabled = was_disabled;
+            bool was_disabled          = session->history->disabled;
+            session->history->disabled = true;
+            int exit_status            = execute_script(fd, session);
+            session->history->disabled = was_disabled;
 #else
-                int exit_status = execute_string(content, session);
+            int exit_status = execute_script(fd, session);
 #endif
 
-                free(content);
-
-                if (!keep_alive) {
-                    run_cwd_hook(session, HOOK_SESSION_END);
-                    free_session(session);
-                    free(session);
-                    return exit_status;
-                }
+            if (fd != STDIN_FILENO) {
+                close(fd);
             }
-            if (f != stdin) {
-                fclose(f);
+
+            if (!keep_alive) {
+                run_cwd_hook(session, HOOK_SESSION_END);
+                free_session(session);
+                free(session);
+                return exit_status;
             }
         } else {
 #ifdef PROJECT_NAME
@@ -0,0 +1,167 @@
+#include <stdlib.h>       /* malloc */
+#include <string.h>       /* memset, strcmp */
+#include <sys/resource.h> /* getrusage, RUSAGE_SELF, RUSAGE_CHILDREN */
+#include <sys/time.h>     /* timeradd */
+#include <time.h>         /* clock_gettime, CLOCK_MONOTONIC */
+
+#include "environ.h" /* environ_get */
+#include "profile.h"
+#include "trace.h" /* trace_begin, trace_end */
+
+/* Names of the phases, as printed in reports */
+static const char *phase_names[PROFILE_PHASE_COUNT] = {
+    [PROFILE_SHELL]        = "shell",
+    [PROFILE_PARSE]        = "parse",
+    [PROFILE_SUBSTITUTION] = "substitution",
+    [PROFILE_EXPANSION]    = "expansion",
+    [PROFILE_LOOKUP]       = "path lookup",
+    [PROFILE_HOOKS]        = "hooks",
+    [PROFILE_SPAWN]        = "spawn",
+    [PROFILE_WAIT]         = "wait",
+    [PROFILE_BUILTIN]      = "builtin",
+};
+
+uint64_t profile_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Seconds of CPU time between two timevals */
+static double timeval_seconds(const struct timeval *start,
+                              const struct timeval *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_usec - start->tv_usec) / 1e6;
+}
+
+Profile *init_profile(Profile *profile) {
+    if (!profile) {
+        profile = malloc(sizeof(Profile));
+        if (!profile) {
+            return NULL;
+        }
+    }
+    memset(profile, 0, sizeof(Profile));
+    getrusage(RUSAGE_SELF, &profile->self);
+    getrusage(RUSAGE_CHILDREN, &profile->children);
+    profile->start = profile_now();
+    profile->last  = profile->start;
+    return profile;
+}
+
+bool profile_requested(Session *session) {
+    char *value = environ_get(session->environ, "TIDESH_PROFILE");
+    return value && value[0] && strcmp(value, "0") != 0;
+}
+
+/* Charge the time since the last charge to the current phase */
+static void profile_charge(Profile *profile, uint64_t now) {
+    ProfilePhase current = PROFILE_SHELL;
+    if (profile->depth > 0) {
+        size_t depth = profile->depth < PROFILE_MAX_DEPTH ? profile->depth
+                                                          : PROFILE_MAX_DEPTH;
+        current      = profile->stack[depth - 1];
+    }
+    profile->elapsed[current] += now - profile->last;
+    profile->last = now;
+}
+
+void profile_begin(Session *session, ProfilePhase phase) {
+    profile_begin_named(session, phase, NULL, NULL);
+}
+
+void profile_begin_named(Session *session, ProfilePhase phase,
+                         const char *name, const char *detail) {
+    trace_begin(session->trace, phase_names[phase],
+                name ? name : phase_names[phase], detail);
+    Profile *profile = session->profile;
+    if (!profile) {
+        return;
+    }
+    profile_charge(profile, profile_now());
+    // Phases nested too deep are charged to the deepest one tracked
+    if (profile->depth < PROFILE_MAX_DEPTH) {
+        profile->stack[profile->depth] = phase;
+    }
+    profile->depth++;
+    profile->calls[phase]++;
+}
+
+void profile_end(Session *session) {
+    trace_end(session->trace);
+    Profile *profile = session->profile;
+    if (!profile || profile->depth == 0) {
+        return;
+    }
+    profile_charge(profile, profile_now());
+    profile->depth--;
+}
+
+/* Add a resource usage to another one */
+static void add_usage(struct rusage *total, const struct rusage *usage) {
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+    if (usage->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = usage->ru_maxrss;
+    }
+}
+
+void profile_add_child(Session *session, const struct rusage *usage) {
+    if (session->profile) {
+        add_usage(&session->profile->spawned, usage);
+    }
+}
+
+void profile_merge(Profile *profile, const Profile *other) {
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        profile->elapsed[i] += other->elapsed[i];
+        profile->calls[i] += other->calls[i];
+    }
+    add_usage(&profile->spawned, &other->spawned);
+    // The time the other profile covered is already accounted for
+    profile->last = other->last;
+}
+
+void profile_report(Profile *profile, FILE *output, bool verbose) {
+    profile_charge(profile, profile_now());
+
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    // Children started by the zygote count as the shell's
+    add_usage(&children, &profile->spawned);
+
+    double real = (double)(profile->last - profile->start) / 1e9;
+    double user = timeval_seconds(&profile->self.ru_utime, &self.ru_utime) +
+                  timeval_seconds(&profile->children.ru_utime,
+                                  &children.ru_utime);
+    double sys = timeval_seconds(&profile->self.ru_stime, &self.ru_stime) +
+                 timeval_seconds(&profile->children.ru_stime,
+                                 &children.ru_stime);
+
+    if (verbose) {
+        uint64_t total = profile->last - profile->start;
+        fprintf(output, "%-14s %12s %7s %7s\n", "phase", "time", "share",
+                "calls");
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            if (profile->elapsed[i] == 0 && profile->calls[i] == 0) {
+                continue;
+            }
+            fprintf(output, "%-14s %9.3f ms %6.1f%%", phase_names[i],
+                    (double)profile->elapsed[i] / 1e6,
+                    total ? 100.0 * (double)profile->elapsed[i] / total : 0.0);
+            // The shell phase is never entered, it is what is left
+            if (i != PROFILE_SHELL) {
+                fprintf(output, " %7zu", profile->calls[i]);
+            }
+            fprintf(output, "\n");
+        }
+        fprintf(output, "children: user %.3fs, sys %.3fs, max rss %ld KB\n",
+                timeval_seconds(&profile->children.ru_utime,
+                                &children.ru_utime),
+                timeval_seconds(&profile->children.ru_stime,
+                                &children.ru_stime),
+                children.ru_maxrss);
+    }
+    fprintf(output, "real\t%.3fs\nuser\t%.3fs\nsys\t%.3fs\n", real, user, sys);
+}
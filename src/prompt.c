@@ -1,4 +1,5 @@
 #include <errno.h>   /* errno, EINTR */
+#include <poll.h>    /* poll, struct pollfd, POLLIN */
 #include <stdbool.h> /* bool, true, false */
 #include <stddef.h>  /* size_t, NULL */
 #include <stdio.h>   /* NULL */
@@ -9,8 +10,8 @@
 #include "data/dynamic.h" /* dynamic_extend, dynamic_append, dynamic_to_string */
 #include "data/utf8.h"    /* utf8_strlen */
 #include "history.h" /* history_reset_state, history_get_previous, history_get_next */
-#include "prompt/completion.h" /* completion_apply */
-#include "prompt/cursor.h" /* Cursor, CursorPosition, init_cursor, free_cursor, cursor_* functions, visible_length */
+#include "prompt/completion.h" /* completion_request, completion_receive, completion_cancel */
+#include "prompt/cursor.h" /* Cursor, CursorPosition, init_cursor, free_cursor, cursor_* functions */
 #include "prompt/keyboard.h" /* Key, keyboard_parse, KEY_* */
 #include "prompt/terminal.h" /* terminal_setup, terminal_restore, terminal_write_check_newline, terminal_write, terminal_newline_checked, terminal_check_resize */
 #include "session.h"         /* Session */
@@ -25,9 +26,8 @@ static void handle_key(Key key, Cursor *cursor) {
                 if (key.value == 'u') {
                     cursor_delete_line(cursor);
                 } else if (key.value == 'a') {
-                    CursorPosition pos = cursor_terminal_position(cursor);
-                    cursor_backward(cursor,
-                                    pos.col - visible_length(cursor->prompt));
+                    size_t distance = cursor_bol_distance(cursor);
+                    cursor_backward(cursor, distance);
                 } else if (key.value == 'e') {
                     size_t distance = cursor_eol_distance(cursor);
                     cursor_forward(cursor, distance);
@@ -73,7 +73,7 @@ static void handle_key(Key key, Cursor *cursor) {
 
         case KEY_TAB:
             if (cursor->session->features.completion) {
-                completion_apply(cursor, cursor->session);
+                completion_request(cursor, cursor->session);
             }
             break;
 
@@ -122,15 +122,36 @@ static bool read_until_enter(Cursor *cursor) {
 
     while (1) {
         terminal_check_resize(cursor->session);
+
+        // Keep reading keys while a completion is computed in the background
+        int completion = completion_fd(cursor->session);
+        if (completion >= 0) {
+            struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0},
+                                    {completion, POLLIN, 0}};
+            int ready = poll(fds, 2, completion_timeout(cursor->session));
+            if (ready < 0) {
+                if (errno == EINTR)
+                    continue;
+                completion_cancel(cursor->session);
+                return false;
+            }
+            if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+                completion_receive(cursor, cursor->session);
+                continue;
+            }
+        }
+
         ssize_t nread = read(STDIN_FILENO, temp, PROMPT_BUFFER_SIZE - 1);
 
         if (nread < 0) {
             if (errno == EINTR)
                 continue;
+            completion_cancel(cursor->session);
             return false;
         }
 
         if (nread == 0) {
+            completion_cancel(cursor->session);
             // EOF: if we have data, we should probably process it even if no
             // newline. However, we must ensure we don't loop forever.
             if (cursor->session->exit_requested) {
@@ -146,9 +167,15 @@ static bool read_until_enter(Cursor *cursor) {
         Key   key         = keyboard_parse(temp);
         char *unprocessed = temp + key.read;
 
+        // The line is about to change, so a pending completion is stale
+        if (key.type != KEY_TAB || *unprocessed) {
+            completion_cancel(cursor->session);
+        }
+
         if (cursor->session->terminal->is_visual) {
             cursor_insert(cursor, unprocessed);
         } else {
+            cursor_layout_changed(cursor, cursor->data->length);
             dynamic_extend(cursor->data, unprocessed);
             cursor->visible_length += utf8_strlen(unprocessed);
         }
@@ -222,6 +249,7 @@ char *prompt(char *prompt_str, char *continuation, Session *session,
     if (cursor->session->terminal->is_visual) {
         cursor_append(cursor, '\n');
     } else {
+        cursor_layout_changed(cursor, cursor->data->length);
         dynamic_append(cursor->data, '\n');
         cursor->visible_length += 1;
     }
@@ -247,6 +275,7 @@ char *prompt(char *prompt_str, char *continuation, Session *session,
         if (cursor->session->terminal->is_visual) {
             cursor_append(cursor, '\n');
         } else {
+            cursor_layout_changed(cursor, cursor->data->length);
             dynamic_append(cursor->data, '\n');
             cursor->visible_length += 1;
         }
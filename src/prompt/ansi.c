@@ -2,9 +2,12 @@
 #include <stdbool.h> /* bool */
 #include <stddef.h>  /* size_t */
 #include <stdio.h>   /* NULL */
+#include <stdint.h>  /* uint32_t */
 #include <stdlib.h>  /* malloc */
-#include <string.h>  /* strlen, strcmp, strstr */
+#include <string.h>  /* strlen, strchr, strcmp, strstr, memcpy */
 
+#include "data/scan.h"   /* scan_ascii */
+#include "data/utf8.h"   /* utf8_decode, utf8_codepoint_width */
 #include "prompt/ansi.h"
 
 #define MAX_APPLY_ANSI_CODES 64
@@ -398,19 +401,23 @@ static const char *ansi_skip_sequence(const char *s) {
 }
 
 size_t ansi_strlen(const char *s) {
-    size_t      len = 0;
-    const char *p   = s;
-
     if (!s)
         return 0;
 
+    size_t      len = 0;
+    const char *p   = s;
+
+    // Count the bytes between escape sequences a whole span at a time
     while (*p != '\0') {
-        const char *next_p = ansi_skip_sequence(p);
-        if (next_p > p) {
-            p = next_p; // Skip ANSI sequence
-        } else {
-            len++;
-            p++; // Move to next character
+        const char *escape = strchr(p, ANSI_ESCAPE[0]);
+        if (!escape)
+            return len + strlen(p);
+
+        len += escape - p;
+        p = ansi_skip_sequence(escape);
+        if (p == escape) {
+            len++; // Not a sequence, the escape is a visible character
+            p++;
         }
     }
     return len;
@@ -420,9 +427,6 @@ char *ansi_strip(const char *s) {
     if (!s)
         return NULL;
 
-    size_t      len = 0;
-    const char *p   = s;
-
     size_t stripped_length = ansi_strlen(s);
 
     // Allocate memory for stripped string
@@ -430,15 +434,20 @@ char *ansi_strip(const char *s) {
     if (!stripped)
         return NULL;
 
-    // Copy
-    p          = s;
-    char *dest = stripped;
+    // Copy the spans between escape sequences
+    const char *p    = s;
+    char       *dest = stripped;
     while (*p != '\0') {
-        const char *next_p = ansi_skip_sequence(p);
-        if (next_p > p) {
-            p = next_p; // Skip ANSI sequence
-        } else {
-            *dest++ = *p++; // Copy visible character
+        const char *escape = strchr(p, ANSI_ESCAPE[0]);
+        size_t      span   = escape ? (size_t)(escape - p) : strlen(p);
+        memcpy(dest, p, span);
+        dest += span;
+        if (!escape)
+            break;
+
+        p = ansi_skip_sequence(escape);
+        if (p == escape) {
+            *dest++ = *p++; // Not a sequence, keep the escape
         }
     }
     *dest = '\0';
@@ -446,6 +455,40 @@ char *ansi_strip(const char *s) {
     return stripped;
 }
 
+size_t ansi_width(const char *s) {
+    if (!s)
+        return 0;
+
+    size_t length = strlen(s);
+    size_t width  = 0;
+    size_t i      = 0;
+    while (i < length) {
+        // Pure ASCII text takes one column per byte
+        size_t span = scan_ascii(s + i, length - i, ANSI_ESCAPE[0]);
+        width += span;
+        i += span;
+        if (i >= length)
+            break;
+
+        if (s[i] == ANSI_ESCAPE[0]) {
+            const char *next = ansi_skip_sequence(s + i);
+            if (next > s + i) {
+                i = next - s;
+            } else {
+                width++; // Not a sequence, the escape is a visible character
+                i++;
+            }
+            continue;
+        }
+
+        unsigned char char_length;
+        uint32_t      codepoint = utf8_decode(s + i, length - i, &char_length);
+        width += utf8_codepoint_width(codepoint);
+        i += char_length;
+    }
+    return width;
+}
+
 const char *ansi_next_char(const char *s) {
     if (!s || *s == '\0') {
         return s;
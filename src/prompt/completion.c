@@ -1,19 +1,25 @@
-#include <ctype.h>   /* isspace */
-#include <dirent.h>  /* DIR, opendir, closedir, readdir, struct dirent */
-#include <limits.h>  /* PATH_MAX */
-#include <stdbool.h> /* bool, true, false */
-#include <stdio.h>   /* printf, fflush, stdout, snprintf */
-#include <stdlib.h>  /* malloc, free, realloc, NULL */
-#include <string.h> /* strlen, strcmp, strncmp, strdup, strndup, strncpy, strcpy, strcat, strchr, strrchr */
+#include <ctype.h>     /* isspace */
+#include <dirent.h>    /* DT_DIR, DT_LNK, DT_UNKNOWN */
+#include <fcntl.h>     /* fcntl, F_SETFD, F_SETFL, FD_CLOEXEC, O_NONBLOCK */
+#include <limits.h>    /* PATH_MAX */
+#include <pthread.h>   /* pthread_*, pthread_sigmask */
+#include <signal.h>    /* sigset_t, sigfillset */
+#include <stdatomic.h> /* atomic_ulong, atomic_load, atomic_fetch_add */
+#include <stdbool.h>   /* bool, true, false */
+#include <stdio.h>     /* printf, fflush, stdout, snprintf */
+#include <stdlib.h>    /* malloc, calloc, free, realloc, NULL */
+#include <string.h> /* strlen, strcmp, strncmp, strdup, strndup, strncpy, strcpy, strcat, strchr, strrchr, strtok_r */
 #include <sys/stat.h> /* struct stat, stat, S_ISDIR */
-#include <unistd.h>   /* access, R_OK */
+#include <time.h>     /* clock_gettime, CLOCK_MONOTONIC */
+#include <unistd.h>   /* access, pipe, read, write, close, getpid, X_OK */
 
 #include "builtin.h" /* builtins */
 #include "data/array.h" /* Array, init_array, array_add, array_extend, free_array */
-#include "data/dynamic.h"      /* dynamic_to_string */
-#include "data/trie.h"         /* trie_starting_with */
-#include "environ.h"           /* update_path */
-#include "prompt/completion.h" /* completion_apply */
+#include "data/dynamic.h" /* dynamic_to_string */
+#include "data/trie.h" /* Trie, init_trie, trie_get, trie_set, trie_starting_with, free_trie */
+#include "dircache.h" /* DirCache, DirListing, dircache_get, dircache_release */
+#include "environ.h"  /* environ_get, update_path */
+#include "prompt/completion.h" /* completion_apply, completion_request */
 #include "prompt/cursor.h"     /* Cursor, cursor_insert */
 
 /* Check if a character is a word delimiter in shell */
@@ -76,6 +82,7 @@ static void match_history(const char *prefix, Session *session,
                           Array *matches) {
     if (!session || !session->history || !prefix)
         return;
+    history_ensure_loaded(session->history);
 
     HistoryEntry *curr       = session->history->tail;
     size_t        prefix_len = strlen(prefix);
@@ -112,14 +119,23 @@ static void match_aliases(const char *prefix, Session *session,
 }
 #endif
 
+/* Budget limiting how long a slow source may run for one request */
+typedef struct CompletionBudget {
+    CompletionEngine *engine;     // Engine whose generation is checked
+    unsigned long     generation; // Generation the work belongs to
+    struct timespec   deadline;   // Time after which the source gives up
+} CompletionBudget;
+
+/* Check if a source may keep working (always true without a budget) */
+static bool budget_left(const CompletionBudget *budget);
+
 /* Match executables in PATH */
 static void match_path(const char *prefix, Session *session, Array *matches) {
     if (session->path_commands) {
-        // Do not perform the path update more than once in this function
-        static bool path_updated = false;
-        if (!path_updated) {
+        // Do not perform the path update more than once per session
+        if (!session->path_scanned) {
             update_path(session);
-            path_updated = true;
+            session->path_scanned = true;
         }
 
         Array *path_matches =
@@ -133,7 +149,8 @@ static void match_path(const char *prefix, Session *session, Array *matches) {
 }
 
 /* Match files and directories */
-static void match_files(const char *prefix, Array *matches) {
+static void match_files(const char *prefix, DirCache *cache, Array *matches,
+                        const CompletionBudget *budget) {
     char *dir_path    = ".";
     char *file_prefix = (char *)prefix;
     char *last_slash  = strrchr(prefix, '/');
@@ -148,50 +165,67 @@ static void match_files(const char *prefix, Array *matches) {
         file_prefix = last_slash + 1;
     }
 
-    DIR *dir = opendir(dir_path);
-    if (dir) {
-        size_t         prefix_len = strlen(file_prefix);
-        struct dirent *entry;
-        while ((entry = readdir(dir)) != NULL) {
-            // Skip . and .. always unless prefix starts with .
-            if (entry->d_name[0] == '.' && file_prefix[0] != '.') {
+    // The cache leaves out `.` and `..`, which are still completed
+    static const char *dot_entries[] = {".", ".."};
+    size_t             prefix_len    = strlen(file_prefix);
+    for (size_t i = 0; i < 2 && file_prefix[0] == '.'; i++) {
+        if (strncmp(dot_entries[i], file_prefix, prefix_len) == 0) {
+            char match_str[PATH_MAX];
+            snprintf(match_str, sizeof(match_str), "%.*s%s/",
+                     last_slash ? (int)(last_slash - prefix + 1) : 0, prefix,
+                     dot_entries[i]);
+            array_add(matches, match_str);
+        }
+    }
+
+    // Repeated completions in the same directory reuse the cached listing
+    const DirListing *listing = dircache_get(cache, dir_path);
+    if (listing) {
+        for (size_t i = 0; i < listing->count && budget_left(budget); i++) {
+            const char *name = listing->names[i];
+            // Skip hidden entries unless prefix starts with .
+            if (name[0] == '.' && file_prefix[0] != '.') {
                 continue;
             }
-            if (strncmp(entry->d_name, file_prefix, prefix_len) != 0) {
+            if (strncmp(name, file_prefix, prefix_len) != 0) {
                 continue;
             }
 
             char *match_str;
             if (last_slash) {
                 size_t d_len = strlen(dir_path);
-                size_t e_len = strlen(entry->d_name);
+                size_t e_len = strlen(name);
                 match_str    = malloc(d_len + 1 + e_len + 1);
                 if (match_str) {
                     if (strcmp(dir_path, "/") == 0)
                         snprintf(match_str, d_len + 1 + e_len + 1, "/%s",
-                                 entry->d_name);
+                                 name);
                     else
                         snprintf(match_str, d_len + 1 + e_len + 1, "%s/%s",
-                                 dir_path, entry->d_name);
+                                 dir_path, name);
                 }
             } else {
-                match_str = strdup(entry->d_name);
+                match_str = strdup(name);
             }
 
             if (!match_str)
                 continue;
 
-            // Check if it's a directory to append /
-            struct stat st;
-            char        full_path[PATH_MAX];
-            if (last_slash) {
-                strcpy(full_path, match_str);
-            } else {
+            // Check if it's a directory to append /, only calling stat
+            // when the entry type does not say (symlinks, some filesystems)
+            bool          is_dir = false;
+            unsigned char type   = listing->types[i];
+            if (type == DT_DIR) {
+                is_dir = true;
+            } else if (type == DT_LNK || type == DT_UNKNOWN) {
+                struct stat st;
+                char        full_path[PATH_MAX];
                 snprintf(full_path, sizeof(full_path), "%s/%s", dir_path,
-                         entry->d_name);
+                         name);
+                is_dir = stat(full_path, &st) == 0 && S_ISDIR(st.st_mode);
             }
 
-            if (stat(full_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            if (is_dir) {
                 size_t m_len = strlen(match_str);
                 char  *temp  = realloc(match_str, m_len + 2);
                 if (temp) {
@@ -202,56 +236,75 @@ static void match_files(const char *prefix, Array *matches) {
             array_add(matches, match_str);
             free(match_str);
         }
-        closedir(dir);
+        dircache_release(cache, listing);
     }
     if (temp_dir)
         free(temp_dir);
 }
 
-void completion_apply(Cursor *cursor, Session *session) {
-    char  *data = dynamic_to_string(cursor->data);
-    size_t pos  = cursor->data->length - cursor->position;
+/* Information about the word being completed */
+typedef struct CompletionWord {
+    char  *data;       // Whole line
+    size_t pos;        // Byte offset of the cursor in data
+    char  *prefix;     // Word up to the cursor
+    bool   is_command; // Word is in command position
+} CompletionWord;
 
-    size_t start  = find_word_start(data, pos);
-    char  *prefix = strndup(data + start, pos - start);
+/* Extract the word under the cursor */
+static void completion_word(Cursor *cursor, CompletionWord *word) {
+    word->data = dynamic_to_string(cursor->data);
+    word->pos  = cursor->data->length - cursor->position;
 
-    Array *matches = init_array(NULL);
+    size_t start = find_word_start(word->data, word->pos);
+    word->prefix = strndup(word->data + start, word->pos - start);
 
     // Determine if we are completing a command or a file
-    bool   is_command = true;
-    size_t i          = start;
+    word->is_command = true;
+    size_t i         = start;
     while (i > 0) {
         i--;
-        if (!isspace(data[i])) {
-            if (data[i] == '|' || data[i] == '&' || data[i] == ';' ||
-                data[i] == '(') {
-                is_command = true;
+        if (!isspace(word->data[i])) {
+            if (word->data[i] == '|' || word->data[i] == '&' ||
+                word->data[i] == ';' || word->data[i] == '(') {
+                word->is_command = true;
             } else {
-                is_command = false;
+                word->is_command = false;
             }
             break;
         }
     }
     if (start == 0)
-        is_command = true;
+        word->is_command = true;
+}
+
+/* Check if the word completes against PATH rather than files */
+static bool completes_commands(const CompletionWord *word) {
+    return word->is_command && strchr(word->prefix, '/') == NULL;
+}
 
-    if (is_command && strchr(prefix, '/') == NULL) {
-        if (strlen(prefix) > 0) {
-            match_builtins(prefix, matches);
+/* Collect the in-memory sources, which are always fast enough to run inline */
+static void match_memory_sources(const CompletionWord *word, Session *session,
+                                 Array *matches) {
+    if (completes_commands(word) && strlen(word->prefix) > 0) {
+        match_builtins(word->prefix, matches);
 #ifndef TIDESH_DISABLE_ALIASES
-            match_aliases(prefix, session, matches);
+        match_aliases(word->prefix, session, matches);
 #endif
-            match_path(prefix, session, matches);
-        }
-    } else {
-        match_files(prefix, matches);
     }
+}
+
+/* Insert the completion for a set of matches. Unless `final`, other
+ * sources did not finish: the word is only extended to the common prefix,
+ * and never ended with a space as if it were the only match. */
+static void insert_matches(Cursor *cursor, Session *session,
+                           CompletionWord *word, Array *matches, bool final) {
+    char *prefix = word->prefix;
+    char *line   = NULL;
 
     if (matches->count == 0) {
         // Fallback to history completion if no matches were found
-        free(prefix);
-        start  = 0; // Match entire line up to cursor
-        prefix = strndup(data, pos);
+        line   = strndup(word->data, word->pos); // Entire line up to cursor
+        prefix = line;
 #ifndef TIDESH_DISABLE_HISTORY
         match_history(prefix, session, matches);
 #endif
@@ -262,8 +315,8 @@ void completion_apply(Cursor *cursor, Session *session) {
         if (common && strlen(common) > strlen(prefix)) {
             // Extend the current word
             cursor_insert(cursor, common + strlen(prefix));
-        } else if (matches->count > 1) {
-            // Multiple matches, show them?
+        } else if (matches->count > 1 || !final) {
+            // Multiple (or maybe more) matches, show them?
             // Ring a bell also
             printf("\a");
             fflush(stdout);
@@ -282,8 +335,446 @@ void completion_apply(Cursor *cursor, Session *session) {
         fflush(stdout);
     }
 
+    free(line);
+}
+
+/* Free the strings of a CompletionWord */
+static void free_completion_word(CompletionWord *word) {
+    free(word->prefix);
+    free(word->data);
+    word->prefix = NULL;
+    word->data   = NULL;
+}
+
+void completion_apply(Cursor *cursor, Session *session) {
+    CompletionWord word;
+    completion_word(cursor, &word);
+
+    Array *matches = init_array(NULL);
+    match_memory_sources(&word, session, matches);
+    if (completes_commands(&word)) {
+        if (strlen(word.prefix) > 0) {
+            match_path(word.prefix, session, matches);
+        }
+    } else {
+        match_files(word.prefix, session->dircache, matches, NULL);
+    }
+
+    insert_matches(cursor, session, &word, matches, true);
+
     free_array(matches);
     free(matches);
-    free(prefix);
-    free(data);
+    free_completion_word(&word);
+}
+
+/* Asynchronous completion
+ *
+ * Slow sources (the PATH scan and directory listings) run on a worker thread.
+ * Each Tab press gets a new generation number; any other key bumps it too, so
+ * results computed for an outdated generation are dropped and sources stop
+ * as soon as they notice. The worker never touches the session: it keeps its
+ * own PATH index, built from a snapshot of $PATH and resumed across requests
+ * when it runs out of budget, and its own directory cache.
+ */
+
+struct CompletionEngine {
+    pthread_t       thread;     // Worker thread
+    pid_t           owner;      // Process that started the worker
+    pthread_mutex_t lock;       // Protects the request and result fields
+    pthread_cond_t  wake;       // Signals a new request or shutdown
+    int             notify[2];  // Pipe written by the worker on results
+    atomic_ulong    generation; // Latest generation, older work is stale
+    bool            stopping;   // Worker should exit
+
+    // Request handed to the worker (lock)
+    bool          pending;            // A request is waiting
+    unsigned long request_generation; // Generation of the request
+    char         *request_prefix;     // Word to complete
+    bool          request_commands;   // Complete commands instead of files
+    char         *request_path;       // Snapshot of $PATH
+
+    // Result handed back by the worker (lock)
+    bool          finished;          // Results are ready
+    unsigned long result_generation; // Generation the results belong to
+    Array        *results;           // Matches found by the slow source
+
+    // Request being completed, only used by the prompt thread
+    bool            active;         // A request is in flight
+    unsigned long   active_generation; // Its generation
+    CompletionWord  active_word;    // The word being completed
+    Array          *active_matches; // Matches from the in-memory sources
+    struct timespec active_deadline; // When to stop waiting for the worker
+
+    // Worker-owned state
+    char     *path_value;    // $PATH the index was built from
+    Array    *path_dirs;     // Directories of path_value
+    size_t    path_next;     // Next directory to scan
+    Trie     *path_commands; // Executables found so far
+    DirCache *dircache;      // Listings read by the worker
+};
+
+/* Current time plus a number of milliseconds */
+static struct timespec deadline_after(long milliseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (milliseconds % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+/* Milliseconds left until a deadline (negative once it passed) */
+static long remaining_ms(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(deadline->tv_sec - now.tv_sec) * 1000 +
+           (deadline->tv_nsec - now.tv_nsec) / 1000000L;
+}
+
+static bool budget_left(const CompletionBudget *budget) {
+    if (!budget) {
+        return true;
+    }
+    return atomic_load(&budget->engine->generation) == budget->generation &&
+           remaining_ms(&budget->deadline) > 0;
+}
+
+/* Reset the worker's PATH index for a new $PATH value */
+static void reset_path_index(CompletionEngine *engine, const char *path) {
+    free(engine->path_value);
+    if (engine->path_dirs) {
+        free_array(engine->path_dirs);
+        free(engine->path_dirs);
+    }
+    if (engine->path_commands) {
+        free_trie(engine->path_commands);
+        free(engine->path_commands);
+    }
+
+    engine->path_value    = strdup(path);
+    engine->path_dirs     = init_array(NULL);
+    engine->path_next     = 0;
+    engine->path_commands = init_trie(NULL);
+
+    char *copy = strdup(path);
+    char *save = NULL;
+    for (char *dir = copy ? strtok_r(copy, ":", &save) : NULL; dir;
+         dir       = strtok_r(NULL, ":", &save)) {
+        array_add(engine->path_dirs, dir);
+    }
+    free(copy);
+}
+
+/* Match executables in PATH, scanning directories within the budget */
+static void match_path_async(CompletionEngine *engine, const char *prefix,
+                             const char *path, Array *matches,
+                             const CompletionBudget *budget) {
+    if (!engine->path_value || strcmp(engine->path_value, path) != 0) {
+        reset_path_index(engine, path);
+    }
+    if (!engine->path_dirs || !engine->path_commands) {
+        return;
+    }
+
+    // Scanning resumes where the last request ran out of time
+    while (engine->path_next < engine->path_dirs->count &&
+           budget_left(budget)) {
+        const char       *dir     = engine->path_dirs->items[engine->path_next];
+        const DirListing *listing = dircache_get(engine->dircache, dir);
+        if (listing) {
+            for (size_t i = 0; i < listing->count; i++) {
+                char full_path[PATH_MAX];
+                snprintf(full_path, sizeof(full_path), "%s/%s", dir,
+                         listing->names[i]);
+                // Earlier PATH entries win, as in update_path
+                if (!trie_get(engine->path_commands, listing->names[i]) &&
+                    access(full_path, X_OK) == 0) {
+                    trie_set(engine->path_commands, listing->names[i],
+                             full_path);
+                }
+            }
+            dircache_release(engine->dircache, listing);
+        }
+        engine->path_next++;
+    }
+
+    Array *path_matches =
+        trie_starting_with(engine->path_commands, (char *)prefix);
+    if (path_matches) {
+        array_extend(matches, path_matches);
+        free_array(path_matches);
+        free(path_matches);
+    }
+}
+
+/* Worker thread: serve requests until the engine stops */
+static void *completion_worker(void *arg) {
+    CompletionEngine *engine = arg;
+
+    pthread_mutex_lock(&engine->lock);
+    while (true) {
+        while (!engine->pending && !engine->stopping) {
+            pthread_cond_wait(&engine->wake, &engine->lock);
+        }
+        if (engine->stopping) {
+            break;
+        }
+
+        CompletionBudget budget;
+        budget.engine     = engine;
+        budget.generation = engine->request_generation;
+        budget.deadline   = deadline_after(COMPLETION_SOURCE_BUDGET_MS);
+        char *prefix      = engine->request_prefix;
+        char *path        = engine->request_path;
+        bool  commands    = engine->request_commands;
+        engine->request_prefix = NULL;
+        engine->request_path   = NULL;
+        engine->pending        = false;
+        pthread_mutex_unlock(&engine->lock);
+
+        Array *found = init_array(NULL);
+        if (commands) {
+            match_path_async(engine, prefix, path ? path : "", found, &budget);
+        } else {
+            match_files(prefix, engine->dircache, found, &budget);
+        }
+        free(prefix);
+        free(path);
+
+        pthread_mutex_lock(&engine->lock);
+        if (atomic_load(&engine->generation) == budget.generation) {
+            if (engine->results) {
+                free_array(engine->results);
+                free(engine->results);
+            }
+            engine->results           = found;
+            engine->result_generation = budget.generation;
+            engine->finished          = true;
+            found                     = NULL;
+            char byte                 = 1;
+            if (write(engine->notify[1], &byte, 1) < 0) {
+                // The pipe is full, so the prompt has a wakeup pending
+            }
+        }
+        if (found) {
+            free_array(found);
+            free(found);
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return NULL;
+}
+
+/* Create the engine and start its worker */
+static CompletionEngine *start_engine(void) {
+    CompletionEngine *engine = calloc(1, sizeof(CompletionEngine));
+    if (!engine) {
+        return NULL;
+    }
+    engine->dircache = init_dircache(NULL);
+    if (!engine->dircache || pipe(engine->notify) != 0) {
+        free(engine->dircache);
+        free(engine);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(engine->notify[i], F_SETFD, FD_CLOEXEC);
+        fcntl(engine->notify[i], F_SETFL,
+              fcntl(engine->notify[i], F_GETFL) | O_NONBLOCK);
+    }
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->wake, NULL);
+    atomic_init(&engine->generation, 0);
+    engine->owner = getpid();
+
+    // Signals must keep interrupting the prompt thread, not the worker
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int failed =
+        pthread_create(&engine->thread, NULL, completion_worker, engine);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (failed) {
+        close(engine->notify[0]);
+        close(engine->notify[1]);
+        pthread_mutex_destroy(&engine->lock);
+        pthread_cond_destroy(&engine->wake);
+        free_dircache(engine->dircache);
+        free(engine->dircache);
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+/* Forget the request the prompt is waiting for */
+static void clear_active(CompletionEngine *engine) {
+    if (!engine->active) {
+        return;
+    }
+    engine->active = false;
+    free_completion_word(&engine->active_word);
+    if (engine->active_matches) {
+        free_array(engine->active_matches);
+        free(engine->active_matches);
+        engine->active_matches = NULL;
+    }
+}
+
+void completion_request(Cursor *cursor, Session *session) {
+    if (!session->completion) {
+        session->completion = start_engine();
+    }
+    CompletionEngine *engine = session->completion;
+    if (!engine) {
+        completion_apply(cursor, session);
+        return;
+    }
+
+    clear_active(engine);
+    unsigned long generation = atomic_fetch_add(&engine->generation, 1) + 1;
+
+    CompletionWord word;
+    completion_word(cursor, &word);
+    Array *matches = init_array(NULL);
+    match_memory_sources(&word, session, matches);
+
+    bool commands = completes_commands(&word);
+    if (commands && strlen(word.prefix) == 0) {
+        // Nothing to look up: only history can help
+        insert_matches(cursor, session, &word, matches, true);
+        free_array(matches);
+        free(matches);
+        free_completion_word(&word);
+        return;
+    }
+
+    engine->active            = true;
+    engine->active_generation = generation;
+    engine->active_word       = word;
+    engine->active_matches    = matches;
+    engine->active_deadline   = deadline_after(COMPLETION_WAIT_BUDGET_MS);
+
+    const char *path = environ_get(session->environ, "PATH");
+    pthread_mutex_lock(&engine->lock);
+    free(engine->request_prefix);
+    free(engine->request_path);
+    engine->request_prefix     = strdup(word.prefix);
+    engine->request_path       = commands && path ? strdup(path) : NULL;
+    engine->request_commands   = commands;
+    engine->request_generation = generation;
+    engine->pending            = true;
+    pthread_cond_signal(&engine->wake);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+void completion_cancel(Session *session) {
+    CompletionEngine *engine = session ? session->completion : NULL;
+    if (!engine || !engine->active) {
+        return;
+    }
+    atomic_fetch_add(&engine->generation, 1);
+    clear_active(engine);
+}
+
+int completion_fd(Session *session) {
+    CompletionEngine *engine = session ? session->completion : NULL;
+    return engine && engine->active ? engine->notify[0] : -1;
+}
+
+int completion_timeout(Session *session) {
+    CompletionEngine *engine = session ? session->completion : NULL;
+    if (!engine || !engine->active) {
+        return -1;
+    }
+    long remaining = remaining_ms(&engine->active_deadline);
+    return remaining > 0 ? (int)remaining : 0;
+}
+
+void completion_receive(Cursor *cursor, Session *session) {
+    CompletionEngine *engine = session ? session->completion : NULL;
+    if (!engine) {
+        return;
+    }
+
+    char buffer[64];
+    while (read(engine->notify[0], buffer, sizeof(buffer)) > 0) {
+    }
+
+    if (!engine->active) {
+        return;
+    }
+
+    Array *results = NULL;
+    pthread_mutex_lock(&engine->lock);
+    if (engine->finished &&
+        engine->result_generation == engine->active_generation) {
+        results          = engine->results;
+        engine->results  = NULL;
+        engine->finished = false;
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    if (!results && remaining_ms(&engine->active_deadline) > 0) {
+        return;
+    }
+
+    // Late results would belong to a request the user no longer sees, and
+    // the matches so far are only part of them
+    bool final = results != NULL;
+    if (!results) {
+        atomic_fetch_add(&engine->generation, 1);
+    } else {
+        array_extend(engine->active_matches, results);
+        free_array(results);
+        free(results);
+    }
+
+    insert_matches(cursor, session, &engine->active_word,
+                   engine->active_matches, final);
+    clear_active(engine);
+}
+
+void free_completion_engine(CompletionEngine *engine) {
+    if (!engine) {
+        return;
+    }
+    // Forked children inherit the memory but not the worker thread
+    if (engine->owner != getpid()) {
+        return;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    engine->stopping = true;
+    atomic_fetch_add(&engine->generation, 1);
+    pthread_cond_signal(&engine->wake);
+    pthread_mutex_unlock(&engine->lock);
+    pthread_join(engine->thread, NULL);
+
+    clear_active(engine);
+    free(engine->request_prefix);
+    free(engine->request_path);
+    if (engine->results) {
+        free_array(engine->results);
+        free(engine->results);
+    }
+    free(engine->path_value);
+    if (engine->path_dirs) {
+        free_array(engine->path_dirs);
+        free(engine->path_dirs);
+    }
+    if (engine->path_commands) {
+        free_trie(engine->path_commands);
+        free(engine->path_commands);
+    }
+    free_dircache(engine->dircache);
+    free(engine->dircache);
+    close(engine->notify[0]);
+    close(engine->notify[1]);
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->wake);
 }
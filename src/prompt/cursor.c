@@ -1,9 +1,11 @@
 #include <stdbool.h> /* bool */
 #include <stddef.h>  /* size_t */
+#include <stdint.h>  /* uint32_t */
 #include <stdlib.h>  /* malloc */
-#include <string.h>  /* strlen, strncpy */
+#include <string.h>  /* strlen, strncpy, memchr, memset */
 
 #include "data/dynamic.h"
+#include "data/scan.h"
 #include "data/utf8.h"
 #include "history.h"
 #include "prompt/ansi.h"
@@ -55,16 +57,136 @@ static void cursor_render_tail(Cursor *cursor, size_t start_index) {
     }
 }
 
-size_t visible_length(const char *str) {
-    if (!str)
-        return 0;
-    char *stripped = ansi_strip(str);
-    if (!stripped) {
-        return 0;
+size_t visible_length(const char *str) { return ansi_width(str); }
+
+size_t cursor_prompt_width(Cursor *cursor) {
+    if (cursor->layout.prompt != cursor->prompt) {
+        cursor->layout.prompt       = cursor->prompt;
+        cursor->layout.prompt_width = visible_length(cursor->prompt);
+        cursor->layout.valid        = false;
+    }
+    return cursor->layout.prompt_width;
+}
+
+size_t cursor_continuation_width(Cursor *cursor) {
+    if (cursor->layout.continuation != cursor->continuation_prompt) {
+        cursor->layout.continuation = cursor->continuation_prompt;
+        cursor->layout.continuation_width =
+            visible_length(cursor->continuation_prompt);
+        cursor->layout.valid = false;
+    }
+    return cursor->layout.continuation_width;
+}
+
+void cursor_layout_changed(Cursor *cursor, size_t offset) {
+    if (cursor && offset < cursor->layout.line_start) {
+        cursor->layout.valid = false;
+    }
+}
+
+/* Get the width of the terminal */
+static size_t cursor_columns(Cursor *cursor) {
+    size_t total_cols = cursor->session->terminal->cols;
+    if (total_cols <= 0)
+        total_cols = TERMINAL_DEFAULT_COLS;
+    return total_cols;
+}
+
+/* Advance a terminal position over the character at `p` and return the
+ * next character */
+static const char *layout_step(const char *p, const char *end, size_t columns,
+                               size_t continuation_col, size_t *row,
+                               size_t *col) {
+    if (*p == '\n') {
+        (*row)++;
+        // Reset to continuation prompt size, not original prompt
+        *col = continuation_col;
+        return p + 1;
+    }
+
+    unsigned char char_len;
+    uint32_t      codepoint = utf8_decode(p, end - p, &char_len);
+    size_t        width     = utf8_codepoint_width(codepoint);
+
+    // A wide character that does not fit is moved to the next row
+    if (width == 2 && *col + 2 > columns) {
+        (*row)++;
+        *col = 0;
+    }
+    *col += width;
+    if (*col >= columns) {
+        (*row)++;
+        *col = 0;
+    }
+    return p + char_len;
+}
+
+/* Advance a terminal position over the characters between `p` and `end` */
+static void layout_walk(const char *p, const char *end, size_t columns,
+                        size_t continuation_col, size_t *row, size_t *col) {
+    while (p < end) {
+        // Pure ASCII spans are placed in one step
+        size_t span = scan_ascii(p, end - p, '\n');
+        if (span > 0) {
+            *col += span;
+            *row += *col / columns;
+            *col %= columns;
+            p += span;
+            continue;
+        }
+        p = layout_step(p, end, columns, continuation_col, row, col);
+    }
+}
+
+/* Move the cached line back until it starts at or before `offset` and on or
+ * before `row`, and get the column it starts at */
+static size_t cursor_layout_seek(Cursor *cursor, size_t offset, size_t row) {
+    CursorLayout *layout       = &cursor->layout;
+    size_t        columns      = cursor_columns(cursor);
+    size_t        prompt_width = cursor_prompt_width(cursor);
+    size_t        cont_col     = cursor_continuation_width(cursor) % columns;
+    const char   *base         = cursor->data->value;
+
+    if (!layout->valid || layout->columns != columns ||
+        layout->line_start > cursor->data->length ||
+        (layout->line_start > 0 && base[layout->line_start - 1] != '\n')) {
+        layout->valid      = true;
+        layout->columns    = columns;
+        layout->line_start = 0;
+        layout->line_row   = prompt_width / columns;
+    }
+
+    while (layout->line_start > 0 &&
+           (layout->line_start > offset || layout->line_row > row)) {
+        // Find the start of the previous line, which ends with a newline
+        size_t end   = layout->line_start - 1;
+        size_t start = end;
+        while (start > 0 && base[start - 1] != '\n')
+            start--;
+
+        size_t rows = 0;
+        size_t col  = start == 0 ? prompt_width % columns : cont_col;
+        layout_walk(base + start, base + end, columns, cont_col, &rows, &col);
+        layout->line_row -= rows + 1;
+        layout->line_start = start;
+    }
+
+    return layout->line_start == 0 ? prompt_width % columns : cont_col;
+}
+
+/* Move the terminal cursor between two positions of the input */
+static void cursor_move_terminal(CursorPosition from, CursorPosition to) {
+    if (to.row > from.row) {
+        terminal_cursor_down(to.row - from.row);
+        terminal_cursor_to_column(to.col);
+    } else if (to.row < from.row) {
+        terminal_cursor_up(from.row - to.row);
+        terminal_cursor_to_column(to.col);
+    } else if (to.col > from.col) {
+        terminal_cursor_forward(to.col - from.col);
+    } else if (to.col < from.col) {
+        terminal_cursor_backward(from.col - to.col);
     }
-    size_t len = utf8_strlen(stripped);
-    free(stripped);
-    return len;
 }
 
 Cursor *init_cursor(Cursor *cursor, Session *session, const char *prompt,
@@ -92,6 +214,7 @@ Cursor *init_cursor(Cursor *cursor, Session *session, const char *prompt,
     cursor->session             = session;
     cursor->keep                = NULL;
     cursor->suggestion          = NULL;
+    memset(&cursor->layout, 0, sizeof(CursorLayout));
     return cursor;
 }
 
@@ -101,48 +224,35 @@ CursorPosition cursor_terminal_position(Cursor *cursor) {
     if (!cursor || !cursor->data || !cursor->data->value)
         return cursor_pos;
 
-    size_t total_cols = cursor->session->terminal->cols;
-    if (total_cols <= 0)
-        total_cols = TERMINAL_DEFAULT_COLS;
-
-    // Start with the prompt position
-    size_t prompt_len = visible_length(cursor->prompt);
-    size_t cont_len   = visible_length(cursor->continuation_prompt);
-
-    size_t current_col = prompt_len % total_cols;
-    size_t current_row = prompt_len / total_cols;
-
     // Calculate bytes to process
     size_t bytes_to_cursor = 0;
     if (cursor->data->length >= cursor->position) {
         bytes_to_cursor = cursor->data->length - cursor->position;
     }
 
-    char *p   = cursor->data->value;
-    char *end = p + bytes_to_cursor;
-
-    while (p < end) {
-        if (*p == '\n') {
+    // Start from the cached line instead of the start of the input
+    CursorLayout *layout      = &cursor->layout;
+    size_t        current_col = cursor_layout_seek(cursor, bytes_to_cursor,
+                                                   (size_t)-1);
+    size_t        current_row = layout->line_row;
+    size_t        columns     = layout->columns;
+    size_t        cont_col    = layout->continuation_width % columns;
+
+    const char *base = cursor->data->value;
+    size_t      i    = layout->line_start;
+    while (i < bytes_to_cursor) {
+        const char *newline = memchr(base + i, '\n', bytes_to_cursor - i);
+        size_t      stop    = newline ? (size_t)(newline - base) : bytes_to_cursor;
+        layout_walk(base + i, base + stop, columns, cont_col, &current_row,
+                    &current_col);
+        i = stop;
+        if (newline) {
+            // Remember the line the cursor is on for the next call
             current_row++;
-            // Reset to continuation prompt size, not original prompt
-            current_col = cont_len % total_cols;
-            p++;
-        } else {
-            unsigned char char_len = utf8_charlen(*p);
-            // Safety check for malformed UTF8
-            if (char_len == 0)
-                char_len = 1;
-
-            if (p + char_len > end)
-                break;
-
-            p += char_len;
-            current_col++;
-
-            if (current_col >= total_cols) {
-                current_row++;
-                current_col = 0;
-            }
+            current_col        = cont_col;
+            i                  = stop + 1;
+            layout->line_start = i;
+            layout->line_row   = current_row;
         }
     }
 
@@ -164,6 +274,7 @@ void cursor_insert(Cursor *cursor, char *string) {
     // If cursor is at the very end (position 0), just append
     if (cursor->position == 0) {
         terminal_clear_to_end();
+        cursor_layout_changed(cursor, cursor->data->length);
         dynamic_extend(cursor->data, string);
 
         cursor_update_suggestion(cursor);
@@ -182,6 +293,8 @@ void cursor_insert(Cursor *cursor, char *string) {
             insert_pos = cursor->data->length;
         }
 
+        CursorPosition cursor_pos = cursor_terminal_position(cursor);
+        cursor_layout_changed(cursor, insert_pos);
         dynamic_insert(cursor->data, insert_pos, string);
         cursor->visible_length += visible_insert_len;
 
@@ -193,22 +306,8 @@ void cursor_insert(Cursor *cursor, char *string) {
         cursor_render_tail(cursor, insert_pos);
         terminal_restore_cursor();
 
-        // Move the cursor forward on screen
-        for (size_t i = 0; i < visible_insert_len; i++) {
-            CursorPosition cursor_pos = cursor_terminal_position(cursor);
-            size_t         total_cols = cursor->session->terminal->cols
-                                            ? cursor->session->terminal->cols
-                                            : TERMINAL_DEFAULT_COLS;
-
-            if (cursor_pos.col >= total_cols - 1) {
-                terminal_cursor_down(1);
-                // Move to end of continuation prompt
-                terminal_cursor_to_column(
-                    visible_length(cursor->continuation_prompt));
-            } else {
-                terminal_cursor_forward(1);
-            }
-        }
+        // Move the cursor forward on screen, past the inserted text
+        cursor_move_terminal(cursor_pos, cursor_terminal_position(cursor));
     }
 }
 
@@ -235,6 +334,7 @@ bool cursor_delete(Cursor *cursor) {
 
     CursorPosition cursor_pos = cursor_terminal_position(cursor);
 
+    cursor_layout_changed(cursor, delete_pos);
     dynamic_remove(cursor->data, delete_pos, deleting_length);
 
     if (cursor->visible_length > 0) {
@@ -244,12 +344,7 @@ bool cursor_delete(Cursor *cursor) {
     CursorPosition new_pos = cursor_terminal_position(cursor);
 
     // Move visual cursor back
-    if (new_pos.row < cursor_pos.row) {
-        terminal_cursor_up(1);
-        terminal_cursor_to_column(new_pos.col);
-    } else if (new_pos.col < cursor_pos.col) {
-        terminal_cursor_backward(1);
-    }
+    cursor_move_terminal(cursor_pos, new_pos);
 
     terminal_clear_to_end();
 
@@ -327,6 +422,7 @@ void cursor_append(Cursor *cursor, char character) {
     }
 
     // Append always happens at the very end
+    cursor_layout_changed(cursor, cursor->data->length);
     dynamic_append(cursor->data, character);
 
     if (character == '\n') {
@@ -392,6 +488,24 @@ size_t cursor_eol_distance(Cursor *cursor) {
     return distance;
 }
 
+size_t cursor_bol_distance(Cursor *cursor) {
+    if (!cursor || !cursor->data)
+        return 0;
+
+    char  *start    = cursor->data->value;
+    char  *p        = start + (cursor->data->length - cursor->position);
+    size_t distance = 0;
+
+    while (p > start && *(p - 1) != '\n') {
+        char *prev = utf8_prev_char(p, start);
+        if (!prev || prev < start)
+            break;
+        p = prev;
+        distance++;
+    }
+    return distance;
+}
+
 void cursor_backward(Cursor *cursor, size_t n) {
     if (!cursor || !cursor->data)
         return;
@@ -409,22 +523,14 @@ void cursor_backward(Cursor *cursor, size_t n) {
         if (!prev_char || prev_char < cursor->data->value)
             break;
 
-        bool   is_newline = (*prev_char == '\n');
-        size_t char_len   = char_at_cursor - prev_char;
+        size_t char_len = char_at_cursor - prev_char;
 
         CursorPosition cursor_pos = cursor_terminal_position(cursor);
 
         cursor->position += char_len;
         cursor->visible_position += 1;
 
-        CursorPosition new_pos = cursor_terminal_position(cursor);
-
-        if (is_newline || cursor_pos.col == 0) {
-            terminal_cursor_up(1);
-            terminal_cursor_to_column(new_pos.col);
-        } else {
-            terminal_cursor_backward(1);
-        }
+        cursor_move_terminal(cursor_pos, cursor_terminal_position(cursor));
         moved++;
     }
 }
@@ -433,10 +539,6 @@ void cursor_forward(Cursor *cursor, size_t n) {
     if (!cursor || !cursor->data)
         return;
 
-    size_t total_cols = cursor->session->terminal->cols;
-    if (total_cols == 0)
-        total_cols = TERMINAL_DEFAULT_COLS;
-
     size_t moved = 0;
     while (moved < n && cursor->position > 0) {
         size_t char_pos = cursor->data->length - cursor->position;
@@ -444,7 +546,6 @@ void cursor_forward(Cursor *cursor, size_t n) {
             break;
 
         char          current_char = cursor->data->value[char_pos];
-        bool          is_newline   = (current_char == '\n');
         unsigned char char_len     = utf8_charlen(current_char);
         if (char_len == 0)
             char_len = 1;
@@ -458,13 +559,7 @@ void cursor_forward(Cursor *cursor, size_t n) {
         if (cursor->visible_position > 0)
             cursor->visible_position -= 1;
 
-        if (is_newline || cursor_pos.col >= total_cols - 1) {
-            terminal_cursor_down(1);
-            terminal_cursor_to_column(
-                visible_length(cursor->continuation_prompt));
-        } else {
-            terminal_cursor_forward(1);
-        }
+        cursor_move_terminal(cursor_pos, cursor_terminal_position(cursor));
 
         if (cursor->position == 0 && cursor->suggestion) {
             terminal_save_cursor();
@@ -572,16 +667,17 @@ void cursor_set(Cursor *cursor, char *string, bool history) {
     for (size_t i = 0; i < cursor_pos.row; i++) {
         terminal_cursor_up(1);
     }
-    terminal_cursor_to_column(visible_length(cursor->prompt));
+    terminal_cursor_to_column(cursor_prompt_width(cursor));
     terminal_write(ANSI_ERASE_CURSOR_TO_EOF);
 
     // Reset data
+    cursor_layout_changed(cursor, 0);
     dynamic_clear(cursor->data);
     dynamic_extend(cursor->data, string);
 
     cursor->position         = 0;
     cursor->visible_position = 0;
-    cursor->visible_length   = visible_length(cursor->data->value);
+    cursor->visible_length   = utf8_strlen(cursor->data->value);
 
     terminal_clear_to_end();
     cursor_update_suggestion(cursor);
@@ -597,6 +693,7 @@ void cursor_clear_screen(Cursor *cursor) {
     cursor->position         = 0;
     cursor->visible_position = 0;
     cursor->visible_length   = 0;
+    cursor_layout_changed(cursor, 0);
     dynamic_clear(cursor->data);
 }
 
@@ -606,18 +703,14 @@ static size_t cursor_get_index_at_pos(Cursor *cursor, size_t target_row,
     if (!cursor || !cursor->data)
         return 0;
 
-    size_t total_cols = cursor->session->terminal->cols;
-    if (total_cols == 0)
-        total_cols = TERMINAL_DEFAULT_COLS;
-
-    // Start sizes
-    size_t prompt_len = visible_length(cursor->prompt);
-    size_t cont_len   = visible_length(cursor->continuation_prompt);
+    // Start from a line on or before the target row
+    size_t current_col = cursor_layout_seek(cursor, cursor->data->length,
+                                            target_row);
+    size_t current_row = cursor->layout.line_row;
+    size_t columns     = cursor->layout.columns;
+    size_t cont_col    = cursor->layout.continuation_width % columns;
 
-    size_t current_col = prompt_len % total_cols;
-    size_t current_row = prompt_len / total_cols;
-
-    char *p          = cursor->data->value;
+    char *p          = cursor->data->value + cursor->layout.line_start;
     char *end        = cursor->data->value + cursor->data->length;
     char *target_ptr = p;
 
@@ -638,35 +731,18 @@ static size_t cursor_get_index_at_pos(Cursor *cursor, size_t target_row,
             return cursor->data->length - (target_ptr - cursor->data->value);
         }
 
-        if (*p == '\n') {
-            // If we are ending the target row and haven't returned, return this
-            // newline
-            if (current_row == target_row) {
-                return cursor->data->length - (p - cursor->data->value);
-            }
-            current_row++;
-            current_col = cont_len % total_cols;
-            p++;
-        } else {
-            unsigned char char_len = utf8_charlen(*p);
-            if (char_len == 0)
-                char_len = 1;
-
-            if (p + char_len > end)
-                break;
-
-            p += char_len;
-            current_col++;
-
-            if (current_col >= total_cols) {
-                current_row++;
-                current_col = 0;
-            }
-
-            // Update target pointer if we are still on the target row
-            if (current_row == target_row)
-                target_ptr = p;
+        // If we are ending the target row and haven't returned, return this
+        // newline
+        if (*p == '\n' && current_row == target_row) {
+            return cursor->data->length - (p - cursor->data->value);
         }
+
+        p = (char *)layout_step(p, end, columns, cont_col, &current_row,
+                                &current_col);
+
+        // Update target pointer if we are still on the target row
+        if (current_row == target_row)
+            target_ptr = p;
     }
 
     return 0;
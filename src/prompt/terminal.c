@@ -1,5 +1,6 @@
 /* Terminal control implementation */
 
+#include <pthread.h>   /* pthread_mutex_t, pthread_mutex_lock, pthread_once */
 #include <signal.h>    /* sigaction, sigemptyset, sig_atomic_t */
 #include <stdarg.h>    /* va_list, va_start, va_end */
 #include <stdio.h>     /* vsnprintf */
@@ -19,25 +20,30 @@
 // Signal flags
 static volatile sig_atomic_t g_needs_resize = 0; // Resize needed flag
 
-// Handling multiple sessions
+// Handling multiple sessions, possibly created and freed by different threads
 static struct Sessions {
     Session         *session; // The session
     struct Sessions *next;    // Next in list
 } g_sessions = {NULL, NULL};
+static pthread_mutex_t g_sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  g_sessions_once = PTHREAD_ONCE_INIT;
 
 static void register_session(Session *session) {
     struct Sessions *new_entry = malloc(sizeof(struct Sessions));
     if (!new_entry)
         return;
     new_entry->session = session;
-    new_entry->next    = g_sessions.next;
-    g_sessions.next    = new_entry;
+    pthread_mutex_lock(&g_sessions_lock);
+    new_entry->next = g_sessions.next;
+    g_sessions.next = new_entry;
+    pthread_mutex_unlock(&g_sessions_lock);
 }
 
 static void unregister_session(Session *session) {
     if (!session)
         return;
 
+    pthread_mutex_lock(&g_sessions_lock);
     struct Sessions *prev = &g_sessions;
     struct Sessions *curr = g_sessions.next;
 
@@ -45,11 +51,12 @@ static void unregister_session(Session *session) {
         if (curr->session == session) {
             prev->next = curr->next;
             free(curr);
-            return;
+            break;
         }
         prev = curr;
         curr = curr->next;
     }
+    pthread_mutex_unlock(&g_sessions_lock);
 }
 
 static void cleanup_session(Session *session) {
@@ -61,16 +68,25 @@ static void cleanup_session(Session *session) {
 }
 
 static void cleanup_sessions(void) {
+    // The list is detached first, as cleaning a session unregisters it
+    pthread_mutex_lock(&g_sessions_lock);
     struct Sessions *curr = g_sessions.next;
+    g_sessions.next       = NULL;
+    pthread_mutex_unlock(&g_sessions_lock);
     while (curr) {
         struct Sessions *next = curr->next;
-        cleanup_session(curr->session);
+        terminal_restore(curr->session);
+        free(curr);
         curr = next;
     }
-    g_sessions.next = NULL;
-    terminal_show_cursor();
+    // Not into the output of commands run in forked children
+    if (isatty(STDOUT_FILENO))
+        terminal_show_cursor();
 }
 
+/* Restore the terminals at exit, however many sessions there are */
+static void register_cleanup(void) { atexit(cleanup_sessions); }
+
 // Helpers
 
 /* Handle window resize signal */
@@ -147,7 +163,7 @@ Terminal *init_terminal(Terminal *terminal, Session *session) {
     }
 
     session->terminal = terminal;
-    atexit(cleanup_sessions);
+    pthread_once(&g_sessions_once, register_cleanup);
     register_session(session);
 
     terminal->is_raw          = false;
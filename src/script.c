@@ -0,0 +1,183 @@
+#include <errno.h>   /* errno, EINTR */
+#include <stdlib.h>  /* malloc, free */
+#include <string.h>  /* memset, strndup */
+#include <unistd.h>  /* read */
+
+#include "data/dynamic.h" /* Dynamic, init_dynamic, dynamic_extend_length, dynamic_remove, free_dynamic */
+#include "execute.h"      /* execute_string */
+#include "lexer.h"        /* LexerInput, LexerToken, lexer_next_token, free_lexer_token, TOKEN_* */
+#include "script.h"
+
+ScriptReader *init_script_reader(ScriptReader *reader, int fd,
+                                 Session *session) {
+    bool allocated = false;
+    if (!reader) {
+        reader = malloc(sizeof(ScriptReader));
+        if (!reader) {
+            return NULL;
+        }
+        allocated = true;
+    }
+    memset(reader, 0, sizeof(ScriptReader));
+    if (!init_dynamic(&reader->pending)) {
+        if (allocated) {
+            free(reader);
+        }
+        return NULL;
+    }
+    reader->fd      = fd;
+    reader->session = session;
+    return reader;
+}
+
+/* Update the state of the current command with a token */
+static void script_state_update(ScriptState *state, TokenType type) {
+    if (type == TOKEN_COMMENT || type == TOKEN_EOL) {
+        return;
+    }
+    switch (type) {
+#ifndef TIDESH_DISABLE_CONDITIONALS
+        case TOKEN_IF:
+            state->conditionals++;
+            break;
+        case TOKEN_FI:
+            state->conditionals--;
+            break;
+#endif
+#ifndef TIDESH_DISABLE_SUBSHELLS
+        case TOKEN_LPAREN:
+            state->subshells++;
+            break;
+        case TOKEN_RPAREN:
+            state->subshells--;
+            break;
+#endif
+        default:
+            break;
+    }
+    state->last        = type;
+    state->has_command = true;
+}
+
+/* Check whether a command ending at a newline is complete */
+static bool script_state_complete(const ScriptState *state) {
+    if (state->conditionals > 0 || state->subshells > 0) {
+        return false;
+    }
+    switch (state->last) {
+#ifndef TIDESH_DISABLE_PIPES
+        case TOKEN_PIPE:
+        case TOKEN_OR:
+#endif
+#ifndef TIDESH_DISABLE_SEQUENCES
+        case TOKEN_SEQUENCE:
+#endif
+            return false;
+        default:
+            return true;
+    }
+}
+
+/* Read the next block of the script, returning false at the end of it */
+static bool script_reader_fill(ScriptReader *reader) {
+    // Drop the commands that were already returned
+    if (reader->start > 0) {
+        dynamic_remove(&reader->pending, 0, reader->start);
+        reader->scanned -= reader->start;
+        reader->start = 0;
+    }
+
+    char    block[SCRIPT_BLOCK_SIZE];
+    ssize_t n;
+    do {
+        n = read(reader->fd, block, sizeof(block));
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        reader->eof = true;
+        return false;
+    }
+    dynamic_extend_length(&reader->pending, block, (size_t)n);
+    return true;
+}
+
+/* Take the text between start and `end` as the next command */
+static char *script_reader_take(ScriptReader *reader, size_t end) {
+    char *command = strndup(reader->pending.value + reader->start,
+                            end - reader->start);
+    reader->start = end;
+    memset(&reader->state, 0, sizeof(ScriptState));
+    return command;
+}
+
+char *script_reader_next(ScriptReader *reader) {
+    while (true) {
+        // Only whole lines are trusted: a token cut by the end of a block
+        // is lexed again once the rest of it has been read
+        LexerInput input = {.data    = reader->pending.value,
+                            .length  = reader->pending.length,
+                            .pos     = reader->scanned,
+                            .session = reader->session};
+        ScriptState state = reader->state;
+
+        while (input.pos < input.length) {
+            LexerToken token = lexer_next_token(&input);
+            TokenType  type  = token.type;
+            free_lexer_token(&token);
+            if (type == TOKEN_EOF) {
+                break;
+            }
+            script_state_update(&state, type);
+            if (type != TOKEN_EOL) {
+                continue;
+            }
+
+            reader->scanned = input.pos;
+            reader->state   = state;
+            if (!state.has_command) {
+                // Blank lines and comments are skipped
+                reader->start = input.pos;
+            } else if (script_state_complete(&state)) {
+                return script_reader_take(reader, input.pos);
+            }
+        }
+
+        if (!reader->eof && script_reader_fill(reader)) {
+            continue;
+        }
+
+        // The rest of the script is returned as is, even if it is incomplete
+        if (reader->start < reader->pending.length) {
+            size_t end = reader->pending.length;
+            reader->scanned = end;
+            if (state.has_command) {
+                return script_reader_take(reader, end);
+            }
+            reader->start = end;
+        }
+        return NULL;
+    }
+}
+
+void free_script_reader(ScriptReader *reader) {
+    if (!reader) {
+        return;
+    }
+    free_dynamic(&reader->pending);
+}
+
+int execute_script(int fd, Session *session) {
+    ScriptReader reader;
+    if (!init_script_reader(&reader, fd, session)) {
+        return 1;
+    }
+
+    int   status = 0;
+    char *command;
+    while ((command = script_reader_next(&reader)) != NULL) {
+        status = execute_string(command, session);
+        free(command);
+    }
+
+    free_script_reader(&reader);
+    return status;
+}
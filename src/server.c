@@ -0,0 +1,264 @@
+#include <errno.h>      /* errno, EINTR, EAGAIN */
+#include <fcntl.h>      /* fcntl, open, F_DUPFD_CLOEXEC, O_RDONLY, O_NONBLOCK */
+#include <poll.h>       /* poll, struct pollfd, POLLIN, POLLHUP */
+#include <pthread.h>    /* pthread_create, pthread_join */
+#include <stdbool.h>    /* bool */
+#include <stdint.h>     /* int32_t, uint32_t, uint8_t */
+#include <stdio.h>      /* fflush, stdout, stderr */
+#include <stdlib.h>     /* malloc, free */
+#include <string.h>     /* memcpy, strlen */
+#include <sys/socket.h> /* send, MSG_NOSIGNAL */
+#include <unistd.h>     /* read, write, pipe, dup, dup2, close */
+
+#include "execute.h" /* execute_string */
+#include "server.h"
+
+/* Forwards the output of a request to the client while it runs */
+typedef struct Forwarder {
+    int      socket; // Connection to the client
+    uint32_t id;     // Request the output belongs to
+    int      out;    // Read end of the standard output of the request
+    int      err;    // Read end of its standard error
+    int      stop;   // Read end of a pipe written once the request is done
+    bool     failed; // Whether the client could not be written to
+} Forwarder;
+
+/* Read exactly length bytes, or fail */
+static bool read_all_bytes(int fd, void *buffer, size_t length) {
+    char *bytes = buffer;
+    while (length > 0) {
+        ssize_t result = read(fd, bytes, length);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return true;
+}
+
+/* Write exactly length bytes, or fail (without SIGPIPE if the other end is
+ * gone) */
+static bool write_all_bytes(int fd, const void *buffer, size_t length) {
+    const char *bytes = buffer;
+    while (length > 0) {
+        ssize_t result = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return true;
+}
+
+/* Send a frame, with its header and payload in the same write so that
+ * small frames go out in a single packet */
+static bool send_frame(int fd, uint32_t id, ServerFrameType type,
+                       const void *payload, uint32_t length) {
+    uint8_t frame[SERVER_HEADER_SIZE + 64];
+    uint8_t kind = (uint8_t)type;
+    memcpy(frame, &id, sizeof(id));
+    memcpy(frame + 4, &kind, sizeof(kind));
+    memcpy(frame + 5, &length, sizeof(length));
+    if (length <= sizeof(frame) - SERVER_HEADER_SIZE) {
+        memcpy(frame + SERVER_HEADER_SIZE, payload, length);
+        return write_all_bytes(fd, frame, SERVER_HEADER_SIZE + length);
+    }
+    return write_all_bytes(fd, frame, SERVER_HEADER_SIZE) &&
+           write_all_bytes(fd, payload, length);
+}
+
+/* Send what can be read from a pipe, returning false at its end (or once
+ * it is empty, for a non-blocking pipe) */
+static bool forward_pipe(Forwarder *forwarder, int fd, ServerFrameType type) {
+    char    buffer[SERVER_CHUNK_SIZE];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0) {
+        return errno == EINTR;
+    }
+    if (length == 0) {
+        return false;
+    }
+    if (!forwarder->failed &&
+        !send_frame(forwarder->socket, forwarder->id, type, buffer,
+                    (uint32_t)length)) {
+        forwarder->failed = true; // Keep draining so the command never blocks
+    }
+    return true;
+}
+
+/* Forward the output of a request until both pipes are closed, or until the
+ * request is done and what it wrote has been sent (background jobs may keep
+ * the pipes open) */
+static void *forward_output(void *data) {
+    Forwarder    *forwarder = data;
+    struct pollfd fds[3]    = {{.fd = forwarder->out, .events = POLLIN},
+                               {.fd = forwarder->err, .events = POLLIN},
+                               {.fd = forwarder->stop, .events = POLLIN}};
+
+    while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[2].revents) {
+            // Done: drain without waiting for writers that outlive the request
+            for (int i = 0; i < 2; i++) {
+                if (fds[i].fd >= 0) {
+                    fcntl(fds[i].fd, F_SETFL, O_NONBLOCK);
+                    while (forward_pipe(forwarder, fds[i].fd,
+                                        i == 0 ? SERVER_STDOUT
+                                               : SERVER_STDERR)) {
+                    }
+                }
+            }
+            break;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].fd >= 0 && fds[i].revents &&
+                !forward_pipe(forwarder, fds[i].fd,
+                              i == 0 ? SERVER_STDOUT : SERVER_STDERR)) {
+                fds[i].fd = -1; // Ignored by poll from now on
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Create a pipe whose ends are not inherited by executed commands */
+static bool cloexec_pipe(int fds[2]) {
+    if (pipe(fds) < 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+/* Execute the command of a request, with its output forwarded to the
+ * client, and send its status */
+static bool serve_command(Session *session, int socket, uint32_t id,
+                          const char *command) {
+    int out[2], err[2], stop[2];
+    if (!cloexec_pipe(out)) {
+        return false;
+    }
+    if (!cloexec_pipe(err)) {
+        close(out[0]);
+        close(out[1]);
+        return false;
+    }
+    if (!cloexec_pipe(stop)) {
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        return false;
+    }
+
+    // Swap the standard streams of the shell for the ones of the request
+    fflush(stdout);
+    fflush(stderr);
+    int saved[3];
+    for (int i = 0; i < 3; i++) {
+        saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 3);
+    }
+    int input = open("/dev/null", O_RDONLY);
+    if (input >= 0) {
+        dup2(input, STDIN_FILENO);
+        close(input);
+    }
+    dup2(out[1], STDOUT_FILENO);
+    dup2(err[1], STDERR_FILENO);
+    close(out[1]);
+    close(err[1]);
+
+    Forwarder forwarder = {.socket = socket,
+                           .id     = id,
+                           .out    = out[0],
+                           .err    = err[0],
+                           .stop   = stop[0],
+                           .failed = false};
+    pthread_t thread;
+    bool      forwarding =
+        pthread_create(&thread, NULL, forward_output, &forwarder) == 0;
+
+    int32_t status = forwarding ? execute_string(command, session) : 1;
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        if (saved[i] >= 0) {
+            dup2(saved[i], i);
+            close(saved[i]);
+        } else {
+            close(i);
+        }
+    }
+
+    if (forwarding) {
+        while (write(stop[1], "", 1) < 0 && errno == EINTR) {
+        }
+        pthread_join(thread, NULL);
+    }
+    close(out[0]);
+    close(err[0]);
+    close(stop[0]);
+    close(stop[1]);
+
+    return forwarding && !forwarder.failed &&
+           send_frame(socket, id, SERVER_STATUS, &status, sizeof(status));
+}
+
+int serve(Session *session, int fd) {
+    uint8_t header[SERVER_HEADER_SIZE];
+    while (!session->exit_requested) {
+        if (!read_all_bytes(fd, header, sizeof(header))) {
+            return 0; // The client is gone
+        }
+
+        uint32_t id, length;
+        uint8_t  type;
+        memcpy(&id, header, sizeof(id));
+        memcpy(&type, header + 4, sizeof(type));
+        memcpy(&length, header + 5, sizeof(length));
+        if (length > SERVER_MAX_COMMAND) {
+            return -1;
+        }
+
+        char *payload = malloc((size_t)length + 1);
+        if (!payload) {
+            return -1;
+        }
+        if (!read_all_bytes(fd, payload, length)) {
+            free(payload);
+            return 0;
+        }
+        payload[length] = '\0';
+
+        bool sent;
+        if (type == SERVER_EXECUTE) {
+            sent = serve_command(session, fd, id, payload);
+        } else {
+            const char *message = "tidesh: unknown request\n";
+            int32_t     status  = 2;
+            sent = send_frame(fd, id, SERVER_STDERR, message,
+                              (uint32_t)strlen(message)) &&
+                   send_frame(fd, id, SERVER_STATUS, &status, sizeof(status));
+        }
+        free(payload);
+        if (!sent) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -3,15 +3,21 @@
 #include <stdbool.h> /* bool */
 #include <stdio.h>   /* snprintf */
 #include <stdlib.h>  /* malloc, free */
-#include <string.h>  /* strdup, strcmp */
+#include <string.h>  /* strdup, strcmp, strtok_r */
 #include <unistd.h>  /* getcwd */
 
 #include "data/array.h"      /* array_add, free_array */
+#include "data/intern.h"     /* init_intern_table, intern_string, free_intern_table */
+#include "dircache.h"        /* init_dircache, free_dircache */
 #include "environ.h"         /* environ_get, environ_set, environ_get_default */
 #include "feature-flags.h"   /* Features */
 #include "hooks.h"           /* HOOK_* */
+#include "prompt/completion.h" /* free_completion_engine */
 #include "prompt/terminal.h" /* Terminal, terminal functions */
 #include "session.h"         /* Session, Environ, History, Trie, DirStack */
+#include "startup.h"         /* startup_trace_step */
+#include "trace.h"           /* open_requested_trace, close_trace */
+#include "zygote.h"          /* start_requested_zygote, stop_zygote */
 
 Session *init_session(Session *session, char *history_path) {
     if (!session) {
@@ -23,19 +29,43 @@ Session *init_session(Session *session, char *history_path) {
         memset(session, 0, sizeof(Session));
     }
 
+    session->strings = init_intern_table(NULL);
+    if (!session->strings) {
+        free(session);
+        return NULL;
+    }
+    startup_trace_step("intern table");
+
     session->environ = init_environ(NULL);
     if (!session->environ) {
+        free_session(session);
         free(session);
         return NULL;
     }
+    startup_trace_step("environ");
+
+    // The zygote is forked while the shell is as small as it gets
+    session->zygote = start_requested_zygote(session);
+    startup_trace_step("zygote");
+
+    // Tracing starts as early as possible, to see the rest of the startup
+    session->trace = open_requested_trace(session);
+    startup_trace_step("trace");
 
 #ifndef TIDESH_DISABLE_HISTORY
-    session->history = load_history(NULL, history_path);
+    // Repeated commands share their storage. The file is only read once the
+    // history is used, so commands that never use it do not pay for it.
+    session->history = init_history(NULL);
+    if (session->history) {
+        session->history->strings = session->strings;
+        history_defer_load(session->history, history_path);
+    }
     if (!session->history) {
         free_session(session);
         free(session);
         return NULL;
     }
+    startup_trace_step("history");
 #endif
 
 #ifndef TIDESH_DISABLE_ALIASES
@@ -45,6 +75,7 @@ Session *init_session(Session *session, char *history_path) {
         free(session);
         return NULL;
     }
+    startup_trace_step("aliases");
 #endif
 
 #ifndef TIDESH_DISABLE_DIRSTACK
@@ -54,6 +85,7 @@ Session *init_session(Session *session, char *history_path) {
         free(session);
         return NULL;
     }
+    startup_trace_step("dirstack");
 #endif
 
     session->path_commands = init_trie(NULL);
@@ -62,6 +94,7 @@ Session *init_session(Session *session, char *history_path) {
         free(session);
         return NULL;
     }
+    startup_trace_step("path commands");
 
     session->terminal = init_terminal(NULL, session);
     if (!session->terminal) {
@@ -69,6 +102,15 @@ Session *init_session(Session *session, char *history_path) {
         free(session);
         return NULL;
     }
+    startup_trace_step("terminal");
+
+    session->dircache = init_dircache(NULL);
+    if (!session->dircache) {
+        free_session(session);
+        free(session);
+        return NULL;
+    }
+    startup_trace_step("dircache");
 
 #ifndef TIDESH_DISABLE_JOB_CONTROL
     session->jobs = init_jobs();
@@ -77,6 +119,8 @@ Session *init_session(Session *session, char *history_path) {
         free(session);
         return NULL;
     }
+    session->jobs->trace = session->trace;
+    startup_trace_step("jobs");
 #endif
 
     session->current_working_dir      = NULL;
@@ -90,8 +134,10 @@ Session *init_session(Session *session, char *history_path) {
 
     // Initialize working directories
     update_working_dir(session);
+    startup_trace_step("working directory");
     // update_path(session); // Pretty slow
     hooks_register_session(session);
+    startup_trace_step("hooks");
     return session;
 }
 
@@ -99,9 +145,11 @@ void free_session(Session *session) {
     if (!session)
         return;
 
-    // Free working directories (session owns these)
-    free(session->current_working_dir);
-    free(session->previous_working_dir);
+    // Release working directories (session owns these)
+    intern_release(session->strings, session->current_working_dir);
+    intern_release(session->strings, session->previous_working_dir);
+    session->current_working_dir  = NULL;
+    session->previous_working_dir = NULL;
 
 #ifndef TIDESH_DISABLE_DIRSTACK
     if (session->dirstack) {
@@ -139,22 +187,53 @@ void free_session(Session *session) {
         free(session->terminal);
     }
 
+    if (session->completion) {
+        free_completion_engine(session->completion);
+        free(session->completion);
+    }
+
+    if (session->dircache) {
+        free_dircache(session->dircache);
+        free(session->dircache);
+    }
+
 #ifndef TIDESH_DISABLE_JOB_CONTROL
     if (session->jobs) {
         free_jobs(session->jobs);
         free(session->jobs);
     }
 #endif
+
+    if (session->trace) {
+        close_trace(session->trace);
+        free(session->trace);
+        session->trace = NULL;
+    }
+
+    if (session->zygote) {
+        stop_zygote(session->zygote);
+        free(session->zygote);
+        session->zygote = NULL;
+    }
+
+    // Everything holding interned strings is gone by now
+    if (session->strings) {
+        free_intern_table(session->strings);
+        free(session->strings);
+        session->strings = NULL;
+    }
 }
 
 static void init_previous_working_dir(Session *session) {
     // First time setting CWD, set previous to same value
     char *oldpwd = environ_get(session->environ, "OLDPWD");
     if (!oldpwd) {
-        session->previous_working_dir = strdup(session->current_working_dir);
+        session->previous_working_dir =
+            (char *)intern_retain(session->current_working_dir);
         environ_set(session->environ, "OLDPWD", session->previous_working_dir);
     } else {
-        session->previous_working_dir = strdup(oldpwd);
+        session->previous_working_dir =
+            (char *)intern_string(session->strings, oldpwd);
     }
 }
 
@@ -440,7 +519,8 @@ static void run_ancestor_exit_hooks(Session *session, const char *from,
     }
 
     free(to_normalized);
-    free(exiting_dirs); // Don't free the strings, they're owned by from_parents
+    free_array(exiting_dirs); // array_add copied the strings
+    free(exiting_dirs);
     free_array(from_parents);
     free(from_parents);
 }
@@ -453,13 +533,14 @@ void update_working_dir(Session *session) {
         if (current_value && strcmp(current_value, cwd) == 0) {
             free(cwd);
         } else {
-            session->current_working_dir = strdup(cwd);
+            session->current_working_dir =
+                (char *)intern_string(session->strings, cwd);
             environ_set(session->environ, "PWD", session->current_working_dir);
             free(cwd);
         }
     } else if (!session->current_working_dir) {
-        session->current_working_dir =
-            strdup(environ_get_default(session->environ, "PWD", "."));
+        session->current_working_dir = (char *)intern_string(
+            session->strings, environ_get_default(session->environ, "PWD", "."));
     } else {
         if (!session->previous_working_dir) {
             init_previous_working_dir(session);
@@ -493,10 +574,7 @@ void update_working_dir(Session *session) {
     }
 
     // Else update OLDPWD and the previous working dir
-    if (session->previous_working_dir) {
-        free(session->previous_working_dir);
-    }
-
+    intern_release(session->strings, session->previous_working_dir);
     session->previous_working_dir = (char *)current_value;
     if (session->previous_working_dir) {
         environ_set(session->environ, "OLDPWD", session->previous_working_dir);
@@ -596,8 +674,12 @@ void update_path(Session *session) {
         return;
     }
 
-    char *path  = strdup(original_path);
-    char *token = strtok(path, ":");
+    char *path = strdup(original_path);
+    if (!path) {
+        return;
+    }
+    char *saveptr = NULL;
+    char *token   = strtok_r(path, ":", &saveptr);
     while (token) {
         // Open directory and read entries
         DIR *dir = opendir(token);
@@ -622,7 +704,7 @@ void update_path(Session *session) {
             }
             closedir(dir);
         }
-        token = strtok(NULL, ":");
+        token = strtok_r(NULL, ":", &saveptr);
     }
     free(path);
 }
@@ -0,0 +1,56 @@
+#include <stdbool.h> /* bool */
+#include <stdint.h>  /* uint64_t */
+
+#include "profile.h" /* profile_now */
+#include "startup.h"
+
+/* A step of the startup */
+typedef struct StartupStep {
+    const char *name;    // Name of the step
+    uint64_t    elapsed; // Time it took (ns)
+} StartupStep;
+
+static bool        trace_enabled = false;
+static uint64_t    trace_start   = 0; // When the trace began (monotonic ns)
+static uint64_t    trace_last    = 0; // When the last step ended
+static StartupStep trace_steps[STARTUP_MAX_STEPS];
+static size_t      trace_count   = 0;
+
+void startup_trace_begin(void) {
+    trace_start = profile_now();
+    trace_last  = trace_start;
+    trace_count = 0;
+}
+
+void startup_trace_enable(void) {
+    if (trace_start == 0) {
+        startup_trace_begin();
+    }
+    trace_enabled = true;
+}
+
+void startup_trace_step(const char *step) {
+    if (!trace_enabled) {
+        return;
+    }
+    uint64_t now = profile_now();
+    if (trace_count < STARTUP_MAX_STEPS) {
+        trace_steps[trace_count].name    = step;
+        trace_steps[trace_count].elapsed = now - trace_last;
+        trace_count++;
+    }
+    trace_last = now;
+}
+
+void startup_trace_report(FILE *output) {
+    if (!trace_enabled) {
+        return;
+    }
+    for (size_t i = 0; i < trace_count; i++) {
+        fprintf(output, "%-24s %10.1f us\n", trace_steps[i].name,
+                (double)trace_steps[i].elapsed / 1e3);
+    }
+    fprintf(output, "%-24s %10.1f us\n", "total",
+            (double)(trace_last - trace_start) / 1e3);
+    trace_enabled = false;
+}
@@ -0,0 +1,518 @@
+#include <errno.h>    /* errno, EINTR */
+#include <fcntl.h>    /* open, O_WRONLY, O_CREAT, O_APPEND, O_CLOEXEC */
+#include <pthread.h>  /* pthread_once, pthread_atfork */
+#include <signal.h>   /* sigaction, sigprocmask, kill, SIGUSR1 */
+#include <stdio.h>    /* snprintf */
+#include <stdlib.h>   /* malloc, free */
+#include <string.h>   /* strlen, strcmp */
+#include <sys/mman.h> /* mmap, munmap, madvise, MADV_DONTFORK */
+#include <sys/stat.h> /* fstat, struct stat */
+#include <sys/wait.h> /* waitpid */
+#include <time.h>     /* nanosleep */
+#include <unistd.h>   /* write, close, fork, getpid, getppid, setpgid */
+
+#include "environ.h" /* environ_get */
+#include "profile.h" /* profile_now */
+#include "trace.h"
+
+/* Size of the buffer events are formatted in before being written */
+#define TRACE_WRITE_BUFFER 65536
+
+/* How long the writer sleeps between batches (ns): the minimum while events
+ * come in, doubled each time there was nothing to write up to the maximum */
+#define TRACE_WRITER_MIN_INTERVAL 500000
+#define TRACE_WRITER_MAX_INTERVAL 12800000
+
+/* The current process, updated in forked children */
+static pid_t          trace_pid  = 0;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+
+/* Events of a parent are not ours to record once forked */
+static void trace_forked(void) { trace_pid = getpid(); }
+
+static void trace_setup(void) {
+    trace_pid = getpid();
+    pthread_atfork(NULL, NULL, trace_forked);
+}
+
+/* Wakes the writer up from its sleep */
+static void trace_wake(int sig) { (void)sig; }
+
+/* Copy a string into a fixed size field, cutting it if needed */
+static void copy_field(char *field, size_t size, const char *value) {
+    size_t length = value ? strlen(value) : 0;
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(field, value ? value : "", length);
+    field[length] = '\0';
+}
+
+/* Claim the next slot of the ring buffer, or NULL if it is full or the
+ * trace belongs to another process */
+static TraceEvent *trace_reserve(Trace *trace) {
+    if (!trace || trace->owner != trace_pid) {
+        return NULL;
+    }
+    TraceRing *ring = trace->ring;
+    size_t     head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // The writer is usually far behind the end of the buffer: only look at
+    // where it is (a cache line it writes to) when the buffer seems full
+    if (head - trace->free_tail >= TRACE_RING_SIZE) {
+        trace->free_tail =
+            atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - trace->free_tail >= TRACE_RING_SIZE) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+    }
+    TraceEvent *event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->timestamp  = profile_now();
+    event->category   = NULL;
+    event->name[0]    = '\0';
+    event->detail[0]  = '\0';
+    event->pid        = 0;
+    event->status     = TRACE_NO_STATUS;
+    event->job        = 0;
+    return event;
+}
+
+/* Hand the slot claimed last to the writer */
+static void trace_commit(Trace *trace) {
+    TraceRing *ring = trace->ring;
+    size_t     head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Buffer events are formatted in by the writer */
+typedef struct TraceOutput {
+    int    fd;                                      // The trace file
+    char   buffer[TRACE_WRITE_BUFFER];              // Formatted events
+    size_t length;                                  // Length of the buffer
+    char   names[TRACE_MAX_DEPTH][TRACE_NAME_SIZE]; // Names of open spans
+    size_t depth;                                   // Number of open spans
+} TraceOutput;
+
+/* Write the formatted events to the file */
+static void output_flush(TraceOutput *output) {
+    size_t written = 0;
+    while (written < output->length) {
+        ssize_t result = write(output->fd, output->buffer + written,
+                               output->length - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += (size_t)result;
+    }
+    output->length = 0;
+}
+
+/* Append text to the output buffer. Events are formatted by hand rather
+ * than with printf, which would be most of the cost of tracing. */
+static void output_append(TraceOutput *output, const char *text,
+                          size_t length) {
+    if (output->length + length > TRACE_WRITE_BUFFER) {
+        output_flush(output);
+    }
+    memcpy(output->buffer + output->length, text, length);
+    output->length += length;
+}
+
+/* Append a string literal to the output buffer */
+#define output_literal(output, text)                                           \
+    output_append(output, text, sizeof(text) - 1)
+
+/* Append a number to the output buffer */
+static void output_number(TraceOutput *output, long long value) {
+    char   digits[24];
+    size_t length   = sizeof(digits);
+    bool   negative = value < 0;
+    unsigned long long magnitude =
+        negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--length] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (negative) {
+        digits[--length] = '-';
+    }
+    output_append(output, digits + length, sizeof(digits) - length);
+}
+
+/* Append a string as a JSON string */
+static void output_string(TraceOutput *output, const char *value) {
+    static const char hex[] = "0123456789abcdef";
+    char              text[TRACE_DETAIL_SIZE * 6 + 2];
+    size_t            length = 0;
+    text[length++]           = '"';
+    for (const unsigned char *c = (const unsigned char *)value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            text[length++] = '\\';
+            text[length++] = (char)*c;
+        } else if (*c < 0x20) {
+            memcpy(text + length, "\\u00", 4);
+            text[length + 4] = hex[*c >> 4];
+            text[length + 5] = hex[*c & 0xf];
+            length += 6;
+        } else {
+            text[length++] = (char)*c;
+        }
+    }
+    text[length++] = '"';
+    output_append(output, text, length);
+}
+
+/* Start an argument of an event */
+static void output_argument(TraceOutput *output, bool chrome,
+                            bool *arguments) {
+    if (!*arguments && chrome) {
+        output_literal(output, ",\"args\":{");
+    } else {
+        output_literal(output, ",");
+    }
+    *arguments = true;
+}
+
+/* Format an event */
+static void output_event(TraceOutput *output, const TraceEvent *event,
+                         TraceFormat format, pid_t pid) {
+    const char *name = event->name;
+    if (event->type == TRACE_BEGIN) {
+        // Slots are reused once written: keep the name for the end
+        if (output->depth < TRACE_MAX_DEPTH) {
+            memcpy(output->names[output->depth], event->name,
+                   TRACE_NAME_SIZE);
+        }
+        output->depth++;
+    } else if (event->type == TRACE_END) {
+        name = "";
+        if (output->depth > 0) {
+            output->depth--;
+            if (output->depth < TRACE_MAX_DEPTH) {
+                name = output->names[output->depth];
+            }
+        }
+    }
+
+    bool chrome = format == TRACE_CHROME;
+    if (chrome) {
+        // Microseconds, with the nanoseconds as decimals
+        static const char *phases[] = {[TRACE_BEGIN]   = "{\"ph\":\"B\"",
+                                       [TRACE_END]     = "{\"ph\":\"E\"",
+                                       [TRACE_INSTANT] = "{\"ph\":\"i\""};
+        char              fraction[4];
+        fraction[0] = (char)('0' + event->timestamp / 100 % 10);
+        fraction[1] = (char)('0' + event->timestamp / 10 % 10);
+        fraction[2] = (char)('0' + event->timestamp % 10);
+        fraction[3] = ',';
+        output_append(output, phases[event->type], 9);
+        output_literal(output, ",\"ts\":");
+        output_number(output, (long long)(event->timestamp / 1000));
+        output_literal(output, ".");
+        output_append(output, fraction, sizeof(fraction));
+        output_literal(output, "\"pid\":");
+        output_number(output, pid);
+        output_literal(output, ",\"tid\":");
+        output_number(output, pid);
+        if (event->type == TRACE_INSTANT) {
+            output_literal(output, ",\"s\":\"t\"");
+        }
+    } else {
+        static const char *types[] = {[TRACE_BEGIN]   = "\"begin\"",
+                                      [TRACE_END]     = "\"end\"",
+                                      [TRACE_INSTANT] = "\"instant\""};
+        output_literal(output, "{\"ts\":");
+        output_number(output, (long long)event->timestamp);
+        output_literal(output, ",\"type\":");
+        output_append(output, types[event->type], strlen(types[event->type]));
+        output_literal(output, ",\"pid\":");
+        output_number(output, pid);
+    }
+
+    output_literal(output, ",\"name\":");
+    output_string(output, name);
+    if (event->category) {
+        output_literal(output, ",\"cat\":");
+        output_string(output, event->category);
+    }
+
+    // Chrome traces keep the arguments apart, JSON lines inline them
+    bool arguments = false;
+    if (event->detail[0]) {
+        output_argument(output, chrome, &arguments);
+        output_literal(output, "\"detail\":");
+        output_string(output, event->detail);
+    }
+    if (event->pid) {
+        output_argument(output, chrome, &arguments);
+        output_literal(output, "\"child\":");
+        output_number(output, event->pid);
+    }
+    if (event->status != TRACE_NO_STATUS) {
+        output_argument(output, chrome, &arguments);
+        output_literal(output, "\"status\":");
+        output_number(output, event->status);
+    }
+    if (event->job) {
+        output_argument(output, chrome, &arguments);
+        output_literal(output, "\"job\":");
+        output_number(output, event->job);
+    }
+    if (arguments && chrome) {
+        output_literal(output, "}");
+    }
+    if (chrome) {
+        output_literal(output, "},\n");
+    } else {
+        output_literal(output, "}\n");
+    }
+}
+
+/* Format the events recorded since the last call */
+static size_t trace_drain(Trace *trace, TraceOutput *output) {
+    TraceRing *ring = trace->ring;
+    size_t     tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t     head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (size_t i = tail; i != head; i++) {
+        output_event(output, &ring->events[i & (TRACE_RING_SIZE - 1)],
+                     trace->format, trace->owner);
+    }
+    // Slots are only given back once the whole batch is formatted
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    return head - tail;
+}
+
+/* Writes the events of a trace to its file until it is closed or the shell
+ * is gone, in the writer process */
+static void trace_writer(Trace *trace) {
+    // Stay out of the way of the terminal: signals meant for the shell and
+    // its jobs are not meant for the writer
+    setpgid(0, 0);
+    // Nor should it keep the pipes the shell may be writing to open
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+        if (fd != trace->fd) {
+            close(fd);
+        }
+    }
+    struct sigaction action = {0};
+    action.sa_handler       = trace_wake;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+    sigset_t wake;
+    sigemptyset(&wake);
+    sigaddset(&wake, SIGUSR1);
+    sigprocmask(SIG_UNBLOCK, &wake, NULL);
+
+    TraceOutput *output = malloc(sizeof(TraceOutput));
+    if (!output) {
+        return;
+    }
+    output->fd     = trace->fd;
+    output->length = 0;
+    output->depth  = 0;
+
+    // Poll often while events come in, and less and less once idle
+    TraceRing *ring     = trace->ring;
+    long       interval = TRACE_WRITER_MIN_INTERVAL;
+    while (!atomic_load(&ring->stop) && getppid() == trace->owner) {
+        if (trace_drain(trace, output) > 0) {
+            interval = TRACE_WRITER_MIN_INTERVAL;
+        } else {
+            output_flush(output);
+            if (interval < TRACE_WRITER_MAX_INTERVAL) {
+                interval *= 2;
+            }
+        }
+        struct timespec sleep = {0, interval};
+        nanosleep(&sleep, NULL);
+    }
+    trace_drain(trace, output);
+
+    size_t dropped = atomic_load(&ring->dropped);
+    if (dropped > 0) {
+        TraceEvent event = {.timestamp = profile_now(),
+                            .type      = TRACE_INSTANT,
+                            .category  = "trace",
+                            .status    = TRACE_NO_STATUS};
+        snprintf(event.name, sizeof(event.name), "dropped %zu events",
+                 dropped);
+        output_event(output, &event, trace->format, trace->owner);
+    }
+    output_flush(output);
+    free(output);
+}
+
+Trace *open_trace(Trace *trace, const char *path, TraceFormat format) {
+    pthread_once(&trace_once, trace_setup);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    TraceRing *ring = mmap(NULL, sizeof(TraceRing), PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->stop, false);
+
+    bool allocated = false;
+    if (!trace) {
+        trace = malloc(sizeof(Trace));
+        if (!trace) {
+            munmap(ring, sizeof(TraceRing));
+            close(fd);
+            return NULL;
+        }
+        allocated = true;
+    }
+    trace->ring      = ring;
+    trace->format    = format;
+    trace->fd        = fd;
+    trace->owner     = trace_pid;
+    trace->free_tail = 0;
+
+    // The array is never closed: the format allows it, and other shells may
+    // append to the file after this one is done
+    struct stat st;
+    if (format == TRACE_CHROME && fstat(fd, &st) == 0 && st.st_size == 0) {
+        if (write(fd, "[\n", 2) != 2) {
+            // Events are still written, the file was just not started
+        }
+    }
+
+    // The writer is woken up with SIGUSR1: keep it blocked until the writer
+    // handles it, so that it cannot be killed by it
+    sigset_t wake, mask;
+    sigemptyset(&wake);
+    sigaddset(&wake, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &wake, &mask);
+    trace->writer = fork();
+    if (trace->writer == 0) {
+        trace_writer(trace);
+        _exit(0);
+    }
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+    if (trace->writer < 0) {
+        munmap(ring, sizeof(TraceRing));
+        close(fd);
+        if (allocated) {
+            free(trace);
+        }
+        return NULL;
+    }
+    // The writer has its copy: children forked from now on do not need one,
+    // and not sharing it keeps forks cheap
+    madvise(ring, sizeof(TraceRing), MADV_DONTFORK);
+
+    TraceEvent *event = trace_reserve(trace);
+    if (event) {
+        event->type     = TRACE_INSTANT;
+        event->category = "trace";
+        copy_field(event->name, sizeof(event->name), "trace started");
+        trace_commit(trace);
+    }
+    return trace;
+}
+
+Trace *open_requested_trace(Session *session) {
+    char *path = environ_get(session->environ, "TIDESH_TRACE");
+    if (!path || !path[0]) {
+        return NULL;
+    }
+    char       *format_name = environ_get(session->environ,
+                                          "TIDESH_TRACE_FORMAT");
+    TraceFormat format      = TRACE_CHROME;
+    if (format_name && strcmp(format_name, "jsonl") == 0) {
+        format = TRACE_JSONL;
+    }
+    return open_trace(NULL, path, format);
+}
+
+void trace_begin(Trace *trace, const char *category, const char *name,
+                 const char *detail) {
+    TraceEvent *event = trace_reserve(trace);
+    if (!event) {
+        return;
+    }
+    event->type     = TRACE_BEGIN;
+    event->category = category;
+    copy_field(event->name, sizeof(event->name), name);
+    copy_field(event->detail, sizeof(event->detail), detail);
+    trace_commit(trace);
+}
+
+void trace_end(Trace *trace) {
+    TraceEvent *event = trace_reserve(trace);
+    if (!event) {
+        return;
+    }
+    event->type = TRACE_END;
+    trace_commit(trace);
+}
+
+void trace_instant(Trace *trace, const char *category, const char *name,
+                   const char *detail) {
+    TraceEvent *event = trace_reserve(trace);
+    if (!event) {
+        return;
+    }
+    event->type     = TRACE_INSTANT;
+    event->category = category;
+    copy_field(event->name, sizeof(event->name), name);
+    copy_field(event->detail, sizeof(event->detail), detail);
+    trace_commit(trace);
+}
+
+void trace_process(Trace *trace, const char *name, pid_t pid, int status,
+                   const char *detail) {
+    TraceEvent *event = trace_reserve(trace);
+    if (!event) {
+        return;
+    }
+    event->type     = TRACE_INSTANT;
+    event->category = "process";
+    copy_field(event->name, sizeof(event->name), name);
+    copy_field(event->detail, sizeof(event->detail), detail);
+    event->pid    = pid;
+    event->status = status;
+    trace_commit(trace);
+}
+
+void trace_job(Trace *trace, int job, pid_t pid, const char *state) {
+    TraceEvent *event = trace_reserve(trace);
+    if (!event) {
+        return;
+    }
+    event->type     = TRACE_INSTANT;
+    event->category = "job";
+    copy_field(event->name, sizeof(event->name), state);
+    event->pid = pid;
+    event->job = job;
+    trace_commit(trace);
+}
+
+void close_trace(Trace *trace) {
+    if (!trace) {
+        return;
+    }
+    // A forked child has a copy of the trace, but neither its writer nor
+    // its buffer
+    if (trace->owner == trace_pid) {
+        atomic_store(&trace->ring->stop, true);
+        kill(trace->writer, SIGUSR1);
+        while (waitpid(trace->writer, NULL, 0) < 0 && errno == EINTR) {
+        }
+        munmap(trace->ring, sizeof(TraceRing));
+    }
+    close(trace->fd);
+    trace->ring = NULL;
+}
@@ -0,0 +1,416 @@
+#include <errno.h>      /* errno, EINTR */
+#include <fcntl.h>      /* open, O_RDONLY, O_RDWR, O_DIRECTORY, O_CLOEXEC */
+#include <pthread.h>    /* pthread_once, pthread_atfork */
+#include <signal.h>     /* signal, SIGINT, SIGQUIT, SIG_DFL, SIG_IGN */
+#include <stdint.h>     /* int32_t, uint32_t, uint8_t */
+#include <stdio.h>      /* fprintf, perror, stderr */
+#include <stdlib.h>     /* malloc, free */
+#include <string.h>     /* memcpy, memset, strcmp, strerror, strlen */
+#include <sys/socket.h> /* socketpair, sendmsg, recvmsg, SCM_RIGHTS */
+#include <sys/wait.h>   /* wait4, waitpid */
+#include <unistd.h>     /* fork, execve, dup2, fchdir, close, getpid */
+
+#include "environ.h" /* environ_get */
+#include "zygote.h"
+
+/* Descriptors sent with a request: the working directory and the
+ * standard streams */
+#define ZYGOTE_FDS 4
+
+/* Mode redirection targets are created with */
+#define RW_R__R__ 0644
+
+/* What the shell sends to start a command, followed by `length` bytes of
+ * strings: the path, the arguments, the environment variables and the
+ * targets of the redirections, each NUL terminated */
+typedef struct ZygoteRequest {
+    uint32_t argc;                            // Number of arguments
+    uint32_t envc;                            // Number of variables
+    uint32_t redirect_count;                  // Number of redirections
+    uint32_t length;                          // Length of the strings
+    int32_t  streams;                         // Standard streams sent (bits)
+    int32_t  fds[ZYGOTE_MAX_REDIRECTS];       // Redirected descriptors
+    int32_t  flags[ZYGOTE_MAX_REDIRECTS];     // How targets are opened
+    uint8_t  err[ZYGOTE_MAX_REDIRECTS];       // Whether stderr follows
+} ZygoteRequest;
+
+/* What the zygote sends back, once when the command is started and once
+ * when it is done */
+typedef struct ZygoteReply {
+    int32_t       pid;    // The command (-1 if it could not be started)
+    int32_t       status; // Its status (as waitpid gives it)
+    struct rusage usage;  // Its resource usage
+} ZygoteReply;
+
+/* The current process, updated in forked children */
+static pid_t          zygote_pid  = 0;
+static pthread_once_t zygote_once = PTHREAD_ONCE_INIT;
+
+static void zygote_forked(void) { zygote_pid = getpid(); }
+
+static void zygote_setup(void) {
+    zygote_pid = getpid();
+    pthread_atfork(NULL, NULL, zygote_forked);
+}
+
+/* Read exactly length bytes, or fail */
+static bool read_all_bytes(int fd, void *buffer, size_t length) {
+    char *bytes = buffer;
+    while (length > 0) {
+        ssize_t result = read(fd, bytes, length);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return true;
+}
+
+/* Write exactly length bytes, or fail (without SIGPIPE if the other end is
+ * gone) */
+static bool write_all_bytes(int fd, const void *buffer, size_t length) {
+    const char *bytes = buffer;
+    while (length > 0) {
+        ssize_t result = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return true;
+}
+
+/* Set up the process a request describes, and execute the command */
+static void zygote_exec(const ZygoteRequest *request, char *strings,
+                        const int *fds) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+
+    // The descriptors received are above the standard streams, which the
+    // zygote keeps open on /dev/null
+    if (fchdir(fds[0]) < 0) {
+        perror("tidesh: cd");
+    }
+    for (int i = 0; i < 3; i++) {
+        if (request->streams & (1 << i)) {
+            dup2(fds[i + 1], i);
+        } else {
+            close(i);
+        }
+    }
+
+    char  *path = strings;
+    char **argv = malloc((request->argc + 1) * sizeof(char *));
+    char **envp = malloc((request->envc + 1) * sizeof(char *));
+    if (!argv || !envp) {
+        _exit(126);
+    }
+    char *string = path + strlen(path) + 1;
+    for (uint32_t i = 0; i < request->argc; i++) {
+        argv[i] = string;
+        string += strlen(string) + 1;
+    }
+    argv[request->argc] = NULL;
+    for (uint32_t i = 0; i < request->envc; i++) {
+        envp[i] = string;
+        string += strlen(string) + 1;
+    }
+    envp[request->envc] = NULL;
+
+    for (uint32_t i = 0; i < request->redirect_count; i++) {
+        int fd = open(string, request->flags[i], RW_R__R__);
+        if (fd < 0) {
+            fprintf(stderr, "Error opening redirection target: %s\n",
+                    strerror(errno));
+            _exit(1);
+        }
+        dup2(fd, request->fds[i]);
+        if (request->err[i]) {
+            dup2(fd, STDERR_FILENO);
+        }
+        if (fd != request->fds[i]) {
+            close(fd);
+        }
+        string += strlen(string) + 1;
+    }
+
+    execve(path, argv, envp);
+    perror("execve");
+    _exit(126);
+}
+
+/* Receive a request and the descriptors sent with it */
+static bool zygote_receive(int socket, ZygoteRequest *request, int *fds,
+                           size_t *fd_count) {
+    char          control[CMSG_SPACE(sizeof(int) * ZYGOTE_FDS)];
+    struct iovec  data    = {request, sizeof(*request)};
+    struct msghdr message = {0};
+    message.msg_iov        = &data;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t result;
+    do {
+        result = recvmsg(socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    } while (result < 0 && errno == EINTR);
+    if (result != (ssize_t)sizeof(*request)) {
+        return false;
+    }
+
+    *fd_count = 0;
+    for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header;
+         header                 = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET &&
+            header->cmsg_type == SCM_RIGHTS) {
+            *fd_count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(header), *fd_count * sizeof(int));
+        }
+    }
+    return *fd_count == ZYGOTE_FDS;
+}
+
+/* Serve requests until the shell closes its end of the socket */
+static void zygote_serve(int socket) {
+    // Signals from the terminal are for the commands
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+
+    // Keep the standard streams busy, so that received descriptors never
+    // take their numbers, without holding on to the shell's
+    int null = open("/dev/null", O_RDWR);
+    for (int i = 0; i < 3; i++) {
+        if (null != i) {
+            dup2(null, i);
+        }
+    }
+    if (null > 2) {
+        close(null);
+    }
+
+    for (;;) {
+        ZygoteRequest request;
+        int           fds[ZYGOTE_FDS];
+        size_t        fd_count = 0;
+        if (!zygote_receive(socket, &request, fds, &fd_count)) {
+            for (size_t i = 0; i < fd_count; i++) {
+                close(fds[i]);
+            }
+            return;
+        }
+
+        char *strings = malloc(request.length + 1);
+        if (!strings || request.redirect_count > ZYGOTE_MAX_REDIRECTS ||
+            !read_all_bytes(socket, strings, request.length)) {
+            return;
+        }
+        strings[request.length] = '\0';
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(socket);
+            zygote_exec(&request, strings, fds);
+        }
+        free(strings);
+        for (int i = 0; i < ZYGOTE_FDS; i++) {
+            close(fds[i]);
+        }
+
+        ZygoteReply reply = {0};
+        reply.pid         = pid;
+        if (!write_all_bytes(socket, &reply, sizeof(reply))) {
+            return;
+        }
+        if (pid < 0) {
+            continue;
+        }
+
+        while (wait4(pid, &reply.status, 0, &reply.usage) < 0 &&
+               errno == EINTR) {
+        }
+        if (!write_all_bytes(socket, &reply, sizeof(reply))) {
+            return;
+        }
+    }
+}
+
+Zygote *start_zygote(Zygote *zygote) {
+    pthread_once(&zygote_once, zygote_setup);
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0) {
+        return NULL;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sockets[0]);
+        close(sockets[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        close(sockets[0]);
+        zygote_serve(sockets[1]);
+        _exit(0);
+    }
+    close(sockets[1]);
+
+    if (!zygote) {
+        zygote = malloc(sizeof(Zygote));
+        if (!zygote) {
+            close(sockets[0]);
+            waitpid(pid, NULL, 0);
+            return NULL;
+        }
+    }
+    zygote->socket = sockets[0];
+    zygote->pid    = pid;
+    zygote->owner  = zygote_pid;
+    return zygote;
+}
+
+Zygote *start_requested_zygote(Session *session) {
+    char *value = environ_get(session->environ, "TIDESH_ZYGOTE");
+    if (!value || !value[0] || strcmp(value, "0") == 0) {
+        return NULL;
+    }
+    return start_zygote(NULL);
+}
+
+bool zygote_usable(Zygote *zygote) {
+    return zygote && zygote->socket >= 0 && zygote->owner == zygote_pid;
+}
+
+/* Append a string and its NUL to the strings of a request */
+static void append_string(char *strings, size_t *length, const char *value) {
+    size_t size = strlen(value) + 1;
+    memcpy(strings + *length, value, size);
+    *length += size;
+}
+
+pid_t zygote_spawn(Zygote *zygote, const ZygoteCommand *command) {
+    if (!zygote_usable(zygote) ||
+        command->redirect_count > ZYGOTE_MAX_REDIRECTS) {
+        return -1;
+    }
+
+    ZygoteRequest request;
+    memset(&request, 0, sizeof(request));
+    size_t length = strlen(command->path) + 1;
+    for (; command->argv[request.argc]; request.argc++) {
+        length += strlen(command->argv[request.argc]) + 1;
+    }
+    for (; command->envp[request.envc]; request.envc++) {
+        length += strlen(command->envp[request.envc]) + 1;
+    }
+    request.redirect_count = (uint32_t)command->redirect_count;
+    for (size_t i = 0; i < command->redirect_count; i++) {
+        request.fds[i]   = command->redirects[i].fd;
+        request.flags[i] = command->redirects[i].flags;
+        request.err[i]   = command->redirects[i].err;
+        length += strlen(command->redirects[i].target) + 1;
+    }
+    request.length = (uint32_t)length;
+
+    char *strings = malloc(length);
+    if (!strings) {
+        return -1;
+    }
+    length = 0;
+    append_string(strings, &length, command->path);
+    for (uint32_t i = 0; i < request.argc; i++) {
+        append_string(strings, &length, command->argv[i]);
+    }
+    for (uint32_t i = 0; i < request.envc; i++) {
+        append_string(strings, &length, command->envp[i]);
+    }
+    for (size_t i = 0; i < command->redirect_count; i++) {
+        append_string(strings, &length, command->redirects[i].target);
+    }
+
+    // Closed standard streams are sent as the working directory, and
+    // closed again by the command
+    int fds[ZYGOTE_FDS];
+    fds[0] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fds[0] < 0) {
+        free(strings);
+        return -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (fcntl(i, F_GETFD) >= 0) {
+            request.streams |= 1 << i;
+            fds[i + 1] = i;
+        } else {
+            fds[i + 1] = fds[0];
+        }
+    }
+
+    char          control[CMSG_SPACE(sizeof(fds))];
+    struct iovec  data    = {&request, sizeof(request)};
+    struct msghdr message = {0};
+    memset(control, 0, sizeof(control));
+    message.msg_iov        = &data;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level     = SOL_SOCKET;
+    header->cmsg_type      = SCM_RIGHTS;
+    header->cmsg_len       = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(zygote->socket, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    close(fds[0]);
+
+    ZygoteReply reply;
+    bool        ok = sent == (ssize_t)sizeof(request) &&
+              write_all_bytes(zygote->socket, strings, length) &&
+              read_all_bytes(zygote->socket, &reply, sizeof(reply));
+    free(strings);
+    if (!ok || reply.pid < 0) {
+        // Whatever went wrong, the zygote cannot be relied on anymore
+        stop_zygote(zygote);
+        return -1;
+    }
+    return reply.pid;
+}
+
+bool zygote_wait(Zygote *zygote, pid_t pid, int *status,
+                 struct rusage *usage) {
+    ZygoteReply reply;
+    if (!zygote_usable(zygote) ||
+        !read_all_bytes(zygote->socket, &reply, sizeof(reply)) ||
+        reply.pid != pid) {
+        stop_zygote(zygote);
+        return false;
+    }
+    *status = reply.status;
+    if (usage) {
+        *usage = reply.usage;
+    }
+    return true;
+}
+
+void stop_zygote(Zygote *zygote) {
+    if (!zygote || zygote->socket < 0) {
+        return;
+    }
+    close(zygote->socket);
+    zygote->socket = -1;
+    // A forked child has a copy of the socket, but the zygote is not its
+    if (zygote->owner == zygote_pid) {
+        while (waitpid(zygote->pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+    }
+}
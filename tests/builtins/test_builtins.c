@@ -33,4 +33,19 @@ describe(builtin) {
         int (*nonexistent)(int, char **, Session *) = get_builtin("nonexistent");
         asserteq(nonexistent, NULL);
     }
+
+    it("should find every listed builtin by its own name") {
+        for (int i = 0; builtins[i]; i++) {
+            const Builtin *builtin = find_builtin(builtins[i]);
+            assertneq(builtin, NULL);
+            asserteq_str(builtin->name, builtins[i]);
+        }
+        asserteq(find_builtin(".")->function, get_builtin("source"));
+        asserteq(find_builtin("[")->function, get_builtin("test"));
+        // Other names are rejected by the comparison after the probe
+        asserteq(find_builtin(""), NULL);
+        asserteq(find_builtin("cdx"), NULL);
+        asserteq(find_builtin("exi"), NULL);
+        asserteq(find_builtin("pw"), NULL);
+    }
 }
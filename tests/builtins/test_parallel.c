@@ -0,0 +1,125 @@
+#include <stdio.h>  /* fopen, fread, fclose */
+#include <stdlib.h> /* free */
+#include <string.h> /* strcmp */
+#include <unistd.h> /* dup, dup2, close */
+
+#include "builtin.h"
+#include "session.h"
+#include "snow/snow.h"
+
+describe(parallel) {
+    it("should count failed jobs") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        char *argv[] = {"parallel", "-j", "2", "test", "{}", "-eq", "0",
+                        ":::",      "0",  "1", "0",    "1"};
+        int   result = builtin_parallel(12, argv, session);
+        asserteq(result, 2);
+        asserteq(session->jobs->count, 0);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should keep outputs in input order with -k") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        FILE *out = fopen("/tmp/test_parallel_output", "w+");
+        assertneq(out, NULL);
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+
+        char *argv[] = {"parallel", "-k", "-j", "3", "echo",
+                        ":::",      "a",  "b",  "c"};
+        int   result = builtin_parallel(9, argv, session);
+
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        asserteq(result, 0);
+
+        char   buffer[64] = {0};
+        rewind(out);
+        size_t read       = fread(buffer, 1, sizeof(buffer) - 1, out);
+        fclose(out);
+        buffer[read] = '\0';
+        asserteq(strcmp(buffer, "a\nb\nc\n"), 0);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should pass each item as a single literal word") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        FILE *out = fopen("/tmp/test_parallel_output", "w+");
+        assertneq(out, NULL);
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+
+        char *argv[] = {"parallel",    "-k",          "echo",
+                        ":::",         "x$HOME",      "back\\slash",
+                        "it's \"a  b\""};
+        int   result = builtin_parallel(7, argv, session);
+
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        asserteq(result, 0);
+
+        char   buffer[64] = {0};
+        rewind(out);
+        size_t read       = fread(buffer, 1, sizeof(buffer) - 1, out);
+        fclose(out);
+        buffer[read] = '\0';
+        asserteq(strcmp(buffer, "x$HOME\nback\\slash\nit's \"a  b\"\n"), 0);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should pass each template word as a single literal word") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        FILE *out = fopen("/tmp/test_parallel_output", "w+");
+        assertneq(out, NULL);
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+
+        char *argv[] = {"parallel", "echo", "a;echo b", "<{}>", ":::", "x"};
+        int   result = builtin_parallel(6, argv, session);
+
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        asserteq(result, 0);
+
+        char   buffer[64] = {0};
+        rewind(out);
+        size_t read       = fread(buffer, 1, sizeof(buffer) - 1, out);
+        fclose(out);
+        buffer[read] = '\0';
+        asserteq(strcmp(buffer, "a;echo b <x>\n"), 0);
+
+        // The script is a single argument of sh
+        char *exits[] = {"parallel", "sh", "-c", "exit 3", ":::", "y"};
+        asserteq(builtin_parallel(6, exits, session), 1);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should reject an invalid job count") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        char *argv[] = {"parallel", "-j", "0", "echo", ":::", "a"};
+        int   result = builtin_parallel(6, argv, session);
+        asserteq(result, 255);
+
+        free_session(session);
+        free(session);
+    }
+}
@@ -0,0 +1,88 @@
+#include <signal.h>   /* kill, SIGKILL */
+#include <stdlib.h>   /* free, exit */
+#include <sys/wait.h> /* waitpid */
+#include <unistd.h>   /* fork, usleep */
+
+#include "builtin.h"
+#include "jobs.h"
+#include "session.h"
+#include "snow/snow.h"
+
+describe(wait) {
+    it("should return the exit status of a waited job") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            usleep(50000);
+            _exit(7);
+        }
+        jobs_add(session->jobs, pid, "exit 7", JOB_RUNNING);
+
+        char *argv[] = {"wait", "%1"};
+        int   result = builtin_wait(2, argv, session);
+        asserteq(result, 7);
+        asserteq(session->jobs->count, 0);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should return the first job to finish with -n") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        pid_t slow = fork();
+        if (slow == 0) {
+            usleep(2000000);
+            _exit(1);
+        }
+        pid_t fast = fork();
+        if (fast == 0) {
+            _exit(3);
+        }
+        jobs_add(session->jobs, slow, "slow", JOB_RUNNING);
+        jobs_add(session->jobs, fast, "fast", JOB_RUNNING);
+
+        char *argv[] = {"wait", "-n"};
+        int   result = builtin_wait(2, argv, session);
+        asserteq(result, 3);
+        asserteq(session->jobs->count, 1);
+
+        kill(slow, SIGKILL);
+        waitpid(slow, NULL, 0);
+        free_session(session);
+        free(session);
+    }
+
+    it("should give up after the timeout") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            usleep(2000000);
+            _exit(0);
+        }
+        jobs_add(session->jobs, pid, "sleep", JOB_RUNNING);
+
+        char *argv[] = {"wait", "--timeout", "0.05"};
+        int   result = builtin_wait(3, argv, session);
+        asserteq(result, 124);
+        asserteq(session->jobs->count, 1);
+
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        free_session(session);
+        free(session);
+    }
+
+    it("should reject unknown jobs") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        char *argv[] = {"wait", "%4"};
+        int   result = builtin_wait(2, argv, session);
+        asserteq(result, 127);
+
+        free_session(session);
+        free(session);
+    }
+}
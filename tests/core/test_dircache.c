@@ -0,0 +1,134 @@
+#include <fcntl.h>    /* open, O_CREAT, O_WRONLY, AT_FDCWD */
+#include <stdio.h>    /* snprintf */
+#include <stdlib.h>   /* free, mkdtemp */
+#include <sys/stat.h> /* utimensat */
+#include <time.h>     /* time */
+#include <unistd.h>   /* close, unlink, rmdir */
+
+#include "dircache.h"
+#include "snow/snow.h"
+
+/* Create an empty file inside a directory */
+static void touch_in(const char *dir, const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_CREAT | O_WRONLY, 0644);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/* Remove a file created by touch_in */
+static void remove_in(const char *dir, const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+/* Move a directory's mtime into the past so its listing can be trusted */
+static void age_directory(const char *dir) {
+    struct timespec times[2];
+    times[0].tv_sec  = time(NULL) - 3600;
+    times[0].tv_nsec = 0;
+    times[1]         = times[0];
+    utimensat(AT_FDCWD, dir, times, 0);
+}
+
+describe(dircache) {
+    it("should list a directory without . and ..") {
+        char root[] = "/tmp/tidesh_dircache_XXXXXX";
+        assertneq(mkdtemp(root), NULL);
+        touch_in(root, "a");
+        touch_in(root, "b");
+
+        DirCache         *cache   = init_dircache(NULL);
+        const DirListing *listing = dircache_get(cache, root);
+        assertneq(listing, NULL);
+        asserteq(listing->count, 2);
+        dircache_release(cache, listing);
+
+        free_dircache(cache);
+        free(cache);
+        remove_in(root, "a");
+        remove_in(root, "b");
+        rmdir(root);
+    }
+
+    it("should reuse listings of unchanged directories") {
+        char root[] = "/tmp/tidesh_dircache_XXXXXX";
+        assertneq(mkdtemp(root), NULL);
+        touch_in(root, "a");
+        age_directory(root);
+
+        DirCache         *cache   = init_dircache(NULL);
+        const DirListing *listing = dircache_get(cache, root);
+        dircache_release(cache, listing);
+        listing = dircache_get(cache, root);
+        assertneq(listing, NULL);
+        asserteq(cache->misses, 1);
+        asserteq(cache->hits, 1);
+        dircache_release(cache, listing);
+
+        free_dircache(cache);
+        free(cache);
+        remove_in(root, "a");
+        rmdir(root);
+    }
+
+    it("should reread directories that changed") {
+        char root[] = "/tmp/tidesh_dircache_XXXXXX";
+        assertneq(mkdtemp(root), NULL);
+        touch_in(root, "a");
+        age_directory(root);
+
+        DirCache         *cache   = init_dircache(NULL);
+        const DirListing *listing = dircache_get(cache, root);
+        asserteq(listing->count, 1);
+        dircache_release(cache, listing);
+
+        touch_in(root, "b");
+        listing = dircache_get(cache, root);
+        assertneq(listing, NULL);
+        asserteq(listing->count, 2);
+        asserteq(cache->misses, 2);
+        dircache_release(cache, listing);
+
+        free_dircache(cache);
+        free(cache);
+        remove_in(root, "a");
+        remove_in(root, "b");
+        rmdir(root);
+    }
+
+    it("should not evict pinned listings") {
+        char roots[DIRCACHE_MAX_LISTINGS + 1][32];
+        DirCache *cache = init_dircache(NULL);
+
+        const DirListing *first = NULL;
+        for (int i = 0; i <= DIRCACHE_MAX_LISTINGS; i++) {
+            snprintf(roots[i], sizeof(roots[i]), "/tmp/tidesh_dircache_XXXXXX");
+            assertneq(mkdtemp(roots[i]), NULL);
+            touch_in(roots[i], "entry");
+            const DirListing *listing = dircache_get(cache, roots[i]);
+            if (i == 0) {
+                first = listing;
+            } else if (i < DIRCACHE_MAX_LISTINGS) {
+                dircache_release(cache, listing);
+            } else {
+                // Evicts the least recently used unpinned listing
+                assertneq(listing, NULL);
+                assertneq(listing, first);
+                dircache_release(cache, listing);
+            }
+        }
+        asserteq(first->count, 1);
+        dircache_release(cache, first);
+
+        free_dircache(cache);
+        free(cache);
+        for (int i = 0; i <= DIRCACHE_MAX_LISTINGS; i++) {
+            remove_in(roots[i], "entry");
+            rmdir(roots[i]);
+        }
+    }
+}
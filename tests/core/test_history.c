@@ -250,4 +250,48 @@ describe(history) {
         free_history(history);
         free(history);
     }
+
+    it("should read a deferred history file on first use") {
+        const char *path = "/tmp/tidesh_test_deferred_history";
+        FILE       *file = fopen(path, "w");
+        assertneq(file, NULL);
+        fprintf(file, "1,first\n2,second\n");
+        fclose(file);
+
+        History *history = init_history(NULL);
+        history_defer_load(history, (char *)path);
+        asserteq(history->size, 0);
+        asserteq_str(history_last_command(history), "second");
+        asserteq(history->size, 2);
+
+        free_history(history);
+        free(history);
+        unlink(path);
+    }
+
+    it("should load a history file in the background") {
+        const char *path = "/tmp/tidesh_test_background_history";
+        FILE       *file = fopen(path, "w");
+        assertneq(file, NULL);
+        fprintf(file, "1,first\n2,second\n");
+        fclose(file);
+
+        InternTable *strings = init_intern_table(NULL);
+        History     *history = init_history(NULL);
+        history->strings     = strings;
+        history_defer_load(history, (char *)path);
+        assert(history_load_in_background(history));
+        asserteq(history_load_in_background(history), false);
+
+        history_append(history, "third");
+        asserteq(history->size, 3);
+        asserteq_str(history_nth_command(history, 1), "first");
+        asserteq_str(history_last_command(history), "third");
+
+        free_history(history);
+        free(history);
+        free_intern_table(strings);
+        free(strings);
+        unlink(path);
+    }
 }
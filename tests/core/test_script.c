@@ -0,0 +1,101 @@
+#include <stdlib.h> /* free, mkstemp */
+#include <string.h> /* strlen */
+#include <unistd.h> /* pipe, write, close, lseek, unlink */
+
+#include "environ.h"
+#include "script.h"
+#include "session.h"
+#include "snow/snow.h"
+
+/* Create a temporary script file and return a descriptor open on it */
+static int script_file(const char *content) {
+    char path[] = "/tmp/tidesh_script_XXXXXX";
+    int  fd     = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (write(fd, content, strlen(content)) != (ssize_t)strlen(content)) {
+        close(fd);
+        return -1;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+describe(script) {
+    it("should split a script into top-level commands") {
+        int fd = script_file("# comment\n"
+                             "echo a; echo b\n"
+                             "\n"
+                             "if true\n"
+                             "then\n"
+                             "  echo c\n"
+                             "fi\n"
+                             "echo \"d\n"
+                             "e\" |\n"
+                             "  cat\n"
+                             "echo f");
+        assert(fd >= 0);
+
+        ScriptReader reader;
+        assertneq(init_script_reader(&reader, fd, NULL), NULL);
+
+        char *command = script_reader_next(&reader);
+        asserteq_str(command, "echo a; echo b\n");
+        free(command);
+        command = script_reader_next(&reader);
+        asserteq_str(command, "if true\nthen\n  echo c\nfi\n");
+        free(command);
+        command = script_reader_next(&reader);
+        asserteq_str(command, "echo \"d\ne\" |\n  cat\n");
+        free(command);
+        command = script_reader_next(&reader);
+        asserteq_str(command, "echo f");
+        free(command);
+        asserteq(script_reader_next(&reader), NULL);
+
+        free_script_reader(&reader);
+        close(fd);
+    }
+
+    it("should return commands before the rest of the script is written") {
+        int fds[2];
+        asserteq(pipe(fds), 0);
+
+        ScriptReader reader;
+        assertneq(init_script_reader(&reader, fds[0], NULL), NULL);
+
+        const char *first = "cat <<EOF\nbody\nEOF\n";
+        asserteq(write(fds[1], first, strlen(first)), (ssize_t)strlen(first));
+        char *command = script_reader_next(&reader);
+        asserteq_str(command, first);
+        free(command);
+
+        const char *second = "echo done\n";
+        asserteq(write(fds[1], second, strlen(second)),
+                 (ssize_t)strlen(second));
+        close(fds[1]);
+        command = script_reader_next(&reader);
+        asserteq_str(command, second);
+        free(command);
+        asserteq(script_reader_next(&reader), NULL);
+
+        free_script_reader(&reader);
+        close(fds[0]);
+    }
+
+    it("should run commands before a later syntax error") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        int      fd      = script_file("export SCRIPT_VAR=ran\n"
+                                       "echo oops |\n");
+        assert(fd >= 0);
+
+        execute_script(fd, session);
+        asserteq_str(environ_get(session->environ, "SCRIPT_VAR"), "ran");
+
+        close(fd);
+        free_session(session);
+        free(session);
+    }
+}
@@ -1,9 +1,34 @@
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "execute.h"
+#include "expand.h"
 #include "session.h"
 #include "snow/snow.h"
 
+/* Create a session, then look up and expand in it (run by many threads) */
+static void *drive_session(void *result) {
+    for (int i = 0; i < 10; i++) {
+        Session *session = init_session(NULL, NULL);
+        char    *path    = session ? find_in_path("ls", session) : NULL;
+        Array   *words   = session ? full_expansion("a{b,c}", session) : NULL;
+        if (!path || !words || words->count != 2) {
+            *(bool *)result = false;
+        }
+        free(path);
+        if (words) {
+            free_array(words);
+            free(words);
+        }
+        if (session) {
+            free_session(session);
+            free(session);
+        }
+    }
+    return NULL;
+}
+
 describe(session) {
     it("should initialize a session") {
         Session *session = init_session(NULL, "/tmp/test_history");
@@ -136,4 +161,19 @@ describe(session) {
             free(session);
         }
     }
+
+    it("should drive sessions from many threads") {
+        pthread_t threads[4];
+        bool      results[4];
+        for (int i = 0; i < 4; i++) {
+            results[i] = true;
+            asserteq(
+                pthread_create(&threads[i], NULL, drive_session, &results[i]),
+                0);
+        }
+        for (int i = 0; i < 4; i++) {
+            pthread_join(threads[i], NULL);
+            assert(results[i]);
+        }
+    }
 }
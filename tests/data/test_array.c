@@ -159,10 +159,11 @@ describe(array) {
         array_sort(arr);
         
         // Arrays should be sorted lexicographically
-        // Just verify it doesn't crash and has correct count
         asserteq(arr->count, 4);
-        assertneq(arr->items[0], NULL);
-        assertneq(arr->items[3], NULL);
+        asserteq_str(arr->items[0], "apple");
+        asserteq_str(arr->items[1], "banana");
+        asserteq_str(arr->items[2], "mango");
+        asserteq_str(arr->items[3], "zebra");
         
         free_array(arr);
         free(arr);
@@ -153,6 +153,24 @@ describe(dynamic) {
         free(dyn);
     }
 
+    it("should keep short strings inline") {
+        Dynamic dyn = {0};
+        init_dynamic(&dyn);
+        dynamic_extend(&dyn, "short");
+        asserteq(dyn.value, dyn.small);
+
+        char long_string[DYNAMIC_INLINE_CAPACITY * 4 + 1];
+        memset(long_string, 'x', sizeof(long_string) - 1);
+        long_string[sizeof(long_string) - 1] = '\0';
+        dynamic_extend(&dyn, long_string);
+        assertneq(dyn.value, dyn.small);
+        asserteq(dyn.length, 5 + sizeof(long_string) - 1);
+        assert(dyn.capacity > dyn.length);
+        asserteq(strncmp(dyn.value, "shortxxx", 8), 0);
+
+        free_dynamic(&dyn);
+    }
+
     it("should handle empty dynamic") {
         Dynamic *dyn = init_dynamic(NULL);
         char *str = dynamic_to_string(dyn);
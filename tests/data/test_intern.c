@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include "data/intern.h"
+#include "snow/snow.h"
+
+describe(intern) {
+    it("should return the same pointer for equal strings") {
+        InternTable table;
+        assertneq(init_intern_table(&table), NULL);
+
+        char        buffer[] = "echo hello";
+        const char *first    = intern_string(&table, "echo hello");
+        const char *second   = intern_string(&table, buffer);
+        asserteq(first, second);
+        asserteq_str(first, "echo hello");
+        assertneq(intern_string(&table, "echo world"), first);
+        asserteq_int(table.count, 2);
+
+        // Only the given bytes are interned
+        asserteq(intern_string_length(&table, "echo hello!", 10), first);
+
+        free_intern_table(&table);
+    }
+
+    it("should free strings with their last reference") {
+        InternTable table;
+        init_intern_table(&table);
+
+        const char *string = intern_string(&table, "/usr/bin");
+        intern_retain(string);
+        intern_release(&table, string);
+        assert(intern_contains(&table, string));
+        asserteq_int(table.count, 1);
+
+        intern_release(&table, string);
+        asserteq_int(table.count, 0);
+        asserteq_int(table.bytes, 0);
+
+        free_intern_table(&table);
+    }
+
+    it("should keep lookups working while growing and releasing") {
+        InternTable table;
+        init_intern_table(&table);
+
+        const char *strings[500];
+        char        buffer[32];
+        for (int i = 0; i < 500; i++) {
+            snprintf(buffer, sizeof(buffer), "word%d", i);
+            strings[i] = intern_string(&table, buffer);
+        }
+        asserteq_int(table.count, 500);
+
+        // Release every other string, moving entries back into the holes
+        for (int i = 0; i < 500; i += 2) {
+            intern_release(&table, strings[i]);
+        }
+        asserteq_int(table.count, 250);
+        for (int i = 1; i < 500; i += 2) {
+            snprintf(buffer, sizeof(buffer), "word%d", i);
+            assert(intern_contains(&table, strings[i]));
+            asserteq(intern_string(&table, buffer), strings[i]);
+        }
+
+        free_intern_table(&table);
+    }
+}
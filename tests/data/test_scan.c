@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <string.h>
+#include "data/scan.h"
+#include "snow/snow.h"
+
+describe(scan) {
+    it("should find the first byte of the set") {
+        ScanSet set = SCANSET("$\\");
+        asserteq_int(scan_until("abc$def\\", 8, &set), 3);
+        asserteq_int(scan_until("\\abc", 4, &set), 0);
+    }
+
+    it("should return the length without a match") {
+        ScanSet set = SCANSET(" ");
+        asserteq_int(scan_until("abcdef", 6, &set), 6);
+        asserteq_int(scan_until("", 0, &set), 0);
+        // Bytes past the length are never reported
+        asserteq_int(scan_until("abc def", 3, &set), 3);
+    }
+
+    it("should find matches in every position of long buffers") {
+        ScanSet set    = SCANSET("|;");
+        char   *buffer = malloc(200);
+        for (size_t position = 0; position < 100; position++) {
+            memset(buffer, 'x', 100);
+            buffer[position] = position % 2 ? '|' : ';';
+            asserteq_int(scan_until(buffer, 100, &set), position);
+        }
+        memset(buffer, 'x', 100);
+        asserteq_int(scan_until(buffer, 100, &set), 100);
+        free(buffer);
+    }
+
+    it("should stop at non-ASCII bytes and at the stop byte") {
+        asserteq_int(scan_ascii("plain text", 10, '\n'), 10);
+        asserteq_int(scan_ascii("caf\xc3\xa9", 5, '\n'), 3);
+        asserteq_int(scan_ascii("two\nlines", 9, '\n'), 3);
+
+        char *buffer = malloc(100);
+        for (size_t position = 0; position < 100; position++) {
+            memset(buffer, 'x', 100);
+            buffer[position] = position % 2 ? (char)0xE6 : '\x1b';
+            asserteq_int(scan_ascii(buffer, 100, '\x1b'), position);
+        }
+        free(buffer);
+    }
+}
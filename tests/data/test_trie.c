@@ -218,4 +218,21 @@ describe(trie) {
         free_trie(trie);
         free(trie);
     }
+
+    it("should measure its nodes and keys") {
+        Trie *trie = init_trie(NULL);
+        TrieStats empty = trie_stats(trie);
+        asserteq(empty.nodes, 1);
+        asserteq(empty.keys, 0);
+
+        trie_set(trie, "ab", "1");
+        trie_set(trie, "ac", "22");
+        TrieStats stats = trie_stats(trie);
+        asserteq(stats.nodes, 4);
+        asserteq(stats.keys, 2);
+        asserteq(stats.bytes, 4 * (empty.bytes) + 2 + 3);
+
+        free_trie(trie);
+        free(trie);
+    }
 }
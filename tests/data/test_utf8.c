@@ -122,4 +122,32 @@ describe(utf8) {
         assert(utf8_charlen(' ') == 1);
         assert(utf8_charlen('\n') == 1);
     }
+
+    it("should decode characters and reject invalid sequences") {
+        unsigned char length;
+        asserteq_int(utf8_decode("a", 1, &length), 'a');
+        asserteq_int(length, 1);
+        asserteq_int(utf8_decode("\xc3\xa9", 2, &length), 0xE9);
+        asserteq_int(length, 2);
+        asserteq_int(utf8_decode("\xf0\x9f\x8e\x89", 4, &length), 0x1F389);
+        asserteq_int(length, 4);
+        // Truncated and invalid sequences take a single byte
+        asserteq_int(utf8_decode("\xe6\x97", 2, &length), 0xFFFD);
+        asserteq_int(length, 1);
+        asserteq_int(utf8_decode("\xc3" "a", 2, &length), 0xFFFD);
+        asserteq_int(length, 1);
+    }
+
+    it("should count terminal columns") {
+        asserteq_int(utf8_width("hello", 5), 5);
+        asserteq_int(utf8_width("caf\xc3\xa9", 5), 4);
+        // East Asian wide characters and emoji take two columns
+        asserteq_int(utf8_width("日本語", strlen("日本語")), 6);
+        asserteq_int(utf8_width("🎉!", strlen("🎉!")), 3);
+        // Combining marks take none
+        asserteq_int(utf8_width("e\xcc\x81", 3), 1);
+        asserteq_int(utf8_codepoint_width(0x200B), 0);
+        asserteq_int(utf8_codepoint_width(0xFF21), 2);
+        asserteq_int(utf8_codepoint_width(0x00E9), 1);
+    }
 }
@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "execute.h"
+#include "profile.h"
+#include "trace.h"
+#include "zygote.h"
 #include "snow/snow.h"
 
 describe(execute) {
@@ -229,4 +233,189 @@ describe(execute) {
         free_session(session);
         free(session);
     }
+
+    it("should only run command substitutions that are expanded") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        unlink("/tmp/tidesh_substitution_marker");
+
+        execute_string("false && echo $(touch /tmp/tidesh_substitution_marker)", session);
+        asserteq(access("/tmp/tidesh_substitution_marker", F_OK), -1);
+
+        execute_string("SUBSTITUTED=$(echo value)", session);
+        asserteq_str(environ_get(session->environ, "SUBSTITUTED"), "value");
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should split the time of a command into phases") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        Profile  profile;
+        session->profile = init_profile(&profile);
+
+        asserteq_int(execute_string("pwd > /dev/null", session), 0);
+        asserteq_int(profile.calls[PROFILE_PARSE], 1);
+        // The redirection target is expanded by the child
+        asserteq_int(profile.calls[PROFILE_EXPANSION], 1);
+        asserteq_int(profile.calls[PROFILE_SPAWN], 1);
+        asserteq_int(profile.calls[PROFILE_WAIT], 1);
+        asserteq_int(profile.depth, 0);
+
+        // Nested phases are only charged once
+        uint64_t total = 0;
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            total += profile.elapsed[i];
+        }
+        asserteq(total, profile.last - profile.start);
+
+        session->profile = NULL;
+        free_session(session);
+        free(session);
+    }
+
+    it("should time a command with the time prefix") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        // The prefix keeps the status of the command
+        asserteq_int(execute_string("time false", session), 1);
+        asserteq_int(execute_string("time -v true", session), 0);
+        asserteq(session->profile, NULL);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should run the time builtin from an expanded command word") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        asserteq_int(execute_string("T=time", session), 0);
+        asserteq_int(execute_string("$T true", session), 0);
+        asserteq_int(execute_string("$T false", session), 1);
+        asserteq(session->profile, NULL);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should record a trace of a command") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        unlink("/tmp/test_trace.jsonl");
+        session->trace =
+            open_trace(NULL, "/tmp/test_trace.jsonl", TRACE_JSONL);
+        assertneq_ptr(session->trace, NULL);
+
+        asserteq_int(execute_string("pwd > /dev/null", session), 0);
+        close_trace(session->trace);
+        free(session->trace);
+        session->trace = NULL;
+
+        FILE *file = fopen("/tmp/test_trace.jsonl", "r");
+        assertneq_ptr(file, NULL);
+        char   line[512];
+        size_t begins = 0, ends = 0;
+        bool   command = false, forked = false, exited = false;
+        while (fgets(line, sizeof(line), file)) {
+            asserteq_int(line[0], '{');
+            assert(strstr(line, "}\n") != NULL);
+            begins += strstr(line, "\"type\":\"begin\"") != NULL;
+            ends += strstr(line, "\"type\":\"end\"") != NULL;
+            command |= strstr(line, "\"cat\":\"command\"") != NULL;
+            forked |= strstr(line, "\"name\":\"fork\"") != NULL;
+            exited |= strstr(line, "\"name\":\"exit\"") != NULL &&
+                      strstr(line, "\"status\":0") != NULL;
+        }
+        fclose(file);
+        unlink("/tmp/test_trace.jsonl");
+
+        // Every span is closed
+        assert(begins > 0);
+        asserteq_int(begins, ends);
+        assert(command);
+        assert(forked);
+        assert(exited);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should trace the exit of every forked process") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        unlink("/tmp/test_trace.jsonl");
+        session->trace =
+            open_trace(NULL, "/tmp/test_trace.jsonl", TRACE_JSONL);
+        assertneq_ptr(session->trace, NULL);
+
+        asserteq_int(execute_string("pwd | cat > /dev/null", session), 0);
+        asserteq_int(execute_string("X=$(pwd)", session), 0);
+        close_trace(session->trace);
+        free(session->trace);
+        session->trace = NULL;
+
+        FILE *file = fopen("/tmp/test_trace.jsonl", "r");
+        assertneq_ptr(file, NULL);
+        char   line[512];
+        size_t forks = 0, exits = 0;
+        while (fgets(line, sizeof(line), file)) {
+            forks += strstr(line, "\"name\":\"fork\"") != NULL;
+            exits += strstr(line, "\"name\":\"exit\"") != NULL;
+        }
+        fclose(file);
+        unlink("/tmp/test_trace.jsonl");
+
+        // Both sides of the pipe, their children and the substitution
+        assert(forks >= 3);
+        asserteq_int(forks, exits);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should count what commands do") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        asserteq_int(execute_string("pwd > /dev/null", session), 0);
+        asserteq_int(execute_string("cd .", session), 0);
+        asserteq_int(execute_string("echo {a,b}/nothing* > /dev/null",
+                                    session),
+                     0);
+        asserteq(session->stats.commands, 3);
+        asserteq(session->stats.forks, 2);
+        asserteq(session->stats.builtins, 1);
+        asserteq(session->stats.globs, 2);
+        asserteq(session->stats.glob_matches, 0);
+        // Redirection targets are expanded by the children
+        asserteq(session->stats.words, 6);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should start external commands with the zygote") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        session->zygote  = start_zygote(NULL);
+        assertneq_ptr(session->zygote, NULL);
+
+        unlink("/tmp/test_zygote.out");
+        asserteq_int(execute_string("ls -d / > /tmp/test_zygote.out", session),
+                     0);
+        asserteq_int(execute_string("sh -c 'exit 3'", session), 3);
+        // Redirections are opened by the command, as when forking
+        asserteq_int(execute_string("ls > /nonexistent/file", session), 1);
+        asserteq(session->stats.zygote_spawns, 3);
+
+        FILE *file = fopen("/tmp/test_zygote.out", "r");
+        assertneq_ptr(file, NULL);
+        char line[16] = {0};
+        assertneq_ptr(fgets(line, sizeof(line), file), NULL);
+        fclose(file);
+        unlink("/tmp/test_zygote.out");
+        asserteq_str(line, "/\n");
+
+        // Background commands are still forked
+        asserteq_int(execute_string("true &", session), 0);
+        asserteq(session->stats.zygote_spawns, 3);
+
+        free_session(session);
+        free(session);
+    }
 }
@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "server.h"
+#include "snow/snow.h"
+
+/* Send an execute request */
+static void send_request(int fd, uint32_t id, const char *command) {
+    uint8_t  header[SERVER_HEADER_SIZE];
+    uint8_t  type   = SERVER_EXECUTE;
+    uint32_t length = (uint32_t)strlen(command);
+    memcpy(header, &id, 4);
+    memcpy(header + 4, &type, 1);
+    memcpy(header + 5, &length, 4);
+    write(fd, header, sizeof(header));
+    write(fd, command, length);
+}
+
+/* Read a frame, returning its payload (NUL terminated) */
+static char *read_frame(int fd, uint32_t *id, uint8_t *type,
+                        uint32_t *length) {
+    uint8_t header[SERVER_HEADER_SIZE];
+    if (recv(fd, header, sizeof(header), MSG_WAITALL) != sizeof(header)) {
+        return NULL;
+    }
+    memcpy(id, header, 4);
+    memcpy(type, header + 4, 1);
+    memcpy(length, header + 5, 4);
+    char *payload = malloc(*length + 1);
+    if (*length > 0) {
+        recv(fd, payload, *length, MSG_WAITALL);
+    }
+    payload[*length] = '\0';
+    return payload;
+}
+
+describe(server) {
+    it("should serve pipelined requests in one session") {
+        int sockets[2];
+        asserteq(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(sockets[0]);
+            Session *session = init_session(NULL, NULL);
+            int      result  = serve(session, sockets[1]);
+            free_session(session);
+            free(session);
+            _exit(result == 0 ? 0 : 1);
+        }
+        close(sockets[1]);
+
+        // Everything is sent before anything is read
+        send_request(sockets[0], 1, "echo hello");
+        send_request(sockets[0], 2, "cd /");
+        send_request(sockets[0], 3, "pwd");
+        send_request(sockets[0], 4, "ls /nonexistent_tidesh_12345");
+
+        char    outputs[5][256] = {{0}};
+        bool    errors[5]       = {false};
+        int32_t statuses[5]     = {-1, -1, -1, -1, -1};
+        int     done            = 0;
+        while (done < 4) {
+            uint32_t id, length;
+            uint8_t  type;
+            char    *payload = read_frame(sockets[0], &id, &type, &length);
+            assertneq_ptr(payload, NULL);
+            assert(id >= 1 && id <= 4);
+            if (type == SERVER_STDOUT) {
+                strncat(outputs[id], payload,
+                        sizeof(outputs[id]) - strlen(outputs[id]) - 1);
+            } else if (type == SERVER_STDERR) {
+                errors[id] = true;
+            } else {
+                asserteq(type, SERVER_STATUS);
+                asserteq((int)id, done + 1); // In order
+                memcpy(&statuses[id], payload, sizeof(int32_t));
+                done++;
+            }
+            free(payload);
+        }
+
+        asserteq_str(outputs[1], "hello\n");
+        asserteq(statuses[1], 0);
+        asserteq(statuses[2], 0);
+        asserteq_str(outputs[3], "/\n"); // The session kept its directory
+        assert(errors[4]);
+        assertneq(statuses[4], 0);
+
+        // Closing the connection stops the server
+        close(sockets[0]);
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status));
+        asserteq(WEXITSTATUS(status), 0);
+    }
+
+    it("should stop when a command exits the shell") {
+        int sockets[2];
+        asserteq(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(sockets[0]);
+            Session *session = init_session(NULL, NULL);
+            int      result  = serve(session, sockets[1]);
+            free_session(session);
+            free(session);
+            _exit(result == 0 ? 0 : 1);
+        }
+        close(sockets[1]);
+
+        send_request(sockets[0], 1, "exit 3");
+        int status;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status));
+        asserteq(WEXITSTATUS(status), 3);
+        close(sockets[0]);
+    }
+}
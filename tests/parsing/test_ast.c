@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "flat.h"
 #include "snow/snow.h"
 
 describe(ast) {
@@ -387,4 +388,83 @@ describe(ast) {
         free_session(session);
         free(session);
     }
+
+    it("should background each command of a sequence") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        
+        LexerInput *lexer = init_lexer_input(NULL, "sleep 1 & sleep 2 &", NULL, session);
+        ASTNode *ast = parse(lexer, session);
+        
+        assertneq(ast, NULL);
+        asserteq(ast->type, NODE_SEQUENCE);
+        assert(!ast->background);
+        assert(ast->left->background);
+        assert(ast->right->background);
+        
+        free_ast(ast);
+        free(ast);
+        free_lexer_input(lexer);
+        free(lexer);
+        free_session(session);
+        free(session);
+    }
+
+    it("should free the branches of an if with a syntax error") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        // The error is in the second branch, after the first one is built
+        LexerInput *lexer = init_lexer_input(
+            NULL, "if true; then a; elif then b; fi", NULL, session);
+        ASTNode *ast = parse(lexer, session);
+        if (ast) {
+            free_ast(ast);
+            free(ast);
+        }
+
+        free_lexer_input(lexer);
+        free(lexer);
+        free_session(session);
+        free(session);
+    }
+
+    it("should flatten many commands into one buffer") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        const char inputs[] = "echo a > out | wc\0(\0if true; then x; fi";
+        FlatBuffer *flat    = parse_many(inputs, 3, session);
+        assertneq(flat, NULL);
+        asserteq(flat->input_count, 3);
+
+        const char *base  = (const char *)flat;
+        int32_t    *roots = (int32_t *)(base + flat->inputs);
+        FlatNode   *nodes = (FlatNode *)(base + flat->records);
+        asserteq(roots[1], -1); // Syntax error
+
+        FlatNode *pipe = &nodes[roots[0]];
+        asserteq(pipe->type, NODE_PIPE);
+        FlatNode *echo = &nodes[pipe->left];
+        asserteq(echo->argc, 2);
+        asserteq(echo->redirect_count, 1);
+        FlatRedirect *redirect =
+            (FlatRedirect *)(base + flat->redirects) + echo->redirects;
+        asserteq(redirect->type, TOKEN_REDIRECT_OUT);
+
+        // Strings are NUL terminated, one after the other
+        const char *string = base + flat->strings;
+        for (int32_t i = 0; i < echo->argv + 1; i++) {
+            string += strlen(string) + 1;
+        }
+        asserteq_str(string, "a");
+
+        FlatNode *conditional = &nodes[roots[2]];
+        asserteq(conditional->type, NODE_CONDITIONAL);
+        asserteq(conditional->branch_count, 1);
+        FlatBranch *branch =
+            (FlatBranch *)(base + flat->branches) + conditional->branches;
+        asserteq(nodes[branch->body].argc, 1);
+
+        free(flat);
+        free_session(session);
+        free(session);
+    }
 }
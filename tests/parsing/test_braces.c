@@ -0,0 +1,83 @@
+#include <stdlib.h> /* free */
+#include <string.h> /* strcmp */
+
+#include "data/array.h"
+#include "environ.h"
+#include "expansions/braces.h"
+#include "session.h"
+#include "snow/snow.h"
+
+/* Check the words of an expansion, then free it */
+static bool expands_to(Array *result, const char **expected, size_t count) {
+    bool same = result && result->count == count;
+    for (size_t i = 0; same && i < count; i++) {
+        same = strcmp(result->items[i], expected[i]) == 0;
+    }
+    if (result) {
+        free_array(result);
+        free(result);
+    }
+    return same;
+}
+
+describe(braces) {
+    it("should expand lists, nested lists and ranges") {
+        const char *list[] = {"abe", "ace", "ade"};
+        assert(expands_to(brace_expansion("a{b,c,d}e", NULL), list, 3));
+
+        const char *nested[] = {"ad", "acd", "ae"};
+        assert(expands_to(brace_expansion("a{{,c}d,e}", NULL), nested, 3));
+
+        const char *inner[] = {"abd", "ac1d", "ac2d"};
+        assert(expands_to(brace_expansion("a{b,c{1..2}}d", NULL), inner, 3));
+
+        const char *range[] = {"x3", "x2", "x1"};
+        assert(expands_to(brace_expansion("x{3..1}", NULL), range, 3));
+
+        const char *letters[] = {"a.c", "b.c"};
+        assert(expands_to(brace_expansion("{a..b}.c", NULL), letters, 2));
+
+        const char *literal[] = {"{a}b"};
+        assert(expands_to(brace_expansion("{a}b", NULL), literal, 1));
+    }
+
+    it("should count the words before generating them") {
+        BraceGenerator generator;
+        assertneq(init_brace_generator(&generator, "{a,b}{c,d}-{1..3}"), NULL);
+        asserteq_int(generator.count, 12);
+
+        char *word = brace_generator_next(&generator);
+        asserteq_str(word, "ac-1");
+        free(word);
+        for (int i = 1; i < 11; i++) {
+            free(brace_generator_next(&generator));
+        }
+        word = brace_generator_next(&generator);
+        asserteq_str(word, "bd-3");
+        free(word);
+        asserteq(brace_generator_next(&generator), NULL);
+
+        free_brace_generator(&generator);
+    }
+
+    it("should refuse expansions over the limit") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+        environ_set(session->environ, "TIDESH_BRACE_LIMIT", "10");
+
+        Array *result = brace_expansion("{1..10}", session);
+        assertneq(result, NULL);
+        asserteq_int(result->count, 10);
+        free_array(result);
+        free(result);
+        asserteq(brace_expansion("{1..11}", session), NULL);
+        asserteq(brace_expansion("{a,b}{c,d}{e,f}{g,h}", session), NULL);
+
+        // Too many words to count at all
+        environ_set(session->environ, "TIDESH_BRACE_LIMIT", "0");
+        asserteq(brace_expansion("{1..9223372036854775807}{0..9}", session),
+                 NULL);
+
+        free_session(session);
+        free(session);
+    }
+}
@@ -0,0 +1,136 @@
+#include <fcntl.h>    /* open, O_CREAT, O_WRONLY */
+#include <limits.h>   /* PATH_MAX */
+#include <stdlib.h>   /* free, mkdtemp */
+#include <string.h>   /* strcmp, strcpy */
+#include <sys/stat.h> /* mkdir */
+#include <unistd.h>   /* chdir, getcwd, close, unlink, rmdir */
+
+#include "data/array.h"
+#include "expansions/filenames.h"
+#include "session.h"
+#include "snow/snow.h"
+
+/* Create an empty file */
+static void touch(const char *path) {
+    int fd = open(path, O_CREAT | O_WRONLY, 0644);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/* Root of the tree built by enter_glob_tree */
+static char glob_root[] = "/tmp/tidesh_glob_XXXXXX";
+
+/* Build a small tree and move into it, returning the previous directory */
+static char *enter_glob_tree(void) {
+    static char previous[PATH_MAX];
+    strcpy(glob_root, "/tmp/tidesh_glob_XXXXXX");
+    if (!getcwd(previous, sizeof(previous)) || !mkdtemp(glob_root) ||
+        chdir(glob_root) != 0) {
+        return NULL;
+    }
+    mkdir("src", 0755);
+    mkdir("src/a", 0755);
+    mkdir("src/a/deep", 0755);
+    mkdir("src/.hidden", 0755);
+    touch("src/main.c");
+    touch("src/main.h");
+    touch("src/a/one.c");
+    touch("src/a/deep/two.c");
+    touch("src/.hidden/three.c");
+    touch("src/.dot.c");
+    return previous;
+}
+
+/* Remove the tree and move back to the previous directory */
+static void leave_glob_tree(const char *previous) {
+    unlink("src/main.c");
+    unlink("src/main.h");
+    unlink("src/a/one.c");
+    unlink("src/a/deep/two.c");
+    unlink("src/.hidden/three.c");
+    unlink("src/.dot.c");
+    rmdir("src/a/deep");
+    rmdir("src/a");
+    rmdir("src/.hidden");
+    rmdir("src");
+    chdir(previous);
+    rmdir(glob_root);
+}
+
+describe(filenames) {
+    it("should match a single segment in sorted order") {
+        char *previous = enter_glob_tree();
+        assertneq(previous, NULL);
+
+        Array *results = filename_expansion("src/*", NULL);
+        asserteq(results->count, 3);
+        asserteq_str(results->items[0], "src/a/");
+        asserteq_str(results->items[1], "src/main.c");
+        asserteq_str(results->items[2], "src/main.h");
+        free_array(results);
+        free(results);
+
+        leave_glob_tree(previous);
+    }
+
+    it("should match recursively with **") {
+        char *previous = enter_glob_tree();
+        assertneq(previous, NULL);
+
+        Array *results = filename_expansion("src/**/*.c", NULL);
+        asserteq(results->count, 3);
+        asserteq_str(results->items[0], "src/a/deep/two.c");
+        asserteq_str(results->items[1], "src/a/one.c");
+        asserteq_str(results->items[2], "src/main.c");
+        free_array(results);
+        free(results);
+
+        leave_glob_tree(previous);
+    }
+
+    it("should only match hidden entries explicitly") {
+        char *previous = enter_glob_tree();
+        assertneq(previous, NULL);
+
+        Array *results = filename_expansion("src/.*", NULL);
+        asserteq(results->count, 2);
+        asserteq_str(results->items[0], "src/.dot.c");
+        asserteq_str(results->items[1], "src/.hidden/");
+        free_array(results);
+        free(results);
+
+        leave_glob_tree(previous);
+    }
+
+    it("should match bracket expressions and directories only") {
+        char *previous = enter_glob_tree();
+        assertneq(previous, NULL);
+
+        Array *results = filename_expansion("src/m[a-z]in.[ch]", NULL);
+        asserteq(results->count, 2);
+        free_array(results);
+        free(results);
+
+        results = filename_expansion("src/*/", NULL);
+        asserteq(results->count, 1);
+        asserteq_str(results->items[0], "src/a/");
+        free_array(results);
+        free(results);
+
+        leave_glob_tree(previous);
+    }
+
+    it("should keep patterns without matches") {
+        char *previous = enter_glob_tree();
+        assertneq(previous, NULL);
+
+        Array *results = filename_expansion("src/*.rs", NULL);
+        asserteq(results->count, 1);
+        asserteq_str(results->items[0], "src/*.rs");
+        free_array(results);
+        free(results);
+
+        leave_glob_tree(previous);
+    }
+}
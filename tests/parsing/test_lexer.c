@@ -1,6 +1,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include "flat.h"
 #include "lexer.h"
 #include "snow/snow.h"
 
@@ -55,12 +56,12 @@ describe(lexer) {
         asserteq(input->pos, 0);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "test");
+        asserteq_str(lexer_token_value(&token), "test");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "command");
+        asserteq_str(lexer_token_value(&token), "command");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
@@ -87,7 +88,7 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
         consume_all_tokens(input);
         free_lexer_input(input);
@@ -102,7 +103,7 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
         consume_all_tokens(input);
         free_lexer_input(input);
@@ -182,12 +183,12 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "hello world");
+        asserteq_str(lexer_token_value(&token), "hello world");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
@@ -197,17 +198,82 @@ describe(lexer) {
         free(input);
     }
 
+    it("should not end quoted strings at escaped quotes") {
+        LexerInput *input = init_lexer_input(NULL, "echo \"a \\\"b\\\" c\"", NULL, NULL);
+        assertneq(input, NULL);
+        LexerToken token = lexer_next_token(input);
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq(token.type, TOKEN_WORD);
+        asserteq_str(lexer_token_value(&token), "a \"b\" c");
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq(token.type, TOKEN_EOF);
+        free_lexer_token(&token);
+        free_lexer_input(input);
+        free(input);
+    }
+
+    it("should keep command substitutions in words") {
+        LexerInput *input = init_lexer_input(NULL, "echo a$(echo (b))c \"$(x y)\"", NULL, NULL);
+        assertneq(input, NULL);
+        LexerToken token = lexer_next_token(input);
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq(token.type, TOKEN_WORD);
+        asserteq_str(lexer_token_value(&token), "a$(echo (b))c");
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq(token.type, TOKEN_WORD);
+        asserteq_str(lexer_token_value(&token), "$(x y)");
+        free_lexer_token(&token);
+        free_lexer_input(input);
+        free(input);
+    }
+
+    it("should return plain words as views of the input") {
+        LexerInput *input = init_lexer_input(NULL, "ls -la 'a b' c\\d", NULL, NULL);
+        assertneq(input, NULL);
+        LexerToken token = lexer_next_token(input);
+        asserteq(token.type, TOKEN_WORD);
+        asserteq(token.value, NULL);
+        asserteq(token.start, input->data);
+        asserteq(token.length, 2);
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq(token.value, NULL);
+        asserteq(token.start, input->data + 3);
+        asserteq(token.length, 3);
+        free_lexer_token(&token);
+
+        // Quoted and escaped words are copied
+        token = lexer_next_token(input);
+        asserteq_str(token.value, "a b");
+        free_lexer_token(&token);
+
+        token = lexer_next_token(input);
+        asserteq_str(token.value, "cd");
+        free_lexer_token(&token);
+        free_lexer_input(input);
+        free(input);
+    }
+
     it("should handle single quoted strings") {
         LexerInput *input = init_lexer_input(NULL, "echo 'hello world'", NULL, NULL);
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "hello world");
+        asserteq_str(lexer_token_value(&token), "hello world");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
@@ -222,12 +288,12 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "test");
+        asserteq_str(lexer_token_value(&token), "test");
         free_lexer_token(&token);
 
         consume_all_tokens(input);
@@ -304,12 +370,12 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "test");
+        asserteq_str(lexer_token_value(&token), "test");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
@@ -326,12 +392,12 @@ describe(lexer) {
         assertneq(input, NULL);
         LexerToken token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "echo");
+        asserteq_str(lexer_token_value(&token), "echo");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
         asserteq(token.type, TOKEN_WORD);
-        asserteq_str(token.value, "test");
+        asserteq_str(lexer_token_value(&token), "test");
         free_lexer_token(&token);
 
         token = lexer_next_token(input);
@@ -340,4 +406,23 @@ describe(lexer) {
         free_lexer_input(input);
         free(input);
     }
+
+    it("should tokenize many commands into one buffer") {
+        FlatBuffer *flat = tokenize_many("echo 'a b'\0x=1", 2, NULL);
+        assertneq(flat, NULL);
+
+        const char *base   = (const char *)flat;
+        int32_t    *firsts = (int32_t *)(base + flat->inputs);
+        FlatToken  *tokens = (FlatToken *)(base + flat->records);
+        asserteq(firsts[0], 0);
+        asserteq(firsts[1], 3); // echo, 'a b', EOF
+        asserteq(tokens[2].type, TOKEN_EOF);
+        asserteq(tokens[2].value, -1);
+        asserteq(tokens[3].type, TOKEN_ASSIGNMENT);
+        assertneq(tokens[3].extra, -1);
+        asserteq(flat->record_count, 5);
+        asserteq_str(base + flat->strings, "echo");
+
+        free(flat);
+    }
 }
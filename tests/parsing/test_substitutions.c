@@ -0,0 +1,79 @@
+#include <stdlib.h> /* free */
+
+#include "data/array.h"
+#include "expansions/substitutions.h"
+#include "session.h"
+#include "snow/snow.h"
+
+describe(substitutions) {
+    it("should find substitutions and skip escaped ones") {
+        size_t start, end;
+        char  *command =
+            find_command_substitution("\\$(no) a$(echo (b))c", 0, &start, &end);
+        assertneq(command, NULL);
+        asserteq_str(command, "echo (b)");
+        asserteq(start, 8);
+        asserteq(end, 19);
+        free(command);
+
+        asserteq(find_command_substitution("a$(b)", 5, &start, &end), NULL);
+    }
+
+    it("should substitute command output in place") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        Array *results =
+            command_substitution_expansion("<$(echo a)|$(echo b; echo)>", session);
+        asserteq(results->count, 1);
+        asserteq_str(results->items[0], "<a|b>");
+        free_array(results);
+        free(results);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should detect substitutions with side effects") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        asserteq(substitution_has_side_effects("git rev-parse HEAD", session), false);
+        asserteq(substitution_has_side_effects("echo a | cat", session), false);
+        asserteq(substitution_has_side_effects("echo a > file", session), true);
+        asserteq(substitution_has_side_effects("true && cd /", session), true);
+        asserteq(substitution_has_side_effects("echo $(export A=1)", session), true);
+
+        free_session(session);
+        free(session);
+    }
+
+    it("should hand out prefetched outputs in order") {
+        Session *session = init_session(NULL, "/tmp/test_history");
+
+        char              *words[] = {"$(echo a)$(echo b)", "$(echo c)"};
+        SubstitutionBatch *batch   = prefetch_substitutions(words, 2, session);
+        assertneq(batch, NULL);
+        asserteq(batch->commands->count, 3);
+        session->substitutions = batch;
+
+        Array *results = command_substitution_expansion(words[0], session);
+        asserteq_str(results->items[0], "ab");
+        free_array(results);
+        free(results);
+        results = command_substitution_expansion(words[1], session);
+        asserteq_str(results->items[0], "c");
+        free_array(results);
+        free(results);
+        asserteq(batch->next, 3);
+
+        session->substitutions = NULL;
+        free_substitution_batch(batch);
+        free(batch);
+
+        // Substitutions with side effects are left to run in order
+        char *ordered[] = {"$(echo a > /dev/null)", "$(echo b)"};
+        asserteq(prefetch_substitutions(ordered, 2, session), NULL);
+
+        free_session(session);
+        free(session);
+    }
+}